@@ -0,0 +1,61 @@
+// audio_backend.h
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include <glib.h>
+#include <portaudio.h>
+#include <stdbool.h>
+
+// Hardware-free backends that stand in for a PortAudio stream. Each one runs
+// its own thread and drives the same PaStreamCallback the real device uses,
+// so the full pipeline behaves identically with or without a sound card.
+typedef enum {
+    AUDIO_BACKEND_PORTAUDIO,     // Real device through PortAudio
+    AUDIO_BACKEND_NULL,          // Discards output at exact wall-clock rate
+    AUDIO_BACKEND_NULL_FREERUN,  // Discards output as fast as it is produced
+    AUDIO_BACKEND_LOOPBACK,      // Wall-clock rate, output fed back as capture input
+    AUDIO_BACKEND_FILE           // Writes output to a sound file as fast as it is produced
+} AudioBackendType;
+
+#define AUDIO_BACKEND_DEFAULT_FILE "waveform_output.wav"
+
+// Readiness hook for the free-running backends: blocks until at least
+// `frames` can be consumed or the timeout expires. Returns false on timeout.
+typedef bool (*AudioBackendWaitFunc)(void *user_data, size_t frames, gint64 timeout_us);
+
+struct AudioBackend {
+    AudioBackendType type;
+    char *file_path;
+    int sample_rate;
+    int channels;
+    unsigned long frames_per_buffer;
+
+    PaStreamCallback *callback;
+    AudioBackendWaitFunc wait_ready;
+    void *user_data;
+
+    GThread *thread;
+    gint running;              // Accessed atomically
+    float *output;
+    void *file;                // SNDFILE handle for AUDIO_BACKEND_FILE
+    int timer_fd;
+    guint64 frames_processed;
+    gint64 start_time;         // Monotonic start time in microseconds
+};
+
+typedef struct AudioBackend AudioBackend;
+
+// Function declarations
+AudioBackend* audio_backend_open(AudioBackendType type, const char *file_path,
+                                 int sample_rate, int channels,
+                                 unsigned long frames_per_buffer,
+                                 PaStreamCallback *callback,
+                                 AudioBackendWaitFunc wait_ready,
+                                 void *user_data);
+bool audio_backend_start(AudioBackend *backend);
+void audio_backend_stop(AudioBackend *backend);
+void audio_backend_close(AudioBackend *backend);
+const char* audio_backend_name(AudioBackendType type);
+bool audio_backend_parse(const char *spec, AudioBackendType *type, char **file_path);
+
+#endif // AUDIO_BACKEND_H
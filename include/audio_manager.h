@@ -4,17 +4,18 @@
 #include <gtk/gtk.h>
 #include <portaudio.h>
 #include <stdbool.h>
-#include "common_defs.h"  // For AUDIO_BUFFER_SIZE and SAMPLE_RATE
+#include "common_defs.h"  // For AUDIO_BUFFER_SIZE and DEFAULT_SAMPLE_RATE
+#include "audio_backend.h"
+#include "audio_telemetry.h"
 
-// Buffer management constants
+// Buffer management constants, in frames at the negotiated sample rate
 #define CIRCULAR_BUFFER_MS 100
-#define CIRCULAR_BUFFER_FRAMES ((SAMPLE_RATE * CIRCULAR_BUFFER_MS) / 1000)
-#define BUFFER_LOW_WATERMARK ((size_t)(CIRCULAR_BUFFER_FRAMES / 4))
-#define BUFFER_HIGH_WATERMARK ((size_t)(CIRCULAR_BUFFER_FRAMES * 3 / 4))
+#define CIRCULAR_BUFFER_FRAMES(rate) (((size_t)(rate) * CIRCULAR_BUFFER_MS) / 1000)
+#define BUFFER_LOW_WATERMARK(rate) ((size_t)(CIRCULAR_BUFFER_FRAMES(rate) / 4))
+#define BUFFER_HIGH_WATERMARK(rate) ((size_t)(CIRCULAR_BUFFER_FRAMES(rate) * 3 / 4))
 #define TARGET_WRITE_INTERVAL_MS 4
-#define MIN_BUFFER_FILL ((size_t)(AUDIO_BUFFER_SIZE))
-#define BUFFER_DURATION_MS ((AUDIO_BUFFER_SIZE * 1000.0) / SAMPLE_RATE)
-//#define MIN_BUFFER_FILL ((size_t)(AUDIO_BUFFER_SIZE * 2))  // Double the minimum requirement
+#define MIN_BUFFER_FILL ((size_t)(AUDIO_BUFFER_SIZE))  // Until the first callback reports its size
+#define BUFFER_DURATION_MS(frames, rate) (((frames) * 1000.0) / (rate))
 
 
 // Forward declarations
@@ -30,15 +31,22 @@ typedef struct {
 } AudioDeviceInfo;
 
 typedef struct {
-    float *data;
-    size_t size;
+    float *data;             // From the memory pool
+    size_t capacity;         // Floats data holds; only ever grows
+    size_t size;             // In frames
+    int channels;            // Interleaved samples per frame
     size_t read_pos;
     size_t write_pos;
     size_t frames_stored;
+    size_t min_fill;         // Output silence below this; tracks the callback size
     GMutex mutex;
     GCond data_ready;
+    GCond data_written;
     gint64 last_callback_time;
     guint callback_count;
+    size_t underruns;        // Reads that found less than requested
+    size_t overruns;         // Writes that found the buffer full
+    size_t dropped_frames;   // Frames lost to overruns
 } CircularBuffer;
 
 struct AudioManager {
@@ -47,13 +55,32 @@ struct AudioManager {
     AudioDataCallback data_callback;
     void *callback_data;
     GMutex mutex;
-    int sample_rate;
-    int channels;
+    int sample_rate;                 // Negotiated at stream open
+    int requested_sample_rate;
+    unsigned long frames_per_buffer; // 0 lets the host choose (paFramesPerBufferUnspecified)
+    int channels;                    // Negotiated at stream open
+    int requested_channels;          // 0 asks for every channel the device has
     char *selected_device;
     PaDeviceIndex output_device;
     CircularBuffer buffer;
     GArray *available_devices;
     bool devices_updated;
+
+    // Backend selection; anything other than PortAudio runs hardware-free
+    AudioBackendType backend_type;
+    char *backend_path;
+    AudioBackend *virtual_stream;
+    bool pa_initialized;
+
+    // Capture as (played, captured) sample pairs of channel 0
+    int input_channels;              // Of the open stream; 0 when it has no input
+    bool capture_enabled;
+    CircularBuffer capture;
+    float *capture_scratch;
+
+    // Written by the audio callback, readable from any thread without locking it
+    AudioTelemetry telemetry;
+    double output_latency_ms;
 };
 
 typedef struct AudioManager AudioManager;
@@ -68,12 +95,22 @@ bool audio_manager_get_cached_devices(struct AudioManager *manager, char ***devi
                                     char ***device_descriptions, int *count);
 bool audio_manager_switch_device(struct AudioManager *manager, const char *device_name);
 bool audio_manager_is_playback_active(struct AudioManager *manager);
+void audio_manager_set_format(struct AudioManager *manager, int sample_rate, unsigned long frames_per_buffer);
+int audio_manager_get_sample_rate(struct AudioManager *manager);
+void audio_manager_set_channels(struct AudioManager *manager, int channels);
+int audio_manager_get_channels(struct AudioManager *manager);
+AudioBackendType audio_manager_get_backend(struct AudioManager *manager);
+size_t audio_manager_read_capture(struct AudioManager *manager, float *pairs, size_t frames);
+void audio_manager_get_telemetry(struct AudioManager *manager, AudioTelemetrySnapshot *snapshot);
+void audio_manager_reset_telemetry(struct AudioManager *manager);
 
 // Circular buffer functions
-void circular_buffer_init(CircularBuffer *buffer, size_t size_in_frames);
+void circular_buffer_init(CircularBuffer *buffer, size_t size_in_frames, int channels);
 void circular_buffer_destroy(CircularBuffer *buffer);
 void circular_buffer_clear(CircularBuffer *buffer);
+void circular_buffer_resize(CircularBuffer *buffer, size_t size_in_frames, int channels);
 size_t circular_buffer_write(CircularBuffer *buffer, float *data, size_t frames);
 size_t circular_buffer_read(CircularBuffer *buffer, float *data, size_t frames);
+size_t circular_buffer_drain(CircularBuffer *buffer, float *data, size_t max_frames);
 
 #endif // AUDIO_MANAGER_H
@@ -0,0 +1,62 @@
+// audio_telemetry.h
+#ifndef AUDIO_TELEMETRY_H
+#define AUDIO_TELEMETRY_H
+
+#include <glib.h>
+#include <stddef.h>
+
+// Callback interval histogram: fixed-width bins, the last one catches overflow
+#define TELEMETRY_HIST_BINS 64
+#define TELEMETRY_HIST_BIN_US 250
+
+typedef struct {
+    guint64 callbacks;
+    guint64 output_underflows;    // paOutputUnderflow reported by the device
+    guint64 output_overflows;     // paOutputOverflow reported by the device
+    guint64 ring_underruns;       // Callback found the output ring short
+    guint64 ring_overruns;        // Producer hit a full output ring
+    guint64 dropped_frames;       // Frames the producer could not write
+
+    guint32 interval_hist[TELEMETRY_HIST_BINS];
+    double interval_min_ms;
+    double interval_max_ms;
+    double interval_avg_ms;
+
+    size_t fill_min;              // Output ring fill seen by the callback, in frames
+    size_t fill_max;
+    double fill_avg;
+
+    double callback_load;         // Callback run time over period, smoothed
+    double cpu_load;              // Pa_GetStreamCpuLoad, or callback_load without PortAudio
+    double output_latency_ms;     // As reported when the stream was opened
+    int sample_rate;
+    unsigned long frames_per_buffer;
+} AudioTelemetrySnapshot;
+
+// Single writer (the audio callback), any number of readers. Readers never
+// block the writer: they retry if the sequence changed while copying.
+struct AudioTelemetry {
+    gint sequence;                // Odd while an update is in progress
+    gint reset_requested;
+    AudioTelemetrySnapshot data;
+    guint64 interval_count;
+    double interval_sum_ms;
+    double fill_sum;
+    size_t ring_base[3];          // Ring counters at the last reset
+};
+
+typedef struct AudioTelemetry AudioTelemetry;
+
+// Function declarations
+void audio_telemetry_init(AudioTelemetry *telemetry);
+void audio_telemetry_record(AudioTelemetry *telemetry, gint64 interval_us, gint64 run_time_us,
+                            size_t fill_frames, size_t ring_underruns, size_t ring_overruns,
+                            size_t dropped_frames, unsigned long status_flags,
+                            int sample_rate, unsigned long frames);
+void audio_telemetry_read(AudioTelemetry *telemetry, AudioTelemetrySnapshot *snapshot);
+void audio_telemetry_request_reset(AudioTelemetry *telemetry);
+guint64 audio_telemetry_xrun_count(AudioTelemetry *telemetry);
+double audio_telemetry_interval_percentile(const AudioTelemetrySnapshot *snapshot, double percentile);
+void audio_telemetry_print(const AudioTelemetrySnapshot *snapshot);
+
+#endif // AUDIO_TELEMETRY_H
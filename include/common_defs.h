@@ -1,9 +1,12 @@
 #ifndef COMMON_DEFS_H
 #define COMMON_DEFS_H
 
-// Audio and waveform settings
-#define SAMPLE_RATE 48000
-#define AUDIO_BUFFER_SIZE 256     // Small buffer for low latency audio
+// Audio and waveform settings; rate and block size are negotiated at stream open
+#define DEFAULT_SAMPLE_RATE 48000
+#define AUDIO_BUFFER_SIZE 256     // Default frames per device buffer
+#define MAX_BLOCK_SIZE 1024       // Largest block the generator renders at once
+#define DEFAULT_OUTPUT_CHANNELS 2
+#define MAX_OUTPUT_CHANNELS 32    // Upper bound on channels rendered per frame
 #define SCOPE_BUFFER_SIZE 4096    // Larger buffer for smooth display
 #define UPDATE_INTERVAL_MS 32     // Visual update interval
 
@@ -27,6 +27,37 @@ struct ControlPanel {
     GtkWidget *filter_cutoff_lfo_amount_dial;
     GtkWidget *filter_res_lfo_freq_dial;
     GtkWidget *filter_res_lfo_amount_dial;
+
+    // Per-channel relationship to the main waveform
+    GtkWidget *channel_spin;
+    GtkWidget *channel_ratio_dial;
+    GtkWidget *channel_phase_dial;
+    GtkWidget *channel_gain_dial;
+    GtkWidget *channel_freq_dial;
+    int selected_channel;
+
+    // Modulation matrix: one source and one route edited at a time
+    GtkWidget *mod_source_spin;
+    GtkWidget *mod_shape_combo;
+    GtkWidget *mod_rate_dial;
+    GtkWidget *mod_route_spin;
+    GtkWidget *mod_route_source_combo;
+    GtkWidget *mod_route_dest_combo;
+    GtkWidget *mod_depth_dial;
+    int selected_mod_source;
+    int selected_mod_route;
+    gboolean loading_mod;   // Suppresses writes while a selection loads
+
+    // Sweep settings, applied when Start is pressed
+    GtkWidget *sweep_type_combo;
+    GtkWidget *sweep_start_dial;
+    GtkWidget *sweep_end_dial;
+    GtkWidget *sweep_duration_dial;
+    GtkWidget *sweep_steps_dial;
+    GtkWidget *sweep_settle_dial;
+    GtkWidget *sweep_dwell_dial;
+    GtkWidget *sweep_loop_check;
+    GtkWidget *sweep_start_button;
 };
 
 typedef struct ControlPanel ControlPanel;
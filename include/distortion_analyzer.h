@@ -0,0 +1,66 @@
+// distortion_analyzer.h
+#ifndef DISTORTION_ANALYZER_H
+#define DISTORTION_ANALYZER_H
+
+#include <glib.h>
+#include "fft_analyzer.h"
+
+#define DISTORTION_MAX_HARMONICS 10
+#define DISTORTION_MIN_LEVEL_DB -100.0f   // Fundamentals below this are not measured
+
+// Bin classes in the cached mask: the harmonic order for the fundamental
+// (1) and its harmonics, otherwise noise or outside the bandwidth
+#define DISTORTION_BIN_NOISE 0
+#define DISTORTION_BIN_FUNDAMENTAL 1
+#define DISTORTION_BIN_EXCLUDED 255
+
+typedef struct {
+    int harmonics;          // Highest order counted in THD, 2..DISTORTION_MAX_HARMONICS
+    int lobe_bins;          // Half-width of each tone's band; 5 holds a Blackman-Harris main lobe
+    float low_freq;         // Measurement bandwidth, Hz
+    float high_freq;
+} DistortionConfig;
+
+typedef struct {
+    gboolean valid;
+    float fundamental_freq;     // Interpolated, Hz
+    float fundamental_dbfs;     // Full-scale sine is 0 dBFS
+    float thd_percent;
+    float thd_db;
+    float thdn_percent;
+    float thdn_db;
+    float sinad_db;
+    float snr_db;
+    float enob;
+    float harmonic_db[DISTORTION_MAX_HARMONICS + 1];   // By order, relative to the fundamental
+    int num_harmonics;          // Orders 2..num_harmonics fit below the bandwidth limit
+} DistortionResult;
+
+struct DistortionAnalyzer {
+    DistortionConfig config;
+
+    // Bin classes for the last fundamental; rebuilt only when the FFT size,
+    // sample rate, fundamental bin or config change
+    guint8 *mask;               // FFT_SIZE / 2 + 1 bins, from the memory pool
+    size_t mask_size;
+    float mask_rate;
+    long mask_fundamental;      // In eighths of a bin, so harmonic bands stay aligned
+    gboolean mask_valid;
+    size_t band_bins;           // In-band bins, DC excluded
+    size_t noise_bins;          // Of those, the ones no tone claims
+    size_t lobe_count[DISTORTION_MAX_HARMONICS + 1];
+
+    DistortionResult result;
+};
+
+typedef struct DistortionAnalyzer DistortionAnalyzer;
+
+// Function declarations
+void distortion_config_default(DistortionConfig *config);
+DistortionAnalyzer* distortion_analyzer_create(void);
+void distortion_analyzer_destroy(DistortionAnalyzer *analyzer);
+void distortion_analyzer_set_config(DistortionAnalyzer *analyzer, const DistortionConfig *config);
+gboolean distortion_analyzer_process(DistortionAnalyzer *analyzer, const struct FFTAnalyzer *fft,
+                                     float sample_rate);
+
+#endif // DISTORTION_ANALYZER_H
@@ -9,24 +9,57 @@
 #define WINDOW_SIZE FFT_SIZE
 #define MIN_DB -80.0f
 #define MAX_DB 0.0f
+#define FFT_MAX_PEAKS 8
+#define FFT_PEAK_THRESHOLD_DB -90.0f   // dBFS
+#define FFT_PEAK_MATCH_BINS 2.0f       // Largest move between frames that keeps a peak's id
+
+typedef enum {
+   FFT_WINDOW_HANN,
+   FFT_WINDOW_BLACKMAN_HARRIS   // 4-term, -92 dB sidelobes; for distortion measurement
+} FFTWindowType;
+
+// Local maximum of the last frame, refined between bins
+typedef struct {
+   int id;                 // Stays the same while the peak is tracked across frames
+   int age;                // Frames tracked
+   float bin;              // Fractional bin
+   float frequency;        // Hz
+   float magnitude_db;     // On the display's scale
+   float level_dbfs;       // Amplitude of the sine it belongs to
+} FFTPeak;
 
 struct FFTAnalyzer {
-   fftw_plan plan;
-   double *window;
-   double *input;
-   fftw_complex *output;
+   fftwf_plan plan;
+   float *window;
+   FFTWindowType window_type;
+   float *input;
+   fftwf_complex *output;
    float *magnitudes;
    float *smoothed_mags;
+   float *power;           // Unsmoothed |X|^2 of the last frame; a full-scale sine's lobe sums to 0.25
    size_t size;
    double window_power;
+   double coherent_gain;   // Mean of the window
+
+   FFTPeak peaks[FFT_MAX_PEAKS];   // Strongest first
+   int num_peaks;
+   int next_peak_id;
 };
 
 typedef struct FFTAnalyzer FFTAnalyzer;
 
+// The FFTW planner is not thread-safe. Every fftwf_plan_* and
+// fftwf_destroy_plan call in the program holds this lock; executing a
+// plan does not need it.
+void fft_planner_lock(void);
+void fft_planner_unlock(void);
+
 // Function declarations
 struct FFTAnalyzer* fft_analyzer_create(void);
 void fft_analyzer_destroy(struct FFTAnalyzer *analyzer);
+void fft_analyzer_set_window(struct FFTAnalyzer *analyzer, FFTWindowType type);
 void fft_analyzer_process(struct FFTAnalyzer *analyzer, const float *buffer, size_t buffer_size);
+int fft_analyzer_find_peaks(struct FFTAnalyzer *analyzer, float sample_rate);
 size_t fft_analyzer_freq_to_bin(struct FFTAnalyzer *analyzer, float freq, float sample_rate);
 float fft_analyzer_bin_to_freq(struct FFTAnalyzer *analyzer, size_t bin, float sample_rate);
 
@@ -0,0 +1,51 @@
+// latency_controller.h
+#ifndef LATENCY_CONTROLLER_H
+#define LATENCY_CONTROLLER_H
+
+#include <glib.h>
+#include <stddef.h>
+#include "audio_manager.h"
+
+// Controller tuning
+#define LATENCY_MIN_BLOCK 64                 // Smallest producer block in frames
+#define LATENCY_BLOCK_ALIGN 16               // Block sizes are multiples of this
+#define LATENCY_QUIET_PERIOD_US 2000000      // Underrun-free time before tightening
+#define LATENCY_START_GRACE_US 250000        // Ignore priming underruns after start
+#define LATENCY_STEP_DOWN_DIVISOR 8          // Tighten by 1/8 of the target per step
+#define LATENCY_START_TARGET ((size_t)(AUDIO_BUFFER_SIZE * 2))  // The old fixed two-block fill
+
+// Adjusts the output ring target fill and producer block size at runtime.
+// Underruns widen the margin immediately; a long quiet period with unused
+// headroom tightens it again. Only the producer thread updates it; the
+// published values may be read from any thread.
+struct LatencyController {
+    size_t min_target;       // Never aim below this fill
+    size_t max_target;       // Never aim above this fill
+    size_t target_fill;      // Producer keeps the ring at least this full
+    size_t block_size;       // Frames generated per producer iteration
+    size_t max_block;
+
+    gint64 last_update;      // Monotonic time of the last evaluation
+    gint64 quiet_since;      // Last underrun or adjustment
+    gint64 grace_until;      // Underruns before this are priming, not xruns
+    guint64 last_xruns;
+    size_t window_min_fill;  // Lowest fill seen since the last adjustment
+
+    gint published_target;   // Atomic copies for readers on other threads
+    gint published_block;
+    gint adjustments;
+};
+
+typedef struct LatencyController LatencyController;
+
+// Function declarations
+void latency_controller_init(LatencyController *controller, size_t max_block);
+void latency_controller_configure(LatencyController *controller, int sample_rate, size_t min_fill);
+void latency_controller_reset(LatencyController *controller, guint64 xruns, gint64 now);
+void latency_controller_update(LatencyController *controller, size_t fill,
+                               guint64 xruns, gint64 now);
+size_t latency_controller_target(LatencyController *controller);
+size_t latency_controller_block(LatencyController *controller);
+void latency_controller_print(LatencyController *controller, int sample_rate);
+
+#endif // LATENCY_CONTROLLER_H
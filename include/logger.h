@@ -0,0 +1,91 @@
+// logger.h
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <glib.h>
+
+typedef enum {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_NONE
+} LogLevel;
+
+// Calls below this level compile to nothing, e.g. -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+#define LOG_RING_SIZE 256               // Records per thread, power of two
+#define LOG_MAX_THREADS 128
+#define LOG_MAX_ARGS 8                  // Including '*' widths and precisions
+#define LOG_TEXT_SIZE 104               // Room for copies of %s arguments
+#define LOG_TRUNCATED_TEXT "[...]"      // Ends a %s argument that did not fit
+#define LOG_DRAIN_INTERVAL_MS 20
+#define LOG_LINE_LENGTH 512
+
+// Arguments are kept as they were passed and only formatted by the
+// drainer; strings are copied into text, so args holds their offset
+typedef union {
+    gint64 i;
+    double d;
+    const void *p;
+} LogArg;
+
+typedef struct {
+    gint64 time_us;
+    const char *format;         // A literal, read when the record is drained
+    guint8 level;
+    guint8 num_args;
+    gboolean truncated;         // Arguments past LOG_MAX_ARGS were not kept
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+} LogRecord;
+
+// Written only by the thread that owns it, read only by the drainer
+typedef struct {
+    gint head;                  // Next record to drain
+    gint tail;                  // Next record to write
+    gint owned;                 // Claimed by a running thread
+    gint dropped;               // Records lost to a full ring, not yet reported
+    LogRecord records[LOG_RING_SIZE];
+} LogRing;
+
+// Threads claim a ring on their first message and hand it back when they
+// exit; writing never takes a lock or makes a system call. A background
+// thread merges the rings in time order and writes them to stdout.
+struct Logger {
+    gint level;
+    gint running;
+    LogRing *rings[LOG_MAX_THREADS];
+    gint dropped;               // Messages from threads that found no free ring
+    gint64 start_us;
+
+    GThread *drainer;
+    GMutex mutex;
+    GCond wake;
+    gboolean quit;
+};
+
+typedef struct Logger Logger;
+
+#define LOG_AT(level, ...) \
+    do { \
+        if ((level) >= LOG_COMPILE_LEVEL) logger_write((level), __VA_ARGS__); \
+    } while (0)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Function declarations
+void logger_init(void);
+void logger_shutdown(void);
+void logger_set_level(LogLevel level);
+gboolean logger_parse_level(const char *name, LogLevel *level);
+void logger_thread_init(void);
+void logger_write(LogLevel level, const char *format, ...) G_GNUC_PRINTF(2, 3);
+
+#endif // LOGGER_H
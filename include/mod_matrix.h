@@ -0,0 +1,86 @@
+// mod_matrix.h
+#ifndef MOD_MATRIX_H
+#define MOD_MATRIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOD_MAX_SOURCES 8
+#define MOD_MAX_ROUTES 16
+#define MOD_CONTROL_INTERVAL 32   // Samples between modulation evaluations
+
+typedef enum {
+    MOD_SHAPE_SINE,
+    MOD_SHAPE_TRIANGLE,
+    MOD_SHAPE_SAW,
+    MOD_SHAPE_SQUARE,
+    MOD_SHAPE_SAMPLE_HOLD,      // New random level every period
+    MOD_SHAPE_DECAY,            // Exponential decay envelope, retriggered every period
+    MOD_SHAPE_COUNT
+} ModShape;
+
+// Destinations keep the semantics of the fixed paths they replace
+typedef enum {
+    MOD_DEST_PITCH,             // Frequency multiplier 1 + sum (was FM)
+    MOD_DEST_AMPLITUDE,         // Gain multiplier 1 + sum (was AM)
+    MOD_DEST_DUTY,              // Added to duty cycle, clamped to [0.1, 0.9] (was DCM)
+    MOD_DEST_CUTOFF,            // Fraction of (cutoff - 20 Hz) added to cutoff
+    MOD_DEST_RESONANCE,         // Added to resonance
+    MOD_DEST_COUNT
+} ModDestination;
+
+typedef struct {
+    ModShape shape;
+    float frequency;            // Hz; 0 disables the source and its routes
+} ModSource;
+
+typedef struct {
+    int source;                 // -1 leaves the route unused
+    ModDestination destination;
+    float depth;
+} ModRoute;
+
+// User-facing configuration, stored in the ParameterStore
+typedef struct {
+    ModSource sources[MOD_MAX_SOURCES];
+    ModRoute routes[MOD_MAX_ROUTES];
+} ModMatrix;
+
+typedef struct {
+    int source;
+    int destination;
+    float depth;
+} ModOp;
+
+// Active routes flattened at block start: evaluation is a straight
+// multiply-add per op with no per-route checks, and only the sources the
+// ops read are evaluated
+typedef struct {
+    ModOp ops[MOD_MAX_ROUTES];
+    int num_ops;
+    int used_sources[MOD_MAX_SOURCES];
+    int num_used;
+    ModShape shapes[MOD_MAX_SOURCES];
+    float frequency[MOD_MAX_SOURCES];
+    unsigned dest_mask;         // Bit per destination with at least one op
+} ModProgram;
+
+// Per-oscillator source state; the program is shared between oscillators
+typedef struct {
+    float phase[MOD_MAX_SOURCES];     // Cycles, [0, 1)
+    float held[MOD_MAX_SOURCES];      // Current sample-and-hold level
+    uint32_t rng;
+} ModState;
+
+// Function declarations
+void mod_matrix_init(ModMatrix *matrix);
+void mod_program_compile(ModProgram *program, const ModMatrix *matrix);
+void mod_state_reset(ModState *state, uint32_t seed);
+void mod_program_evaluate(const ModProgram *program, const ModState *state,
+                          float dest[MOD_DEST_COUNT]);
+void mod_program_advance(const ModProgram *program, ModState *state,
+                         size_t frames, float inv_sample_rate);
+const char* mod_shape_name(ModShape shape);
+const char* mod_destination_name(ModDestination destination);
+
+#endif // MOD_MATRIX_H
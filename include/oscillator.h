@@ -0,0 +1,60 @@
+// oscillator.h
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "parameter_store.h"
+#include "mod_matrix.h"
+#include "pink_noise.h"
+
+#define FILTER_STAGES 4
+
+typedef struct {
+    float delay[FILTER_STAGES];
+} LadderFilter;
+
+// Coefficients derived from cutoff and resonance; recomputed only when
+// those change, at most once per modulation interval
+typedef struct {
+    float p;          // One-pole coefficient
+    float feedback;   // Resonance feedback gain
+    float comp;       // Resonance gain compensation
+    float drive;      // Saturation drive
+} LadderCoeffs;
+
+// Parameters for one block of one channel, resolved from the shared
+// waveform settings and that channel's ChannelConfig
+typedef struct {
+    WaveformType waveform;
+    float frequency;
+    float amplitude;
+    float phase_offset;      // Radians, added when the waveform is evaluated
+    float duty_cycle;
+    float filter_cutoff;
+    float filter_resonance;
+    float frequency_end;     // Reached at the end of the block: linear ramps
+    float amplitude_end;     // from frequency and amplitude, equal when steady
+    const ModProgram *mod;   // Compiled once per block, shared by all instances
+} OscillatorParams;
+
+// Complete state of one output channel's generator. Owned by the thread
+// that renders it, so it carries no lock.
+typedef struct {
+    float phase;           // Current phase
+    ModState mod;          // Modulation source phases
+    LadderFilter filter;
+    float pink[PINK_NOISE_POLES];   // Same filter as the voice engine lanes
+    uint32_t noise_seed;   // Restored into noise_state on reset
+    uint32_t noise_state;  // xorshift32, never zero
+} Oscillator;
+
+// Function declarations
+void ladder_filter_coeffs(LadderCoeffs *coeffs, float cutoff, float resonance,
+                          float sample_rate);
+void oscillator_seed(Oscillator *osc, uint32_t seed);
+void oscillator_reset(Oscillator *osc);
+void oscillator_render(Oscillator *osc, const OscillatorParams *params, float *out,
+                       size_t frames, float sample_rate, float phase_scale);
+
+#endif // OSCILLATOR_H
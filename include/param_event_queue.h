@@ -0,0 +1,95 @@
+// param_event_queue.h
+#ifndef PARAM_EVENT_QUEUE_H
+#define PARAM_EVENT_QUEUE_H
+
+#include <glib.h>
+#include <stdbool.h>
+
+#define PARAM_EVENT_QUEUE_SIZE 1024   // Power of two
+#define PARAM_RAMP_INTERVAL 32        // Longest span with a held value while ramping
+
+// Parameters that can be automated with sample accuracy
+typedef enum {
+    PARAM_FREQUENCY,
+    PARAM_AMPLITUDE,
+    PARAM_DUTY_CYCLE,
+    PARAM_FILTER_CUTOFF,
+    PARAM_FILTER_RESONANCE,
+    PARAM_COUNT
+} ParamId;
+
+typedef enum {
+    PARAM_RAMP_STEP,          // Jump at sample_time
+    PARAM_RAMP_LINEAR,
+    PARAM_RAMP_EXPONENTIAL    // Falls back to linear unless both ends share a sign
+} ParamRampShape;
+
+typedef struct {
+    guint64 sample_time;      // On the generator's sample clock
+    ParamId param;
+    float value;              // Reached at sample_time + ramp_frames
+    guint32 ramp_frames;
+    ParamRampShape shape;
+    guint32 tag;              // Nonzero: reported by param_event_queue_read_applied
+} ParamEvent;
+
+// When a tagged event took effect, for timing logs
+typedef struct {
+    guint32 tag;
+    guint64 sample_time;      // When it was due
+    guint64 applied_time;     // Frame it took effect on; later when it arrived late
+} ParamEventApplied;
+
+typedef struct {
+    gint sequence;            // Slot state for the ring, see param_event_queue.c
+    ParamEvent event;
+} ParamEventSlot;
+
+// Automation state of one parameter. An engaged lane overrides the
+// ParameterStore value until the store value itself changes.
+typedef struct {
+    float value;
+    float target;
+    float step;               // Per frame: added when linear, multiplied when exponential
+    guint32 remaining;        // Frames left in the ramp
+    ParamRampShape shape;
+    gboolean engaged;
+    float store_value;        // Store value when the lane engaged
+} ParamLane;
+
+// Any number of producers push without locking; the render thread is the
+// only consumer and owns everything below the ring
+struct ParamEventQueue {
+    ParamEventSlot slots[PARAM_EVENT_QUEUE_SIZE];
+    gint tail;
+    gint head;
+
+    ParamEvent pending[PARAM_EVENT_QUEUE_SIZE];   // Drained events, sorted by time
+    int num_pending;
+    ParamLane lanes[PARAM_COUNT];
+
+    // Written by the render thread, readable from any thread
+    ParamEventApplied applied[PARAM_EVENT_QUEUE_SIZE];   // Tagged events, see publish_ring.h
+    gint applied_written;
+    gint late_events;         // Applied after their sample time had passed
+};
+
+typedef struct ParamEventQueue ParamEventQueue;
+
+// Function declarations
+ParamEventQueue* param_event_queue_create(void);
+void param_event_queue_destroy(ParamEventQueue *queue);
+bool param_event_queue_push(ParamEventQueue *queue, const ParamEvent *event);
+int param_event_queue_read_applied(ParamEventQueue *queue, gint *cursor,
+                                   ParamEventApplied *out, int max);
+int param_event_queue_late_events(ParamEventQueue *queue);
+const char* param_id_name(ParamId param);
+
+// Render thread only
+void param_event_queue_begin(ParamEventQueue *queue, const float store_values[PARAM_COUNT]);
+void param_event_queue_apply(ParamEventQueue *queue, guint64 now);
+size_t param_event_queue_span(ParamEventQueue *queue, guint64 now, size_t max_frames);
+void param_event_queue_values(const ParamEventQueue *queue, float values[PARAM_COUNT]);
+void param_event_queue_advance(ParamEventQueue *queue, size_t frames);
+
+#endif // PARAM_EVENT_QUEUE_H
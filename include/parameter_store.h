@@ -2,15 +2,38 @@
 #define PARAMETER_STORE_H
 
 #include <glib.h>
+#include "common_defs.h"
+#include "mod_matrix.h"
+#include "sweep.h"
 
 typedef enum {
     WAVE_SINE,
     WAVE_SQUARE,
     WAVE_SAW,
     WAVE_TRIANGLE,
-    WAVE_PINK_NOISE
+    WAVE_PINK_NOISE,
+    WAVE_SWEEP            // Measurement sweep from ParameterStore.sweep
 } WaveformType;
 
+// How one output channel relates to the main waveform settings
+typedef struct {
+    float frequency;      // Fixed frequency in Hz; 0 follows the main frequency
+    float freq_ratio;     // Multiplier on the main frequency
+    float phase_offset;   // Degrees
+    float gain;           // Linear, on top of the main amplitude
+} ChannelConfig;
+
+// Matrix slots driven by the fixed FM/AM/DCM/filter LFO controls: each
+// owns the source and the route with the same index. Later slots are free.
+enum {
+    MOD_SLOT_FM,
+    MOD_SLOT_AM,
+    MOD_SLOT_DCM,
+    MOD_SLOT_CUTOFF_LFO,
+    MOD_SLOT_RES_LFO,
+    MOD_SLOT_USER
+};
+
 struct ParameterStore {
     GMutex mutex;
     GCond changed;
@@ -36,6 +59,16 @@ struct ParameterStore {
     float filter_cutoff_lfo_amount;
     float filter_res_lfo_freq;
     float filter_res_lfo_amount;
+
+    // Per-channel relationships, indexed by output channel
+    ChannelConfig channels[MAX_OUTPUT_CHANNELS];
+
+    // Modulation sources and routes, compiled by the generator every block
+    ModMatrix mod;
+
+    // Sweep played by WAVE_SWEEP; bumping sweep_serial restarts it
+    SweepConfig sweep;
+    guint sweep_serial;
 };
 
 typedef struct ParameterStore ParameterStore;
@@ -59,4 +92,21 @@ void parameter_store_set_filter_resonance(struct ParameterStore *store, float re
 void parameter_store_set_filter_cutoff_lfo(struct ParameterStore *store, float freq, float amount);
 void parameter_store_set_filter_res_lfo(struct ParameterStore *store, float freq, float amount);
 
+// Channel functions
+void parameter_store_set_channel(struct ParameterStore *store, int channel,
+                                 float freq_ratio, float phase_offset, float gain);
+void parameter_store_set_channel_frequency(struct ParameterStore *store, int channel, float freq);
+gboolean parameter_store_get_channel(struct ParameterStore *store, int channel, ChannelConfig *config);
+
+// Modulation matrix functions
+void parameter_store_set_mod_source(struct ParameterStore *store, int index,
+                                    ModShape shape, float freq);
+void parameter_store_set_mod_route(struct ParameterStore *store, int index,
+                                   int source, ModDestination destination, float depth);
+gboolean parameter_store_get_mod_matrix(struct ParameterStore *store, ModMatrix *matrix);
+
+// Sweep functions
+void parameter_store_set_sweep(struct ParameterStore *store, const SweepConfig *config);
+gboolean parameter_store_get_sweep(struct ParameterStore *store, SweepConfig *config);
+
 #endif // PARAMETER_STORE_H
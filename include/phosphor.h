@@ -0,0 +1,63 @@
+// phosphor.h
+#ifndef PHOSPHOR_H
+#define PHOSPHOR_H
+
+#include <glib.h>
+#include <stddef.h>
+#include "simd.h"
+#include "common_defs.h"
+#include "audio_manager.h"   // CircularBuffer
+
+#define PHOSPHOR_MAX_WIDTH 4096
+#define PHOSPHOR_MAX_HEIGHT 2048
+#define PHOSPHOR_DEFAULT_PERSISTENCE_S 0.5f   // Time for a trace to fade to 1/e
+#define PHOSPHOR_SATURATION 24.0f             // Hits that reach the top of the palette
+#define PHOSPHOR_HOLDOFF_DIVISOR 4            // Rearm after a quarter window of new frames
+#define PHOSPHOR_HISTORY_FRAMES SCOPE_BUFFER_SIZE   // Acquisitions take half of this
+#define PHOSPHOR_FEED_FRAMES (SCOPE_BUFFER_SIZE * 4)  // Frames the UI may fall behind by
+#define PHOSPHOR_RENORMALIZE_GAIN (1.0f / 4096.0f)  // Fold the gain into the grid below this
+
+// Digital phosphor: every acquisition adds one hit per sample to a grid of
+// per-pixel intensities that decays exponentially on the sample clock.
+// The generator only feeds its frames into a ring; the UI thread acquires
+// from it and turns the grid into pixels through a 256-entry palette, so
+// jitter and rare glitches stay visible for the persistence time at the
+// cost of one image blit.
+//
+// The decay is one gain for the whole grid. New hits are weighted by its
+// inverse, and the grid is only rescaled once the gain gets small, so an
+// acquisition touches the cells it hits rather than every cell.
+struct Phosphor {
+    int width;                  // Grid, in display pixels
+    int height;
+    int row_stride;             // Floats per row, a multiple of SIMD_LANES
+    float *intensity;           // height * row_stride hits / gain, 64-byte aligned
+    size_t intensity_bytes;     // Allocated, at least the current grid
+    float gain;                 // Decay since the grid was last rescaled
+    guint serial;               // Bumped whenever the rendered image would change
+
+    float persistence;          // Seconds
+    float trigger_level;        // Rising edge on channel 0
+    size_t pending_frames;      // New frames since the last acquisition
+    guint64 acquisitions;
+
+    CircularBuffer feed;        // Stereo pairs, generator to UI thread
+    float *history;             // Newest PHOSPHOR_HISTORY_FRAMES pairs, UI thread
+    size_t history_frames;
+
+    guint32 palette[256];       // Cairo ARGB32, black through green to white
+};
+
+typedef struct Phosphor Phosphor;
+
+// Function declarations
+Phosphor* phosphor_create(void);
+void phosphor_destroy(Phosphor *phosphor);
+gboolean phosphor_set_size(Phosphor *phosphor, int width, int height);
+void phosphor_set_persistence(Phosphor *phosphor, float seconds);
+void phosphor_clear(Phosphor *phosphor);
+void phosphor_feed(Phosphor *phosphor, float *pairs, size_t frames);
+void phosphor_acquire(Phosphor *phosphor, float sample_rate);
+gboolean phosphor_render(Phosphor *phosphor, guint8 *pixels, int stride, int width, int height);
+
+#endif // PHOSPHOR_H
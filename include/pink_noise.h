@@ -0,0 +1,37 @@
+// pink_noise.h
+#ifndef PINK_NOISE_H
+#define PINK_NOISE_H
+
+#include "simd.h"
+
+// Kellet's economy pink filter: three one-pole lowpasses over white noise,
+// within 0.5 dB of -3 dB/octave above 10 Hz at 48 kHz. The single-voice
+// oscillator and the voice engine lanes both step it, so a note sounds the
+// same whichever path renders it.
+#define PINK_NOISE_POLES 3
+
+static const float pink_noise_pole[PINK_NOISE_POLES] = { 0.99765f, 0.96300f, 0.57000f };
+static const float pink_noise_gain[PINK_NOISE_POLES] = { 0.0990460f, 0.2965164f, 1.0526913f };
+#define PINK_NOISE_DIRECT 0.1848f   // Unfiltered white added to the poles
+#define PINK_NOISE_SCALE 0.25f      // Keeps the output near [-1, 1]
+
+static inline float pink_noise_step(float state[PINK_NOISE_POLES], float white) {
+    float sum = white * PINK_NOISE_DIRECT;
+    for (int k = 0; k < PINK_NOISE_POLES; k++) {
+        state[k] = pink_noise_pole[k] * state[k] + white * pink_noise_gain[k];
+        sum += state[k];
+    }
+    return sum * PINK_NOISE_SCALE;
+}
+
+// Same filter, one voice per lane
+static inline v8sf v8sf_pink_noise_step(v8sf state[PINK_NOISE_POLES], v8sf white) {
+    v8sf sum = white * v8sf_set1(PINK_NOISE_DIRECT);
+    for (int k = 0; k < PINK_NOISE_POLES; k++) {
+        state[k] = v8sf_set1(pink_noise_pole[k]) * state[k] + white * v8sf_set1(pink_noise_gain[k]);
+        sum += state[k];
+    }
+    return sum * v8sf_set1(PINK_NOISE_SCALE);
+}
+
+#endif // PINK_NOISE_H
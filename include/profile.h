@@ -0,0 +1,100 @@
+// profile.h
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <glib.h>
+
+// Stages timed inside one generator block and one scope frame
+typedef enum {
+    PROFILE_BLOCK,              // A whole generator block
+    PROFILE_OSCILLATOR,         // One oscillator_render call
+    PROFILE_MODULATION,         // LFOs and the mod matrix, per oscillator call
+    PROFILE_SAMPLE_LOOP,        // Waveform, ladder filter and gain, per oscillator call
+    PROFILE_RING_WRITE,
+    PROFILE_SCOPE_COPY,         // Scope history and the hand-off to the window
+    PROFILE_FFT,
+    PROFILE_TRACE,              // Trigger search and trace downsampling
+    PROFILE_SPECTRUM,           // Spectrum curve and peaks
+    PROFILE_RASTERIZE_CAIRO,    // Drawing the finished frame with cairo
+    PROFILE_RASTERIZE_GL,       // The same with OpenGL, until the GPU is done
+    PROFILE_FRAME,              // A whole scope draw
+    PROFILE_STAGE_COUNT
+} ProfileStage;
+
+#define PROFILE_MAX_THREADS 128
+#define PROFILE_SUB_BINS 8                      // Per power of two, about 9% wide
+#define PROFILE_BINS (40 * PROFILE_SUB_BINS)    // Up to 2^40 ticks
+
+// One thread's samples; only that thread writes, readers tolerate a
+// histogram that is a few counts behind
+typedef struct {
+    guint32 bins[PROFILE_BINS];
+    guint64 count;
+    guint64 total;
+    guint64 max;
+} ProfileHistogram;
+
+typedef struct {
+    gint owned;                 // Claimed by a running thread
+    ProfileHistogram stages[PROFILE_STAGE_COUNT];
+} ProfileThread;
+
+typedef struct {
+    const char *name;
+    guint64 count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} ProfileStageReport;
+
+typedef struct {
+    ProfileStageReport stages[PROFILE_STAGE_COUNT];
+} ProfileReport;
+
+// Timers build to nothing unless WAVEFORM_PROFILE is defined (make
+// PROFILE=1). A timer's name is a local holding its start:
+//   PROFILE_START(t); ...; PROFILE_STOP(PROFILE_FFT, t);
+// Work split over a loop is summed and recorded once:
+//   PROFILE_TOTAL(sum); loop { PROFILE_START(t); ...; PROFILE_ADD(sum, t); }
+//   PROFILE_RECORD(PROFILE_SAMPLE_LOOP, sum);
+#ifdef WAVEFORM_PROFILE
+#define PROFILE_START(name) guint64 name = profile_ticks()
+#define PROFILE_STOP(stage, name) profile_record((stage), profile_ticks() - (name))
+#define PROFILE_TOTAL(name) guint64 name = 0
+#define PROFILE_ADD(total, name) ((total) += profile_ticks() - (name))
+#define PROFILE_RECORD(stage, total) profile_record((stage), (total))
+#define PROFILE_THREAD_INIT() profile_thread_init()
+#else
+#define PROFILE_START(name) do { } while (0)
+#define PROFILE_STOP(stage, name) do { } while (0)
+#define PROFILE_TOTAL(name) do { } while (0)
+#define PROFILE_ADD(total, name) do { } while (0)
+#define PROFILE_RECORD(stage, total) do { } while (0)
+#define PROFILE_THREAD_INIT() do { } while (0)
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+// The invariant TSC: a few cycles to read, converted to time on report
+static inline guint64 profile_ticks(void) {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+
+static inline guint64 profile_ticks(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (guint64)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+#endif
+
+// Function declarations
+void profile_thread_init(void);
+void profile_record(ProfileStage stage, guint64 ticks);
+gboolean profile_report(ProfileReport *report);
+void profile_dump(void);
+
+#endif // PROFILE_H
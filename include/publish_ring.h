@@ -0,0 +1,26 @@
+// publish_ring.h
+#ifndef PUBLISH_RING_H
+#define PUBLISH_RING_H
+
+#include <glib.h>
+#include <stddef.h>
+
+// One writer publishes fixed-size records into a power-of-two ring and
+// counts them; any number of readers copy them out without locks, each
+// with its own cursor. The owner keeps the records and the count; these
+// implement the slot and cursor rules so every ring follows the same ones.
+//
+// Record n lives in slot n % size. While the writer fills record
+// `written`, that slot still reads as record `written - size`, so only the
+// newest size - 1 records are ever intact; readers that fall further
+// behind skip ahead, and records overwritten during a copy are dropped.
+
+// Function declarations
+void publish_ring_push(void *records, size_t record_size, int size, gint *written,
+                       const void *record);
+int publish_ring_read(const void *records, size_t record_size, int size, const gint *written,
+                      gint *cursor, void *out, int max);
+gboolean publish_ring_latest(const void *records, size_t record_size, int size,
+                             const gint *written, void *out);
+
+#endif // PUBLISH_RING_H
@@ -0,0 +1,62 @@
+// render_pool.h
+#ifndef RENDER_POOL_H
+#define RENDER_POOL_H
+
+#include <glib.h>
+#include "common_defs.h"
+#include "oscillator.h"
+#include "parameter_store.h"
+
+#define RENDER_CACHE_LINE 64
+#define RENDER_POOL_MAX_THREADS 64
+#define RENDER_POOL_MIN_PARALLEL 8   // Fewer instances render inline on the caller
+
+// One generator instance. Aligned and padded to whole cache lines so
+// workers rendering neighbours never share a line.
+typedef struct {
+    Oscillator osc;
+    ChannelConfig config;        // Relationship to the shared parameters
+    int route;                   // Output channel, -1 mutes
+    float block[MAX_BLOCK_SIZE]; // Last rendered block, planar
+} __attribute__((aligned(RENDER_CACHE_LINE))) RenderInstance;
+
+// Each participant starts on its own contiguous range and then steals
+// single instances from the others' ranges
+typedef struct {
+    gint next;                   // Next unclaimed instance, claimed atomically
+    gint end;
+} __attribute__((aligned(RENDER_CACHE_LINE))) RenderRange;
+
+struct RenderPool {
+    RenderInstance *instances;
+    size_t capacity;
+
+    GThread *workers[RENDER_POOL_MAX_THREADS];
+    int num_threads;             // Workers plus the calling thread
+    RenderRange ranges[RENDER_POOL_MAX_THREADS];
+
+    // Current job, written by the caller before the generation is bumped
+    const OscillatorParams *base;
+    size_t frames;
+    float sample_rate;
+    float phase_scale;
+
+    GMutex mutex;
+    GCond start;
+    GCond done;
+    guint generation;
+    gint pending;                // Participants still rendering
+    gboolean quit;
+};
+
+typedef struct RenderPool RenderPool;
+
+// Function declarations
+RenderPool* render_pool_create(size_t capacity, int num_threads);
+void render_pool_destroy(RenderPool *pool);
+void render_pool_reset(RenderPool *pool);
+void render_pool_render(RenderPool *pool, size_t count, const OscillatorParams *base,
+                        float *out, int channels, size_t frames,
+                        float sample_rate, float phase_scale);
+
+#endif // RENDER_POOL_H
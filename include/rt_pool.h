@@ -0,0 +1,33 @@
+// rt_pool.h
+#ifndef RT_POOL_H
+#define RT_POOL_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RT_POOL_SIZE (4 * 1024 * 1024)  // Two huge pages; everything set up at start but a tone bank fits
+#define RT_POOL_ALIGNMENT 64            // A cache line, and any vector width we use
+
+// One region, mapped, prefaulted and (with realtime configured) locked at
+// startup. Buffers the audio, scope and analysis paths use on every block
+// or frame are carved from it when their owners are created, so those
+// paths never touch the heap.
+typedef struct {
+    char *base;
+    size_t size;
+    gint used;                  // Bytes handed out, advanced atomically
+    bool huge_pages;            // Explicit huge pages rather than a hint
+    bool mapped;
+} RtPool;
+
+#define rt_pool_new(type, count) ((type *)rt_pool_alloc(sizeof(type) * (count)))
+
+// Function declarations
+bool rt_pool_init(size_t bytes, bool huge_pages);
+void rt_pool_shutdown(void);
+void* rt_pool_alloc(size_t bytes);
+void rt_pool_free(void *memory);
+void rt_pool_report(void);
+
+#endif // RT_POOL_H
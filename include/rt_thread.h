@@ -0,0 +1,37 @@
+// rt_thread.h
+#ifndef RT_THREAD_H
+#define RT_THREAD_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RT_DEFAULT_PRIORITY 70          // SCHED_FIFO, audio threads; clamped to what is allowed
+#define RT_MAX_CPUS 64
+#define RT_STACK_PREFAULT (128 * 1024)  // Touched once per thread so it never faults later
+#define RTKIT_TIMEOUT_MS 500
+
+// The generator runs one priority below the threads it feeds
+typedef enum {
+    RT_THREAD_AUDIO,            // Audio callback and backend threads
+    RT_THREAD_GENERATOR         // Generator and its render workers
+} RtThreadRole;
+
+typedef struct {
+    int priority;               // 0 keeps normal scheduling and leaves memory unlocked
+    int cpus[RT_MAX_CPUS];      // Realtime threads run only on these, none = anywhere
+    int num_cpus;
+    bool lock_memory;
+} RtConfig;
+
+// Function declarations
+void rt_config_init(RtConfig *config);
+bool rt_parse_cpus(const char *list, RtConfig *config);
+void rt_configure(const RtConfig *config);
+bool rt_thread_setup(RtThreadRole role, const char *name);
+void rt_thread_adopt(RtThreadRole role, const char *name);
+void rt_shutdown(void);
+void rt_flush_denormals(void);
+void rt_prefault(void *memory, size_t bytes);
+
+#endif // RT_THREAD_H
@@ -0,0 +1,117 @@
+// scope_frame.h
+#ifndef SCOPE_FRAME_H
+#define SCOPE_FRAME_H
+
+#include <glib.h>
+#include <cairo.h>
+
+#define SCOPE_FRAME_MAX_CURVES 4
+#define SCOPE_FRAME_MAX_MARKS 16
+#define SCOPE_LAYER_MAX_LINES 64
+#define SCOPE_LAYER_MAX_LABELS 96
+#define SCOPE_FRAME_MAX_IMAGES 2
+#define SCOPE_LABEL_LENGTH 64
+
+typedef struct {
+    float red, green, blue, alpha;
+} ScopeColor;
+
+// Polyline with one point per pixel column, starting at x = 0
+typedef struct {
+    const float *y;         // Pixels from the top, in the frame's curve storage
+    int count;
+    float width;
+    ScopeColor color;
+} ScopeCurve;
+
+typedef struct {
+    float x0, y0, x1, y1;
+    float width;
+    ScopeColor color;
+} ScopeLine;
+
+// Filled triangle pointing down at (x, y), as over a spectrum peak
+typedef struct {
+    float x, y;
+} ScopeMark;
+
+typedef struct {
+    float x, y;             // Baseline start, or centre with centered set
+    int size;               // Font size in pixels
+    gboolean centered;      // Kept inside the frame's width
+    ScopeColor color;
+    char text[SCOPE_LABEL_LENGTH];
+} ScopeLabel;
+
+// Straight lines and text, drawn lines first
+typedef struct {
+    ScopeLine lines[SCOPE_LAYER_MAX_LINES];
+    int num_lines;
+    ScopeLabel labels[SCOPE_LAYER_MAX_LABELS];
+    int num_labels;
+} ScopeLayer;
+
+// Premultiplied ARGB32 pixels, owned by the scope window. The serial
+// changes whenever the pixels do, so a renderer that keeps a copy only
+// uploads new ones; 0 means they may have changed on every frame.
+typedef struct {
+    cairo_surface_t *surface;
+    int x, y;
+    guint serial;
+} ScopeImage;
+
+typedef enum {
+    SCOPE_AXES_NONE,
+    SCOPE_AXES_SPECTRUM,    // Log frequency, MIN_DB to MAX_DB
+    SCOPE_AXES_TRANSFER     // TRANSFER_MIN_DB to TRANSFER_MAX_DB
+} ScopeAxes;
+
+// Everything that only changes with the layout. Compared byte for byte to
+// decide whether a cached graticule is still good, so it is always zeroed
+// before being filled.
+typedef struct {
+    int width;
+    int height;
+    int wave_height;
+    gboolean time_grid;     // Off in XY mode
+    int xy_size;            // Square XY grid centred in the waveform pane, 0 for none
+    ScopeAxes axes;
+    int sample_rate;        // For the spectrum's frequency axis
+} ScopeGraticule;
+
+// One display refresh as a list of primitives, so the same frame can be
+// drawn with cairo or uploaded to the GPU. Drawn in the order of the
+// fields: images on the black background, the graticule's lines and
+// labels, curves, overlay lines, marks, overlay labels.
+struct ScopeFrame {
+    ScopeImage images[SCOPE_FRAME_MAX_IMAGES];
+    int num_images;
+    ScopeGraticule graticule;
+    ScopeLayer background;  // Built from graticule by scope_frame_end
+    ScopeCurve curves[SCOPE_FRAME_MAX_CURVES];
+    int num_curves;
+    ScopeMark marks[SCOPE_FRAME_MAX_MARKS];
+    int num_marks;
+    ScopeLayer overlay;
+
+    float *curve_storage;   // SCOPE_FRAME_MAX_CURVES rows of curve_capacity
+    int curve_capacity;
+};
+
+typedef struct ScopeFrame ScopeFrame;
+
+// Function declarations
+gboolean scope_frame_begin(ScopeFrame *frame, int width, int height, int wave_height);
+void scope_frame_end(ScopeFrame *frame);
+void scope_frame_free(ScopeFrame *frame);
+float* scope_frame_add_curve(ScopeFrame *frame, int count, float width, ScopeColor color);
+void scope_frame_add_line(ScopeFrame *frame, float x0, float y0, float x1, float y1,
+                          float width, ScopeColor color);
+void scope_frame_add_mark(ScopeFrame *frame, float x, float y);
+void scope_frame_add_label(ScopeFrame *frame, float x, float y, int size, gboolean centered,
+                           ScopeColor color, const char *text);
+void scope_frame_add_image(ScopeFrame *frame, cairo_surface_t *surface, int x, int y,
+                           guint serial);
+void scope_frame_draw(cairo_t *cr, const ScopeFrame *frame);
+
+#endif // SCOPE_FRAME_H
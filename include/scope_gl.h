@@ -0,0 +1,76 @@
+// scope_gl.h
+#ifndef SCOPE_GL_H
+#define SCOPE_GL_H
+
+#include <glib.h>
+#include "scope_frame.h"
+
+#define SCOPE_GL_ATLAS_WIDTH 512
+#define SCOPE_GL_ATLAS_HEIGHT 256
+#define SCOPE_GL_FIRST_GLYPH 32         // Printable ASCII
+#define SCOPE_GL_NUM_GLYPHS 95
+#define SCOPE_GL_MIN_FONT_SIZE 10       // Label sizes in the atlas, in pixels
+#define SCOPE_GL_FONT_SIZES 3
+
+// A glyph's cell in the atlas and where it sits relative to the pen
+typedef struct {
+    float u0, v0, u1, v1;
+    int left, top;              // Cell corner from the pen position
+    int width, height;
+    float advance;
+} ScopeGlyph;
+
+// Draws a ScopeFrame with OpenGL 3.2 core, which Mesa's llvmpipe provides
+// when there is no GPU. Curves and lines are widened into antialiased
+// quads as they are staged; text is quads into a glyph atlas rendered with
+// cairo at realize time. Only pixels that are drawn on cost fill rate,
+// which is what limits a software rasterizer on large windows. The
+// graticule's opaque horizontal and vertical lines are scissored clears,
+// the rest of it stays in static buffers until the layout changes; the
+// phosphor and XY images are uploaded into textures reused between frames,
+// only when their serial changed, and blitted. All calls except create
+// and destroy need the area's context current.
+struct ScopeGL {
+    gboolean realized;
+
+    guint stroke_program;
+    int stroke_viewport;        // Uniform locations
+    int stroke_color;
+    guint texture_program;
+    int texture_viewport;
+    int texture_tint;
+
+    guint vertex_array;
+    guint stream_buffer;        // Refilled for every draw
+    float *vertices;            // Staging for each upload, from the memory pool
+
+    guint background_lines;
+    guint background_glyphs;
+    ScopeGraticule graticule;   // Layout the background buffers hold
+    gboolean have_graticule;
+    ScopeLine grid_rects[SCOPE_LAYER_MAX_LINES];     // Background lines drawn as clears
+    int num_grid_rects;
+    ScopeLine grid_quads[SCOPE_LAYER_MAX_LINES];     // The rest, in background_lines
+    int num_grid_quads;
+
+    guint image_textures[SCOPE_FRAME_MAX_IMAGES];
+    guint image_framebuffers[SCOPE_FRAME_MAX_IMAGES];   // Blit sources
+    int image_width[SCOPE_FRAME_MAX_IMAGES];
+    int image_height[SCOPE_FRAME_MAX_IMAGES];
+    guint image_serial[SCOPE_FRAME_MAX_IMAGES];        // Of the pixels uploaded, 0 for none
+
+    guint atlas_texture;
+    float solid_u, solid_v;     // An opaque white texel, for filled shapes
+    ScopeGlyph glyphs[SCOPE_GL_FONT_SIZES][SCOPE_GL_NUM_GLYPHS];
+};
+
+typedef struct ScopeGL ScopeGL;
+
+// Function declarations
+ScopeGL* scope_gl_create(void);
+void scope_gl_destroy(ScopeGL *gl);
+gboolean scope_gl_realize(ScopeGL *gl);
+void scope_gl_unrealize(ScopeGL *gl);
+gboolean scope_gl_render(ScopeGL *gl, const ScopeFrame *frame);
+
+#endif // SCOPE_GL_H
@@ -5,8 +5,33 @@
 #include <gtk/gtk.h>
 #include "parameter_store.h"
 #include "fft_analyzer.h"
+#include "transfer_analyzer.h"
+#include "distortion_analyzer.h"
+#include "tone_tracker.h"
+#include "phosphor.h"
+#include "xy_plot.h"
+#include "waveform_measure.h"
+#include "scope_frame.h"
 #include "common_defs.h"
 
+#define SCOPE_MAX_MARKERS 32
+
+struct AudioManager;
+struct ScopeGL;
+
+// What draws the display; both take the same ScopeFrame
+typedef enum {
+    SCOPE_RENDER_CAIRO,     // GtkDrawingArea, drawn on the CPU
+    SCOPE_RENDER_GL         // GtkGLArea, falls back to cairo without OpenGL 3.2
+} ScopeRenderer;
+
+// What the waveform pane plots
+typedef enum {
+    SCOPE_XY_OFF,           // Channel 1 against time
+    SCOPE_XY_CHANNELS,      // Channel 1 (x) against channel 2 (y)
+    SCOPE_XY_CAPTURE        // Played (x) against captured (y), from the capture ring
+} ScopeXYSource;
+
 // Keep the original struct definition
 struct TriggerInfo {
     size_t position;
@@ -18,7 +43,16 @@ struct ScopeWindow {
     struct ParameterStore *params;
     size_t data_size;
     float *waveform_data;
+    float *draw_data;      // The draw's copy of waveform_data, UI thread only
     size_t write_pos;
+    int sample_rate;       // Rate of waveform_data, set with the data
+    guint data_serial;     // Bumped with every update of waveform_data
+    guint64 end_time;      // Generator sample time one past the newest frame
+
+    // Sweep sync points that fall inside waveform_data, set with the data
+    SweepMarker markers[SCOPE_MAX_MARKERS];
+    int num_markers;
+    float sweep_frequency; // Current sweep frequency, 0 when not sweeping
     
     // Display parameters
     float time_scale;
@@ -33,8 +67,12 @@ struct ScopeWindow {
     // Trigger info
     struct TriggerInfo trigger;
     
-    // Drawing area
+    // Drawing area, a GtkGLArea with the GL renderer
     GtkWidget *drawing_area;
+    ScopeRenderer renderer;
+    struct ScopeGL *gl;
+    ScopeFrame frame;                    // Rebuilt on every draw
+    guint image_serial;                  // Last serial given to a redrawn image
     
     // Synchronization
     GMutex data_mutex;
@@ -45,6 +83,35 @@ struct ScopeWindow {
     float *fft_data;
     gboolean show_fft;
     int fft_height;
+    struct DistortionAnalyzer *distortion;   // Measured on every spectrum frame
+    struct ToneTracker *tracker;             // Readings listed over the trace, not owned
+    struct WaveformMeasure *measure;         // Latest window shown over the trace, not owned
+    gboolean show_measurements;
+
+    // Transfer function measurement; replaces the spectrum while it has data
+    struct TransferAnalyzer *transfer;
+    TransferResult *transfer_result;  // Latest copy, drawn from
+    guint transfer_serial;
+
+    // Phosphor persistence; filled by the generator, replaces the trace
+    struct Phosphor *phosphor;
+    gboolean show_phosphor;
+    cairo_surface_t *phosphor_surface;   // Waveform pane sized, reused per draw
+    guint phosphor_drawn;                // Phosphor serial the surface shows, 0 for none
+    guint phosphor_image;                // Image serial of the surface
+
+    // XY mode; the capture source is drained on the UI thread into a
+    // rolling history unless a transfer measurement is reading the ring
+    ScopeXYSource xy_source;
+    struct XYPlot *xy;
+    struct AudioManager *xy_audio;       // Not owned
+    float *xy_history;                   // SCOPE_BUFFER_SIZE pairs
+    size_t xy_frames;
+    guint xy_capture_serial;             // Bumped whenever xy_history changes
+    cairo_surface_t *xy_surface;
+    ScopeXYSource xy_drawn_source;       // Inputs the surface shows; serial 0 for none
+    guint xy_drawn_serial;
+    guint xy_image;                      // Image serial of the surface
 
     gboolean drawing_in_progress; 
 
@@ -59,5 +126,12 @@ void scope_window_downsample_buffer(const float *source_buffer, size_t source_sa
                                   float *display_buffer, size_t display_width,
                                   size_t trigger_position);
 void scope_window_toggle_fft(struct ScopeWindow *scope, gboolean show);
+void scope_window_set_tracker(struct ScopeWindow *scope, struct ToneTracker *tracker);
+void scope_window_set_measure(struct ScopeWindow *scope, struct WaveformMeasure *measure);
+void scope_window_show_measurements(struct ScopeWindow *scope, gboolean show);
+void scope_window_set_transfer(struct ScopeWindow *scope, struct TransferAnalyzer *analyzer);
+void scope_window_set_phosphor(struct ScopeWindow *scope, gboolean show);
+void scope_window_set_xy(struct ScopeWindow *scope, ScopeXYSource source, struct AudioManager *audio);
+void scope_window_set_renderer(struct ScopeWindow *scope, ScopeRenderer renderer);
 
 #endif // SCOPE_WINDOW_H
@@ -0,0 +1,79 @@
+// sequence_runner.h
+#ifndef SEQUENCE_RUNNER_H
+#define SEQUENCE_RUNNER_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include "parameter_store.h"
+#include "param_event_queue.h"
+
+struct WaveformGenerator;
+
+// A sequence file is plain text, one command per line, '#' starts a
+// comment. Times are in seconds from the start of the sequence; commands
+// take effect at the time cursor, which only `hold` and `at` move.
+//
+//   waveform square            sine | square | saw | triangle | noise
+//   set frequency 1000         frequency | amplitude | duty_cycle |
+//   set amplitude 0.5            filter_cutoff | filter_resonance
+//   ramp frequency 2000 1.5 exp     reach 2000 Hz after 1.5 s (linear | exp)
+//   hold 2                     advance the cursor by 2 s
+//   at 10                      move the cursor to 10 s (never backwards)
+//   fm 5 0.1                   fm | am | dcm | cutoff-lfo | res-lfo FREQ DEPTH
+//   mod-source 6 triangle 0.5  matrix source N: shape, rate in Hz
+//   mod-route 6 6 cutoff 0.3   matrix route N: source (0 = off), destination, depth
+//   sweep exp 20 20000 10      start a linear | exp sweep: from Hz, to Hz, seconds
+//   sweep stepped 20 20000 31 0.05 0.1   or STEPS, settle and dwell seconds
+//
+// The sequence ends at the furthest point the cursor reached.
+
+typedef enum {
+    SEQUENCE_EVENT,           // Timestamped parameter change
+    SEQUENCE_WAVEFORM,
+    SEQUENCE_LFO,             // One of the fixed FM/AM/DCM/filter LFO controls
+    SEQUENCE_MOD_SOURCE,
+    SEQUENCE_MOD_ROUTE,
+    SEQUENCE_SWEEP            // Configures, restarts and selects the sweep
+} SequenceStepType;
+
+typedef struct {
+    SequenceStepType type;
+    double time;              // Seconds
+    int line;
+    char *text;               // Source line, for the timing log
+    ParamEvent event;         // SEQUENCE_EVENT; sample_time is filled in when run
+    double ramp_seconds;
+    int index;                // Waveform, matrix source or route
+    int source;
+    int shape;                // ModShape or ModDestination
+    float freq;
+    float depth;
+    void (*lfo_setter)(struct ParameterStore *store, float freq, float depth);
+    SweepConfig sweep;
+} SequenceStep;
+
+struct Sequence {
+    char *path;
+    SequenceStep *steps;      // Ordered by time
+    int num_steps;
+    double duration;          // Seconds
+};
+
+typedef struct Sequence Sequence;
+
+// Function declarations
+Sequence* sequence_load(const char *path);
+void sequence_destroy(Sequence *sequence);
+
+// Renders the sequence on a private generator as fast as the CPU allows,
+// writing a float WAV file and a timing log. Safe to run several at once.
+bool sequence_render(const Sequence *sequence, int sample_rate, int channels,
+                     const char *wav_path, const char *log_path);
+
+// Drives a running generator in step with its audio stream. Parameter
+// events stay sample-accurate; the other commands land on the next block.
+// Blocks until the sequence has played or *cancel becomes nonzero.
+bool sequence_run_live(const Sequence *sequence, struct WaveformGenerator *gen,
+                       const char *log_path, gint *cancel);
+
+#endif // SEQUENCE_RUNNER_H
@@ -0,0 +1,159 @@
+// simd.h
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Portable 8-lane vectors through GCC vector extensions. The compiler maps
+// them to AVX when enabled and to pairs of SSE/NEON registers otherwise.
+#define SIMD_LANES 8
+#define SIMD_ALIGN 32
+
+typedef float v8sf __attribute__((vector_size(32)));
+typedef int32_t v8si __attribute__((vector_size(32)));
+typedef uint32_t v8su __attribute__((vector_size(32)));
+
+static inline v8sf v8sf_set1(float x) {
+    return (v8sf){x, x, x, x, x, x, x, x};
+}
+
+static inline v8si v8si_set1(int32_t x) {
+    return (v8si){x, x, x, x, x, x, x, x};
+}
+
+// Loads and stores go through memcpy so unaligned pointers are legal;
+// with aligned arrays the compiler emits plain vector moves
+static inline v8sf v8sf_load(const float *p) {
+    v8sf v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void v8sf_store(float *p, v8sf v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline v8su v8su_load(const uint32_t *p) {
+    v8su v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void v8su_store(uint32_t *p, v8su v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+// Comparisons yield all-ones lanes; select picks a where the mask is set
+static inline v8sf v8sf_select(v8si mask, v8sf a, v8sf b) {
+    return (v8sf)(((v8si)a & mask) | ((v8si)b & ~mask));
+}
+
+// Lane-wise a < b. Without AVX, GCC lowers an 8-lane float compare one
+// lane at a time, so it is done as two 4-lane compares instead.
+static inline v8si v8sf_less(v8sf a, v8sf b) {
+#if defined(__AVX__) || defined(__clang__)
+    return a < b;
+#else
+    typedef float v4sf __attribute__((vector_size(16)));
+    typedef int32_t v4si __attribute__((vector_size(16)));
+    v4sf a_half[2], b_half[2];
+    v4si result[2];
+    memcpy(a_half, &a, sizeof(a));
+    memcpy(b_half, &b, sizeof(b));
+    result[0] = a_half[0] < b_half[0];
+    result[1] = a_half[1] < b_half[1];
+    v8si mask;
+    memcpy(&mask, result, sizeof(mask));
+    return mask;
+#endif
+}
+
+static inline v8sf v8sf_abs(v8sf x) {
+    return (v8sf)((v8si)x & v8si_set1(0x7fffffff));
+}
+
+static inline v8sf v8sf_min(v8sf a, v8sf b) {
+    return v8sf_select(v8sf_less(a, b), a, b);
+}
+
+static inline v8sf v8sf_max(v8sf a, v8sf b) {
+    return v8sf_select(v8sf_less(b, a), a, b);
+}
+
+// Rounds towards -inf; lanes must fit an int32
+static inline v8sf v8sf_floor(v8sf x) {
+    v8sf truncated = __builtin_convertvector(__builtin_convertvector(x, v8si), v8sf);
+    return truncated - v8sf_select(v8sf_less(x, truncated), v8sf_set1(1.0f), v8sf_set1(0.0f));
+}
+
+static inline float v8sf_hsum(v8sf v) {
+    return ((v[0] + v[1]) + (v[2] + v[3])) + ((v[4] + v[5]) + (v[6] + v[7]));
+}
+
+// Splits 16 interleaved values (complex re/im pairs) into evens and odds
+static inline void v8sf_deinterleave(v8sf a, v8sf b, v8sf *even, v8sf *odd) {
+#if defined(__clang__)
+    *even = __builtin_shufflevector(a, b, 0, 2, 4, 6, 8, 10, 12, 14);
+    *odd = __builtin_shufflevector(a, b, 1, 3, 5, 7, 9, 11, 13, 15);
+#else
+    *even = __builtin_shuffle(a, b, (v8si){0, 2, 4, 6, 8, 10, 12, 14});
+    *odd = __builtin_shuffle(a, b, (v8si){1, 3, 5, 7, 9, 11, 13, 15});
+#endif
+}
+
+// log2(x) for positive normal x: the exponent bits plus a degree-5
+// polynomial in the mantissa; absolute error stays below 1.5e-5. Zero and
+// denormals come out near -127 instead of -inf, which callers clamp.
+static inline v8sf v8sf_log2(v8sf x) {
+    v8si bits = (v8si)x;
+    v8sf exponent = __builtin_convertvector(((bits >> 23) & v8si_set1(0xff)) - v8si_set1(127), v8sf);
+    v8sf m = (v8sf)((bits & v8si_set1(0x007fffff)) | v8si_set1(0x3f800000));   // [1, 2)
+
+    v8sf p = v8sf_set1(-0.034436006f);
+    p = p * m + v8sf_set1(0.31821337f);
+    p = p * m - v8sf_set1(1.2315303f);
+    p = p * m + v8sf_set1(2.5988452f);
+    p = p * m - v8sf_set1(3.3241990f);
+    p = p * m + v8sf_set1(3.1157899f);
+    return p * (m - v8sf_set1(1.0f)) + exponent;
+}
+
+// sin(2*pi*x) for x in [0, 1). The argument is folded into a quarter
+// period and fed to an odd polynomial; error stays below 4e-6.
+static inline v8sf v8sf_sin_cycles(v8sf x) {
+    const v8sf half = v8sf_set1(0.5f);
+    const v8sf quarter = v8sf_set1(0.25f);
+
+    // sin(2*pi*x) = -sin(2*pi*t) with t in [-0.5, 0.5)
+    v8sf t = x - half;
+    v8sf sign_half = (v8sf)(((v8si)t & v8si_set1((int32_t)0x80000000)) | (v8si)half);
+    t = v8sf_select(v8sf_less(quarter, v8sf_abs(t)), sign_half - t, t);
+
+    v8sf z = t * v8sf_set1(6.28318530718f);
+    v8sf z2 = z * z;
+    v8sf p = v8sf_set1(2.75573192e-6f);
+    p = p * z2 - v8sf_set1(1.98412698e-4f);
+    p = p * z2 + v8sf_set1(8.33333333e-3f);
+    p = p * z2 - v8sf_set1(1.66666667e-1f);
+    p = p * z2 + v8sf_set1(1.0f);
+    return -(z * p);
+}
+
+// Rational tanh approximation, the lane-wise twin of fast_tanh()
+static inline v8sf v8sf_tanh(v8sf x) {
+    v8sf x2 = x * x;
+    return x * (v8sf_set1(27.0f) + x2) / (v8sf_set1(27.0f) + v8sf_set1(9.0f) * x2);
+}
+
+// xorshift32 per lane, mapped to [-1, 1)
+static inline v8sf v8su_white_noise(v8su *state) {
+    v8su x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return __builtin_convertvector(x, v8sf) * v8sf_set1(2.0f / 4294967296.0f) - v8sf_set1(1.0f);
+}
+
+#endif // SIMD_H
@@ -0,0 +1,85 @@
+// sweep.h
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <glib.h>
+#include <stddef.h>
+
+#define SWEEP_MARKER_RING_SIZE 256   // Power of two
+#define SWEEP_MAX_STEPS 1000
+
+typedef enum {
+    SWEEP_LINEAR,          // Linear chirp
+    SWEEP_EXPONENTIAL,     // Exponential (Farina) sine sweep
+    SWEEP_STEPPED,         // Log-spaced steady tones with settle and dwell
+    SWEEP_TYPE_COUNT
+} SweepType;
+
+typedef struct {
+    SweepType type;
+    float start_freq;      // Hz
+    float end_freq;        // Hz
+    float duration;        // Seconds, chirps only
+    int steps;             // Stepped only, including both end frequencies
+    float settle;          // Seconds per step before the tone counts as steady
+    float dwell;           // Seconds per step to measure over
+    gboolean loop;         // Restart at the end instead of falling silent
+} SweepConfig;
+
+typedef enum {
+    SWEEP_MARK_START,      // First sample of a sweep
+    SWEEP_MARK_STEP,       // Stepped: a new frequency begins settling
+    SWEEP_MARK_SETTLED,    // Stepped: the dwell (measurement) window begins
+    SWEEP_MARK_END         // One past the last sample of a sweep
+} SweepMarkKind;
+
+// Sync point on the generator's sample clock
+typedef struct {
+    guint64 sample_time;
+    SweepMarkKind kind;
+    float frequency;       // Instantaneous frequency at sample_time
+    int step;              // Stepped sweeps; 0 otherwise
+} SweepMarker;
+
+// One writer (the render thread), any number of readers, each with its
+// own cursor, by the rules in publish_ring.h.
+typedef struct {
+    SweepMarker markers[SWEEP_MARKER_RING_SIZE];
+    gint written;          // Total markers ever pushed
+} SweepMarkerRing;
+
+// Render state. All per-sample work is additions and multiplications on
+// precomputed increments; the closed-form phase is only evaluated when a
+// block starts, which also keeps rounding from accumulating.
+typedef struct {
+    SweepConfig config;
+    float sample_rate;
+    gboolean active;
+    guint64 origin;        // Sample time of the first sample
+    guint64 position;      // Frames since origin
+    guint64 length;        // Frames in one pass
+
+    double phase;          // Radians, wrapped to [0, 2*pi)
+    double inc;            // Phase increment of the next sample
+    double inc_step;       // Linear: added to inc; exponential: multiplies it
+    double rate;           // Linear: Hz per second; exponential: L = T / ln(f2 / f1)
+
+    guint64 step_frames;   // Stepped: settle + dwell
+    guint64 settle_frames;
+    double step_ratio;     // Stepped: frequency ratio between steps
+} Sweep;
+
+// Function declarations
+void sweep_config_default(SweepConfig *config);
+gboolean sweep_config_valid(const SweepConfig *config, float sample_rate);
+void sweep_start(Sweep *sweep, const SweepConfig *config, float sample_rate, guint64 now);
+void sweep_render(Sweep *sweep, float *out, size_t frames, SweepMarkerRing *markers);
+double sweep_frequency_at(const SweepConfig *config, double seconds);
+double sweep_duration(const SweepConfig *config);
+const char* sweep_type_name(SweepType type);
+
+void sweep_marker_ring_push(SweepMarkerRing *ring, const SweepMarker *marker);
+int sweep_marker_ring_read(const SweepMarkerRing *ring, gint *cursor,
+                           SweepMarker *out, int max);
+
+#endif // SWEEP_H
@@ -0,0 +1,82 @@
+// tone_tracker.h
+#ifndef TONE_TRACKER_H
+#define TONE_TRACKER_H
+
+#include <glib.h>
+#include <stddef.h>
+#include "simd.h"
+
+#define TONE_TRACKER_MAX 64            // Multiple of SIMD_LANES
+#define TONE_TRACKER_RESYNC 256        // Frames between exact phasor refreshes
+#define TONE_TRACKER_DEFAULT_BLOCK_S 0.1f
+#define TONE_TRACKER_MAX_RATE 192000.0f // Sizes the windows; faster streams get shorter blocks
+
+#define TRACKER_ARRAY(type, name) type name[TONE_TRACKER_MAX] __attribute__((aligned(64)))
+
+// One tracker's result for the last completed block
+typedef struct {
+    float frequency;        // Hz, as configured
+    float amplitude;        // Peak, full scale is 1
+    float level_db;         // dBFS
+    float phase;            // Radians, of a cosine at sample time 0
+    guint64 sample_time;    // First frame of the block measured
+} ToneReading;
+
+// Everything that follows the stream rate. Prepared off the processing
+// thread, which only switches pointers to it.
+typedef struct {
+    TRACKER_ARRAY(float, frequency);   // Kept below this rate's Nyquist
+    TRACKER_ARRAY(float, rotate_re);   // e^(-j w)
+    TRACKER_ARRAY(float, rotate_im);
+    float sample_rate;
+    size_t block_frames;
+    float *window;                     // window_capacity frames, from the pool
+    double window_sum;
+} ToneTrackerRate;
+
+// Single-bin DFTs at fixed frequencies over consecutive Hann-windowed
+// blocks. Each tracker demodulates with a rotating phasor, so a sample
+// costs one complex multiply-accumulate per tracker, eight trackers per
+// vector. Readings are published under a seqlock once per block.
+struct ToneTracker {
+    TRACKER_ARRAY(float, frequency);   // As configured
+    TRACKER_ARRAY(float, phasor_re);   // e^(-j w n) at the next frame
+    TRACKER_ARRAY(float, phasor_im);
+    TRACKER_ARRAY(float, acc_re);      // Windowed sum of the block so far
+    TRACKER_ARRAY(float, acc_im);
+    int count;
+    int groups;                        // ceil(count / SIMD_LANES)
+
+    float block_seconds;
+    size_t window_capacity;
+    size_t position;                   // Frames into the current block
+    guint64 block_start;
+
+    // Two rate setups: the processing thread uses one while the other is
+    // prepared. A new one is only prepared once the last has been taken.
+    ToneTrackerRate rates[2];
+    const ToneTrackerRate *rate;       // Processing thread's current setup
+    gint rate_serial;                  // Serial of `rate`, processing thread only
+    gint published;                    // Serial of the newest setup, in rates[serial & 1]
+    gint adopted;                      // Last serial the processing thread switched to
+    gint wanted_rate;                  // Hz the processing thread has no setup for, or 0
+    GMutex prepare_mutex;
+
+    // Written by the processing thread, read from any thread
+    ToneReading readings[TONE_TRACKER_MAX];
+    guint64 blocks;                    // Published so far
+    gint sequence;                     // Odd while a block is being published
+};
+
+typedef struct ToneTracker ToneTracker;
+
+// Function declarations
+ToneTracker* tone_tracker_create(const float *frequencies, int count, float block_seconds,
+                                 float sample_rate);
+void tone_tracker_destroy(ToneTracker *tracker);
+void tone_tracker_process(ToneTracker *tracker, const float *samples, size_t frames, int stride,
+                          guint64 sample_time, float sample_rate);
+int tone_tracker_read(ToneTracker *tracker, ToneReading *out, int max);
+ToneTracker* tone_tracker_parse(const char *list, float sample_rate);
+
+#endif // TONE_TRACKER_H
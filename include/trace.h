@@ -0,0 +1,58 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glib.h>
+
+#define TRACE_BUFFER_EVENTS 65536       // Per thread, power of two; the newest are kept
+#define TRACE_MAX_THREADS 128
+#define TRACE_NAME_LENGTH 32
+
+typedef enum {
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    TRACE_PHASE_COUNTER,
+    TRACE_PHASE_INSTANT
+} TracePhase;
+
+typedef struct {
+    gint64 time_ns;
+    const char *name;           // A literal, read when the trace is written
+    double value;               // Counters only
+    gint phase;
+} TraceEvent;
+
+// Written only by the thread that owns it, as a ring that overwrites its
+// oldest events. Readers copy without stopping the writer and discard
+// whatever may have been overwritten meanwhile.
+typedef struct {
+    gint owned;                 // Claimed by a running thread
+    gint id;                    // Thread id in the trace; changes with each claim
+    gint written;               // Events ever written by the current owner, wraps
+    gint full;                  // Every slot has been written at least once
+    char name[TRACE_NAME_LENGTH];
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+// Set once tracing starts; read by the macros on every event
+extern gint trace_enabled;
+
+// Names must be string literals. Every macro is a load and a branch while
+// tracing is off (--trace not given).
+#define TRACE_EVENT(phase, name, value) \
+    do { \
+        if (G_UNLIKELY(g_atomic_int_get(&trace_enabled))) trace_event((phase), (name), (value)); \
+    } while (0)
+#define TRACE_BEGIN(name) TRACE_EVENT(TRACE_PHASE_BEGIN, (name), 0.0)
+#define TRACE_END(name) TRACE_EVENT(TRACE_PHASE_END, (name), 0.0)
+#define TRACE_COUNTER(name, value) TRACE_EVENT(TRACE_PHASE_COUNTER, (name), (double)(value))
+#define TRACE_INSTANT(name) TRACE_EVENT(TRACE_PHASE_INSTANT, (name), 0.0)
+
+// Function declarations
+void trace_start(void);
+void trace_thread_name(const char *name);
+void trace_reserve(void);
+void trace_event(TracePhase phase, const char *name, double value);
+gboolean trace_write(const char *path);
+
+#endif // TRACE_H
@@ -0,0 +1,95 @@
+// transfer_analyzer.h
+#ifndef TRANSFER_ANALYZER_H
+#define TRANSFER_ANALYZER_H
+
+#include <fftw3.h>
+#include <glib.h>
+#include <stdbool.h>
+
+#define TRANSFER_FFT_SIZE 8192
+#define TRANSFER_BINS (TRANSFER_FFT_SIZE / 2 + 1)
+#define TRANSFER_HOP (TRANSFER_FFT_SIZE / 2)      // 50% overlap
+#define TRANSFER_MAX_AVERAGES 64      // Linear up to here, then exponential
+#define TRANSFER_MAX_SWEEP_S 30.0     // Longest sweep recording
+#define TRANSFER_SWEEP_TAIL_S 0.5     // Recorded past the end marker for latency and decay
+#define TRANSFER_MIN_DB -60.0f
+#define TRANSFER_MAX_DB 20.0f
+
+struct AudioManager;
+struct WaveformGenerator;
+
+typedef enum {
+    TRANSFER_WELCH,     // Cross-spectral averaging of any broadband excitation
+    TRANSFER_SWEEP      // Deconvolved linear or exponential sweep
+} TransferMethod;
+
+// Published result, one value per FFT bin
+typedef struct {
+    TransferMethod method;
+    int averages;           // Welch frames, or sweeps deconvolved
+    float sample_rate;
+    float h1_db[TRANSFER_BINS];     // Sxy / Sxx; the sweep response for TRANSFER_SWEEP
+    float h2_db[TRANSFER_BINS];     // Syy / Syx, Welch only
+    float phase[TRANSFER_BINS];     // Of H1, radians
+    float coherence[TRANSFER_BINS]; // |Sxy|^2 / (Sxx Syy), Welch only
+} TransferResult;
+
+// x is the played signal and y the captured response, as the pairs from
+// audio_manager_read_capture()
+struct TransferAnalyzer {
+    float *window;
+    float *frame;               // Windowed input for the plan
+    fftwf_complex *spectrum_x;
+    fftwf_complex *spectrum_y;
+    fftwf_plan plan;            // r2c, executed on x and y with new-array execute
+
+    // Welch accumulators; double so long averages keep their precision
+    double *sxx;
+    double *syy;
+    double *sxy_re;
+    double *sxy_im;
+    int averages;
+    float *pending;             // Pairs not yet consumed by a full frame
+    size_t num_pending;
+    float *capture;             // One hop read from the capture ring
+
+    // Sweep recording between the start and end markers
+    float *sweep_x;
+    float *sweep_y;
+    size_t sweep_frames;
+    size_t sweep_capacity;
+    size_t sweep_tail;          // Frames still to record after the end marker
+    gboolean recording;
+    int sweeps;
+
+    float sample_rate;
+
+    GMutex mutex;               // Guards result and serial
+    TransferResult *result;
+    guint serial;               // Bumped on every published update
+
+    // Measurement thread
+    struct AudioManager *audio;
+    struct WaveformGenerator *generator;
+    GThread *thread;
+    gint running;
+};
+
+typedef struct TransferAnalyzer TransferAnalyzer;
+
+// Function declarations
+TransferAnalyzer* transfer_analyzer_create(void);
+void transfer_analyzer_destroy(TransferAnalyzer *analyzer);
+void transfer_analyzer_reset(TransferAnalyzer *analyzer, float sample_rate);
+void transfer_analyzer_process(TransferAnalyzer *analyzer, const float *pairs, size_t frames);
+void transfer_analyzer_begin_sweep(TransferAnalyzer *analyzer);
+void transfer_analyzer_end_sweep(TransferAnalyzer *analyzer);
+bool transfer_analyzer_read(TransferAnalyzer *analyzer, TransferResult *result, guint *serial);
+
+// Plays through the generator and measures from the audio manager's
+// capture on a thread of its own
+bool transfer_analyzer_start(TransferAnalyzer *analyzer, struct AudioManager *audio,
+                             struct WaveformGenerator *generator);
+void transfer_analyzer_stop(TransferAnalyzer *analyzer);
+
+#endif // TRANSFER_ANALYZER_H
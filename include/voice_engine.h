@@ -0,0 +1,97 @@
+// voice_engine.h
+#ifndef VOICE_ENGINE_H
+#define VOICE_ENGINE_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include "common_defs.h"
+#include "oscillator.h"
+#include "simd.h"
+
+#define VOICE_MAX 256                // Multiple of SIMD_LANES
+#define VOICE_EVENT_RING 256         // Power of two
+#define VOICE_DEFAULT_ATTACK_MS 5.0f
+#define VOICE_DEFAULT_RELEASE_MS 50.0f
+#define VOICE_MOD_INTERVALS ((MAX_BLOCK_SIZE + MOD_CONTROL_INTERVAL - 1) / MOD_CONTROL_INTERVAL)
+
+typedef enum {
+    VOICE_EVENT_NOTE_ON,
+    VOICE_EVENT_NOTE_OFF,
+    VOICE_EVENT_ALL_OFF,
+    VOICE_EVENT_ENVELOPE
+} VoiceEventType;
+
+typedef struct {
+    VoiceEventType type;
+    guint32 id;
+    float frequency;     // NOTE_ON; attack ms for ENVELOPE
+    float velocity;      // NOTE_ON; release ms for ENVELOPE
+} VoiceEvent;
+
+#define VOICE_ARRAY(type, name) type name[VOICE_MAX] __attribute__((aligned(64)))
+
+// Voice state as structure-of-arrays: lane k of every array is voice k.
+// Active voices are kept packed in [0, active) so rendering touches only
+// ceil(active / SIMD_LANES) groups. Only the render thread touches these.
+struct VoiceEngine {
+    VOICE_ARRAY(float, phase);       // Cycles, [0, 1)
+    VOICE_ARRAY(float, increment);   // Cycles per sample
+    VOICE_ARRAY(float, gain);        // Velocity
+    VOICE_ARRAY(float, env);         // Envelope level, [0, 1]
+    VOICE_ARRAY(float, env_step);    // Per sample; negative while releasing
+    VOICE_ARRAY(float, stage0);      // Ladder filter stages
+    VOICE_ARRAY(float, stage1);
+    VOICE_ARRAY(float, stage2);
+    VOICE_ARRAY(float, stage3);
+    VOICE_ARRAY(float, pink0);       // Pink noise poles, see pink_noise.h
+    VOICE_ARRAY(float, pink1);
+    VOICE_ARRAY(float, pink2);
+    VOICE_ARRAY(uint32_t, noise);    // xorshift32 state
+    VOICE_ARRAY(float, frequency);   // Hz, to rebuild increments on a rate change
+    VOICE_ARRAY(guint32, id);
+    VOICE_ARRAY(guint32, age);       // Note-on order, for stealing
+    int active;
+    guint32 next_age;
+    guint32 next_seed;
+
+    float sample_rate;
+    float attack_ms;
+    float release_ms;
+    guint64 steals;
+
+    // Multi-producer, single-consumer: producers serialize on the mutex,
+    // the render thread consumes without locking
+    VoiceEvent events[VOICE_EVENT_RING];
+    gint event_write;
+    gint event_read;
+    GMutex producer_mutex;
+
+    // Modulation is shared by every voice: one source state, expanded
+    // once per block into per-sample multipliers and the filter at each
+    // interval boundary, interpolated between them
+    ModState mod;
+    float pitch_mod[MAX_BLOCK_SIZE];
+    float gain_mod[MAX_BLOCK_SIZE];
+    float duty_mod[MAX_BLOCK_SIZE];
+    LadderCoeffs filter_mod[VOICE_MOD_INTERVALS + 1];
+
+    // Per-sample lane accumulators, summed across lanes once per block
+    v8sf mix[MAX_BLOCK_SIZE] __attribute__((aligned(64)));
+};
+
+typedef struct VoiceEngine VoiceEngine;
+
+// Function declarations
+VoiceEngine* voice_engine_create(float sample_rate);
+void voice_engine_destroy(VoiceEngine *engine);
+bool voice_engine_note_on(VoiceEngine *engine, guint32 id, float frequency, float velocity);
+bool voice_engine_note_off(VoiceEngine *engine, guint32 id);
+bool voice_engine_all_off(VoiceEngine *engine);
+bool voice_engine_set_envelope(VoiceEngine *engine, float attack_ms, float release_ms);
+
+// Render thread only
+void voice_engine_set_sample_rate(VoiceEngine *engine, float sample_rate);
+int voice_engine_render(VoiceEngine *engine, const OscillatorParams *params,
+                        float *out, size_t frames);
+
+#endif // VOICE_ENGINE_H
@@ -3,31 +3,25 @@
 
 #include <gtk/gtk.h>
 #include <stdbool.h>
+#include "latency_controller.h"
+#include "render_pool.h"
+#include "voice_engine.h"
+#include "param_event_queue.h"
+#include "sweep.h"
+#include "tone_tracker.h"
+#include "waveform_measure.h"
 
 // Forward declarations
 struct ParameterStore;
 struct ScopeWindow;
 struct AudioManager;
 
-#define SAMPLE_RATE 48000
-#define BUFFER_SIZE 256
-#define UPDATE_INTERVAL_MS 32
-
 #define TARGET_FPS 60
 #define FRAME_TIME_US (1000000 / TARGET_FPS)  // Convert to microseconds
 
-#define FILTER_STAGES 4
-
-typedef struct {
-    float cutoff;
-    float resonance;
-    float stage[FILTER_STAGES];
-    float delay[FILTER_STAGES];
-    float cutoff_mod;
-    float res_mod;
-    float cutoff_lfo_phase;
-    float res_lfo_phase;
-} LadderFilter;
+#define MAX_TONES 1024    // Largest multi-tone bank
+#define TONE_MIN_FREQ 20.0f
+#define TONE_MAX_FREQ 20000.0f
 
 struct WaveformGenerator {
     struct ParameterStore *params;
@@ -37,13 +31,28 @@ struct WaveformGenerator {
     GMutex mutex;
     GCond cond;
     gboolean running;
-    float phase;           // Current phase
-    float fm_phase;        // FM modulation phase
-    float am_phase;        // AM modulation phase
-    float dcm_phase;       // Duty cycle modulation phase
-    uint32_t sample_rate;  // Sample rate in Hz
-    size_t buffer_size;    // Number of samples per update
-    LadderFilter filter;
+    RenderPool *pool;      // One instance per channel, or per tone in a tone bank
+    int channels;          // Channels rendered per frame, follows the output ring
+    int tones;             // 0 renders one instance per channel
+    VoiceEngine *voices;   // Polyphonic notes, mixed to every channel
+    float *voice_out;      // Mono voice or sweep block
+    float *block_out;      // Interleaved block for the output ring
+    float *scope_history;  // Stereo frames gathered for the next scope publish
+    gint poly;             // Render voices instead of the channel generators
+    ModProgram mod;        // Modulation routes compiled for the current block
+    ParamEventQueue *events;    // Timestamped parameter changes, any thread pushes
+    guint64 sample_time;   // Frames rendered since creation; the event clock
+    Sweep sweep;           // Render thread state for WAVE_SWEEP
+    guint sweep_serial;    // Store serial the sweep was started from
+    gboolean sweeping;     // WAVE_SWEEP was selected for the last block
+    SweepMarkerRing markers;    // Sweep sync points, readable from any thread
+    ToneTracker *tracker;  // Fed channel 0 of every block; set before the thread starts
+    WaveformMeasure *measure;   // Vpp, RMS and edges of channel 0; set likewise
+    uint32_t sample_rate;  // Sample rate in Hz, follows the audio stream
+    float inv_sample_rate; // 1 / sample_rate
+    float phase_scale;     // 2*pi / sample_rate: Hz to radians per sample
+    size_t buffer_size;    // Largest number of samples per update
+    LatencyController latency;  // Output ring fill target and block size
     GMutex init_mutex;
     GCond init_cond;
     gboolean fully_initialized;
@@ -58,6 +67,15 @@ struct WaveformGenerator* waveform_generator_create(struct ParameterStore *param
 void waveform_generator_destroy(struct WaveformGenerator *gen);
 void waveform_generator_set_audio_enabled(struct WaveformGenerator *gen, bool enable);
 void waveform_generator_start(struct WaveformGenerator *gen);  
+void waveform_generator_set_sample_rate(struct WaveformGenerator *gen, uint32_t sample_rate);
+bool waveform_generator_set_tones(struct WaveformGenerator *gen, int tones, int render_threads);
+void waveform_generator_set_poly(struct WaveformGenerator *gen, bool enable);
+guint64 waveform_generator_get_sample_time(struct WaveformGenerator *gen);
+uint32_t waveform_generator_get_sample_rate(struct WaveformGenerator *gen);
+bool waveform_generator_set_channels(struct WaveformGenerator *gen, int channels);
+void waveform_generator_render(struct WaveformGenerator *gen, float *out, size_t frames);
+int waveform_generator_read_sweep_markers(struct WaveformGenerator *gen, gint *cursor,
+                                          SweepMarker *out, int max);
 
 
 
@@ -0,0 +1,94 @@
+// waveform_measure.h
+#ifndef WAVEFORM_MEASURE_H
+#define WAVEFORM_MEASURE_H
+
+#include <glib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "simd.h"
+
+#define MEASURE_DEFAULT_WINDOW_S 0.1f
+#define MEASURE_CHUNK 256             // Frames gathered per vector pass
+#define MEASURE_RING_SIZE 32          // Power of two
+#define MEASURE_MIN_SWING 1e-3f       // Peak-to-peak below which edges are not timed
+
+// One measurement window of channel 0. Edge figures need two windows: the
+// 10/50/90 % levels come from the previous window's extremes.
+typedef struct {
+    guint64 sample_time;    // First frame of the window
+    float duration;         // Seconds
+    float min;
+    float max;
+    float vpp;
+    float mean;
+    float rms;              // Including DC
+    float ac_rms;           // DC removed
+    float crest_factor;     // Larger peak over RMS
+    int edges;              // Rising mid-level crossings in the window
+    float frequency;        // Hz, 0 with fewer than two rising edges
+    float period;           // Seconds
+    float duty_percent;     // High time over whole periods
+    float rise_time;        // 10-90 %, seconds, 0 when no edge was timed
+    float fall_time;
+} WaveformMeasurement;
+
+// Vpp, RMS, mean and edge timing over consecutive windows of the output.
+// Each chunk is copied out of the interleaved block once, then a single
+// vector pass keeps the extremes and sums and flags every group of eight
+// samples that crosses a reference level. Only flagged groups go through
+// the scalar edge logic, which interpolates the crossing times.
+struct WaveformMeasure {
+    float window_seconds;
+    float sample_rate;
+    size_t window_frames;
+    size_t position;                // Frames into the current window
+    guint64 window_start;
+
+    // Current window
+    float min;
+    float max;
+    double sum;
+    double sum_squares;
+    int rises;
+    double first_rise;              // Frames, relative to the window start
+    double last_rise;
+    double high_time;               // Summed over pulses that started in the window
+    double high_at_last_rise;
+    double rise_sum;
+    int rise_count;
+    double fall_sum;
+    int fall_count;
+
+    // Edge state, carried across blocks and windows
+    gboolean have_levels;
+    float level_low;
+    float level_mid;
+    float level_high;
+    float last_sample;
+    gboolean from_low;              // Rose through the low level, not yet through high
+    gboolean from_high;
+    double low_exit;                // When it did, relative to the window start
+    double high_exit;
+    gboolean armed_rise;            // Mid-level hysteresis: has been below low since the last rise
+    gboolean armed_fall;
+    double pulse_start;             // Last counted rise
+
+    // Written by the processing thread, read from any thread
+    WaveformMeasurement ring[MEASURE_RING_SIZE];
+    gint written;                   // Windows ever published
+};
+
+typedef struct WaveformMeasure WaveformMeasure;
+
+// Function declarations
+WaveformMeasure* waveform_measure_create(float window_seconds);
+void waveform_measure_destroy(WaveformMeasure *measure);
+void waveform_measure_process(WaveformMeasure *measure, const float *samples, size_t frames,
+                              int stride, guint64 sample_time, float sample_rate);
+gboolean waveform_measure_latest(const WaveformMeasure *measure, WaveformMeasurement *out);
+int waveform_measure_read(const WaveformMeasure *measure, gint *cursor,
+                          WaveformMeasurement *out, int max);
+void waveform_measure_write_header(FILE *file);
+void waveform_measure_write(FILE *file, const WaveformMeasurement *measurement);
+
+#endif // WAVEFORM_MEASURE_H
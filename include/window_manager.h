@@ -4,6 +4,7 @@
 #include <gtk/gtk.h>
 #include "audio_manager.h"
 #include "waveform_generator.h"  // Add this include
+#include "transfer_analyzer.h"
 
 typedef struct {
     GtkWidget *main_window;
@@ -13,6 +14,7 @@ typedef struct {
     GtkWidget *control_container;
     AudioManager *audio_manager;
     WaveformGenerator *generator;  // Now WaveformGenerator is known
+    TransferAnalyzer *transfer;    // Created the first time a measurement starts
     int window_width;
     int window_height;
 } WindowManager;
@@ -0,0 +1,35 @@
+// xy_plot.h
+#ifndef XY_PLOT_H
+#define XY_PLOT_H
+
+#include <glib.h>
+#include <stddef.h>
+#include "simd.h"
+
+#define XY_PLOT_FULL_SCALE 2.0f     // Volts from centre to edge, as the trace's vertical axis
+
+// Rasterizes (x, y) sample pairs straight into a square ARGB32 image.
+// Pairs are mapped to pixels eight at a time, then reduced to display
+// resolution by min/max binning: each run of consecutive pairs that
+// travels about one pixel keeps only its extremes along its longer axis,
+// in time order, so spikes survive. The survivors are joined with short
+// DDA segments that add brightness where the path crosses itself.
+struct XYPlot {
+    float *x;               // Pixel positions, 64-byte aligned
+    float *y;
+    float *points;          // Decimated (x, y) pixel positions
+    size_t capacity;        // Pairs
+    size_t num_points;      // After the last render
+    size_t bin_frames;
+};
+
+typedef struct XYPlot XYPlot;
+
+// Function declarations
+XYPlot* xy_plot_create(size_t max_frames);
+void xy_plot_destroy(XYPlot *plot);
+size_t xy_plot_render(XYPlot *plot, const float *pairs, size_t frames,
+                      guint8 *pixels, int stride, int size,
+                      float red, float green, float blue);
+
+#endif // XY_PLOT_H
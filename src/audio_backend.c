@@ -0,0 +1,254 @@
+#include "audio_backend.h"
+#include "logger.h"
+#include "trace.h"
+#include "rt_thread.h"
+#include <sndfile.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+#define FREERUN_WAIT_US 10000
+
+static void frames_to_timespec(guint64 frames, int sample_rate, struct timespec *ts) {
+    // Split to keep the nanosecond math exact and overflow-free
+    ts->tv_sec = frames / sample_rate;
+    ts->tv_nsec = ((frames % sample_rate) * NSEC_PER_SEC) / sample_rate;
+}
+
+static void timespec_add(struct timespec *a, const struct timespec *b) {
+    a->tv_sec += b->tv_sec;
+    a->tv_nsec += b->tv_nsec;
+    if (a->tv_nsec >= (long)NSEC_PER_SEC) {
+        a->tv_sec++;
+        a->tv_nsec -= NSEC_PER_SEC;
+    }
+}
+
+static gint64 timespec_diff_ns(const struct timespec *a, const struct timespec *b) {
+    return (gint64)(a->tv_sec - b->tv_sec) * (gint64)NSEC_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+static bool backend_is_timed(AudioBackendType type) {
+    return type == AUDIO_BACKEND_NULL || type == AUDIO_BACKEND_LOOPBACK;
+}
+
+// Sleep until the absolute deadline of the next period. Deadlines are derived
+// from the total frame count rather than accumulated, so there is no drift.
+// Returns true if we woke more than a full period late (an xrun on real hardware).
+static bool wait_next_period(AudioBackend *backend, struct timespec *base, guint64 *period_index) {
+    struct timespec deadline = *base;
+    struct timespec offset;
+    frames_to_timespec((*period_index + 1) * backend->frames_per_buffer,
+                       backend->sample_rate, &offset);
+    timespec_add(&deadline, &offset);
+
+    struct itimerspec spec = {
+        .it_interval = {0, 0},
+        .it_value = deadline
+    };
+    if (timerfd_settime(backend->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0) {
+        uint64_t expirations;
+        ssize_t ret;
+        do {
+            ret = read(backend->timer_fd, &expirations, sizeof(expirations));
+        } while (ret < 0 && errno == EINTR);
+    }
+
+    (*period_index)++;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    gint64 period_ns = (gint64)(backend->frames_per_buffer * NSEC_PER_SEC / backend->sample_rate);
+    if (timespec_diff_ns(&now, &deadline) > period_ns) {
+        // Too late to catch up; restart the schedule from now like a device would
+        *base = now;
+        *period_index = 0;
+        return true;
+    }
+    return false;
+}
+
+static gpointer backend_thread_func(gpointer data) {
+    AudioBackend *backend = (AudioBackend *)data;
+    bool timed = backend_is_timed(backend->type);
+    size_t frames = backend->frames_per_buffer;
+    logger_thread_init();
+    trace_thread_name("audio backend");
+    rt_thread_setup(RT_THREAD_AUDIO, "audio backend");
+
+    struct timespec base;
+    clock_gettime(CLOCK_MONOTONIC, &base);
+    guint64 period_index = 0;
+    PaStreamCallbackFlags flags = 0;
+
+    LOG_INFO("Audio backend '%s' running: %d Hz, %d channels, %zu frames",
+             audio_backend_name(backend->type), backend->sample_rate,
+             backend->channels, frames);
+
+    while (g_atomic_int_get(&backend->running)) {
+        if (timed) {
+            if (wait_next_period(backend, &base, &period_index)) {
+                TRACE_INSTANT("missed period");
+                flags |= paOutputUnderflow;
+            }
+        } else if (backend->wait_ready &&
+                   !backend->wait_ready(backend->user_data, frames, FREERUN_WAIT_US)) {
+            continue;  // Re-check running flag
+        }
+
+        gint64 now_us = g_get_monotonic_time();
+        PaStreamCallbackTimeInfo time_info = {
+            .inputBufferAdcTime = (now_us - backend->start_time) / 1e6,
+            .currentTime = (now_us - backend->start_time) / 1e6,
+            .outputBufferDacTime = (now_us - backend->start_time) / 1e6
+        };
+
+        // Loopback aliases input to output: the callback fills its output
+        // before it reads input, so it captures exactly what it just played.
+        const void *input = (backend->type == AUDIO_BACKEND_LOOPBACK) ? backend->output : NULL;
+
+        int result = backend->callback(input, backend->output, frames,
+                                       &time_info, flags, backend->user_data);
+        flags = 0;
+
+        if (backend->type == AUDIO_BACKEND_FILE && backend->file) {
+            sf_writef_float((SNDFILE *)backend->file, backend->output, frames);
+        }
+        backend->frames_processed += frames;
+
+        if (result != paContinue) {
+            break;
+        }
+    }
+
+    LOG_INFO("Audio backend '%s' stopped after %" G_GUINT64_FORMAT " frames",
+             audio_backend_name(backend->type), backend->frames_processed);
+    return NULL;
+}
+
+AudioBackend* audio_backend_open(AudioBackendType type, const char *file_path,
+                                 int sample_rate, int channels,
+                                 unsigned long frames_per_buffer,
+                                 PaStreamCallback *callback,
+                                 AudioBackendWaitFunc wait_ready,
+                                 void *user_data) {
+    if (type == AUDIO_BACKEND_PORTAUDIO || !callback ||
+        sample_rate <= 0 || channels <= 0 || frames_per_buffer == 0) {
+        LOG_ERROR("Audio backend: Invalid parameters");
+        return NULL;
+    }
+
+    AudioBackend *backend = g_new0(AudioBackend, 1);
+    backend->type = type;
+    backend->sample_rate = sample_rate;
+    backend->channels = channels;
+    backend->frames_per_buffer = frames_per_buffer;
+    backend->callback = callback;
+    backend->wait_ready = wait_ready;
+    backend->user_data = user_data;
+    backend->timer_fd = -1;
+    backend->output = g_malloc0(frames_per_buffer * channels * sizeof(float));
+
+    if (backend_is_timed(type)) {
+        backend->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (backend->timer_fd < 0) {
+            LOG_ERROR("Audio backend: Failed to create timerfd: %s", strerror(errno));
+            audio_backend_close(backend);
+            return NULL;
+        }
+    }
+
+    if (type == AUDIO_BACKEND_FILE) {
+        backend->file_path = g_strdup(file_path ? file_path : AUDIO_BACKEND_DEFAULT_FILE);
+        SF_INFO info = {
+            .samplerate = sample_rate,
+            .channels = channels,
+            .format = SF_FORMAT_WAV | SF_FORMAT_FLOAT
+        };
+        backend->file = sf_open(backend->file_path, SFM_WRITE, &info);
+        if (!backend->file) {
+            LOG_ERROR("Audio backend: Failed to open '%s': %s",
+                      backend->file_path, sf_strerror(NULL));
+            audio_backend_close(backend);
+            return NULL;
+        }
+    }
+
+    return backend;
+}
+
+bool audio_backend_start(AudioBackend *backend) {
+    if (!backend || backend->thread) return false;
+
+    backend->frames_processed = 0;
+    backend->start_time = g_get_monotonic_time();
+    g_atomic_int_set(&backend->running, 1);
+    backend->thread = g_thread_new("audio_backend", backend_thread_func, backend);
+    return backend->thread != NULL;
+}
+
+void audio_backend_stop(AudioBackend *backend) {
+    if (!backend || !backend->thread) return;
+
+    g_atomic_int_set(&backend->running, 0);
+    g_thread_join(backend->thread);
+    backend->thread = NULL;
+}
+
+void audio_backend_close(AudioBackend *backend) {
+    if (!backend) return;
+
+    audio_backend_stop(backend);
+
+    if (backend->timer_fd >= 0) {
+        close(backend->timer_fd);
+    }
+    if (backend->file) {
+        sf_close((SNDFILE *)backend->file);
+        LOG_INFO("Audio backend: Wrote %" G_GUINT64_FORMAT " frames to %s",
+                 backend->frames_processed, backend->file_path);
+    }
+    g_free(backend->file_path);
+    g_free(backend->output);
+    g_free(backend);
+}
+
+const char* audio_backend_name(AudioBackendType type) {
+    switch (type) {
+        case AUDIO_BACKEND_PORTAUDIO:    return "portaudio";
+        case AUDIO_BACKEND_NULL:         return "null";
+        case AUDIO_BACKEND_NULL_FREERUN: return "null-fast";
+        case AUDIO_BACKEND_LOOPBACK:     return "loopback";
+        case AUDIO_BACKEND_FILE:         return "file";
+        default:                         return "unknown";
+    }
+}
+
+// Accepts "null", "null-fast", "loopback", "file" and "file:PATH"
+bool audio_backend_parse(const char *spec, AudioBackendType *type, char **file_path) {
+    if (!spec || !type) return false;
+
+    if (file_path) *file_path = NULL;
+
+    if (strcmp(spec, "portaudio") == 0) {
+        *type = AUDIO_BACKEND_PORTAUDIO;
+    } else if (strcmp(spec, "null") == 0) {
+        *type = AUDIO_BACKEND_NULL;
+    } else if (strcmp(spec, "null-fast") == 0) {
+        *type = AUDIO_BACKEND_NULL_FREERUN;
+    } else if (strcmp(spec, "loopback") == 0) {
+        *type = AUDIO_BACKEND_LOOPBACK;
+    } else if (strcmp(spec, "file") == 0) {
+        *type = AUDIO_BACKEND_FILE;
+    } else if (g_str_has_prefix(spec, "file:") && spec[5] != '\0') {
+        *type = AUDIO_BACKEND_FILE;
+        if (file_path) *file_path = g_strdup(spec + 5);
+    } else {
+        return false;
+    }
+    return true;
+}
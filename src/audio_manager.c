@@ -1,5 +1,9 @@
 #include "audio_manager.h"
 #include "common_defs.h"
+#include "logger.h"
+#include "trace.h"
+#include "rt_thread.h"
+#include "rt_pool.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -7,17 +11,23 @@
 #include <time.h>
 #include <pthread.h>
 
-void circular_buffer_init(CircularBuffer *buffer, size_t size_in_frames) {
+void circular_buffer_init(CircularBuffer *buffer, size_t size_in_frames, int channels) {
     buffer->size = size_in_frames;
-    buffer->data = g_malloc(size_in_frames * 2 * sizeof(float));
+    buffer->channels = channels;
+    buffer->capacity = size_in_frames * channels;
+    buffer->data = rt_pool_new(float, buffer->capacity);
     buffer->read_pos = 0;
     buffer->write_pos = 0;
     buffer->frames_stored = 0;
+    buffer->min_fill = MIN_BUFFER_FILL;
     buffer->last_callback_time = 0;
     buffer->callback_count = 0;
+    buffer->underruns = 0;
+    buffer->overruns = 0;
+    buffer->dropped_frames = 0;
     g_mutex_init(&buffer->mutex);
     g_cond_init(&buffer->data_ready);
-    memset(buffer->data, 0, size_in_frames * 2 * sizeof(float));
+    g_cond_init(&buffer->data_written);
 }
 
 
@@ -26,9 +36,31 @@ void circular_buffer_clear(CircularBuffer *buffer) {
     buffer->read_pos = 0;
     buffer->write_pos = 0;
     buffer->frames_stored = 0;
-    memset(buffer->data, 0, buffer->size * 2 * sizeof(float));
+    memset(buffer->data, 0, buffer->size * buffer->channels * sizeof(float));
+    g_mutex_unlock(&buffer->mutex);
+    LOG_DEBUG("Circular buffer cleared and zeroed");
+}
+
+// At stream open. Reuses the storage when the new layout fits and carves
+// a larger one from the pool otherwise, so reopening at the same or a
+// smaller format allocates nothing. The mutex and conditions stay valid.
+void circular_buffer_resize(CircularBuffer *buffer, size_t size_in_frames, int channels) {
+    g_mutex_lock(&buffer->mutex);
+    size_t needed = size_in_frames * channels;
+    if (needed > buffer->capacity) {
+        rt_pool_free(buffer->data);
+        buffer->data = rt_pool_new(float, needed);
+        buffer->capacity = needed;
+    } else {
+        memset(buffer->data, 0, needed * sizeof(float));
+    }
+    buffer->size = size_in_frames;
+    buffer->channels = channels;
+    buffer->read_pos = 0;
+    buffer->write_pos = 0;
+    buffer->frames_stored = 0;
+    buffer->min_fill = MIN_BUFFER_FILL;
     g_mutex_unlock(&buffer->mutex);
-    g_print("Circular buffer cleared and zeroed\n");
 }
 
 
@@ -37,7 +69,8 @@ void circular_buffer_clear(CircularBuffer *buffer) {
 void circular_buffer_destroy(CircularBuffer *buffer) {
     g_mutex_clear(&buffer->mutex);
     g_cond_clear(&buffer->data_ready);
-    g_free(buffer->data);
+    g_cond_clear(&buffer->data_written);
+    rt_pool_free(buffer->data);
 }
 
 size_t circular_buffer_write(CircularBuffer *buffer, float *data, size_t frames) {
@@ -49,26 +82,34 @@ size_t circular_buffer_write(CircularBuffer *buffer, float *data, size_t frames)
     size_t current_write_pos = buffer->write_pos;
 
     if (frames_to_write > 0) {
-        // Calculate in stereo samples for safer bounds checking
-        size_t stereo_write_pos = current_write_pos * 2;
-        size_t stereo_buffer_size = buffer->size * 2;
-        size_t stereo_frames_to_write = frames_to_write * 2;
+        // Calculate in interleaved samples for safer bounds checking
+        size_t channels = buffer->channels;
+        size_t sample_write_pos = current_write_pos * channels;
+        size_t sample_buffer_size = buffer->size * channels;
+        size_t samples_to_write = frames_to_write * channels;
 
         // Check if we can write in one chunk
-        if (stereo_write_pos + stereo_frames_to_write <= stereo_buffer_size) {
-            memcpy(buffer->data + stereo_write_pos, data,
-                   stereo_frames_to_write * sizeof(float));
+        if (sample_write_pos + samples_to_write <= sample_buffer_size) {
+            memcpy(buffer->data + sample_write_pos, data,
+                   samples_to_write * sizeof(float));
         } else {
             // Split write into two chunks
-            size_t first_chunk_stereo = stereo_buffer_size - stereo_write_pos;
-            memcpy(buffer->data + stereo_write_pos, data,
-                   first_chunk_stereo * sizeof(float));
-            memcpy(buffer->data, data + first_chunk_stereo,
-                   (stereo_frames_to_write - first_chunk_stereo) * sizeof(float));
+            size_t first_chunk_samples = sample_buffer_size - sample_write_pos;
+            memcpy(buffer->data + sample_write_pos, data,
+                   first_chunk_samples * sizeof(float));
+            memcpy(buffer->data, data + first_chunk_samples,
+                   (samples_to_write - first_chunk_samples) * sizeof(float));
         }
 
         buffer->write_pos = (current_write_pos + frames_to_write) % buffer->size;
         buffer->frames_stored += frames_to_write;
+        g_cond_signal(&buffer->data_written);
+    }
+
+    if (frames_to_write < frames) {
+        TRACE_INSTANT("overrun");
+        buffer->overruns++;
+        buffer->dropped_frames += frames - frames_to_write;
     }
 
     g_mutex_unlock(&buffer->mutex);
@@ -81,14 +122,14 @@ size_t circular_buffer_read(CircularBuffer *buffer, float *data, size_t frames)
     // Get all values we need under lock
     size_t current_frames = buffer->frames_stored;
     size_t current_read_pos = buffer->read_pos;
-    size_t current_write_pos = buffer->write_pos;
+    size_t channels = buffer->channels;
     
-    if (current_frames < MIN_BUFFER_FILL) {
-        g_print("Buffer low (%zu < %zu), outputting silence (write_pos=%zu, read_pos=%zu)\n", 
-                current_frames, (size_t)MIN_BUFFER_FILL,
-                current_write_pos, current_read_pos);
+    // Runs on the audio thread: count the event, never print here
+    if (current_frames < buffer->min_fill) {
+        TRACE_INSTANT("underrun");
+        buffer->underruns++;
         g_mutex_unlock(&buffer->mutex);
-        memset(data, 0, frames * 2 * sizeof(float));
+        memset(data, 0, frames * channels * sizeof(float));
         return frames;
     }
     
@@ -100,13 +141,13 @@ size_t circular_buffer_read(CircularBuffer *buffer, float *data, size_t frames)
     if (frames_to_read > 0) {
         size_t first_chunk = buffer->size - current_read_pos;
         if (frames_to_read <= first_chunk) {
-            memcpy(data, buffer->data + (current_read_pos * 2),
-                   frames_to_read * 2 * sizeof(float));
+            memcpy(data, buffer->data + (current_read_pos * channels),
+                   frames_to_read * channels * sizeof(float));
         } else {
-            memcpy(data, buffer->data + (current_read_pos * 2),
-                   first_chunk * 2 * sizeof(float));
-            memcpy(data + (first_chunk * 2), buffer->data,
-                   (frames_to_read - first_chunk) * 2 * sizeof(float));
+            memcpy(data, buffer->data + (current_read_pos * channels),
+                   first_chunk * channels * sizeof(float));
+            memcpy(data + (first_chunk * channels), buffer->data,
+                   (frames_to_read - first_chunk) * channels * sizeof(float));
         }
         
         buffer->read_pos = (current_read_pos + frames_to_read) % buffer->size;
@@ -114,51 +155,116 @@ size_t circular_buffer_read(CircularBuffer *buffer, float *data, size_t frames)
     }
     
     if (frames_to_read < frames) {
-        memset(data + (frames_to_read * 2), 0,
-               (frames - frames_to_read) * 2 * sizeof(float));
+        TRACE_INSTANT("underrun");
+        buffer->underruns++;
+        memset(data + (frames_to_read * channels), 0,
+               (frames - frames_to_read) * channels * sizeof(float));
     }
     
     g_mutex_unlock(&buffer->mutex);
     return frames;
 }
 
+// Like circular_buffer_read but without the playback priming rules:
+// returns only what is stored and never pads with silence.
+size_t circular_buffer_drain(CircularBuffer *buffer, float *data, size_t max_frames) {
+    g_mutex_lock(&buffer->mutex);
+
+    size_t frames_to_read = MIN(max_frames, buffer->frames_stored);
+    size_t current_read_pos = buffer->read_pos;
+    size_t channels = buffer->channels;
+
+    if (frames_to_read > 0) {
+        size_t first_chunk = buffer->size - current_read_pos;
+        if (frames_to_read <= first_chunk) {
+            memcpy(data, buffer->data + (current_read_pos * channels),
+                   frames_to_read * channels * sizeof(float));
+        } else {
+            memcpy(data, buffer->data + (current_read_pos * channels),
+                   first_chunk * channels * sizeof(float));
+            memcpy(data + (first_chunk * channels), buffer->data,
+                   (frames_to_read - first_chunk) * channels * sizeof(float));
+        }
+
+        buffer->read_pos = (current_read_pos + frames_to_read) % buffer->size;
+        buffer->frames_stored -= frames_to_read;
+    }
+
+    g_mutex_unlock(&buffer->mutex);
+    return frames_to_read;
+}
+
+// Pair channel 0 of what was just played with channel 0 of the input
+static void capture_write_pairs(AudioManager *manager, const float *in,
+                                const float *out, size_t frames) {
+    size_t done = 0;
+    while (done < frames) {
+        size_t chunk = MIN(frames - done, (size_t)AUDIO_BUFFER_SIZE);
+        for (size_t i = 0; i < chunk; i++) {
+            manager->capture_scratch[i * 2] = out[(done + i) * manager->channels];
+            manager->capture_scratch[i * 2 + 1] = in[(done + i) * manager->input_channels];
+        }
+        circular_buffer_write(&manager->capture, manager->capture_scratch, chunk);
+        done += chunk;
+    }
+}
+
+// Free-running backends consume only once the generator has produced a block
+static bool wait_for_output_data(void *user_data, size_t frames, gint64 timeout_us) {
+    AudioManager *manager = (AudioManager *)user_data;
+    CircularBuffer *buffer = &manager->buffer;
+    size_t needed = MAX(frames, buffer->min_fill);
+    gint64 end_time = g_get_monotonic_time() + timeout_us;
+
+    g_mutex_lock(&buffer->mutex);
+    while (buffer->frames_stored < needed) {
+        if (!g_cond_wait_until(&buffer->data_written, &buffer->mutex, end_time)) {
+            break;
+        }
+    }
+    bool ready = buffer->frames_stored >= needed;
+    g_mutex_unlock(&buffer->mutex);
+    return ready;
+}
+
 static int pa_callback(const void *input,
                       void *output,
                       unsigned long framesPerBuffer,
                       const PaStreamCallbackTimeInfo* timeInfo,
                       PaStreamCallbackFlags statusFlags,
                       void *userData) {
-    (void)input;           // Unused parameters marked explicitly
-    (void)timeInfo;
-    (void)statusFlags;
+    (void)timeInfo;        // Unused parameters marked explicitly
     
-    //static bool priority_set = false;
     AudioManager *manager = (AudioManager *)userData;
     float *out = (float*)output;
     
-/*
-    // Set thread priority once on first callback
-    if (!priority_set) {
-        // macOS thread priority setting
-        if (pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0) == 0) {
-            g_print("Audio callback: Set to USER_INTERACTIVE QoS\n");
-            priority_set = true;
-        } else {
-            g_print("Audio callback: Failed to set thread QoS\n");
-        }
-    }
-*/   
+    // The host's thread: only denormals are set here, a helper promotes it
+    rt_thread_adopt(RT_THREAD_AUDIO, "audio callback");
+    trace_thread_name("audio callback");
+    TRACE_BEGIN("audio callback");
     g_mutex_lock(&manager->buffer.mutex);
     
     // Track actual callback timing
     gint64 current_time = g_get_monotonic_time();
+    gint64 interval_us = 0;
     
     if (manager->buffer.last_callback_time != 0) {
-        gdouble interval = (current_time - manager->buffer.last_callback_time) / 1000.0;
-        //g_print("Audio callback interval: %.3f ms\n", interval);
+        interval_us = current_time - manager->buffer.last_callback_time;
     }
     manager->buffer.last_callback_time = current_time;
     manager->buffer.callback_count++;
+
+    // With paFramesPerBufferUnspecified the host picks the size; prime for it
+    if (framesPerBuffer > manager->buffer.min_fill) {
+        manager->buffer.min_fill = framesPerBuffer;
+    }
+
+    // Ring state as the callback finds it
+    size_t fill_frames = manager->buffer.frames_stored;
+    size_t underruns = manager->buffer.underruns;
+    size_t overruns = manager->buffer.overruns;
+    size_t dropped_frames = manager->buffer.dropped_frames;
+    TRACE_COUNTER("ring fill (callback)", fill_frames);
     
     // Signal data consumers
     g_cond_signal(&manager->buffer.data_ready);
@@ -166,35 +272,217 @@ static int pa_callback(const void *input,
     
     // Read from circular buffer
     circular_buffer_read(&manager->buffer, out, framesPerBuffer);
+
+    // Input is read only after output is filled; the loopback backend relies on this
+    if (input && manager->input_channels > 0 && manager->capture_enabled) {
+        capture_write_pairs(manager, (const float *)input, out, framesPerBuffer);
+    }
+
+    audio_telemetry_record(&manager->telemetry, interval_us,
+                           g_get_monotonic_time() - current_time,
+                           fill_frames, underruns, overruns, dropped_frames,
+                           statusFlags, manager->sample_rate, framesPerBuffer);
+    TRACE_END("audio callback");
     return paContinue;
 }
 
-AudioManager* audio_manager_create(void) {
-   PaError err = Pa_Initialize();
-   if (err != paNoError) {
-       g_print("Failed to initialize PortAudio: %s\n", Pa_GetErrorText(err));
-       return NULL;
-   }
+// Prefer the requested rate, then the device default, then any common rate
+static double negotiate_sample_rate(const PaStreamParameters *params,
+                                    const PaDeviceInfo *info, int requested) {
+    static const double common_rates[] = {48000.0, 44100.0, 96000.0, 88200.0, 192000.0};
+
+    if (requested > 0 && Pa_IsFormatSupported(NULL, params, requested) == paFormatIsSupported) {
+        return requested;
+    }
+    LOG_WARN("Device rejected %d Hz", requested);
+    if (Pa_IsFormatSupported(NULL, params, info->defaultSampleRate) == paFormatIsSupported) {
+        return info->defaultSampleRate;
+    }
+    for (size_t i = 0; i < G_N_ELEMENTS(common_rates); i++) {
+        if (Pa_IsFormatSupported(NULL, params, common_rates[i]) == paFormatIsSupported) {
+            return common_rates[i];
+        }
+    }
+    return 0.0;
+}
+
+// The output device itself if it records, else the default input when it
+// shares the output's host API (PortAudio cannot mix host APIs in a stream)
+static PaDeviceIndex find_input_device(PaDeviceIndex output_device, const PaDeviceInfo *output_info) {
+    if (output_info->maxInputChannels > 0) {
+        return output_device;
+    }
 
+    PaDeviceIndex input_device = Pa_GetDefaultInputDevice();
+    const PaDeviceInfo *input_info = Pa_GetDeviceInfo(input_device);
+    if (input_info && input_info->maxInputChannels > 0 &&
+        input_info->hostApi == output_info->hostApi) {
+        return input_device;
+    }
+    return paNoDevice;
+}
+
+// Opens and starts the PortAudio stream for the selected device, with the
+// manager's mutex held. Leaves manager->stream NULL on failure.
+static bool open_portaudio_stream(AudioManager *manager, bool with_input) {
+    const PaDeviceInfo *outputInfo = Pa_GetDeviceInfo(manager->output_device);
+    if (!outputInfo) {
+        LOG_ERROR("Failed to get output device info");
+        return false;
+    }
+
+    // Open as many channels as asked for, up to what the device exposes
+    int max_channels = MIN(outputInfo->maxOutputChannels, MAX_OUTPUT_CHANNELS);
+    manager->channels = manager->requested_channels ?
+        MIN(manager->requested_channels, max_channels) : max_channels;
+    if (manager->channels < 1) {
+        LOG_ERROR("Device has no output channels");
+        return false;
+    }
+    if (manager->requested_channels > manager->channels) {
+        LOG_WARN("Device exposes %d output channels, %d requested",
+                 outputInfo->maxOutputChannels, manager->requested_channels);
+    }
+
+    PaStreamParameters output_params = {
+        .device = manager->output_device,
+        .channelCount = manager->channels,
+        .sampleFormat = paFloat32,
+        .suggestedLatency = outputInfo->defaultLowOutputLatency,
+        .hostApiSpecificStreamInfo = NULL
+    };
+
+    double rate = negotiate_sample_rate(&output_params, outputInfo,
+                                        manager->requested_sample_rate);
+    if (rate <= 0.0) {
+        LOG_ERROR("Device supports none of the usual sample rates");
+        return false;
+    }
+
+    // Duplex only while capture is on, when the device (or the default
+    // input on the same host API) can record, so measurements see the
+    // response in step with what was played; plain playback never opens an
+    // input. Falls back to output only if the host refuses.
+    PaStreamParameters input_params = {0};
+    PaDeviceIndex input_device = with_input ?
+        find_input_device(manager->output_device, outputInfo) : paNoDevice;
+    manager->input_channels = 0;
+    if (input_device != paNoDevice) {
+        input_params = (PaStreamParameters){
+            .device = input_device,
+            .channelCount = 1,
+            .sampleFormat = paFloat32,
+            .suggestedLatency = Pa_GetDeviceInfo(input_device)->defaultLowInputLatency,
+            .hostApiSpecificStreamInfo = NULL
+        };
+        manager->input_channels = 1;
+    }
+
+    unsigned long frames = manager->frames_per_buffer ? manager->frames_per_buffer
+                                                      : paFramesPerBufferUnspecified;
+    PaError err = Pa_OpenStream(&manager->stream,
+                                manager->input_channels ? &input_params : NULL,
+                                &output_params, rate, frames, paNoFlag,
+                                pa_callback, manager);
+    if (err != paNoError && manager->input_channels) {
+        LOG_WARN("Failed to open duplex stream: %s, opening output only",
+                 Pa_GetErrorText(err));
+        manager->input_channels = 0;
+        err = Pa_OpenStream(&manager->stream, NULL, &output_params, rate, frames,
+                            paNoFlag, pa_callback, manager);
+    }
+
+    if (err != paNoError) {
+        LOG_ERROR("Failed to open stream: %s", Pa_GetErrorText(err));
+        return false;
+    }
+
+    // The host may have adjusted the rate; everything downstream follows it
+    const PaStreamInfo *stream_info = Pa_GetStreamInfo(manager->stream);
+    manager->sample_rate = (int)lround(stream_info ? stream_info->sampleRate : rate);
+    manager->output_latency_ms = stream_info ? stream_info->outputLatency * 1000.0 : 0.0;
+    circular_buffer_resize(&manager->buffer, CIRCULAR_BUFFER_FRAMES(manager->sample_rate),
+                           manager->channels);
+    LOG_INFO("Negotiated %d Hz, %d channels, %s frames per buffer%s", manager->sample_rate,
+             manager->channels, manager->frames_per_buffer ? "fixed" : "host-chosen",
+             manager->input_channels ? ", with input" : "");
+
+    // The callback runs on the host's thread, which we cannot prepare
+    trace_reserve();
+    err = Pa_StartStream(manager->stream);
+    if (err != paNoError) {
+        LOG_ERROR("Failed to start stream: %s", Pa_GetErrorText(err));
+        Pa_CloseStream(manager->stream);
+        manager->stream = NULL;
+        manager->input_channels = 0;
+        return false;
+    }
+    LOG_INFO("PortAudio stream started successfully");
+    return true;
+}
+
+static void close_portaudio_stream(AudioManager *manager) {
+    if (!manager->stream) return;
+    Pa_StopStream(manager->stream);
+    Pa_CloseStream(manager->stream);
+    manager->stream = NULL;
+    manager->input_channels = 0;
+}
+
+// Capture was switched while playing: the stream is reopened with or
+// without its input, which interrupts the output for a moment. Playback
+// stops if the device cannot be reopened at all.
+static bool reopen_portaudio_stream(AudioManager *manager, bool with_input) {
+    close_portaudio_stream(manager);
+    if (open_portaudio_stream(manager, with_input)) return true;
+
+    LOG_ERROR("Failed to reopen the audio stream, playback stopped");
+    manager->is_active = false;
+    return false;
+}
+
+AudioManager* audio_manager_create(void) {
    AudioManager *manager = g_new0(AudioManager, 1);
    
    g_mutex_init(&manager->mutex);
-   manager->sample_rate = SAMPLE_RATE;
-   manager->channels = 2;
+   manager->sample_rate = DEFAULT_SAMPLE_RATE;
+   manager->requested_sample_rate = DEFAULT_SAMPLE_RATE;
+   manager->frames_per_buffer = AUDIO_BUFFER_SIZE;
+   manager->channels = DEFAULT_OUTPUT_CHANNELS;
+   manager->requested_channels = DEFAULT_OUTPUT_CHANNELS;
    manager->is_active = false;
    manager->stream = NULL;
    manager->data_callback = NULL;
    manager->callback_data = NULL;
    manager->selected_device = NULL;
    
-   // Initialize buffer - 4 buffers worth for safety
-   circular_buffer_init(&manager->buffer, AUDIO_BUFFER_SIZE * 4);
-   
-   manager->output_device = Pa_GetDefaultOutputDevice();
-   const PaDeviceInfo *outputInfo = Pa_GetDeviceInfo(manager->output_device);
-   if (!outputInfo) {
-       g_free(manager);
-       return NULL;
+   // Sized for the widest margin the latency controller may ask for
+   circular_buffer_init(&manager->buffer, CIRCULAR_BUFFER_FRAMES(manager->sample_rate),
+                        manager->channels);
+   circular_buffer_init(&manager->capture, AUDIO_BUFFER_SIZE * 16, 2);
+   manager->capture_scratch = rt_pool_new(float, AUDIO_BUFFER_SIZE * 2);
+   manager->capture_enabled = false;
+   manager->backend_type = AUDIO_BACKEND_PORTAUDIO;
+   manager->backend_path = NULL;
+   manager->virtual_stream = NULL;
+   manager->output_latency_ms = 0.0;
+   audio_telemetry_init(&manager->telemetry);
+
+   // Without PortAudio or a default device we still run, just hardware-free
+   PaError err = Pa_Initialize();
+   if (err != paNoError) {
+       LOG_WARN("Failed to initialize PortAudio: %s, using null backend", Pa_GetErrorText(err));
+       manager->pa_initialized = false;
+       manager->output_device = paNoDevice;
+       manager->backend_type = AUDIO_BACKEND_NULL;
+   } else {
+       manager->pa_initialized = true;
+       manager->output_device = Pa_GetDefaultOutputDevice();
+       const PaDeviceInfo *outputInfo = Pa_GetDeviceInfo(manager->output_device);
+       if (!outputInfo) {
+           LOG_WARN("No default output device, using null backend");
+           manager->backend_type = AUDIO_BACKEND_NULL;
+       }
    }
    
    manager->available_devices = g_array_new(FALSE, FALSE, sizeof(AudioDeviceInfo));
@@ -215,61 +503,62 @@ bool audio_manager_toggle_playback(AudioManager *manager, bool enable,
    }
    
    if (enable) {
-       g_print("Starting audio stream setup...\n");
-       // Clear and reset buffer before starting
-       circular_buffer_clear(&manager->buffer);
+       LOG_INFO("Starting audio stream setup...");
+       audio_telemetry_request_reset(&manager->telemetry);
        manager->data_callback = callback;
        manager->callback_data = user_data;
 
-       const PaDeviceInfo *outputInfo = Pa_GetDeviceInfo(manager->output_device);
-       if (!outputInfo) {
-           g_print("Failed to get output device info\n");
-           g_mutex_unlock(&manager->mutex);
-           return false;
-       }
-
-       PaError err = Pa_OpenStream(
-           &manager->stream,
-           NULL,
-           &(PaStreamParameters){
-               .device = manager->output_device,
-               .channelCount = 2,
-               .sampleFormat = paFloat32,
-               .suggestedLatency = outputInfo->defaultLowOutputLatency,
-               .hostApiSpecificStreamInfo = NULL
-           },
-           SAMPLE_RATE,
-           AUDIO_BUFFER_SIZE,
-           paNoFlag,
-           pa_callback,
-           manager);
-
-       if (err != paNoError) {
-           g_print("Failed to open stream: %s\n", Pa_GetErrorText(err));
+       if (manager->backend_type != AUDIO_BACKEND_PORTAUDIO) {
+           // Virtual backends take any format; they need a concrete block size
+           unsigned long frames = manager->frames_per_buffer ? manager->frames_per_buffer
+                                                             : AUDIO_BUFFER_SIZE;
+           manager->sample_rate = manager->requested_sample_rate;
+           manager->channels = manager->requested_channels ? manager->requested_channels
+                                                           : MAX_OUTPUT_CHANNELS;
+           circular_buffer_resize(&manager->buffer, CIRCULAR_BUFFER_FRAMES(manager->sample_rate),
+                                  manager->channels);
+           manager->virtual_stream = audio_backend_open(manager->backend_type,
+                                                        manager->backend_path,
+                                                        manager->sample_rate,
+                                                        manager->channels,
+                                                        frames,
+                                                        pa_callback,
+                                                        wait_for_output_data,
+                                                        manager);
+           if (!manager->virtual_stream || !audio_backend_start(manager->virtual_stream)) {
+               LOG_ERROR("Failed to start %s backend", audio_backend_name(manager->backend_type));
+               audio_backend_close(manager->virtual_stream);
+               manager->virtual_stream = NULL;
+               g_mutex_unlock(&manager->mutex);
+               return false;
+           }
+           LOG_INFO("Audio backend '%s' started successfully",
+                    audio_backend_name(manager->backend_type));
+           manager->output_latency_ms = BUFFER_DURATION_MS(frames, manager->sample_rate);
+           // Loopback hands the output block back as its input
+           manager->input_channels = (manager->backend_type == AUDIO_BACKEND_LOOPBACK) ?
+               manager->channels : 0;
+           manager->is_active = true;
            g_mutex_unlock(&manager->mutex);
-           return false;
+           return true;
        }
 
-       err = Pa_StartStream(manager->stream);
-       if (err != paNoError) {
-           g_print("Failed to start stream: %s\n", Pa_GetErrorText(err));
-           Pa_CloseStream(manager->stream);
-           manager->stream = NULL;
+       if (!open_portaudio_stream(manager, manager->capture_enabled)) {
            g_mutex_unlock(&manager->mutex);
            return false;
        }
-       g_print("PortAudio stream started successfully\n");
 
        manager->is_active = true;
    } else {
-       if (manager->stream) {
-           Pa_StopStream(manager->stream);
-           Pa_CloseStream(manager->stream);
-           manager->stream = NULL;
+       close_portaudio_stream(manager);
+       if (manager->virtual_stream) {
+           audio_backend_close(manager->virtual_stream);
+           manager->virtual_stream = NULL;
        }
        manager->data_callback = NULL;
        manager->callback_data = NULL;
        circular_buffer_clear(&manager->buffer);
+       manager->input_channels = 0;
        manager->is_active = false;
    }
    
@@ -288,6 +577,10 @@ void audio_manager_destroy(AudioManager *manager) {
        Pa_CloseStream(manager->stream);
        manager->stream = NULL;
    }
+   if (manager->virtual_stream) {
+       audio_backend_close(manager->virtual_stream);
+       manager->virtual_stream = NULL;
+   }
 
    if (manager->available_devices) {
        for (guint i = 0; i < manager->available_devices->len; i++) {
@@ -298,12 +591,17 @@ void audio_manager_destroy(AudioManager *manager) {
        g_array_free(manager->available_devices, TRUE);
    }
    g_free(manager->selected_device);
+   g_free(manager->backend_path);
    circular_buffer_destroy(&manager->buffer);
+   circular_buffer_destroy(&manager->capture);
+   rt_pool_free(manager->capture_scratch);
    
    g_mutex_unlock(&manager->mutex);
    g_mutex_clear(&manager->mutex);
    
-   Pa_Terminate();
+   if (manager->pa_initialized) {
+       Pa_Terminate();
+   }
    
    g_free(manager);
 }
@@ -312,9 +610,38 @@ void audio_manager_destroy(AudioManager *manager) {
 
 
 bool audio_manager_toggle_capture(AudioManager *manager, bool enable) {
-    (void)manager;
-    (void)enable;
-    return false;
+    if (!manager) return false;
+
+    g_mutex_lock(&manager->mutex);
+    // Loopback always has an input path. PortAudio needs a running stream,
+    // which is reopened duplex to capture and output only once done.
+    bool portaudio = manager->backend_type == AUDIO_BACKEND_PORTAUDIO;
+    if (enable && manager->backend_type != AUDIO_BACKEND_LOOPBACK &&
+        !(portaudio && manager->is_active)) {
+        g_mutex_unlock(&manager->mutex);
+        return false;
+    }
+    if (enable) {
+        // Room for half a second, so a measurement thread can fall behind briefly
+        size_t frames = MAX((size_t)manager->sample_rate / 2, (size_t)AUDIO_BUFFER_SIZE * 16);
+        circular_buffer_resize(&manager->capture, frames, 2);
+    } else {
+        circular_buffer_clear(&manager->capture);
+    }
+    manager->capture_enabled = enable;
+
+    bool ok = true;
+    if (portaudio && manager->is_active && enable != (manager->input_channels > 0)) {
+        ok = reopen_portaudio_stream(manager, enable) && (!enable || manager->input_channels > 0);
+        if (!ok && enable) {
+            if (manager->is_active) {
+                LOG_ERROR("The output device has no input to capture from");
+            }
+            manager->capture_enabled = false;
+        }
+    }
+    g_mutex_unlock(&manager->mutex);
+    return ok;
 }
 
 bool audio_manager_get_cached_devices(AudioManager *manager, char ***device_names, 
@@ -323,25 +650,47 @@ bool audio_manager_get_cached_devices(AudioManager *manager, char ***device_name
        return false;
    }
 
+   static const AudioBackendType virtual_backends[] = {
+       AUDIO_BACKEND_NULL,
+       AUDIO_BACKEND_NULL_FREERUN,
+       AUDIO_BACKEND_LOOPBACK,
+       AUDIO_BACKEND_FILE
+   };
+   static const char *virtual_descriptions[] = {
+       "Null (real-time)",
+       "Null (free-running)",
+       "Loopback",
+       "File (" AUDIO_BACKEND_DEFAULT_FILE ")"
+   };
+   int num_virtual = G_N_ELEMENTS(virtual_backends);
+
    g_mutex_lock(&manager->mutex);
    
-   *count = Pa_GetDeviceCount();
-   if (*count < 0) {
-       g_mutex_unlock(&manager->mutex);
-       return false;
+   int pa_count = manager->pa_initialized ? Pa_GetDeviceCount() : 0;
+   if (pa_count < 0) {
+       pa_count = 0;
    }
 
-   *device_names = g_new(char*, *count);
-   *device_descriptions = g_new(char*, *count);
+   *device_names = g_new(char*, pa_count + num_virtual);
+   *device_descriptions = g_new(char*, pa_count + num_virtual);
+   *count = 0;
 
-   for (int i = 0; i < *count; i++) {
+   for (int i = 0; i < pa_count; i++) {
        const PaDeviceInfo *device_info = Pa_GetDeviceInfo(i);
        if (device_info && device_info->maxOutputChannels > 0) {
-           (*device_names)[i] = g_strdup_printf("%d", i);
-           (*device_descriptions)[i] = g_strdup(device_info->name);
+           (*device_names)[*count] = g_strdup_printf("%d", i);
+           (*device_descriptions)[*count] = g_strdup_printf("%s (%d ch)", device_info->name,
+                                                            device_info->maxOutputChannels);
+           (*count)++;
        }
    }
 
+   for (int i = 0; i < num_virtual; i++) {
+       (*device_names)[*count] = g_strdup(audio_backend_name(virtual_backends[i]));
+       (*device_descriptions)[*count] = g_strdup(virtual_descriptions[i]);
+       (*count)++;
+   }
+
    g_mutex_unlock(&manager->mutex);
    return true;
 }
@@ -359,12 +708,30 @@ bool audio_manager_switch_device(AudioManager *manager, const char *device_name)
         audio_manager_toggle_playback(manager, false, NULL, NULL);
     }
     
+    // Device names are either a backend spec or a PortAudio device index
+    AudioBackendType backend_type;
+    char *backend_path = NULL;
+    if (!audio_backend_parse(device_name, &backend_type, &backend_path)) {
+        backend_type = AUDIO_BACKEND_PORTAUDIO;
+    }
+
     // Update device selection with quick lock
     g_mutex_lock(&manager->mutex);
+    if (backend_type == AUDIO_BACKEND_PORTAUDIO && !manager->pa_initialized) {
+        g_mutex_unlock(&manager->mutex);
+        LOG_ERROR("PortAudio unavailable, cannot select device %s", device_name);
+        return false;
+    }
     g_free(manager->selected_device);
     manager->selected_device = g_strdup(device_name);
-    PaDeviceIndex new_device = atoi(device_name);
-    manager->output_device = new_device;
+    g_free(manager->backend_path);
+    manager->backend_path = backend_path;
+    manager->backend_type = backend_type;
+    if (backend_type == AUDIO_BACKEND_PORTAUDIO && g_ascii_isdigit(device_name[0])) {
+        manager->output_device = atoi(device_name);
+    }
+    // Loopback always has an input path, so capture it by default
+    manager->capture_enabled = (backend_type == AUDIO_BACKEND_LOOPBACK);
     g_mutex_unlock(&manager->mutex);
 
     return true;  // Device switch successful
@@ -380,3 +747,77 @@ bool audio_manager_is_playback_active(AudioManager *manager) {
     
     return active;
 }
+
+AudioBackendType audio_manager_get_backend(AudioManager *manager) {
+    if (!manager) return AUDIO_BACKEND_NULL;
+
+    g_mutex_lock(&manager->mutex);
+    AudioBackendType type = manager->backend_type;
+    g_mutex_unlock(&manager->mutex);
+
+    return type;
+}
+
+size_t audio_manager_read_capture(AudioManager *manager, float *pairs, size_t frames) {
+    if (!manager || !pairs || !manager->capture_enabled) return 0;
+    return circular_buffer_drain(&manager->capture, pairs, frames);
+}
+
+void audio_manager_get_telemetry(AudioManager *manager, AudioTelemetrySnapshot *snapshot) {
+    if (!manager || !snapshot) return;
+
+    audio_telemetry_read(&manager->telemetry, snapshot);
+
+    // Only the control mutex is taken; the audio thread never holds it
+    g_mutex_lock(&manager->mutex);
+    snapshot->output_latency_ms = manager->output_latency_ms;
+    snapshot->cpu_load = manager->stream ? Pa_GetStreamCpuLoad(manager->stream)
+                                         : snapshot->callback_load;
+    g_mutex_unlock(&manager->mutex);
+}
+
+void audio_manager_reset_telemetry(AudioManager *manager) {
+    if (!manager) return;
+    audio_telemetry_request_reset(&manager->telemetry);
+}
+
+// Takes effect the next time playback starts
+void audio_manager_set_format(AudioManager *manager, int sample_rate, unsigned long frames_per_buffer) {
+    if (!manager) return;
+
+    g_mutex_lock(&manager->mutex);
+    if (sample_rate > 0) {
+        manager->requested_sample_rate = sample_rate;
+    }
+    manager->frames_per_buffer = frames_per_buffer;
+    g_mutex_unlock(&manager->mutex);
+}
+
+int audio_manager_get_sample_rate(AudioManager *manager) {
+    if (!manager) return DEFAULT_SAMPLE_RATE;
+
+    g_mutex_lock(&manager->mutex);
+    int rate = manager->sample_rate;
+    g_mutex_unlock(&manager->mutex);
+
+    return rate;
+}
+
+// Takes effect the next time playback starts; 0 selects all device channels
+void audio_manager_set_channels(AudioManager *manager, int channels) {
+    if (!manager || channels < 0) return;
+
+    g_mutex_lock(&manager->mutex);
+    manager->requested_channels = MIN(channels, MAX_OUTPUT_CHANNELS);
+    g_mutex_unlock(&manager->mutex);
+}
+
+int audio_manager_get_channels(AudioManager *manager) {
+    if (!manager) return DEFAULT_OUTPUT_CHANNELS;
+
+    g_mutex_lock(&manager->mutex);
+    int channels = manager->channels;
+    g_mutex_unlock(&manager->mutex);
+
+    return channels;
+}
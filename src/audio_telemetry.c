@@ -0,0 +1,164 @@
+#include "audio_telemetry.h"
+#include "logger.h"
+#include <portaudio.h>
+#include <string.h>
+#include <math.h>
+
+#define LOAD_SMOOTHING 0.95
+
+static void telemetry_clear(AudioTelemetry *telemetry) {
+    memset(&telemetry->data, 0, sizeof(telemetry->data));
+    telemetry->data.fill_min = (size_t)-1;
+    telemetry->interval_count = 0;
+    telemetry->interval_sum_ms = 0.0;
+    telemetry->fill_sum = 0.0;
+}
+
+void audio_telemetry_init(AudioTelemetry *telemetry) {
+    telemetry->sequence = 0;
+    telemetry->reset_requested = 0;
+    memset(telemetry->ring_base, 0, sizeof(telemetry->ring_base));
+    telemetry_clear(telemetry);
+}
+
+// Called from the audio callback only. Ring counters are cumulative since
+// the ring was created; they are rebased here so a reset needs no locking.
+void audio_telemetry_record(AudioTelemetry *telemetry, gint64 interval_us, gint64 run_time_us,
+                            size_t fill_frames, size_t ring_underruns, size_t ring_overruns,
+                            size_t dropped_frames, unsigned long status_flags,
+                            int sample_rate, unsigned long frames) {
+    g_atomic_int_inc(&telemetry->sequence);
+
+    AudioTelemetrySnapshot *data = &telemetry->data;
+
+    if (g_atomic_int_get(&telemetry->reset_requested)) {
+        telemetry_clear(telemetry);
+        telemetry->ring_base[0] = ring_underruns;
+        telemetry->ring_base[1] = ring_overruns;
+        telemetry->ring_base[2] = dropped_frames;
+        g_atomic_int_set(&telemetry->reset_requested, 0);
+    }
+
+    data->callbacks++;
+    if (status_flags & paOutputUnderflow) data->output_underflows++;
+    if (status_flags & paOutputOverflow) data->output_overflows++;
+    data->ring_underruns = ring_underruns - telemetry->ring_base[0];
+    data->ring_overruns = ring_overruns - telemetry->ring_base[1];
+    data->dropped_frames = dropped_frames - telemetry->ring_base[2];
+    data->sample_rate = sample_rate;
+    data->frames_per_buffer = frames;
+
+    // First callback has no previous timestamp
+    if (interval_us > 0) {
+        size_t bin = MIN((size_t)(interval_us / TELEMETRY_HIST_BIN_US),
+                         (size_t)TELEMETRY_HIST_BINS - 1);
+        data->interval_hist[bin]++;
+
+        double interval_ms = interval_us / 1000.0;
+        telemetry->interval_count++;
+        if (telemetry->interval_count == 1 || interval_ms < data->interval_min_ms) {
+            data->interval_min_ms = interval_ms;
+        }
+        if (interval_ms > data->interval_max_ms) data->interval_max_ms = interval_ms;
+        telemetry->interval_sum_ms += interval_ms;
+        data->interval_avg_ms = telemetry->interval_sum_ms / telemetry->interval_count;
+    }
+
+    if (fill_frames < data->fill_min) data->fill_min = fill_frames;
+    if (fill_frames > data->fill_max) data->fill_max = fill_frames;
+    telemetry->fill_sum += fill_frames;
+    data->fill_avg = telemetry->fill_sum / data->callbacks;
+
+    if (sample_rate > 0 && frames > 0) {
+        double period_us = frames * 1e6 / sample_rate;
+        double load = run_time_us / period_us;
+        data->callback_load = data->callback_load * LOAD_SMOOTHING + load * (1.0 - LOAD_SMOOTHING);
+    }
+
+    g_atomic_int_inc(&telemetry->sequence);
+}
+
+// Even sequence to copy against; waits out an update in progress
+static gint read_begin(AudioTelemetry *telemetry) {
+    gint sequence;
+    while ((sequence = g_atomic_int_get(&telemetry->sequence)) & 1) {
+        g_thread_yield();
+    }
+    return sequence;
+}
+
+// True if the writer ran during the copy. The fence keeps the copy's loads
+// from moving past the re-read of the sequence.
+static gboolean read_retry(AudioTelemetry *telemetry, gint before) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return g_atomic_int_get(&telemetry->sequence) != before;
+}
+
+void audio_telemetry_read(AudioTelemetry *telemetry, AudioTelemetrySnapshot *snapshot) {
+    gint before;
+    do {
+        before = read_begin(telemetry);
+        memcpy(snapshot, &telemetry->data, sizeof(*snapshot));
+    } while (read_retry(telemetry, before));
+
+    if (snapshot->callbacks == 0) {
+        snapshot->fill_min = 0;
+    }
+}
+
+void audio_telemetry_request_reset(AudioTelemetry *telemetry) {
+    g_atomic_int_set(&telemetry->reset_requested, 1);
+}
+
+// Cheap read of just the xrun total (device underflows plus ring underruns)
+guint64 audio_telemetry_xrun_count(AudioTelemetry *telemetry) {
+    gint before;
+    guint64 xruns;
+    do {
+        before = read_begin(telemetry);
+        xruns = telemetry->data.output_underflows + telemetry->data.ring_underruns;
+    } while (read_retry(telemetry, before));
+    return xruns;
+}
+
+// Upper edge of the histogram bin holding the given percentile, in ms
+double audio_telemetry_interval_percentile(const AudioTelemetrySnapshot *snapshot, double percentile) {
+    guint64 total = 0;
+    for (size_t i = 0; i < TELEMETRY_HIST_BINS; i++) {
+        total += snapshot->interval_hist[i];
+    }
+    if (total == 0) return 0.0;
+
+    guint64 target = (guint64)ceil(total * percentile / 100.0);
+    guint64 seen = 0;
+    for (size_t i = 0; i < TELEMETRY_HIST_BINS; i++) {
+        seen += snapshot->interval_hist[i];
+        if (seen >= target) {
+            return (i + 1) * TELEMETRY_HIST_BIN_US / 1000.0;
+        }
+    }
+    return TELEMETRY_HIST_BINS * TELEMETRY_HIST_BIN_US / 1000.0;
+}
+
+void audio_telemetry_print(const AudioTelemetrySnapshot *snapshot) {
+    double period_ms = snapshot->sample_rate > 0 ?
+        snapshot->frames_per_buffer * 1000.0 / snapshot->sample_rate : 0.0;
+
+    LOG_INFO("Audio telemetry: %d Hz, %lu frames/buffer (%.3f ms period)",
+             snapshot->sample_rate, snapshot->frames_per_buffer, period_ms);
+    LOG_INFO("  Callbacks: %" G_GUINT64_FORMAT, snapshot->callbacks);
+    LOG_INFO("  Device underflows: %" G_GUINT64_FORMAT ", overflows: %" G_GUINT64_FORMAT,
+             snapshot->output_underflows, snapshot->output_overflows);
+    LOG_INFO("  Ring underruns: %" G_GUINT64_FORMAT ", overruns: %" G_GUINT64_FORMAT
+             " (%" G_GUINT64_FORMAT " frames dropped)",
+             snapshot->ring_underruns, snapshot->ring_overruns, snapshot->dropped_frames);
+    LOG_INFO("  Interval ms: min %.3f, avg %.3f, max %.3f, p50 %.2f, p99 %.2f",
+             snapshot->interval_min_ms, snapshot->interval_avg_ms, snapshot->interval_max_ms,
+             audio_telemetry_interval_percentile(snapshot, 50.0),
+             audio_telemetry_interval_percentile(snapshot, 99.0));
+    LOG_INFO("  Ring fill frames: min %zu, avg %.1f, max %zu",
+             snapshot->fill_min, snapshot->fill_avg, snapshot->fill_max);
+    LOG_INFO("  CPU load: %.1f%% (callback %.1f%%), output latency: %.2f ms",
+             snapshot->cpu_load * 100.0, snapshot->callback_load * 100.0,
+             snapshot->output_latency_ms);
+}
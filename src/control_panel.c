@@ -10,6 +10,53 @@ static void on_waveform_changed(GtkComboBox *widget, gpointer user_data) {
     gtk_widget_set_sensitive(panel->duty_cycle_dial, active == WAVE_SQUARE);
 }
 
+// Restarts the sweep with the current settings and selects it
+static void on_sweep_start(GtkButton *button, gpointer user_data) {
+    ControlPanel *panel = (ControlPanel *)user_data;
+    (void)button;
+
+    SweepConfig config;
+    config.type = gtk_combo_box_get_active(GTK_COMBO_BOX(panel->sweep_type_combo));
+    config.start_freq = waveform_dial_get_value(WAVEFORM_DIAL(panel->sweep_start_dial));
+    config.end_freq = waveform_dial_get_value(WAVEFORM_DIAL(panel->sweep_end_dial));
+    config.duration = waveform_dial_get_value(WAVEFORM_DIAL(panel->sweep_duration_dial));
+    config.steps = (int)waveform_dial_get_value(WAVEFORM_DIAL(panel->sweep_steps_dial));
+    config.settle = waveform_dial_get_value(WAVEFORM_DIAL(panel->sweep_settle_dial));
+    config.dwell = waveform_dial_get_value(WAVEFORM_DIAL(panel->sweep_dwell_dial));
+    config.loop = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(panel->sweep_loop_check));
+
+    parameter_store_set_sweep(panel->params, &config);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(panel->waveform_combo), WAVE_SWEEP);
+}
+
+static void store_mod_source(ControlPanel *panel) {
+    if (panel->loading_mod) return;
+
+    parameter_store_set_mod_source(panel->params, panel->selected_mod_source,
+                                   gtk_combo_box_get_active(GTK_COMBO_BOX(panel->mod_shape_combo)),
+                                   waveform_dial_get_value(WAVEFORM_DIAL(panel->mod_rate_dial)));
+}
+
+// The first route source entry is "Off"
+static void store_mod_route(ControlPanel *panel) {
+    if (panel->loading_mod) return;
+
+    parameter_store_set_mod_route(panel->params, panel->selected_mod_route,
+                                  gtk_combo_box_get_active(GTK_COMBO_BOX(panel->mod_route_source_combo)) - 1,
+                                  gtk_combo_box_get_active(GTK_COMBO_BOX(panel->mod_route_dest_combo)),
+                                  waveform_dial_get_value(WAVEFORM_DIAL(panel->mod_depth_dial)));
+}
+
+static void on_mod_shape_changed(GtkComboBox *widget, gpointer user_data) {
+    (void)widget;
+    store_mod_source((ControlPanel *)user_data);
+}
+
+static void on_mod_route_changed(GtkComboBox *widget, gpointer user_data) {
+    (void)widget;
+    store_mod_route((ControlPanel *)user_data);
+}
+
 static void on_parameter_changed(WaveformDial *dial, float value, gpointer user_data) {
     ControlPanel *panel = (ControlPanel *)user_data;
     
@@ -74,6 +121,25 @@ static void on_parameter_changed(WaveformDial *dial, float value, gpointer user_
                                        waveform_dial_get_value(WAVEFORM_DIAL(panel->filter_res_lfo_freq_dial)),
                                        value);
     }
+    // Channel parameter handling
+    else if (GTK_WIDGET(dial) == panel->channel_ratio_dial ||
+             GTK_WIDGET(dial) == panel->channel_phase_dial ||
+             GTK_WIDGET(dial) == panel->channel_gain_dial) {
+        parameter_store_set_channel(panel->params, panel->selected_channel,
+                                    waveform_dial_get_value(WAVEFORM_DIAL(panel->channel_ratio_dial)),
+                                    waveform_dial_get_value(WAVEFORM_DIAL(panel->channel_phase_dial)),
+                                    waveform_dial_get_value(WAVEFORM_DIAL(panel->channel_gain_dial)));
+    }
+    else if (GTK_WIDGET(dial) == panel->channel_freq_dial) {
+        parameter_store_set_channel_frequency(panel->params, panel->selected_channel, value);
+    }
+    // Modulation matrix handling
+    else if (GTK_WIDGET(dial) == panel->mod_rate_dial) {
+        store_mod_source(panel);
+    }
+    else if (GTK_WIDGET(dial) == panel->mod_depth_dial) {
+        store_mod_route(panel);
+    }
     
     GtkWidget *value_label = g_object_get_data(G_OBJECT(gtk_widget_get_parent(GTK_WIDGET(dial))), 
                                               "value_label");
@@ -85,6 +151,54 @@ static void on_parameter_changed(WaveformDial *dial, float value, gpointer user_
 }
 
 
+static void show_dial_value(GtkWidget *dial, float value) {
+    waveform_dial_set_value(WAVEFORM_DIAL(dial), value);
+
+    GtkWidget *value_label = g_object_get_data(G_OBJECT(gtk_widget_get_parent(dial)), "value_label");
+    if (value_label) {
+        char value_str[32];
+        snprintf(value_str, sizeof(value_str), "%.2f", value);
+        gtk_label_set_text(GTK_LABEL(value_label), value_str);
+    }
+}
+
+// Load the selected channel's settings into the channel dials
+static void on_channel_selected(GtkSpinButton *spin, gpointer user_data) {
+    ControlPanel *panel = (ControlPanel *)user_data;
+    panel->selected_channel = gtk_spin_button_get_value_as_int(spin) - 1;
+
+    ChannelConfig config;
+    if (parameter_store_get_channel(panel->params, panel->selected_channel, &config)) {
+        show_dial_value(panel->channel_ratio_dial, config.freq_ratio);
+        show_dial_value(panel->channel_phase_dial, config.phase_offset);
+        show_dial_value(panel->channel_gain_dial, config.gain);
+        show_dial_value(panel->channel_freq_dial, config.frequency);
+    }
+}
+
+// Load the selected source or route into the matrix widgets
+static void on_mod_selected(GtkSpinButton *spin, gpointer user_data) {
+    ControlPanel *panel = (ControlPanel *)user_data;
+    (void)spin;
+
+    panel->selected_mod_source = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(panel->mod_source_spin)) - 1;
+    panel->selected_mod_route = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(panel->mod_route_spin)) - 1;
+
+    ModMatrix matrix;
+    if (!parameter_store_get_mod_matrix(panel->params, &matrix)) return;
+
+    const ModSource *source = &matrix.sources[panel->selected_mod_source];
+    const ModRoute *route = &matrix.routes[panel->selected_mod_route];
+
+    panel->loading_mod = TRUE;
+    gtk_combo_box_set_active(GTK_COMBO_BOX(panel->mod_shape_combo), source->shape);
+    show_dial_value(panel->mod_rate_dial, source->frequency);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(panel->mod_route_source_combo), route->source + 1);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(panel->mod_route_dest_combo), route->destination);
+    show_dial_value(panel->mod_depth_dial, route->depth);
+    panel->loading_mod = FALSE;
+}
+
 static GtkWidget* create_dial_with_labels(const char* label_text, float min, float max, float step) {
     GtkWidget *container = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
     
@@ -136,7 +250,7 @@ ControlPanel* control_panel_create(GtkWidget *parent, ParameterStore *params) {
     gtk_container_add(GTK_CONTAINER(wave_frame), wave_box);
     
     panel->waveform_combo = gtk_combo_box_text_new();
-    const char *waveform_names[] = {"Sine", "Square", "Sawtooth", "Triangle", "Pink Noise", NULL};
+    const char *waveform_names[] = {"Sine", "Square", "Sawtooth", "Triangle", "Pink Noise", "Sweep", NULL};
     for (const char **name = waveform_names; *name != NULL; name++) {
         gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(panel->waveform_combo), *name);
     }
@@ -278,6 +392,182 @@ ControlPanel* control_panel_create(GtkWidget *parent, ParameterStore *params) {
 
     gtk_box_pack_start(GTK_BOX(panel->container), filter_frame, FALSE, FALSE, 5);
 
+    // Create channel frame
+    GtkWidget *channel_frame = gtk_frame_new("Output Channels");
+    GtkWidget *channel_grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(channel_grid), 10);
+    gtk_container_add(GTK_CONTAINER(channel_frame), channel_grid);
+
+    GtkWidget *channel_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    panel->channel_spin = gtk_spin_button_new_with_range(1, MAX_OUTPUT_CHANNELS, 1);
+    gtk_box_pack_start(GTK_BOX(channel_box), panel->channel_spin, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(channel_box), gtk_label_new("Channel"), FALSE, FALSE, 0);
+
+    GtkWidget *ratio_container = create_dial_with_labels("Freq Ratio", 0.0, 16.0, 0.01);
+    GtkWidget *phase_container = create_dial_with_labels("Phase (deg)", 0.0, 360.0, 1.0);
+    GtkWidget *gain_container = create_dial_with_labels("Gain", 0.0, 1.0, 0.01);
+    GtkWidget *ch_freq_container = create_dial_with_labels("Fixed Freq (Hz)", 0.0, 20000.0, 1.0);
+
+    panel->channel_ratio_dial = g_object_get_data(G_OBJECT(ratio_container), "dial");
+    panel->channel_phase_dial = g_object_get_data(G_OBJECT(phase_container), "dial");
+    panel->channel_gain_dial = g_object_get_data(G_OBJECT(gain_container), "dial");
+    panel->channel_freq_dial = g_object_get_data(G_OBJECT(ch_freq_container), "dial");
+
+    gtk_grid_attach(GTK_GRID(channel_grid), channel_box, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(channel_grid), ratio_container, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(channel_grid), phase_container, 2, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(channel_grid), gain_container, 3, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(channel_grid), ch_freq_container, 4, 0, 1, 1);
+
+    gtk_box_pack_start(GTK_BOX(panel->container), channel_frame, FALSE, FALSE, 5);
+
+    panel->selected_channel = 0;
+    on_channel_selected(GTK_SPIN_BUTTON(panel->channel_spin), panel);
+    g_signal_connect(panel->channel_spin, "value-changed",
+                    G_CALLBACK(on_channel_selected), panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->channel_ratio_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->channel_phase_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->channel_gain_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->channel_freq_dial),
+                              on_parameter_changed, panel);
+
+    // Create modulation matrix frame. Sources and routes 1-5 belong to the
+    // FM, AM, DCM and filter LFO controls above.
+    GtkWidget *mod_frame = gtk_frame_new("Modulation Matrix");
+    GtkWidget *mod_grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(mod_grid), 10);
+    gtk_container_add(GTK_CONTAINER(mod_frame), mod_grid);
+
+    GtkWidget *mod_source_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    panel->mod_source_spin = gtk_spin_button_new_with_range(1, MOD_MAX_SOURCES, 1);
+    panel->mod_shape_combo = gtk_combo_box_text_new();
+    for (int shape = 0; shape < MOD_SHAPE_COUNT; shape++) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(panel->mod_shape_combo),
+                                       mod_shape_name(shape));
+    }
+    gtk_box_pack_start(GTK_BOX(mod_source_box), panel->mod_source_spin, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(mod_source_box), gtk_label_new("Source"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(mod_source_box), panel->mod_shape_combo, FALSE, FALSE, 0);
+
+    GtkWidget *mod_route_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    panel->mod_route_spin = gtk_spin_button_new_with_range(1, MOD_MAX_ROUTES, 1);
+    panel->mod_route_source_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(panel->mod_route_source_combo), "Off");
+    for (int src = 0; src < MOD_MAX_SOURCES; src++) {
+        char name[32];
+        snprintf(name, sizeof(name), "Source %d", src + 1);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(panel->mod_route_source_combo), name);
+    }
+    panel->mod_route_dest_combo = gtk_combo_box_text_new();
+    for (int dest = 0; dest < MOD_DEST_COUNT; dest++) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(panel->mod_route_dest_combo),
+                                       mod_destination_name(dest));
+    }
+    gtk_box_pack_start(GTK_BOX(mod_route_box), panel->mod_route_spin, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(mod_route_box), gtk_label_new("Route"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(mod_route_box), panel->mod_route_source_combo, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(mod_route_box), panel->mod_route_dest_combo, FALSE, FALSE, 0);
+
+    GtkWidget *mod_rate_container = create_dial_with_labels("Rate (Hz)", 0.0, 100.0, 0.1);
+    GtkWidget *mod_depth_container = create_dial_with_labels("Depth", -1.0, 1.0, 0.01);
+    panel->mod_rate_dial = g_object_get_data(G_OBJECT(mod_rate_container), "dial");
+    panel->mod_depth_dial = g_object_get_data(G_OBJECT(mod_depth_container), "dial");
+
+    gtk_grid_attach(GTK_GRID(mod_grid), mod_source_box, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(mod_grid), mod_rate_container, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(mod_grid), mod_route_box, 2, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(mod_grid), mod_depth_container, 3, 0, 1, 1);
+
+    gtk_box_pack_start(GTK_BOX(panel->container), mod_frame, FALSE, FALSE, 5);
+
+    on_mod_selected(NULL, panel);
+    g_signal_connect(panel->mod_source_spin, "value-changed",
+                    G_CALLBACK(on_mod_selected), panel);
+    g_signal_connect(panel->mod_route_spin, "value-changed",
+                    G_CALLBACK(on_mod_selected), panel);
+    g_signal_connect(panel->mod_shape_combo, "changed",
+                    G_CALLBACK(on_mod_shape_changed), panel);
+    g_signal_connect(panel->mod_route_source_combo, "changed",
+                    G_CALLBACK(on_mod_route_changed), panel);
+    g_signal_connect(panel->mod_route_dest_combo, "changed",
+                    G_CALLBACK(on_mod_route_changed), panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->mod_rate_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->mod_depth_dial),
+                              on_parameter_changed, panel);
+
+    // Create sweep frame
+    GtkWidget *sweep_frame = gtk_frame_new("Sweep");
+    GtkWidget *sweep_grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(sweep_grid), 10);
+    gtk_container_add(GTK_CONTAINER(sweep_frame), sweep_grid);
+
+    SweepConfig sweep;
+    parameter_store_get_sweep(params, &sweep);
+
+    GtkWidget *sweep_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    panel->sweep_type_combo = gtk_combo_box_text_new();
+    for (int type = 0; type < SWEEP_TYPE_COUNT; type++) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(panel->sweep_type_combo),
+                                       sweep_type_name(type));
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(panel->sweep_type_combo), sweep.type);
+    panel->sweep_loop_check = gtk_check_button_new_with_label("Loop");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(panel->sweep_loop_check), sweep.loop);
+    panel->sweep_start_button = gtk_button_new_with_label("Start");
+    gtk_box_pack_start(GTK_BOX(sweep_box), panel->sweep_type_combo, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(sweep_box), panel->sweep_loop_check, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(sweep_box), panel->sweep_start_button, FALSE, FALSE, 0);
+
+    GtkWidget *sweep_start_container = create_dial_with_labels("Start (Hz)", 1.0, 20000.0, 1.0);
+    GtkWidget *sweep_end_container = create_dial_with_labels("End (Hz)", 1.0, 20000.0, 1.0);
+    GtkWidget *sweep_duration_container = create_dial_with_labels("Duration (s)", 0.1, 60.0, 0.1);
+    GtkWidget *sweep_steps_container = create_dial_with_labels("Steps", 2.0, 200.0, 1.0);
+    GtkWidget *sweep_settle_container = create_dial_with_labels("Settle (s)", 0.0, 1.0, 0.01);
+    GtkWidget *sweep_dwell_container = create_dial_with_labels("Dwell (s)", 0.01, 2.0, 0.01);
+
+    panel->sweep_start_dial = g_object_get_data(G_OBJECT(sweep_start_container), "dial");
+    panel->sweep_end_dial = g_object_get_data(G_OBJECT(sweep_end_container), "dial");
+    panel->sweep_duration_dial = g_object_get_data(G_OBJECT(sweep_duration_container), "dial");
+    panel->sweep_steps_dial = g_object_get_data(G_OBJECT(sweep_steps_container), "dial");
+    panel->sweep_settle_dial = g_object_get_data(G_OBJECT(sweep_settle_container), "dial");
+    panel->sweep_dwell_dial = g_object_get_data(G_OBJECT(sweep_dwell_container), "dial");
+
+    initialize_dial_with_value(sweep_start_container, panel->sweep_start_dial, sweep.start_freq, params, NULL);
+    initialize_dial_with_value(sweep_end_container, panel->sweep_end_dial, sweep.end_freq, params, NULL);
+    initialize_dial_with_value(sweep_duration_container, panel->sweep_duration_dial, sweep.duration, params, NULL);
+    initialize_dial_with_value(sweep_steps_container, panel->sweep_steps_dial, sweep.steps, params, NULL);
+    initialize_dial_with_value(sweep_settle_container, panel->sweep_settle_dial, sweep.settle, params, NULL);
+    initialize_dial_with_value(sweep_dwell_container, panel->sweep_dwell_dial, sweep.dwell, params, NULL);
+
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_box, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_start_container, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_end_container, 2, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_duration_container, 3, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_steps_container, 4, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_settle_container, 5, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(sweep_grid), sweep_dwell_container, 6, 0, 1, 1);
+
+    gtk_box_pack_start(GTK_BOX(panel->container), sweep_frame, FALSE, FALSE, 5);
+
+    g_signal_connect(panel->sweep_start_button, "clicked",
+                    G_CALLBACK(on_sweep_start), panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->sweep_start_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->sweep_end_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->sweep_duration_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->sweep_steps_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->sweep_settle_dial),
+                              on_parameter_changed, panel);
+    waveform_dial_set_callback(WAVEFORM_DIAL(panel->sweep_dwell_dial),
+                              on_parameter_changed, panel);
+
     // Connect callbacks
     waveform_dial_set_callback(WAVEFORM_DIAL(panel->filter_cutoff_dial),
                               on_parameter_changed, panel);
@@ -0,0 +1,169 @@
+#include "distortion_analyzer.h"
+#include "rt_pool.h"
+#include <string.h>
+#include <math.h>
+
+#define FUNDAMENTAL_RESOLUTION 8.0   // Mask key steps per bin
+
+void distortion_config_default(DistortionConfig *config) {
+    config->harmonics = DISTORTION_MAX_HARMONICS;
+    config->lobe_bins = 5;
+    config->low_freq = 20.0f;
+    config->high_freq = 20000.0f;
+}
+
+DistortionAnalyzer* distortion_analyzer_create(void) {
+    DistortionAnalyzer *analyzer = g_new0(DistortionAnalyzer, 1);
+    distortion_config_default(&analyzer->config);
+    analyzer->mask = rt_pool_new(guint8, FFT_SIZE / 2 + 1);
+    if (!analyzer->mask) {
+        g_free(analyzer);
+        return NULL;
+    }
+    return analyzer;
+}
+
+void distortion_analyzer_destroy(DistortionAnalyzer *analyzer) {
+    if (!analyzer) return;
+    rt_pool_free(analyzer->mask);
+    g_free(analyzer);
+}
+
+void distortion_analyzer_set_config(DistortionAnalyzer *analyzer, const DistortionConfig *config) {
+    if (!analyzer || !config) return;
+
+    analyzer->config = *config;
+    analyzer->config.harmonics = CLAMP(config->harmonics, 2, DISTORTION_MAX_HARMONICS);
+    analyzer->config.lobe_bins = MAX(config->lobe_bins, 1);
+    analyzer->mask_valid = FALSE;
+}
+
+// In-band bins: the bandwidth limits, clear of DC's lobe and of Nyquist
+static gboolean band_limits(const DistortionAnalyzer *analyzer, size_t size, float sample_rate,
+                            size_t *first, size_t *last) {
+    double bin_hz = (double)sample_rate / size;
+    size_t bins = size / 2 + 1;
+
+    *first = MAX((size_t)ceil(analyzer->config.low_freq / bin_hz),
+                 (size_t)analyzer->config.lobe_bins + 1);
+    *last = MIN((size_t)floor(analyzer->config.high_freq / bin_hz), bins - 2);
+    return *first < *last;
+}
+
+static void build_mask(DistortionAnalyzer *analyzer, size_t size, float sample_rate, long key) {
+    size_t bins = size / 2 + 1;
+    size_t first, last;
+    band_limits(analyzer, size, sample_rate, &first, &last);
+
+    guint8 *mask = analyzer->mask;
+    memset(mask, DISTORTION_BIN_EXCLUDED, bins);
+    memset(mask + first, DISTORTION_BIN_NOISE, last - first + 1);
+
+    // Tone bands claim bins in order, so the fundamental wins any overlap
+    double fundamental = key / FUNDAMENTAL_RESOLUTION;
+    int lobe = analyzer->config.lobe_bins;
+    memset(analyzer->lobe_count, 0, sizeof(analyzer->lobe_count));
+    analyzer->result.num_harmonics = 1;
+    for (int h = 1; h <= analyzer->config.harmonics; h++) {
+        long center = lround(h * fundamental);
+        if (center > (long)last) break;
+
+        for (long k = MAX(center - lobe, (long)first); k <= MIN(center + lobe, (long)last); k++) {
+            if (mask[k] == DISTORTION_BIN_NOISE) {
+                mask[k] = (guint8)h;
+                analyzer->lobe_count[h]++;
+            }
+        }
+        analyzer->result.num_harmonics = h;
+    }
+
+    analyzer->band_bins = last - first + 1;
+    analyzer->noise_bins = analyzer->band_bins;
+    for (int h = 1; h <= DISTORTION_MAX_HARMONICS; h++) {
+        analyzer->noise_bins -= analyzer->lobe_count[h];
+    }
+
+    analyzer->mask_size = size;
+    analyzer->mask_rate = sample_rate;
+    analyzer->mask_fundamental = key;
+    analyzer->mask_valid = TRUE;
+}
+
+// Gaussian interpolation of the peak position, exact for a Gaussian lobe
+// and within a few hundredths of a bin for Hann or Blackman-Harris
+static double interpolate_peak(const float *power, size_t k) {
+    double a = log(fmax(power[k - 1], 1e-30));
+    double b = log(fmax(power[k], 1e-30));
+    double c = log(fmax(power[k + 1], 1e-30));
+    double denominator = a - 2.0 * b + c;
+    if (denominator >= 0.0) return (double)k;
+    return k + 0.5 * (a - c) / denominator;
+}
+
+static float ratio_db(double ratio) {
+    return 10.0f * log10f((float)fmax(ratio, 1e-30));
+}
+
+// Measures the frame the FFT analyzer last processed. One pass over the
+// bins sums power per class; the mask is only rebuilt when the
+// fundamental moves by an eighth of a bin or more.
+gboolean distortion_analyzer_process(DistortionAnalyzer *analyzer, const struct FFTAnalyzer *fft,
+                                     float sample_rate) {
+    if (!analyzer || !fft || !fft->power || sample_rate <= 0.0f) return FALSE;
+
+    DistortionResult *result = &analyzer->result;
+    result->valid = FALSE;
+
+    size_t size = fft->size;
+    size_t first, last;
+    if (size > FFT_SIZE || !band_limits(analyzer, size, sample_rate, &first, &last)) return FALSE;
+
+    const float *power = fft->power;
+    size_t peak = first;
+    for (size_t k = first + 1; k <= last; k++) {
+        if (power[k] > power[peak]) peak = k;
+    }
+    if (ratio_db(4.0 * power[peak]) < DISTORTION_MIN_LEVEL_DB) return FALSE;
+
+    double fundamental = interpolate_peak(power, peak);
+    long key = lround(fundamental * FUNDAMENTAL_RESOLUTION);
+    if (!analyzer->mask_valid || size != analyzer->mask_size ||
+        sample_rate != analyzer->mask_rate || key != analyzer->mask_fundamental) {
+        build_mask(analyzer, size, sample_rate, key);
+    }
+
+    double sums[DISTORTION_MAX_HARMONICS + 1] = {0};
+    const guint8 *mask = analyzer->mask;
+    for (size_t k = first; k <= last; k++) {
+        sums[mask[k]] += power[k];
+    }
+
+    // The noise floor under each tone band is taken to be that of the
+    // bins around it, and removed from the tone
+    double density = analyzer->noise_bins ? sums[DISTORTION_BIN_NOISE] / analyzer->noise_bins : 0.0;
+    double fundamental_power = sums[1] - density * analyzer->lobe_count[1];
+    if (fundamental_power <= 0.0) return FALSE;
+
+    double harmonic_power = 0.0;
+    for (int h = 2; h <= result->num_harmonics; h++) {
+        double p = fmax(sums[h] - density * analyzer->lobe_count[h], 0.0);
+        result->harmonic_db[h] = ratio_db(p / fundamental_power);
+        harmonic_power += p;
+    }
+    double noise_power = density * analyzer->band_bins;
+
+    double thd = harmonic_power / fundamental_power;
+    double thdn = (harmonic_power + noise_power) / fundamental_power;
+
+    result->fundamental_freq = (float)(fundamental * sample_rate / size);
+    result->fundamental_dbfs = ratio_db(4.0 * fundamental_power);
+    result->thd_percent = (float)(100.0 * sqrt(thd));
+    result->thd_db = ratio_db(thd);
+    result->thdn_percent = (float)(100.0 * sqrt(thdn));
+    result->thdn_db = ratio_db(thdn);
+    result->sinad_db = -result->thdn_db;
+    result->snr_db = ratio_db(fundamental_power / fmax(noise_power, 1e-30));
+    result->enob = (result->sinad_db - 1.76f) / 6.02f;
+    result->valid = TRUE;
+    return TRUE;
+}
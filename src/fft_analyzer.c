@@ -1,8 +1,23 @@
 // fft_analyzer.c:
 #include "fft_analyzer.h"
+#include "simd.h"
+#include "logger.h"
+#include "rt_pool.h"
 #include <math.h>
 #include <string.h>
 
+#define FFT_SMOOTHING 0.7f
+
+static GMutex planner_lock;
+
+void fft_planner_lock(void) {
+   g_mutex_lock(&planner_lock);
+}
+
+void fft_planner_unlock(void) {
+   g_mutex_unlock(&planner_lock);
+}
+
 static void create_hamming_window(double *window, size_t size) {
    for (size_t i = 0; i < size; i++) {
        // Hamming window formula: 0.54 - 0.46 * cos(2π * n/(N-1))
@@ -10,7 +25,7 @@ static void create_hamming_window(double *window, size_t size) {
    }
 }
 
-static void create_hann_window(double *window, size_t size, double *power) {
+static void create_hann_window(float *window, size_t size, double *power) {
    double sum = 0.0;
    for (size_t i = 0; i < size; i++) {
        window[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (size - 1)));
@@ -19,43 +34,60 @@ static void create_hann_window(double *window, size_t size, double *power) {
    *power = sum / size;
 }
 
-static float mag_to_db(float magnitude) {
-   return 20.0f * log10f(fmaxf(magnitude, 1e-6f));
+static void create_blackman_harris_window(float *window, size_t size, double *power) {
+   double sum = 0.0;
+   for (size_t i = 0; i < size; i++) {
+       double x = 2.0 * M_PI * i / (size - 1);
+       window[i] = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2.0 * x) - 0.01168 * cos(3.0 * x);
+       sum += window[i] * window[i];
+   }
+   *power = sum / size;
+}
+
+static double window_mean(const float *window, size_t size) {
+   double sum = 0.0;
+   for (size_t i = 0; i < size; i++) {
+       sum += window[i];
+   }
+   return sum / size;
 }
 
 struct FFTAnalyzer* fft_analyzer_create(void) {
-   g_print("FFT Analyzer: Starting creation\n");
+   LOG_INFO("FFT Analyzer: Starting creation");
    
    struct FFTAnalyzer *analyzer = g_malloc(sizeof(struct FFTAnalyzer));
    if (!analyzer) {
-       g_print("ERROR: Failed to allocate FFT analyzer structure\n");
+       LOG_ERROR("Failed to allocate FFT analyzer structure");
        return NULL;
    }
    
-   analyzer->input = fftw_alloc_real(FFT_SIZE);
-   analyzer->output = fftw_alloc_complex(FFT_SIZE/2 + 1);
-   analyzer->magnitudes = g_malloc(sizeof(float) * (FFT_SIZE/2 + 1));
-   analyzer->smoothed_mags = g_malloc(sizeof(float) * (FFT_SIZE/2 + 1));
-   analyzer->window = fftw_alloc_real(WINDOW_SIZE);
+   analyzer->input = fftwf_alloc_real(FFT_SIZE);
+   analyzer->output = fftwf_alloc_complex(FFT_SIZE/2 + 1);
+   analyzer->magnitudes = rt_pool_new(float, FFT_SIZE/2 + 1);
+   analyzer->smoothed_mags = rt_pool_new(float, FFT_SIZE/2 + 1);
+   analyzer->power = rt_pool_new(float, FFT_SIZE/2 + 1);
+   analyzer->window = fftwf_alloc_real(WINDOW_SIZE);
    
    if (!analyzer->input || !analyzer->output || !analyzer->magnitudes || 
-       !analyzer->smoothed_mags || !analyzer->window) {
+       !analyzer->smoothed_mags || !analyzer->power || !analyzer->window) {
        fft_analyzer_destroy(analyzer);
        return NULL;
    }
    
-   // Initialize buffers
-   memset(analyzer->magnitudes, 0, sizeof(float) * (FFT_SIZE/2 + 1));
-   memset(analyzer->smoothed_mags, 0, sizeof(float) * (FFT_SIZE/2 + 1));
-   
    analyzer->size = FFT_SIZE;
+   analyzer->num_peaks = 0;
+   analyzer->next_peak_id = 1;
    
    // Create window function
+   analyzer->window_type = FFT_WINDOW_HANN;
    create_hann_window(analyzer->window, WINDOW_SIZE, &analyzer->window_power);
+   analyzer->coherent_gain = window_mean(analyzer->window, WINDOW_SIZE);
    
    // Create FFT plan
-   analyzer->plan = fftw_plan_dft_r2c_1d(FFT_SIZE, analyzer->input, 
-                                        analyzer->output, FFTW_MEASURE);
+   fft_planner_lock();
+   analyzer->plan = fftwf_plan_dft_r2c_1d(FFT_SIZE, analyzer->input, 
+                                         analyzer->output, FFTW_MEASURE);
+   fft_planner_unlock();
    if (!analyzer->plan) {
        fft_analyzer_destroy(analyzer);
        return NULL;
@@ -67,65 +99,189 @@ struct FFTAnalyzer* fft_analyzer_create(void) {
 void fft_analyzer_destroy(struct FFTAnalyzer *analyzer) {
    if (!analyzer) return;
    
-   if (analyzer->plan) fftw_destroy_plan(analyzer->plan);
-   if (analyzer->input) fftw_free(analyzer->input);
-   if (analyzer->output) fftw_free(analyzer->output);
-   if (analyzer->window) fftw_free(analyzer->window);
-   if (analyzer->magnitudes) g_free(analyzer->magnitudes);
-   if (analyzer->smoothed_mags) g_free(analyzer->smoothed_mags);
+   if (analyzer->plan) {
+       fft_planner_lock();
+       fftwf_destroy_plan(analyzer->plan);
+       fft_planner_unlock();
+   }
+   if (analyzer->input) fftwf_free(analyzer->input);
+   if (analyzer->output) fftwf_free(analyzer->output);
+   if (analyzer->window) fftwf_free(analyzer->window);
+   rt_pool_free(analyzer->magnitudes);
+   rt_pool_free(analyzer->smoothed_mags);
+   rt_pool_free(analyzer->power);
    
    g_free(analyzer);
 }
 
+void fft_analyzer_set_window(struct FFTAnalyzer *analyzer, FFTWindowType type) {
+   if (!analyzer || type == analyzer->window_type) return;
+
+   if (type == FFT_WINDOW_BLACKMAN_HARRIS) {
+       create_blackman_harris_window(analyzer->window, WINDOW_SIZE, &analyzer->window_power);
+   } else {
+       create_hann_window(analyzer->window, WINDOW_SIZE, &analyzer->window_power);
+   }
+   analyzer->coherent_gain = window_mean(analyzer->window, WINDOW_SIZE);
+   analyzer->window_type = type;
+   analyzer->num_peaks = 0;
+}
+
+// Everything after the transform in one pass, eight bins per vector:
+//   power       re^2 + im^2, scaled for the window (no sqrt)
+//   dB          10 * log10(power) from the fast log2, within 1e-4 dB
+//   normalized  clamped onto [MIN_DB, MAX_DB] by one multiply-add and two selects
+//   smoothed    one-pole average across frames, for the display
+static void postprocess(struct FFTAnalyzer *analyzer, float power_scale) {
+   const size_t bins = FFT_SIZE/2 + 1;
+   const float db_per_log2 = 10.0f * (float)M_LN2 / (float)M_LN10;
+   const float norm_scale = db_per_log2 / (MAX_DB - MIN_DB);
+   const float norm_offset = -MIN_DB / (MAX_DB - MIN_DB);
+   const float *spectrum = (const float *)analyzer->output;
+
+   const v8sf v_power_scale = v8sf_set1(power_scale);
+   const v8sf v_norm_scale = v8sf_set1(norm_scale);
+   const v8sf v_norm_offset = v8sf_set1(norm_offset);
+   const v8sf v_zero = v8sf_set1(0.0f);
+   const v8sf v_one = v8sf_set1(1.0f);
+   const v8sf v_keep = v8sf_set1(FFT_SMOOTHING);
+   const v8sf v_take = v8sf_set1(1.0f - FFT_SMOOTHING);
+
+   size_t i = 0;
+   for (; i + SIMD_LANES <= bins; i += SIMD_LANES) {
+       v8sf re, im;
+       v8sf_deinterleave(v8sf_load(&spectrum[i * 2]), v8sf_load(&spectrum[i * 2 + SIMD_LANES]),
+                         &re, &im);
+       v8sf power = (re * re + im * im) * v_power_scale;
+       v8sf_store(&analyzer->power[i], power);
+
+       v8sf normalized = v8sf_log2(power) * v_norm_scale + v_norm_offset;
+       normalized = v8sf_min(v8sf_max(normalized, v_zero), v_one);
+
+       v8sf smoothed = v8sf_load(&analyzer->smoothed_mags[i]) * v_keep + normalized * v_take;
+       v8sf_store(&analyzer->smoothed_mags[i], smoothed);
+       v8sf_store(&analyzer->magnitudes[i], smoothed);
+   }
+
+   // Nyquist bin left over from the 2^n / 2 + 1 layout
+   for (; i < bins; i++) {
+       float re = spectrum[i * 2];
+       float im = spectrum[i * 2 + 1];
+       float power = (re * re + im * im) * power_scale;
+       analyzer->power[i] = power;
+
+       float normalized = log2f(fmaxf(power, 1e-30f)) * norm_scale + norm_offset;
+       normalized = fminf(fmaxf(normalized, 0.0f), 1.0f);
+       analyzer->smoothed_mags[i] = analyzer->smoothed_mags[i] * FFT_SMOOTHING +
+                                    normalized * (1.0f - FFT_SMOOTHING);
+       analyzer->magnitudes[i] = analyzer->smoothed_mags[i];
+   }
+}
+
 void fft_analyzer_process(struct FFTAnalyzer *analyzer, const float *buffer, size_t buffer_size) {
    if (!analyzer || !buffer) return;
    
-   // Make a local copy of the input buffer to prevent data races
-   float *temp_buffer = g_malloc(buffer_size * sizeof(float) * 2);
-   if (!temp_buffer) return;
-   
-   memcpy(temp_buffer, buffer, buffer_size * sizeof(float) * 2);
-   
    // Clear input buffer
-   memset(analyzer->input, 0, sizeof(double) * FFT_SIZE);
+   memset(analyzer->input, 0, sizeof(float) * FFT_SIZE);
    
    // Calculate how many samples we can safely process
    size_t samples_to_process = MIN(buffer_size, FFT_SIZE);
    
-   // Copy and window the input data
+   // Window straight from the buffer: callers pass their own copy of the
+   // scope data, so there is nothing to guard against
    for (size_t i = 0; i < samples_to_process; i++) {
-       double sample = (double)temp_buffer[i * 2];  // Use left channel
-       analyzer->input[i] = sample * analyzer->window[i];
+       analyzer->input[i] = buffer[i * 2] * analyzer->window[i];  // Use left channel
    }
    
-   g_free(temp_buffer);
-   
    // Perform FFT
-   fftw_execute(analyzer->plan);
+   fftwf_execute(analyzer->plan);
    
-   // Process FFT output with proper scaling
    const double fft_scale = 1.0 / (FFT_SIZE * sqrt(analyzer->window_power));
-   const float smoothing = 0.7f;
-   
-   for (size_t i = 0; i < FFT_SIZE/2 + 1; i++) {
-       double real = analyzer->output[i][0] * fft_scale;
-       double imag = analyzer->output[i][1] * fft_scale;
-       double magnitude = sqrt(real * real + imag * imag);
-       
-       // Convert to dB with improved range
-       float db = mag_to_db(magnitude);
-       db = fmaxf(db, MIN_DB);
-       db = fminf(db, MAX_DB);
-       
-       // Normalize to 0-1 range for display
-       float normalized = (db - MIN_DB) / (MAX_DB - MIN_DB);
-       
-       // Apply temporal smoothing
-       analyzer->smoothed_mags[i] = analyzer->smoothed_mags[i] * smoothing + 
-                                  normalized * (1.0f - smoothing);
-       
-       analyzer->magnitudes[i] = analyzer->smoothed_mags[i];
+   postprocess(analyzer, (float)(fft_scale * fft_scale));
+}
+
+static double power_db(double power) {
+   return 10.0 * log10(fmax(power, 1e-20));
+}
+
+// Keeps the strongest FFT_MAX_PEAKS candidates, strongest first
+static void insert_peak(FFTPeak *peaks, int *count, const FFTPeak *peak) {
+   int pos = *count;
+   while (pos > 0 && peaks[pos - 1].magnitude_db < peak->magnitude_db) {
+       pos--;
    }
+   if (pos >= FFT_MAX_PEAKS) return;
+
+   int last = MIN(*count, FFT_MAX_PEAKS - 1);
+   memmove(&peaks[pos + 1], &peaks[pos], (last - pos) * sizeof(FFTPeak));
+   peaks[pos] = *peak;
+   *count = MIN(*count + 1, FFT_MAX_PEAKS);
+}
+
+// Finds the strongest local maxima of the last frame and refines each with
+// a parabola through the log power of its bin and neighbours (Gaussian
+// interpolation), then carries ids over from the previous frame's peaks:
+// strongest first, each takes the nearest unclaimed old peak within
+// FFT_PEAK_MATCH_BINS.
+int fft_analyzer_find_peaks(struct FFTAnalyzer *analyzer, float sample_rate) {
+   if (!analyzer || sample_rate <= 0.0f) return 0;
+
+   const float *power = analyzer->power;
+   size_t bins = analyzer->size / 2 + 1;
+   double bin_hz = (double)sample_rate / analyzer->size;
+
+   // A sine of amplitude A peaks at (A / 2) * coherent_gain / sqrt(window_power)
+   double dbfs_offset = 10.0 * log10(4.0 * analyzer->window_power /
+                                     (analyzer->coherent_gain * analyzer->coherent_gain));
+   double threshold_power = pow(10.0, (FFT_PEAK_THRESHOLD_DB - dbfs_offset) / 10.0);
+
+   FFTPeak found[FFT_MAX_PEAKS];
+   int count = 0;
+   for (size_t k = 1; k + 1 < bins; k++) {
+       if (power[k] < threshold_power || power[k] <= power[k - 1] || power[k] < power[k + 1]) {
+           continue;
+       }
+
+       double a = power_db(power[k - 1]);
+       double b = power_db(power[k]);
+       double c = power_db(power[k + 1]);
+       double denominator = a - 2.0 * b + c;
+       double delta = denominator < 0.0 ? 0.5 * (a - c) / denominator : 0.0;
+
+       FFTPeak peak = {
+           .id = 0,
+           .age = 0,
+           .bin = (float)(k + delta),
+           .frequency = (float)((k + delta) * bin_hz),
+           .magnitude_db = (float)(b - 0.25 * (a - c) * delta)
+       };
+       peak.level_dbfs = peak.magnitude_db + (float)dbfs_offset;
+       insert_peak(found, &count, &peak);
+   }
+
+   gboolean claimed[FFT_MAX_PEAKS] = {FALSE};
+   for (int i = 0; i < count; i++) {
+       int match = -1;
+       float best = FFT_PEAK_MATCH_BINS;
+       for (int j = 0; j < analyzer->num_peaks; j++) {
+           float distance = fabsf(found[i].bin - analyzer->peaks[j].bin);
+           if (!claimed[j] && distance <= best) {
+               best = distance;
+               match = j;
+           }
+       }
+       if (match >= 0) {
+           claimed[match] = TRUE;
+           found[i].id = analyzer->peaks[match].id;
+           found[i].age = analyzer->peaks[match].age + 1;
+       } else {
+           found[i].id = analyzer->next_peak_id++;
+       }
+   }
+
+   memcpy(analyzer->peaks, found, count * sizeof(FFTPeak));
+   analyzer->num_peaks = count;
+   return count;
 }
 
 size_t fft_analyzer_freq_to_bin(struct FFTAnalyzer *analyzer, float freq, float sample_rate) {
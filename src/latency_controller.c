@@ -0,0 +1,101 @@
+#include "latency_controller.h"
+#include "logger.h"
+
+static size_t block_for_target(LatencyController *controller, size_t target) {
+    // A quarter of the target keeps the fill from sawing by more than 25%
+    size_t block = (target / 4) / LATENCY_BLOCK_ALIGN * LATENCY_BLOCK_ALIGN;
+    return CLAMP(block, (size_t)LATENCY_MIN_BLOCK, controller->max_block);
+}
+
+static void publish(LatencyController *controller) {
+    g_atomic_int_set(&controller->published_target, (gint)controller->target_fill);
+    g_atomic_int_set(&controller->published_block, (gint)controller->block_size);
+}
+
+void latency_controller_init(LatencyController *controller, size_t max_block) {
+    controller->max_block = MAX(max_block, (size_t)LATENCY_MIN_BLOCK);
+    latency_controller_configure(controller, DEFAULT_SAMPLE_RATE, MIN_BUFFER_FILL);
+    controller->last_update = 0;
+    controller->quiet_since = 0;
+    controller->grace_until = 0;
+    controller->last_xruns = 0;
+    controller->window_min_fill = (size_t)-1;
+    controller->adjustments = 0;
+    publish(controller);
+}
+
+// Bounds follow the negotiated rate and the device block size
+void latency_controller_configure(LatencyController *controller, int sample_rate, size_t min_fill) {
+    controller->min_target = min_fill * 2;
+    controller->max_target = MAX(BUFFER_HIGH_WATERMARK(sample_rate), controller->min_target);
+    // Start where the fixed threshold was; underruns raise it from there
+    controller->target_fill = CLAMP(LATENCY_START_TARGET, controller->min_target, controller->max_target);
+    controller->block_size = block_for_target(controller, controller->target_fill);
+    publish(controller);
+}
+
+// Called when playback (re)starts: priming underruns are not load
+void latency_controller_reset(LatencyController *controller, guint64 xruns, gint64 now) {
+    controller->last_xruns = xruns;
+    controller->last_update = now;
+    controller->quiet_since = now;
+    controller->grace_until = now + LATENCY_START_GRACE_US;
+    controller->window_min_fill = (size_t)-1;
+}
+
+void latency_controller_update(LatencyController *controller, size_t fill,
+                               guint64 xruns, gint64 now) {
+    if (fill < controller->window_min_fill) {
+        controller->window_min_fill = fill;
+    }
+
+    if (now - controller->last_update < TARGET_WRITE_INTERVAL_MS * 1000) {
+        return;
+    }
+    controller->last_update = now;
+
+    size_t new_target = controller->target_fill;
+
+    if (xruns != controller->last_xruns) {
+        controller->last_xruns = xruns;
+        if (now < controller->grace_until) {
+            return;
+        }
+        // Loaded: widen the margin by half plus one block, at once
+        new_target = controller->target_fill + controller->target_fill / 2 + controller->block_size;
+        controller->quiet_since = now;
+    } else if (now - controller->quiet_since >= LATENCY_QUIET_PERIOD_US &&
+               controller->window_min_fill > controller->block_size * 2) {
+        // Quiet, and the ring never came close to draining: tighten a step
+        size_t step = MAX(controller->target_fill / LATENCY_STEP_DOWN_DIVISOR,
+                          (size_t)LATENCY_BLOCK_ALIGN);
+        new_target = controller->target_fill > step ? controller->target_fill - step : 0;
+        controller->quiet_since = now;
+        controller->window_min_fill = (size_t)-1;
+    }
+
+    new_target = CLAMP(new_target, controller->min_target, controller->max_target);
+    if (new_target != controller->target_fill) {
+        controller->target_fill = new_target;
+        controller->block_size = block_for_target(controller, new_target);
+        controller->window_min_fill = (size_t)-1;
+        g_atomic_int_inc(&controller->adjustments);
+        publish(controller);
+    }
+}
+
+size_t latency_controller_target(LatencyController *controller) {
+    return (size_t)g_atomic_int_get(&controller->published_target);
+}
+
+size_t latency_controller_block(LatencyController *controller) {
+    return (size_t)g_atomic_int_get(&controller->published_block);
+}
+
+void latency_controller_print(LatencyController *controller, int sample_rate) {
+    size_t target = latency_controller_target(controller);
+    size_t block = latency_controller_block(controller);
+    LOG_INFO("Latency controller: target %zu frames (%.2f ms), block %zu frames, %d adjustments",
+             target, sample_rate > 0 ? target * 1000.0 / sample_rate : 0.0,
+             block, g_atomic_int_get(&controller->adjustments));
+}
@@ -0,0 +1,457 @@
+#include "logger.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/types.h>
+
+static Logger logger = { .level = LOG_DEFAULT_LEVEL };
+
+static const char *level_names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+static void release_ring(gpointer data);
+static GPrivate thread_ring = G_PRIVATE_INIT(release_ring);
+
+typedef enum {
+    LENGTH_NONE,
+    LENGTH_CHAR,
+    LENGTH_SHORT,
+    LENGTH_LONG,
+    LENGTH_LONG_LONG,
+    LENGTH_SIZE,
+    LENGTH_INTMAX,
+    LENGTH_PTRDIFF,
+    LENGTH_LONG_DOUBLE
+} LengthModifier;
+
+// One conversion of a printf format, from its '%' to its conversion letter
+typedef struct {
+    const char *start;
+    const char *length_start;   // Where the length modifier begins
+    int stars;                  // '*' widths and precisions taking int arguments
+    LengthModifier length;
+    char conversion;
+} FormatSpec;
+
+// Returns the character after the spec; conversion is 0 when the format
+// is malformed and nothing more can be read from it
+static const char* parse_spec(const char *c, FormatSpec *spec) {
+    spec->start = c++;
+    spec->stars = 0;
+    while (*c && strchr("-+ #0'", *c)) c++;
+    if (*c == '*') {
+        spec->stars++;
+        c++;
+    }
+    while (*c >= '0' && *c <= '9') c++;
+    if (*c == '.') {
+        c++;
+        if (*c == '*') {
+            spec->stars++;
+            c++;
+        }
+        while (*c >= '0' && *c <= '9') c++;
+    }
+
+    spec->length_start = c;
+    spec->length = LENGTH_NONE;
+    switch (*c) {
+        case 'h':
+            spec->length = c[1] == 'h' ? LENGTH_CHAR : LENGTH_SHORT;
+            c += c[1] == 'h' ? 2 : 1;
+            break;
+        case 'l':
+            spec->length = c[1] == 'l' ? LENGTH_LONG_LONG : LENGTH_LONG;
+            c += c[1] == 'l' ? 2 : 1;
+            break;
+        case 'q': spec->length = LENGTH_LONG_LONG; c++; break;
+        case 'z': spec->length = LENGTH_SIZE; c++; break;
+        case 'j': spec->length = LENGTH_INTMAX; c++; break;
+        case 't': spec->length = LENGTH_PTRDIFF; c++; break;
+        case 'L': spec->length = LENGTH_LONG_DOUBLE; c++; break;
+    }
+
+    spec->conversion = *c && strchr("diouxXcsfFeEgGaAp%", *c) ? *c : 0;
+    return *c ? c + 1 : c;
+}
+
+static gint64 read_signed(va_list *args, LengthModifier length) {
+    switch (length) {
+        case LENGTH_LONG: return va_arg(*args, long);
+        case LENGTH_LONG_LONG: return va_arg(*args, long long);
+        case LENGTH_SIZE: return va_arg(*args, ssize_t);
+        case LENGTH_INTMAX: return va_arg(*args, intmax_t);
+        case LENGTH_PTRDIFF: return va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, int);
+    }
+}
+
+static gint64 read_unsigned(va_list *args, LengthModifier length) {
+    switch (length) {
+        case LENGTH_LONG: return (gint64)va_arg(*args, unsigned long);
+        case LENGTH_LONG_LONG: return (gint64)va_arg(*args, unsigned long long);
+        case LENGTH_SIZE: return (gint64)va_arg(*args, size_t);
+        case LENGTH_INTMAX: return (gint64)va_arg(*args, uintmax_t);
+        case LENGTH_PTRDIFF: return (gint64)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, unsigned int);
+    }
+}
+
+// Takes the arguments off the list in their promoted types. Only strings
+// are copied; everything else is kept as the bits that were passed. The
+// end of text is kept for LOG_TRUNCATED_TEXT, so a string that is cut
+// short, or finds no room at all, still shows it.
+static void capture(LogRecord *record, const char *format, va_list *args) {
+    const size_t text_limit = LOG_TEXT_SIZE - sizeof(LOG_TRUNCATED_TEXT);
+    size_t text_used = 0;
+    record->num_args = 0;
+    record->truncated = FALSE;
+
+    for (const char *c = format; *c; ) {
+        if (*c != '%') {
+            c++;
+            continue;
+        }
+        FormatSpec spec;
+        c = parse_spec(c, &spec);
+        if (spec.conversion == '%') continue;
+        if (spec.conversion == 0 || record->num_args + spec.stars + 1 > LOG_MAX_ARGS) {
+            record->truncated = TRUE;
+            return;
+        }
+
+        for (int i = 0; i < spec.stars; i++) {
+            record->args[record->num_args++].i = va_arg(*args, int);
+        }
+        LogArg *arg = &record->args[record->num_args++];
+        switch (spec.conversion) {
+            case 'd': case 'i':
+                arg->i = read_signed(args, spec.length);
+                break;
+            case 'o': case 'u': case 'x': case 'X':
+                arg->i = read_unsigned(args, spec.length);
+                break;
+            case 'c':
+                arg->i = va_arg(*args, int);
+                break;
+            case 'p':
+                arg->p = va_arg(*args, void *);
+                break;
+            case 's': {
+                const char *string = va_arg(*args, const char *);
+                if (!string) string = "(null)";
+                size_t room = text_limit - text_used;
+                size_t length = strlen(string);
+                arg->i = (gint64)text_used;
+                if (length < room) {
+                    memcpy(record->text + text_used, string, length + 1);
+                    text_used += length + 1;
+                } else {
+                    memcpy(record->text + text_used, string, room);
+                    memcpy(record->text + text_limit, LOG_TRUNCATED_TEXT,
+                           sizeof(LOG_TRUNCATED_TEXT));
+                    text_used = text_limit;
+                }
+                break;
+            }
+            default:
+                arg->d = spec.length == LENGTH_LONG_DOUBLE ? (double)va_arg(*args, long double)
+                                                           : va_arg(*args, double);
+                break;
+        }
+    }
+}
+
+static void append(char *line, size_t *used, const char *format, ...) G_GNUC_PRINTF(3, 4);
+
+static void append(char *line, size_t *used, const char *format, ...) {
+    if (*used >= LOG_LINE_LENGTH - 1) return;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(line + *used, LOG_LINE_LENGTH - *used, format, args);
+    va_end(args);
+    if (written > 0) {
+        *used = MIN(*used + (size_t)written, LOG_LINE_LENGTH - 1);
+    }
+}
+
+// Rebuilds each conversion without its length modifier so the stored
+// 64-bit integers and doubles can be passed back to printf as they are
+static size_t format_record(const LogRecord *record, gint64 start_us, char *line) {
+    size_t used = 0;
+    int next = 0;
+
+    append(line, &used, "[%10.3f] %-5s ", (record->time_us - start_us) / 1e6,
+           level_names[MIN(record->level, LOG_LEVEL_ERROR)]);
+
+    for (const char *c = record->format; *c; ) {
+        const char *literal = c;
+        while (*c && *c != '%') c++;
+        if (c > literal) append(line, &used, "%.*s", (int)(c - literal), literal);
+        if (!*c) break;
+
+        FormatSpec spec;
+        c = parse_spec(c, &spec);
+        if (spec.conversion == '%') {
+            append(line, &used, "%%");
+            continue;
+        }
+        if (spec.conversion == 0 || next + spec.stars + 1 > record->num_args) {
+            append(line, &used, "%s", record->truncated ? LOG_TRUNCATED_TEXT : "");
+            break;
+        }
+
+        char conversion[32];
+        int prefix = (int)MIN((size_t)(spec.length_start - spec.start), sizeof(conversion) - 4);
+        gboolean integer = strchr("diouxX", spec.conversion) != NULL;
+        snprintf(conversion, sizeof(conversion), "%.*s%s%c", prefix, spec.start,
+                 integer ? "ll" : "", spec.conversion);
+
+        int star[2] = { 0, 0 };
+        for (int i = 0; i < spec.stars; i++) {
+            star[i] = (int)record->args[next++].i;
+        }
+        const LogArg *arg = &record->args[next++];
+
+        // The conversion comes from the caller's literal, which the
+        // compiler checked against these types
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+        switch (spec.conversion) {
+            case 'c':
+                if (spec.stars == 1) append(line, &used, conversion, star[0], (int)arg->i);
+                else append(line, &used, conversion, (int)arg->i);
+                break;
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+                if (spec.stars == 2) append(line, &used, conversion, star[0], star[1], (long long)arg->i);
+                else if (spec.stars == 1) append(line, &used, conversion, star[0], (long long)arg->i);
+                else append(line, &used, conversion, (long long)arg->i);
+                break;
+            case 'p':
+                if (spec.stars == 1) append(line, &used, conversion, star[0], arg->p);
+                else append(line, &used, conversion, arg->p);
+                break;
+            case 's': {
+                const char *string = record->text + arg->i;
+                if (spec.stars == 2) append(line, &used, conversion, star[0], star[1], string);
+                else if (spec.stars == 1) append(line, &used, conversion, star[0], string);
+                else append(line, &used, conversion, string);
+                break;
+            }
+            default:
+                if (spec.stars == 2) append(line, &used, conversion, star[0], star[1], arg->d);
+                else if (spec.stars == 1) append(line, &used, conversion, star[0], arg->d);
+                else append(line, &used, conversion, arg->d);
+                break;
+        }
+#pragma GCC diagnostic pop
+    }
+
+    line[used++] = '\n';
+    return used;
+}
+
+// Claims a free ring, allocating one the first time a slot is used. Rings
+// are never freed while the logger runs, so the drainer can always read
+// what an exited thread left behind.
+static LogRing* claim_ring(void) {
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        LogRing *ring = g_atomic_pointer_get(&logger.rings[i]);
+        if (ring) {
+            if (g_atomic_int_compare_and_exchange(&ring->owned, 0, 1)) return ring;
+            continue;
+        }
+
+        ring = g_try_new0(LogRing, 1);
+        if (!ring) return NULL;
+        ring->owned = 1;
+        if (g_atomic_pointer_compare_and_exchange(&logger.rings[i], NULL, ring)) return ring;
+        g_free(ring);
+    }
+    return NULL;
+}
+
+static void release_ring(gpointer data) {
+    LogRing *ring = (LogRing *)data;
+    g_atomic_int_set(&ring->owned, 0);
+}
+
+// Claims this thread's ring up front, so a realtime thread does not
+// allocate on its first message
+void logger_thread_init(void) {
+    if (!g_private_get(&thread_ring)) {
+        LogRing *ring = claim_ring();
+        if (ring) g_private_set(&thread_ring, ring);
+    }
+}
+
+// Any thread. Never blocks: a full ring drops the message and counts it.
+void logger_write(LogLevel level, const char *format, ...) {
+    if ((gint)level < g_atomic_int_get(&logger.level) || !format) return;
+
+    LogRecord local;
+    LogRecord *record = &local;
+    LogRing *ring = NULL;
+    guint tail = 0;
+    gboolean running = g_atomic_int_get(&logger.running);
+
+    if (running) {
+        logger_thread_init();
+        ring = g_private_get(&thread_ring);
+        if (!ring) {
+            g_atomic_int_inc(&logger.dropped);
+            return;
+        }
+        tail = (guint)ring->tail;
+        if (tail - (guint)g_atomic_int_get(&ring->head) == LOG_RING_SIZE) {
+            g_atomic_int_inc(&ring->dropped);
+            return;
+        }
+        record = &ring->records[tail & (LOG_RING_SIZE - 1)];
+    }
+
+    record->time_us = g_get_monotonic_time();
+    record->format = format;
+    record->level = (guint8)level;
+    va_list args;
+    va_start(args, format);
+    capture(record, format, &args);
+    va_end(args);
+
+    if (running) {
+        g_atomic_int_set(&ring->tail, (gint)(tail + 1));
+    } else {
+        // Before init and after shutdown there is no drainer to wait for
+        if (logger.start_us == 0) logger.start_us = record->time_us;
+        char line[LOG_LINE_LENGTH];
+        size_t length = format_record(record, logger.start_us, line);
+        fwrite(line, 1, length, stdout);
+        fflush(stdout);
+    }
+}
+
+static void report_dropped(gint *counter, char *line) {
+    gint dropped = g_atomic_int_get(counter);
+    if (dropped == 0) return;
+    g_atomic_int_add(counter, -dropped);
+
+    size_t used = 0;
+    append(line, &used, "[%10.3f] %-5s Log: %d messages dropped\n",
+           (g_get_monotonic_time() - logger.start_us) / 1e6, level_names[LOG_LEVEL_WARN], dropped);
+    fwrite(line, 1, used, stdout);
+}
+
+// Writes everything published so far, oldest first across all rings
+static void drain(void) {
+    char line[LOG_LINE_LENGTH];
+    guint ends[LOG_MAX_THREADS];
+    LogRing *rings[LOG_MAX_THREADS];
+    int num_rings = 0;
+
+    for (int i = 0; i < LOG_MAX_THREADS; i++) {
+        LogRing *ring = g_atomic_pointer_get(&logger.rings[i]);
+        if (!ring) break;
+        rings[num_rings] = ring;
+        ends[num_rings++] = (guint)g_atomic_int_get(&ring->tail);
+    }
+
+    int drained = 0;
+    while (TRUE) {
+        int oldest = -1;
+        gint64 oldest_time = 0;
+        for (int i = 0; i < num_rings; i++) {
+            guint head = (guint)rings[i]->head;
+            if (head == ends[i]) continue;
+            gint64 time = rings[i]->records[head & (LOG_RING_SIZE - 1)].time_us;
+            if (oldest < 0 || time < oldest_time) {
+                oldest = i;
+                oldest_time = time;
+            }
+        }
+        if (oldest < 0) break;
+
+        LogRing *ring = rings[oldest];
+        guint head = (guint)ring->head;
+        size_t length = format_record(&ring->records[head & (LOG_RING_SIZE - 1)],
+                                      logger.start_us, line);
+        g_atomic_int_set(&ring->head, (gint)(head + 1));
+        fwrite(line, 1, length, stdout);
+        drained++;
+    }
+    TRACE_COUNTER("log records drained", drained);
+
+    for (int i = 0; i < num_rings; i++) {
+        report_dropped(&rings[i]->dropped, line);
+    }
+    report_dropped(&logger.dropped, line);
+    if (drained > 0) fflush(stdout);
+}
+
+static gpointer drainer_func(gpointer data) {
+    (void)data;
+
+    g_mutex_lock(&logger.mutex);
+    while (!logger.quit) {
+        g_mutex_unlock(&logger.mutex);
+        // Tracing starts after this thread, once options are parsed
+        trace_thread_name("logger");
+        drain();
+        g_mutex_lock(&logger.mutex);
+
+        gint64 deadline = g_get_monotonic_time() + LOG_DRAIN_INTERVAL_MS * G_TIME_SPAN_MILLISECOND;
+        while (!logger.quit && g_cond_wait_until(&logger.wake, &logger.mutex, deadline)) {
+        }
+    }
+    g_mutex_unlock(&logger.mutex);
+
+    drain();
+    return NULL;
+}
+
+// Starts the drainer; messages before this are written synchronously
+void logger_init(void) {
+    if (g_atomic_int_get(&logger.running)) return;
+
+    if (logger.start_us == 0) {
+        logger.start_us = g_get_monotonic_time();
+    }
+    g_mutex_init(&logger.mutex);
+    g_cond_init(&logger.wake);
+    logger.quit = FALSE;
+    g_atomic_int_set(&logger.running, 1);
+    logger.drainer = g_thread_new("logger", drainer_func, NULL);
+}
+
+// Writes what is still queued and stops the drainer. The rings stay
+// allocated: a thread that has not seen running go to zero may still be
+// writing into one.
+void logger_shutdown(void) {
+    if (!g_atomic_int_get(&logger.running)) return;
+
+    g_atomic_int_set(&logger.running, 0);
+    g_mutex_lock(&logger.mutex);
+    logger.quit = TRUE;
+    g_cond_signal(&logger.wake);
+    g_mutex_unlock(&logger.mutex);
+    g_thread_join(logger.drainer);
+    logger.drainer = NULL;
+    g_mutex_clear(&logger.mutex);
+    g_cond_clear(&logger.wake);
+}
+
+void logger_set_level(LogLevel level) {
+    g_atomic_int_set(&logger.level, CLAMP((gint)level, LOG_LEVEL_DEBUG, LOG_LEVEL_NONE));
+}
+
+gboolean logger_parse_level(const char *name, LogLevel *level) {
+    static const char *names[] = { "debug", "info", "warn", "error", "none" };
+    for (int i = 0; name && i <= LOG_LEVEL_NONE; i++) {
+        if (g_ascii_strcasecmp(name, names[i]) == 0) {
+            *level = (LogLevel)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -1,55 +1,344 @@
 // main.c
 #include <gtk/gtk.h>
+#include <glib-unix.h>
+#include <stdlib.h>
+#include <signal.h>
 #include "window_manager.h"
 #include "control_panel.h"
 #include "scope_window.h"
 #include "parameter_store.h"
 #include "waveform_generator.h"
 #include "audio_manager.h"
+#include "sequence_runner.h"
+#include "tone_tracker.h"
+#include "waveform_measure.h"
+#include "logger.h"
+#include "profile.h"
+#include "trace.h"
+#include "rt_thread.h"
+#include "rt_pool.h"
 
+static gchar *opt_audio_backend = NULL;
+static gint opt_sample_rate = 0;
+static gint opt_block_size = 0;
+static gint opt_channels = DEFAULT_OUTPUT_CHANNELS;
+static gint opt_tones = 0;
+static gint opt_render_threads = -1;
+static gchar *opt_chord = NULL;
+static gchar *opt_track = NULL;
+static gchar *opt_measure = NULL;
+static gchar *opt_renderer = NULL;
+static gchar *opt_log_level = NULL;
+static gchar *opt_trace = NULL;
+static gint opt_rt_priority = RT_DEFAULT_PRIORITY;
+static gchar *opt_rt_cpus = NULL;
+static gboolean opt_no_mlock = FALSE;
+static gboolean opt_huge_pages = FALSE;
+static gchar **opt_sequences = NULL;
+static gboolean opt_headless = FALSE;
+static gchar *opt_output_dir = NULL;
+static gint opt_jobs = 0;
+
+static GOptionEntry option_entries[] = {
+    { "audio-backend", 'b', 0, G_OPTION_ARG_STRING, &opt_audio_backend,
+      "Start audio on a device index or backend: null, null-fast, loopback, file[:PATH]", "SPEC" },
+    { "sample-rate", 'r', 0, G_OPTION_ARG_INT, &opt_sample_rate,
+      "Preferred sample rate in Hz (default: 48000, falls back to the device rate)", "HZ" },
+    { "block-size", 'k', 0, G_OPTION_ARG_INT, &opt_block_size,
+      "Frames per audio callback (default: chosen by the device)", "FRAMES" },
+    { "channels", 'c', 0, G_OPTION_ARG_INT, &opt_channels,
+      "Output channels, each with its own generator (default: 2, 0 = all the device has)", "N" },
+    { "tones", 't', 0, G_OPTION_ARG_INT, &opt_tones,
+      "Render a bank of N log-spaced tones spread across the output channels", "N" },
+    { "render-threads", 'j', 0, G_OPTION_ARG_INT, &opt_render_threads,
+      "Threads rendering the tone bank (default: one per core)", "N" },
+    { "chord", 0, 0, G_OPTION_ARG_STRING, &opt_chord,
+      "Hold a chord on the voice engine, e.g. 440,554.37,659.25", "HZ,..." },
+    { "track", 0, 0, G_OPTION_ARG_STRING, &opt_track,
+      "Track amplitude and phase of the output at these frequencies", "HZ,..." },
+    { "measure", 0, 0, G_OPTION_ARG_FILENAME, &opt_measure,
+      "Write Vpp, RMS, frequency, duty and edge times of the output to FILE, - for stdout", "FILE" },
+    { "renderer", 0, 0, G_OPTION_ARG_STRING, &opt_renderer,
+      "Draw the scope with cairo or gl (OpenGL 3.2, falls back to cairo; default: cairo)", "NAME" },
+    { "log-level", 0, 0, G_OPTION_ARG_STRING, &opt_log_level,
+      "Least severe messages shown: debug, info, warn, error or none (default: info)", "LEVEL" },
+    { "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace,
+      "Record a timeline of every thread to FILE (Chrome trace JSON) at exit; SIGUSR1 saves a numbered copy", "FILE" },
+    { "rt-priority", 0, 0, G_OPTION_ARG_INT, &opt_rt_priority,
+      "SCHED_FIFO priority of the audio threads, the generator runs one below (default: 70, 0 = normal scheduling)", "N" },
+    { "rt-cpus", 0, 0, G_OPTION_ARG_STRING, &opt_rt_cpus,
+      "Run the audio and generator threads only on these CPUs, e.g. 2,3 or 2-3", "LIST" },
+    { "no-mlock", 0, 0, G_OPTION_ARG_NONE, &opt_no_mlock,
+      "Do not lock the process's memory with realtime priority", NULL },
+    { "huge-pages", 0, 0, G_OPTION_ARG_NONE, &opt_huge_pages,
+      "Put the realtime buffers on huge pages (falls back to transparent huge pages)", NULL },
+    { "sequence", 's', 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_sequences,
+      "Run a test sequence; repeat to queue several with --headless", "FILE" },
+    { "headless", 0, 0, G_OPTION_ARG_NONE, &opt_headless,
+      "Render sequences to WAV files as fast as possible, without a window or device", NULL },
+    { "output-dir", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output_dir,
+      "Directory for sequence WAV files and timing logs (default: next to each sequence)", "DIR" },
+    { "jobs", 0, 0, G_OPTION_ARG_INT, &opt_jobs,
+      "Sequences rendered at once with --headless (default: one per core)", "N" },
+    { NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+// <dir>/<sequence name without extension><suffix>
+static gchar* sequence_output_path(const char *sequence_path, const char *suffix) {
+    gchar *dir = opt_output_dir ? g_strdup(opt_output_dir) : g_path_get_dirname(sequence_path);
+    gchar *name = g_path_get_basename(sequence_path);
+    gchar *dot = strrchr(name, '.');
+    if (dot && dot != name) *dot = '\0';
+
+    gchar *file = g_strconcat(name, suffix, NULL);
+    gchar *path = g_build_filename(dir, file, NULL);
+    g_free(file);
+    g_free(name);
+    g_free(dir);
+    return path;
+}
+
+typedef struct {
+    gint next;
+    gint failed;
+    int sample_rate;
+    int channels;
+} HeadlessJobs;
+
+static gpointer headless_worker(gpointer data) {
+    HeadlessJobs *jobs = (HeadlessJobs *)data;
+    gint index;
+    trace_thread_name("sequence");
+    // Offline, but the same filters render here as on the audio thread
+    rt_flush_denormals();
+
+    while ((index = g_atomic_int_add(&jobs->next, 1)) < (gint)g_strv_length(opt_sequences)) {
+        const char *path = opt_sequences[index];
+        Sequence *sequence = sequence_load(path);
+        gchar *wav_path = sequence_output_path(path, ".wav");
+        gchar *log_path = sequence_output_path(path, ".log");
+
+        if (!sequence || !sequence_render(sequence, jobs->sample_rate, jobs->channels,
+                                          wav_path, log_path)) {
+            LOG_ERROR("Sequence %s: FAILED", path);
+            g_atomic_int_inc(&jobs->failed);
+        }
+
+        sequence_destroy(sequence);
+        g_free(wav_path);
+        g_free(log_path);
+    }
+    return NULL;
+}
+
+// Renders every --sequence without GTK or an audio device
+static int run_headless(void) {
+    guint count = opt_sequences ? g_strv_length(opt_sequences) : 0;
+    if (count == 0) {
+        LOG_ERROR("--headless needs at least one --sequence");
+        return 1;
+    }
+
+    HeadlessJobs jobs = {
+        .sample_rate = opt_sample_rate > 0 ? opt_sample_rate : DEFAULT_SAMPLE_RATE,
+        .channels = opt_channels > 0 ? opt_channels : DEFAULT_OUTPUT_CHANNELS
+    };
+    int workers = opt_jobs > 0 ? opt_jobs : (int)g_get_num_processors();
+    workers = CLAMP(workers, 1, (int)count);
+
+    gint64 started = g_get_monotonic_time();
+    GThread **threads = g_new(GThread *, workers);
+    for (int i = 0; i < workers; i++) {
+        threads[i] = g_thread_new("sequence", headless_worker, &jobs);
+    }
+    for (int i = 0; i < workers; i++) {
+        g_thread_join(threads[i]);
+    }
+    g_free(threads);
+
+    LOG_INFO("Sequences: %u run, %d failed in %.2f s on %d threads",
+             count, jobs.failed, (g_get_monotonic_time() - started) / 1e6, workers);
+    return jobs.failed ? 1 : 0;
+}
+
+typedef struct {
+    WaveformGenerator *generator;
+    gint cancel;
+} LiveSequence;
+
+static gpointer live_sequence_func(gpointer data) {
+    LiveSequence *live = (LiveSequence *)data;
+    trace_thread_name("sequence");
+    Sequence *sequence = sequence_load(opt_sequences[0]);
+    if (!sequence) return NULL;
+
+    gchar *log_path = sequence_output_path(opt_sequences[0], ".log");
+    LOG_INFO("Sequence %s: Running live", opt_sequences[0]);
+    bool ok = sequence_run_live(sequence, live->generator, log_path, &live->cancel);
+    LOG_INFO("Sequence %s: %s", opt_sequences[0], ok ? "done" : "stopped");
+
+    g_free(log_path);
+    sequence_destroy(sequence);
+    return NULL;
+}
+
+#define MEASURE_EXPORT_INTERVAL_MS 250   // Well inside the ring's MEASURE_RING_SIZE windows
+
+typedef struct {
+    WaveformMeasure *measure;
+    FILE *file;
+    gint cursor;
+} MeasureExport;
+
+// Appends the windows published since the last call, on the main loop
+static gboolean export_measurements(gpointer data) {
+    MeasureExport *export = (MeasureExport *)data;
+    WaveformMeasurement windows[MEASURE_RING_SIZE];
+    int count = waveform_measure_read(export->measure, &export->cursor, windows, MEASURE_RING_SIZE);
+    for (int i = 0; i < count; i++) {
+        waveform_measure_write(export->file, &windows[i]);
+    }
+    if (count > 0) {
+        fflush(export->file);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// <path without extension>-<n><extension>, e.g. trace-1.json
+static gchar* numbered_path(const char *path, int n) {
+    const char *slash = strrchr(path, G_DIR_SEPARATOR);
+    const char *dot = strrchr(path, '.');
+    if (!dot || dot == path || (slash && dot < slash + 2)) {
+        return g_strdup_printf("%s-%d", path, n);
+    }
+    return g_strdup_printf("%.*s-%d%s", (int)(dot - path), path, n, dot);
+}
+
+// SIGUSR1, on the main loop: saves the timeline so far without stopping
+static gboolean save_trace_snapshot(gpointer data) {
+    (void)data;
+    static int snapshots = 0;
+    gchar *path = numbered_path(opt_trace, ++snapshots);
+    trace_write(path);
+    g_free(path);
+    return G_SOURCE_CONTINUE;
+}
 
 int main(int argc, char *argv[]) {
-    g_print("Starting application\n");
+    // Drains queued messages at every exit from main
+    logger_init();
+    atexit(logger_shutdown);
+    LOG_INFO("Starting application");
+
+    // Parse before gtk_init so --headless runs without a display
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- waveform generator");
+    g_option_context_add_main_entries(context, option_entries, NULL);
+    g_option_context_add_group(context, gtk_get_option_group(FALSE));
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        LOG_ERROR("Option parsing failed: %s", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (opt_log_level) {
+        LogLevel level;
+        if (logger_parse_level(opt_log_level, &level)) {
+            logger_set_level(level);
+        } else {
+            LOG_WARN("Unknown log level '%s', using info", opt_log_level);
+        }
+        g_free(opt_log_level);
+    }
+
+    // Before any thread that records is started
+    if (opt_trace) {
+        trace_start();
+        trace_thread_name("main");
+    }
+
+    if (opt_sample_rate < 0 || opt_block_size < 0) {
+        LOG_ERROR("Sample rate and block size must not be negative");
+        return 1;
+    }
+    if (opt_channels < 0 || opt_channels > MAX_OUTPUT_CHANNELS) {
+        LOG_ERROR("Channels must be between 0 and %d", MAX_OUTPUT_CHANNELS);
+        return 1;
+    }
+
+    if (opt_headless) {
+        int status = run_headless();
+        profile_dump();
+        if (opt_trace) {
+            trace_write(opt_trace);
+            g_free(opt_trace);
+        }
+        g_strfreev(opt_sequences);
+        g_free(opt_output_dir);
+        return status;
+    }
     gtk_init(&argc, &argv);
+
+    // Before the audio and generator threads exist; they set themselves up
+    RtConfig rt = { 0 };
+    rt_config_init(&rt);
+    rt.priority = MAX(opt_rt_priority, 0);
+    rt.lock_memory = !opt_no_mlock;
+    if (opt_rt_cpus && !rt_parse_cpus(opt_rt_cpus, &rt)) {
+        LOG_WARN("Ignoring --rt-cpus %s", opt_rt_cpus);
+    }
+    rt_configure(&rt);
+    // A --tones bank's instances come from the pool too
+    rt_pool_init(RT_POOL_SIZE + (size_t)MAX(opt_tones, 0) * sizeof(RenderInstance), opt_huge_pages);
     
-    g_print("Creating parameter store\n");
+    LOG_INFO("Creating parameter store");
     ParameterStore *params = parameter_store_create();
     if (!params) {
-        g_print("Failed to create parameter store\n");
+        LOG_ERROR("Failed to create parameter store");
         return 1;
     }
     
-    g_print("Creating audio manager\n");
+    LOG_INFO("Creating audio manager");
     AudioManager *audio = audio_manager_create();
     if (!audio) {
-        g_print("Warning: Failed to create audio manager, continuing without audio\n");
+        LOG_WARN("Failed to create audio manager, continuing without audio");
+    } else {
+        audio_manager_set_format(audio, opt_sample_rate, (unsigned long)opt_block_size);
+        audio_manager_set_channels(audio, opt_channels);
     }
 
     // Create scope window first as generator needs it
-    g_print("Creating window manager\n");
+    LOG_INFO("Creating window manager");
     WindowManager *window_manager = window_manager_create(audio, NULL);  // Initially pass NULL for generator
     if (!window_manager) {
-        g_print("Failed to create window manager\n");
+        LOG_ERROR("Failed to create window manager");
         if (audio) audio_manager_destroy(audio);
         parameter_store_destroy(params);
         return 1;
     }
     
-    g_print("Creating scope window\n");
+    LOG_INFO("Creating scope window");
     struct ScopeWindow *scope = scope_window_create(window_manager->scope_container, params);
     if (!scope) {
-        g_print("Failed to create scope window\n");
+        LOG_ERROR("Failed to create scope window");
         window_manager_destroy(window_manager);
         if (audio) audio_manager_destroy(audio);
         parameter_store_destroy(params);
         return 1;
     }
+    if (opt_renderer && strcmp(opt_renderer, "gl") == 0) {
+        scope_window_set_renderer(scope, SCOPE_RENDER_GL);
+    } else if (opt_renderer && strcmp(opt_renderer, "cairo") != 0) {
+        LOG_WARN("Unknown renderer '%s', using cairo", opt_renderer);
+    }
 
     // Create generator but don't start audio yet - wait for device selection
-    g_print("Creating waveform generator - audio disabled\n");
+    LOG_INFO("Creating waveform generator - audio disabled");
     WaveformGenerator *generator = waveform_generator_create(params, scope, audio);
     if (!generator) {
-        g_print("Failed to create waveform generator\n");
+        LOG_ERROR("Failed to create waveform generator");
         scope_window_destroy(scope);
         window_manager_destroy(window_manager);
         if (audio) audio_manager_destroy(audio);
@@ -57,13 +346,31 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if ((opt_tones > 0 || opt_render_threads >= 0) &&
+        !waveform_generator_set_tones(generator, opt_tones, MAX(opt_render_threads, 0))) {
+        LOG_INFO("Continuing with one generator per channel");
+    }
+
+    if (opt_chord) {
+        gchar **notes = g_strsplit(opt_chord, ",", -1);
+        float velocity = 1.0f / MAX(g_strv_length(notes), 1u);  // Sum stays within full scale
+        waveform_generator_set_poly(generator, true);
+        for (guint i = 0; notes[i]; i++) {
+            float freq = g_ascii_strtod(notes[i], NULL);
+            if (!voice_engine_note_on(generator->voices, i, freq, velocity)) {
+                LOG_WARN("Ignoring chord note '%s'", notes[i]);
+            }
+        }
+        g_strfreev(notes);
+    }
+
     // Update window manager with generator reference
     window_manager->generator = generator;
     
-    g_print("Creating control panel\n");
+    LOG_INFO("Creating control panel");
     ControlPanel *control_panel = control_panel_create(window_manager->control_container, params);
     if (!control_panel) {
-        g_print("Failed to create control panel\n");
+        LOG_ERROR("Failed to create control panel");
         scope_window_destroy(scope);
         window_manager_destroy(window_manager);
         waveform_generator_destroy(generator);
@@ -72,19 +379,118 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    g_print("Running main window\n");
+    // Tracked on every rendered sample, before the generator thread starts
+    ToneTracker *tracker = NULL;
+    if (opt_track) {
+        tracker = tone_tracker_parse(opt_track, audio_manager_get_sample_rate(audio));
+        if (tracker) {
+            generator->tracker = tracker;
+            scope_window_set_tracker(scope, tracker);
+        } else {
+            LOG_WARN("Ignoring --track %s", opt_track);
+        }
+    }
+
+    // Measured on every rendered sample too; shown on the scope and
+    // optionally written out
+    WaveformMeasure *measure = waveform_measure_create(MEASURE_DEFAULT_WINDOW_S);
+    generator->measure = measure;
+    scope_window_set_measure(scope, measure);
+    MeasureExport measure_export = { .measure = measure };
+    guint measure_source = 0;
+    if (opt_measure) {
+        measure_export.file = strcmp(opt_measure, "-") == 0 ? stdout : fopen(opt_measure, "w");
+        if (measure_export.file) {
+            waveform_measure_write_header(measure_export.file);
+            measure_source = g_timeout_add(MEASURE_EXPORT_INTERVAL_MS, export_measurements,
+                                           &measure_export);
+        } else {
+            LOG_ERROR("Cannot write measurements to '%s'", opt_measure);
+        }
+    }
+
+    // Same path as picking a device from the Audio menu
+    bool playing = false;
+    if (opt_audio_backend && audio) {
+        if (audio_manager_switch_device(audio, opt_audio_backend)) {
+            waveform_generator_start(generator);
+            waveform_generator_set_audio_enabled(generator, true);
+            playing = true;
+        } else {
+            LOG_ERROR("Unknown audio backend '%s'", opt_audio_backend);
+        }
+    }
+
+    LiveSequence live = { .generator = generator };
+    GThread *live_thread = NULL;
+    if (opt_sequences && opt_sequences[0]) {
+        if (playing) {
+            live_thread = g_thread_new("sequence", live_sequence_func, &live);
+        } else {
+            LOG_WARN("--sequence needs --audio-backend, or --headless");
+        }
+    }
+
+    guint trace_source = 0;
+    if (opt_trace) {
+        trace_source = g_unix_signal_add(SIGUSR1, save_trace_snapshot, NULL);
+    }
+
+    rt_pool_report();
+    LOG_INFO("Running main window");
     window_manager_run(window_manager);
     
-    g_print("Entering main loop\n");
+    LOG_INFO("Entering main loop");
     gtk_main();
     
-    g_print("Cleaning up\n");
+    LOG_INFO("Cleaning up");
+    if (live_thread) {
+        g_atomic_int_set(&live.cancel, 1);
+        g_thread_join(live_thread);
+    }
+    // The measurement thread reads the generator's markers
+    transfer_analyzer_stop(window_manager->transfer);
+    if (measure_source) {
+        g_source_remove(measure_source);
+    }
     waveform_generator_destroy(generator);
+    tone_tracker_destroy(tracker);
+    if (measure_export.file) {
+        export_measurements(&measure_export);
+        if (measure_export.file != stdout) {
+            fclose(measure_export.file);
+        }
+    }
+    waveform_measure_destroy(measure);
+    profile_dump();
+    if (trace_source) {
+        g_source_remove(trace_source);
+    }
+    if (opt_trace) {
+        trace_write(opt_trace);
+    }
+    if (audio) {
+        AudioTelemetrySnapshot telemetry;
+        audio_manager_get_telemetry(audio, &telemetry);
+        if (telemetry.callbacks > 0) {
+            audio_telemetry_print(&telemetry);
+        }
+    }
     control_panel_destroy(control_panel);
     scope_window_destroy(scope);
     window_manager_destroy(window_manager);
     if (audio) audio_manager_destroy(audio);
     parameter_store_destroy(params);
+    rt_shutdown();
+    rt_pool_shutdown();
+    g_free(opt_audio_backend);
+    g_free(opt_track);
+    g_free(opt_measure);
+    g_free(opt_renderer);
+    g_free(opt_trace);
+    g_free(opt_rt_cpus);
+    g_strfreev(opt_sequences);
+    g_free(opt_output_dir);
     
     return 0;
 }
@@ -0,0 +1,165 @@
+#include "mod_matrix.h"
+#include <string.h>
+#include <math.h>
+
+#define DECAY_RATE 5.0f   // e-folds per period for MOD_SHAPE_DECAY
+
+static float shape_sine(float phase, float held) {
+    (void)held;
+    return sinf(2.0f * M_PI * phase);
+}
+
+static float shape_triangle(float phase, float held) {
+    (void)held;
+    return 1.0f - 4.0f * fabsf(phase - 0.5f);
+}
+
+static float shape_saw(float phase, float held) {
+    (void)held;
+    return 2.0f * phase - 1.0f;
+}
+
+static float shape_square(float phase, float held) {
+    (void)held;
+    return phase < 0.5f ? 1.0f : -1.0f;
+}
+
+static float shape_sample_hold(float phase, float held) {
+    (void)phase;
+    return held;
+}
+
+static float shape_decay(float phase, float held) {
+    (void)held;
+    return expf(-DECAY_RATE * phase);
+}
+
+// Indexed by ModShape so evaluation needs no switch
+static float (*const shape_table[MOD_SHAPE_COUNT])(float, float) = {
+    shape_sine,
+    shape_triangle,
+    shape_saw,
+    shape_square,
+    shape_sample_hold,
+    shape_decay
+};
+
+static float next_random(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (float)x * (2.0f / 4294967296.0f) - 1.0f;
+}
+
+void mod_matrix_init(ModMatrix *matrix) {
+    memset(matrix, 0, sizeof(*matrix));
+    for (int s = 0; s < MOD_MAX_SOURCES; s++) {
+        matrix->sources[s].shape = MOD_SHAPE_SINE;
+        matrix->sources[s].frequency = 0.0f;
+    }
+    for (int r = 0; r < MOD_MAX_ROUTES; r++) {
+        matrix->routes[r].source = -1;
+    }
+}
+
+// Drops routes that cannot contribute: unused, zero depth, or fed by a
+// stopped source. This is where the old "freq > 0" checks now live.
+void mod_program_compile(ModProgram *program, const ModMatrix *matrix) {
+    unsigned source_mask = 0;
+
+    program->num_ops = 0;
+    program->num_used = 0;
+    program->dest_mask = 0;
+
+    for (int s = 0; s < MOD_MAX_SOURCES; s++) {
+        ModShape shape = matrix->sources[s].shape;
+        program->shapes[s] = (shape >= 0 && shape < MOD_SHAPE_COUNT) ? shape : MOD_SHAPE_SINE;
+        program->frequency[s] = fmaxf(matrix->sources[s].frequency, 0.0f);
+    }
+
+    for (int r = 0; r < MOD_MAX_ROUTES; r++) {
+        const ModRoute *route = &matrix->routes[r];
+        if (route->source < 0 || route->source >= MOD_MAX_SOURCES) continue;
+        if (route->destination < 0 || route->destination >= MOD_DEST_COUNT) continue;
+        if (route->depth == 0.0f || program->frequency[route->source] <= 0.0f) continue;
+
+        ModOp *op = &program->ops[program->num_ops++];
+        op->source = route->source;
+        op->destination = route->destination;
+        op->depth = route->depth;
+        program->dest_mask |= 1u << route->destination;
+        source_mask |= 1u << route->source;
+    }
+
+    for (int s = 0; s < MOD_MAX_SOURCES; s++) {
+        if (source_mask & (1u << s)) {
+            program->used_sources[program->num_used++] = s;
+        }
+    }
+}
+
+void mod_state_reset(ModState *state, uint32_t seed) {
+    memset(state, 0, sizeof(*state));
+    state->rng = seed ? seed : 1;
+}
+
+// Destination offsets at the state's current phase
+void mod_program_evaluate(const ModProgram *program, const ModState *state,
+                          float dest[MOD_DEST_COUNT]) {
+    float value[MOD_MAX_SOURCES];
+
+    for (int d = 0; d < MOD_DEST_COUNT; d++) {
+        dest[d] = 0.0f;
+    }
+    if (program->num_ops == 0) return;
+
+    for (int i = 0; i < program->num_used; i++) {
+        int s = program->used_sources[i];
+        value[s] = shape_table[program->shapes[s]](state->phase[s], state->held[s]);
+    }
+    for (int i = 0; i < program->num_ops; i++) {
+        const ModOp *op = &program->ops[i];
+        dest[op->destination] += op->depth * value[op->source];
+    }
+}
+
+// Every source keeps running, routed or not, so its phase does not depend
+// on when it was routed
+void mod_program_advance(const ModProgram *program, ModState *state,
+                         size_t frames, float inv_sample_rate) {
+    float elapsed = frames * inv_sample_rate;
+
+    for (int s = 0; s < MOD_MAX_SOURCES; s++) {
+        float phase = state->phase[s] + program->frequency[s] * elapsed;
+        if (phase >= 1.0f) {
+            phase -= floorf(phase);
+            state->held[s] = next_random(&state->rng);
+        }
+        state->phase[s] = phase;
+    }
+}
+
+const char* mod_shape_name(ModShape shape) {
+    switch (shape) {
+        case MOD_SHAPE_SINE:        return "Sine";
+        case MOD_SHAPE_TRIANGLE:    return "Triangle";
+        case MOD_SHAPE_SAW:         return "Saw";
+        case MOD_SHAPE_SQUARE:      return "Square";
+        case MOD_SHAPE_SAMPLE_HOLD: return "Sample & Hold";
+        case MOD_SHAPE_DECAY:       return "Decay";
+        default:                    return "Unknown";
+    }
+}
+
+const char* mod_destination_name(ModDestination destination) {
+    switch (destination) {
+        case MOD_DEST_PITCH:     return "Pitch";
+        case MOD_DEST_AMPLITUDE: return "Amplitude";
+        case MOD_DEST_DUTY:      return "Duty Cycle";
+        case MOD_DEST_CUTOFF:    return "Cutoff";
+        case MOD_DEST_RESONANCE: return "Resonance";
+        default:                 return "Unknown";
+    }
+}
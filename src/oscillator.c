@@ -0,0 +1,235 @@
+#include "oscillator.h"
+#include "profile.h"
+#include <string.h>
+#include <math.h>
+
+// Per-oscillator generator: reentrant and reproducible, unlike rand()
+static inline float next_white_noise(Oscillator *osc) {
+    uint32_t x = osc->noise_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    osc->noise_state = x;
+    return (float)x * (2.0f / 4294967296.0f) - 1.0f;
+}
+
+static float generate_pink_noise(Oscillator *osc) {
+    return pink_noise_step(osc->pink, next_white_noise(osc));
+}
+
+
+// Utility function for tanh approximation (faster than std tanh)
+static float fast_tanh(float x) {
+    float x2 = x * x;
+    return x * (27.0f + x2) / (27.0f + 9.0f * x2);
+}
+
+static void ladder_filter_reset(LadderFilter *filter) {
+    memset(filter->delay, 0, sizeof(float) * FILTER_STAGES);
+}
+
+void ladder_filter_coeffs(LadderCoeffs *coeffs, float cutoff, float resonance,
+                          float sample_rate) {
+    // Calculate and bound cutoff frequency with extra safety margin
+    float fc = fmaxf(20.0f, fminf(cutoff, 20000.0f));
+
+    // Add extra safety bound for very low frequencies
+    fc = fmaxf(fc, sample_rate * 0.0005f);  // Minimum 0.05% of sample rate
+
+    // Smoothed frequency normalization
+    float f = fminf(0.499f, fc / sample_rate);  // Prevent getting too close to Nyquist
+
+    // Enhanced resonance response
+    float res = fmaxf(0.0f, fminf(resonance, 1.0f));
+
+    // Scale resonance for feedback (reduced from 4.0 to 3.8 to prevent self-oscillation getting too extreme)
+    float scaled_res = 3.8f * sqrtf(res);
+
+    // Compute filter coefficients
+    float k = 4.0f * (f * M_PI);
+    coeffs->p = k / (1.0f + k);
+
+    // Adjusted compensation - only compensate for resonance-induced gain changes
+    coeffs->comp = 1.0f / (1.0f + scaled_res * 0.1f);
+    coeffs->feedback = scaled_res;
+
+    // Nonlinear processing - scale back the resonance influence
+    coeffs->drive = 1.0f + 0.3f * res;
+}
+
+// Moves coeffs one sample along a linear ramp
+static inline void ladder_coeffs_step(LadderCoeffs *coeffs, const LadderCoeffs *step) {
+    coeffs->p += step->p;
+    coeffs->feedback += step->feedback;
+    coeffs->comp += step->comp;
+    coeffs->drive += step->drive;
+}
+
+static inline float ladder_filter_process(LadderFilter *filter, const LadderCoeffs *coeffs,
+                                          float input) {
+    // Input with resonance feedback
+    float stage = (input - coeffs->feedback * filter->delay[3]) * coeffs->comp;
+
+    // Cascade of 4 one-pole filters
+    for (int i = 0; i < FILTER_STAGES; i++) {
+        if (i > 0) stage = filter->delay[i - 1];
+        stage = fast_tanh(stage * coeffs->drive);
+        filter->delay[i] = filter->delay[i] + coeffs->p * (stage - filter->delay[i]);
+    }
+
+    return filter->delay[3];
+}
+
+static float generate_waveform(Oscillator *osc, float phase, WaveformType type, float duty_cycle) {
+    switch(type) {
+        case WAVE_SINE:
+            return sinf(phase);
+
+        case WAVE_SQUARE: {
+            float threshold = duty_cycle * 2.0f * M_PI;
+            return (phase <= threshold) ? 1.0f : -1.0f;
+        }
+
+        case WAVE_SAW:
+            return (phase / (2.0f * M_PI) * 2.0f) - 1.0f;
+
+        case WAVE_TRIANGLE: {
+            float normalized = phase / (2.0f * M_PI);
+            if (normalized < 0.5f) {
+                return normalized * 4.0f - 1.0f;
+            } else {
+                return 3.0f - normalized * 4.0f;
+            }
+        }
+
+        case WAVE_PINK_NOISE:
+            return generate_pink_noise(osc);
+
+        default:
+            return 0.0f;
+    }
+}
+
+void oscillator_seed(Oscillator *osc, uint32_t seed) {
+    osc->noise_seed = seed ? seed : 1;
+}
+
+void oscillator_reset(Oscillator *osc) {
+    osc->phase = 0.0f;
+    ladder_filter_reset(&osc->filter);
+    memset(osc->pink, 0, sizeof(osc->pink));
+    if (osc->noise_seed == 0) osc->noise_seed = 1;
+    osc->noise_state = osc->noise_seed;
+    mod_state_reset(&osc->mod, osc->noise_seed);
+}
+
+// Renders one channel as a contiguous block; the caller interleaves.
+// Modulation is evaluated every MOD_CONTROL_INTERVAL samples and every
+// destination, filter coefficients included, is interpolated per sample
+// across the interval.
+void oscillator_render(Oscillator *osc, const OscillatorParams *params, float *out,
+                       size_t frames, float sample_rate, float phase_scale) {
+    PROFILE_START(render_start);
+    PROFILE_TOTAL(modulation_ticks);
+    PROFILE_TOTAL(sample_ticks);
+    const float two_pi = 2.0f * M_PI;
+    const ModProgram *mod = params->mod;
+    float inv_sample_rate = 1.0f / sample_rate;
+    float cutoff_range = params->filter_cutoff - 20.0f;
+    int clamp_duty = (mod->dest_mask & (1u << MOD_DEST_DUTY)) != 0;
+
+    float current_phase = osc->phase;
+
+    // Per-block phase increment keeps the sample loop free of divisions
+    float inv_frames = 1.0f / (float)frames;
+    float phase_inc = params->frequency * phase_scale;
+    float phase_inc_step = (params->frequency_end - params->frequency) * phase_scale * inv_frames;
+    float amplitude = params->amplitude;
+    float amplitude_step = (params->amplitude_end - params->amplitude) * inv_frames;
+
+    float mod_start[MOD_DEST_COUNT];
+    float mod_end[MOD_DEST_COUNT];
+    PROFILE_START(first_evaluate);
+    mod_program_evaluate(mod, &osc->mod, mod_start);
+    PROFILE_ADD(modulation_ticks, first_evaluate);
+
+    // Cutoff modulation spans 20 Hz to the current cutoff
+    LadderCoeffs coeffs, coeffs_end;
+    ladder_filter_coeffs(&coeffs,
+                         params->filter_cutoff + mod_start[MOD_DEST_CUTOFF] * cutoff_range,
+                         params->filter_resonance + mod_start[MOD_DEST_RESONANCE],
+                         sample_rate);
+
+    for (size_t start = 0; start < frames; start += MOD_CONTROL_INTERVAL) {
+        size_t end = start + MOD_CONTROL_INTERVAL < frames ? start + MOD_CONTROL_INTERVAL : frames;
+        float inv_count = 1.0f / (float)(end - start);
+
+        PROFILE_START(modulation_start);
+        mod_program_advance(mod, &osc->mod, end - start, inv_sample_rate);
+        mod_program_evaluate(mod, &osc->mod, mod_end);
+        PROFILE_ADD(modulation_ticks, modulation_start);
+
+        // Clamping the endpoints keeps the interpolated duty cycle in range
+        float duty = params->duty_cycle + mod_start[MOD_DEST_DUTY];
+        float duty_end = params->duty_cycle + mod_end[MOD_DEST_DUTY];
+        if (clamp_duty) {
+            duty = fmaxf(0.1f, fminf(0.9f, duty));
+            duty_end = fmaxf(0.1f, fminf(0.9f, duty_end));
+        }
+        float duty_step = (duty_end - duty) * inv_count;
+
+        ladder_filter_coeffs(&coeffs_end,
+                             params->filter_cutoff + mod_end[MOD_DEST_CUTOFF] * cutoff_range,
+                             params->filter_resonance + mod_end[MOD_DEST_RESONANCE],
+                             sample_rate);
+        LadderCoeffs coeffs_step = {
+            .p = (coeffs_end.p - coeffs.p) * inv_count,
+            .feedback = (coeffs_end.feedback - coeffs.feedback) * inv_count,
+            .comp = (coeffs_end.comp - coeffs.comp) * inv_count,
+            .drive = (coeffs_end.drive - coeffs.drive) * inv_count
+        };
+
+        float pitch = 1.0f + mod_start[MOD_DEST_PITCH];
+        float pitch_step = (mod_end[MOD_DEST_PITCH] - mod_start[MOD_DEST_PITCH]) * inv_count;
+        float gain = 1.0f + mod_start[MOD_DEST_AMPLITUDE];
+        float gain_step = (mod_end[MOD_DEST_AMPLITUDE] - mod_start[MOD_DEST_AMPLITUDE]) * inv_count;
+
+        // The filter runs fused with the waveform, so they are timed together
+        PROFILE_START(sample_start);
+        for (size_t i = start; i < end; i++) {
+            // Generate base waveform at this channel's phase offset
+            float eval_phase = current_phase + params->phase_offset;
+            if (eval_phase >= two_pi) eval_phase -= two_pi;
+            float wave_value = generate_waveform(osc, eval_phase, params->waveform, duty);
+
+            wave_value = ladder_filter_process(&osc->filter, &coeffs, wave_value);
+            out[i] = wave_value * amplitude * gain;
+            ladder_coeffs_step(&coeffs, &coeffs_step);
+
+            // Update phase
+            current_phase += phase_inc * pitch;
+            phase_inc += phase_inc_step;
+            amplitude += amplitude_step;
+            // Pitch modulation can step backwards, and a frequency above a
+            // low stream rate more than a cycle at a time
+            if (current_phase >= two_pi || current_phase < 0.0f) {
+                current_phase -= two_pi * floorf(current_phase / two_pi);
+                if (current_phase >= two_pi) current_phase = 0.0f;
+            }
+
+            pitch += pitch_step;
+            gain += gain_step;
+            duty += duty_step;
+        }
+        PROFILE_ADD(sample_ticks, sample_start);
+
+        // Exact endpoints, so rounding in the steps does not carry over
+        memcpy(mod_start, mod_end, sizeof(mod_start));
+        coeffs = coeffs_end;
+    }
+
+    osc->phase = current_phase;
+    PROFILE_RECORD(PROFILE_MODULATION, modulation_ticks);
+    PROFILE_RECORD(PROFILE_SAMPLE_LOOP, sample_ticks);
+    PROFILE_STOP(PROFILE_OSCILLATOR, render_start);
+}
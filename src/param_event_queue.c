@@ -0,0 +1,220 @@
+#include "param_event_queue.h"
+#include "logger.h"
+#include "trace.h"
+#include "publish_ring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The ring is a bounded multi-producer queue in the style of Vyukov's:
+// slot i is free for position p when its sequence equals p and holds an
+// event for the consumer when it equals p + 1. Producers claim a position
+// with a compare-and-swap on the tail and never wait on each other.
+
+ParamEventQueue* param_event_queue_create(void) {
+    ParamEventQueue *queue = g_new0(ParamEventQueue, 1);
+
+    for (int i = 0; i < PARAM_EVENT_QUEUE_SIZE; i++) {
+        queue->slots[i].sequence = i;
+    }
+    return queue;
+}
+
+void param_event_queue_destroy(ParamEventQueue *queue) {
+    if (!queue) return;
+    g_free(queue);
+}
+
+// Any thread. False when the queue is full; the render thread frees room
+// as it picks events up at the start of each block.
+bool param_event_queue_push(ParamEventQueue *queue, const ParamEvent *event) {
+    if (!queue || !event || event->param < 0 || event->param >= PARAM_COUNT) return false;
+
+    guint pos = (guint)g_atomic_int_get(&queue->tail);
+    while (TRUE) {
+        ParamEventSlot *slot = &queue->slots[pos & (PARAM_EVENT_QUEUE_SIZE - 1)];
+        gint diff = (gint)((guint)g_atomic_int_get(&slot->sequence) - pos);
+
+        if (diff == 0) {
+            if (g_atomic_int_compare_and_exchange(&queue->tail, (gint)pos, (gint)(pos + 1))) {
+                slot->event = *event;
+                g_atomic_int_set(&slot->sequence, (gint)(pos + 1));
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        }
+        pos = (guint)g_atomic_int_get(&queue->tail);
+    }
+}
+
+// Move published events into the sorted pending list. Producers do not
+// push in time order, so each event is inserted after any with an equal
+// or earlier time.
+static void drain(ParamEventQueue *queue) {
+    while (queue->num_pending < PARAM_EVENT_QUEUE_SIZE) {
+        guint pos = (guint)queue->head;
+        ParamEventSlot *slot = &queue->slots[pos & (PARAM_EVENT_QUEUE_SIZE - 1)];
+        gint diff = (gint)((guint)g_atomic_int_get(&slot->sequence) - (pos + 1));
+        if (diff < 0) break;
+
+        ParamEvent event = slot->event;
+        g_atomic_int_set(&slot->sequence, (gint)(pos + PARAM_EVENT_QUEUE_SIZE));
+        queue->head = (gint)(pos + 1);
+
+        int i = queue->num_pending++;
+        while (i > 0 && queue->pending[i - 1].sample_time > event.sample_time) {
+            queue->pending[i] = queue->pending[i - 1];
+            i--;
+        }
+        queue->pending[i] = event;
+    }
+}
+
+static void start_ramp(ParamLane *lane, const ParamEvent *event) {
+    lane->target = event->value;
+
+    if (event->shape == PARAM_RAMP_STEP || event->ramp_frames == 0) {
+        lane->value = event->value;
+        lane->remaining = 0;
+        return;
+    }
+
+    lane->remaining = event->ramp_frames;
+    if (event->shape == PARAM_RAMP_EXPONENTIAL && lane->value * event->value > 0.0f) {
+        lane->shape = PARAM_RAMP_EXPONENTIAL;
+        lane->step = powf(event->value / lane->value, 1.0f / event->ramp_frames);
+    } else {
+        lane->shape = PARAM_RAMP_LINEAR;
+        lane->step = (event->value - lane->value) / event->ramp_frames;
+    }
+}
+
+// Start of a block: pick up new events and release lanes whose store value
+// was changed by someone else, e.g. the user turning a dial
+void param_event_queue_begin(ParamEventQueue *queue, const float store_values[PARAM_COUNT]) {
+    drain(queue);
+    TRACE_COUNTER("pending param events", queue->num_pending);
+
+    for (int p = 0; p < PARAM_COUNT; p++) {
+        ParamLane *lane = &queue->lanes[p];
+        if (lane->engaged && lane->store_value != store_values[p]) {
+            lane->engaged = FALSE;
+            lane->remaining = 0;
+        }
+        if (!lane->engaged) {
+            lane->value = store_values[p];
+        }
+        lane->store_value = store_values[p];
+    }
+}
+
+// Apply every pending event due at or before `now`, the frame they take
+// effect on
+void param_event_queue_apply(ParamEventQueue *queue, guint64 now) {
+    int applied = 0;
+
+    while (applied < queue->num_pending && queue->pending[applied].sample_time <= now) {
+        const ParamEvent *event = &queue->pending[applied++];
+        if (event->sample_time < now) {
+            g_atomic_int_set(&queue->late_events, queue->late_events + 1);
+        }
+        if (event->tag) {
+            ParamEventApplied record = {
+                .tag = event->tag,
+                .sample_time = event->sample_time,
+                .applied_time = now
+            };
+            publish_ring_push(queue->applied, sizeof(ParamEventApplied), PARAM_EVENT_QUEUE_SIZE,
+                              &queue->applied_written, &record);
+        }
+
+        ParamLane *lane = &queue->lanes[event->param];
+        lane->engaged = TRUE;
+        start_ramp(lane, event);
+    }
+
+    if (applied > 0) {
+        queue->num_pending -= applied;
+        memmove(queue->pending, queue->pending + applied,
+                queue->num_pending * sizeof(ParamEvent));
+    }
+}
+
+// Frames from `now` that can render with one set of parameter endpoints:
+// up to the next event, the end of a ramp, or PARAM_RAMP_INTERVAL while a
+// parameter without per-sample interpolation is ramping
+size_t param_event_queue_span(ParamEventQueue *queue, guint64 now, size_t max_frames) {
+    size_t span = max_frames;
+
+    if (queue->num_pending > 0 && queue->pending[0].sample_time - now < span) {
+        span = (size_t)(queue->pending[0].sample_time - now);
+    }
+
+    for (int p = 0; p < PARAM_COUNT; p++) {
+        const ParamLane *lane = &queue->lanes[p];
+        if (lane->remaining == 0) continue;
+
+        span = MIN(span, (size_t)lane->remaining);
+
+        // Oscillators interpolate frequency and amplitude linearly per sample
+        bool interpolated = lane->shape == PARAM_RAMP_LINEAR &&
+                            (p == PARAM_FREQUENCY || p == PARAM_AMPLITUDE);
+        if (!interpolated) {
+            span = MIN(span, (size_t)PARAM_RAMP_INTERVAL);
+        }
+    }
+
+    return MAX(span, (size_t)1);
+}
+
+// Overrides store values with the engaged lanes
+void param_event_queue_values(const ParamEventQueue *queue, float values[PARAM_COUNT]) {
+    for (int p = 0; p < PARAM_COUNT; p++) {
+        if (queue->lanes[p].engaged) {
+            values[p] = queue->lanes[p].value;
+        }
+    }
+}
+
+void param_event_queue_advance(ParamEventQueue *queue, size_t frames) {
+    for (int p = 0; p < PARAM_COUNT; p++) {
+        ParamLane *lane = &queue->lanes[p];
+        if (lane->remaining == 0) continue;
+
+        if (frames >= lane->remaining) {
+            lane->value = lane->target;
+            lane->remaining = 0;
+        } else if (lane->shape == PARAM_RAMP_EXPONENTIAL) {
+            lane->value *= powf(lane->step, (float)frames);
+            lane->remaining -= frames;
+        } else {
+            lane->value += lane->step * frames;
+            lane->remaining -= frames;
+        }
+    }
+}
+
+// Any thread: tagged events applied after *cursor, which starts from
+// applied_written
+int param_event_queue_read_applied(ParamEventQueue *queue, gint *cursor,
+                                   ParamEventApplied *out, int max) {
+    if (!queue || !cursor || !out) return 0;
+    return publish_ring_read(queue->applied, sizeof(ParamEventApplied), PARAM_EVENT_QUEUE_SIZE,
+                             &queue->applied_written, cursor, out, max);
+}
+
+int param_event_queue_late_events(ParamEventQueue *queue) {
+    return queue ? g_atomic_int_get(&queue->late_events) : 0;
+}
+
+const char* param_id_name(ParamId param) {
+    switch (param) {
+        case PARAM_FREQUENCY:        return "frequency";
+        case PARAM_AMPLITUDE:        return "amplitude";
+        case PARAM_DUTY_CYCLE:       return "duty_cycle";
+        case PARAM_FILTER_CUTOFF:    return "filter_cutoff";
+        case PARAM_FILTER_RESONANCE: return "filter_resonance";
+        default:                     return "unknown";
+    }
+}
@@ -1,7 +1,17 @@
 #include "parameter_store.h"
+#include "logger.h"
 #include <stdlib.h>
 #include <math.h>
 
+// Points a fixed control's slot at its own source and destination
+static void set_slot(struct ParameterStore *store, int slot, ModDestination destination,
+                     float freq, float depth) {
+    store->mod.sources[slot].frequency = freq;
+    store->mod.routes[slot].source = slot;
+    store->mod.routes[slot].destination = destination;
+    store->mod.routes[slot].depth = depth;
+}
+
 struct ParameterStore* parameter_store_create(void) {
     struct ParameterStore *store = g_new0(struct ParameterStore, 1);
     
@@ -26,6 +36,24 @@ struct ParameterStore* parameter_store_create(void) {
     store->filter_cutoff_lfo_amount = 0.0f;
     store->filter_res_lfo_freq = 0.0f;
     store->filter_res_lfo_amount = 0.0f;
+
+    // Every channel starts as an exact copy of the main waveform
+    for (int ch = 0; ch < MAX_OUTPUT_CHANNELS; ch++) {
+        store->channels[ch].frequency = 0.0f;
+        store->channels[ch].freq_ratio = 1.0f;
+        store->channels[ch].phase_offset = 0.0f;
+        store->channels[ch].gain = 1.0f;
+    }
+
+    // The fixed controls start wired but idle, as sine LFOs
+    mod_matrix_init(&store->mod);
+    set_slot(store, MOD_SLOT_FM, MOD_DEST_PITCH, 0.0f, 0.0f);
+    set_slot(store, MOD_SLOT_AM, MOD_DEST_AMPLITUDE, 0.0f, 0.0f);
+    set_slot(store, MOD_SLOT_DCM, MOD_DEST_DUTY, 0.0f, 0.0f);
+    set_slot(store, MOD_SLOT_CUTOFF_LFO, MOD_DEST_CUTOFF, 0.0f, 0.0f);
+    set_slot(store, MOD_SLOT_RES_LFO, MOD_DEST_RESONANCE, 0.0f, 0.0f);
+
+    sweep_config_default(&store->sweep);
     
     return store;
 }
@@ -40,7 +68,7 @@ void parameter_store_destroy(struct ParameterStore *store) {
 
 void parameter_store_set_waveform(struct ParameterStore *store, WaveformType type) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting waveform type: %d\n", type);
+    LOG_DEBUG("Setting waveform type: %d", type);
     store->waveform = type;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -48,24 +76,24 @@ void parameter_store_set_waveform(struct ParameterStore *store, WaveformType typ
 
 void parameter_store_set_frequency(struct ParameterStore *store, float freq) {
     if (!store) {
-        g_print("Error: NULL parameter store in set_frequency\n");
+        LOG_ERROR("NULL parameter store in set_frequency");
         return;
     }
     
     // Validate frequency range
     if (freq < 0.0f || freq > 20000.0f) {
-        g_print("Warning: Frequency %.2f Hz out of valid range (0-20000 Hz)\n", freq);
+        LOG_WARN("Frequency %.2f Hz out of valid range (0-20000 Hz)", freq);
         freq = CLAMP(freq, 0.0f, 20000.0f);
     }
     
-    g_print("Setting frequency: %.2f Hz (store: %p)\n", freq, (void*)store);
+    LOG_DEBUG("Setting frequency: %.2f Hz (store: %p)", freq, (void*)store);
     if (g_mutex_trylock(&store->mutex)) {
         store->frequency = freq;
         g_cond_signal(&store->changed);
         g_mutex_unlock(&store->mutex);
-        g_print("Frequency updated successfully\n");
+        LOG_DEBUG("Frequency updated successfully");
     } else {
-        g_print("Warning: Could not acquire parameter store mutex for frequency update\n");
+        LOG_WARN("Could not acquire parameter store mutex for frequency update");
     }
 }
 
@@ -73,7 +101,7 @@ void parameter_store_set_frequency(struct ParameterStore *store, float freq) {
 
 void parameter_store_set_amplitude(struct ParameterStore *store, float amp) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting amplitude: %.2f\n", amp);
+    LOG_DEBUG("Setting amplitude: %.2f", amp);
     store->amplitude = amp;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -81,7 +109,7 @@ void parameter_store_set_amplitude(struct ParameterStore *store, float amp) {
 
 void parameter_store_set_duty_cycle(struct ParameterStore *store, float duty) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting duty cycle: %.2f%%\n", duty * 100.0f);
+    LOG_DEBUG("Setting duty cycle: %.2f%%", duty * 100.0f);
     store->duty_cycle = duty;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -89,25 +117,27 @@ void parameter_store_set_duty_cycle(struct ParameterStore *store, float duty) {
 
 void parameter_store_set_fm(struct ParameterStore *store, float freq, float depth) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting FM: freq=%.2f Hz, depth=%.2f\n", freq, depth);
+    LOG_DEBUG("Setting FM: freq=%.2f Hz, depth=%.2f", freq, depth);
     store->fm_frequency = freq;
     store->fm_depth = depth;
+    set_slot(store, MOD_SLOT_FM, MOD_DEST_PITCH, freq, depth);
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
 }
 
 void parameter_store_set_am(struct ParameterStore *store, float freq, float depth) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting AM: freq=%.2f Hz, depth=%.2f\n", freq, depth);
+    LOG_DEBUG("Setting AM: freq=%.2f Hz, depth=%.2f", freq, depth);
     store->am_frequency = freq;
     store->am_depth = depth;
+    set_slot(store, MOD_SLOT_AM, MOD_DEST_AMPLITUDE, freq, depth);
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
 }
 
 void parameter_store_set_preview_mode(struct ParameterStore *store, gboolean local) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting preview mode: %s\n", local ? "local" : "remote");
+    LOG_DEBUG("Setting preview mode: %s", local ? "local" : "remote");
     store->local_preview = local;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -115,7 +145,7 @@ void parameter_store_set_preview_mode(struct ParameterStore *store, gboolean loc
 
 void parameter_store_set_adc_mode(struct ParameterStore *store, gboolean use_adc) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting ADC mode: %s\n", use_adc ? "enabled" : "disabled");
+    LOG_DEBUG("Setting ADC mode: %s", use_adc ? "enabled" : "disabled");
     store->use_adc = use_adc;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -123,16 +153,17 @@ void parameter_store_set_adc_mode(struct ParameterStore *store, gboolean use_adc
 
 void parameter_store_set_dcm(struct ParameterStore *store, float freq, float depth) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting DCM: freq=%.2f Hz, depth=%.2f\n", freq, depth);
+    LOG_DEBUG("Setting DCM: freq=%.2f Hz, depth=%.2f", freq, depth);
     store->dcm_frequency = freq;
     store->dcm_depth = depth;
+    set_slot(store, MOD_SLOT_DCM, MOD_DEST_DUTY, freq, depth);
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
 }
 
 void parameter_store_set_filter_cutoff(struct ParameterStore *store, float cutoff) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting filter cutoff: %.2f Hz\n", cutoff);
+    LOG_DEBUG("Setting filter cutoff: %.2f Hz", cutoff);
     store->filter_cutoff = cutoff;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -140,7 +171,7 @@ void parameter_store_set_filter_cutoff(struct ParameterStore *store, float cutof
 
 void parameter_store_set_filter_resonance(struct ParameterStore *store, float resonance) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting filter resonance: %.2f\n", resonance);
+    LOG_DEBUG("Setting filter resonance: %.2f", resonance);
     store->filter_resonance = resonance;
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
@@ -148,18 +179,143 @@ void parameter_store_set_filter_resonance(struct ParameterStore *store, float re
 
 void parameter_store_set_filter_cutoff_lfo(struct ParameterStore *store, float freq, float amount) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting cutoff LFO: freq=%.2f Hz, amount=%.2f\n", freq, amount);
+    LOG_DEBUG("Setting cutoff LFO: freq=%.2f Hz, amount=%.2f", freq, amount);
     store->filter_cutoff_lfo_freq = freq;
     store->filter_cutoff_lfo_amount = amount;
+    set_slot(store, MOD_SLOT_CUTOFF_LFO, MOD_DEST_CUTOFF, freq, amount);
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
 }
 
 void parameter_store_set_filter_res_lfo(struct ParameterStore *store, float freq, float amount) {
     g_mutex_lock(&store->mutex);
-    g_print("Setting resonance LFO: freq=%.2f Hz, amount=%.2f\n", freq, amount);
+    LOG_DEBUG("Setting resonance LFO: freq=%.2f Hz, amount=%.2f", freq, amount);
     store->filter_res_lfo_freq = freq;
     store->filter_res_lfo_amount = amount;
+    set_slot(store, MOD_SLOT_RES_LFO, MOD_DEST_RESONANCE, freq, amount);
+    g_cond_signal(&store->changed);
+    g_mutex_unlock(&store->mutex);
+}
+
+void parameter_store_set_channel(struct ParameterStore *store, int channel,
+                                 float freq_ratio, float phase_offset, float gain) {
+    if (channel < 0 || channel >= MAX_OUTPUT_CHANNELS) {
+        LOG_WARN("Channel %d out of range", channel);
+        return;
+    }
+
+    // Keep the offset in [0, 360) so the render loop wraps at most once
+    phase_offset = fmodf(phase_offset, 360.0f);
+    if (phase_offset < 0.0f) phase_offset += 360.0f;
+
+    g_mutex_lock(&store->mutex);
+    LOG_DEBUG("Setting channel %d: ratio=%.3f, phase=%.1f deg, gain=%.2f",
+              channel + 1, freq_ratio, phase_offset, gain);
+    store->channels[channel].freq_ratio = fmaxf(freq_ratio, 0.0f);
+    store->channels[channel].phase_offset = phase_offset;
+    store->channels[channel].gain = gain;
+    g_cond_signal(&store->changed);
+    g_mutex_unlock(&store->mutex);
+}
+
+void parameter_store_set_channel_frequency(struct ParameterStore *store, int channel, float freq) {
+    if (channel < 0 || channel >= MAX_OUTPUT_CHANNELS) {
+        LOG_WARN("Channel %d out of range", channel);
+        return;
+    }
+
+    g_mutex_lock(&store->mutex);
+    LOG_DEBUG("Setting channel %d frequency: %.2f Hz%s", channel + 1, freq,
+              freq > 0.0f ? "" : " (follows main)");
+    store->channels[channel].frequency = CLAMP(freq, 0.0f, 20000.0f);
     g_cond_signal(&store->changed);
     g_mutex_unlock(&store->mutex);
 }
+
+gboolean parameter_store_get_channel(struct ParameterStore *store, int channel, ChannelConfig *config) {
+    if (!store || !config || channel < 0 || channel >= MAX_OUTPUT_CHANNELS) {
+        return FALSE;
+    }
+
+    g_mutex_lock(&store->mutex);
+    *config = store->channels[channel];
+    g_mutex_unlock(&store->mutex);
+    return TRUE;
+}
+
+void parameter_store_set_mod_source(struct ParameterStore *store, int index,
+                                    ModShape shape, float freq) {
+    if (index < 0 || index >= MOD_MAX_SOURCES || shape < 0 || shape >= MOD_SHAPE_COUNT) {
+        LOG_WARN("Modulation source %d out of range", index);
+        return;
+    }
+
+    g_mutex_lock(&store->mutex);
+    LOG_DEBUG("Setting mod source %d: shape=%s, freq=%.2f Hz",
+              index + 1, mod_shape_name(shape), freq);
+    store->mod.sources[index].shape = shape;
+    store->mod.sources[index].frequency = fmaxf(freq, 0.0f);
+    g_cond_signal(&store->changed);
+    g_mutex_unlock(&store->mutex);
+}
+
+// A negative source clears the route
+void parameter_store_set_mod_route(struct ParameterStore *store, int index,
+                                   int source, ModDestination destination, float depth) {
+    if (index < 0 || index >= MOD_MAX_ROUTES || source >= MOD_MAX_SOURCES ||
+        destination < 0 || destination >= MOD_DEST_COUNT) {
+        LOG_WARN("Modulation route %d out of range", index);
+        return;
+    }
+
+    g_mutex_lock(&store->mutex);
+    if (source < 0) {
+        LOG_DEBUG("Clearing mod route %d", index + 1);
+    } else {
+        LOG_DEBUG("Setting mod route %d: source %d -> %s, depth=%.2f",
+                  index + 1, source + 1, mod_destination_name(destination), depth);
+    }
+    store->mod.routes[index].source = source < 0 ? -1 : source;
+    store->mod.routes[index].destination = destination;
+    store->mod.routes[index].depth = depth;
+    g_cond_signal(&store->changed);
+    g_mutex_unlock(&store->mutex);
+}
+
+gboolean parameter_store_get_mod_matrix(struct ParameterStore *store, ModMatrix *matrix) {
+    if (!store || !matrix) {
+        return FALSE;
+    }
+
+    g_mutex_lock(&store->mutex);
+    *matrix = store->mod;
+    g_mutex_unlock(&store->mutex);
+    return TRUE;
+}
+
+// Takes effect as a fresh sweep from the start, on the next block
+void parameter_store_set_sweep(struct ParameterStore *store, const SweepConfig *config) {
+    if (!store || !config) {
+        LOG_ERROR("Invalid sweep settings");
+        return;
+    }
+
+    g_mutex_lock(&store->mutex);
+    store->sweep = *config;
+    store->sweep_serial++;
+    LOG_DEBUG("Setting sweep: %s, %.1f-%.1f Hz", sweep_type_name(config->type),
+              config->start_freq, config->end_freq);
+    g_cond_signal(&store->changed);
+    g_mutex_unlock(&store->mutex);
+}
+
+gboolean parameter_store_get_sweep(struct ParameterStore *store, SweepConfig *config) {
+    if (!store || !config) {
+        return FALSE;
+    }
+
+    g_mutex_lock(&store->mutex);
+    *config = store->sweep;
+    g_mutex_unlock(&store->mutex);
+    return TRUE;
+}
@@ -0,0 +1,258 @@
+#include "phosphor.h"
+#include "logger.h"
+#include "rt_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PHOSPHOR_FLOOR_BITS 0x3b000000   // 1/512 as float bits, fainter than the first palette step
+
+// Brightness follows the square root of the hit count so single hits are
+// visible; green comes up first and saturates towards white. Stored
+// premultiplied, with zero hits fully transparent so the graticule shows.
+static void build_palette(Phosphor *phosphor) {
+    for (int i = 0; i < 256; i++) {
+        float s = sqrtf(i / 255.0f);
+        float green = fminf(s * 1.5f, 1.0f);
+        float white = fmaxf(s * 2.5f - 1.5f, 0.0f);
+
+        guint32 a = (guint32)lroundf(green * 255.0f);
+        guint32 rb = (guint32)lroundf(white * 255.0f);
+        phosphor->palette[i] = (a << 24) | (rb << 16) | (a << 8) | rb;
+    }
+}
+
+Phosphor* phosphor_create(void) {
+    Phosphor *phosphor = g_new0(Phosphor, 1);
+    phosphor->gain = 1.0f;
+    phosphor->persistence = PHOSPHOR_DEFAULT_PERSISTENCE_S;
+    circular_buffer_init(&phosphor->feed, PHOSPHOR_FEED_FRAMES, 2);
+    phosphor->history = rt_pool_new(float, PHOSPHOR_HISTORY_FRAMES * 2);
+    build_palette(phosphor);
+    return phosphor;
+}
+
+void phosphor_destroy(Phosphor *phosphor) {
+    if (!phosphor) return;
+    free(phosphor->intensity);
+    circular_buffer_destroy(&phosphor->feed);
+    rt_pool_free(phosphor->history);
+    g_free(phosphor);
+}
+
+// UI thread, like everything here but phosphor_feed. Follows the display;
+// a new size starts from a dark screen. The grid is sized by the window,
+// up to 32 MB, so it comes from the heap rather than the memory pool, and
+// is only reallocated when the window grows past every earlier size.
+gboolean phosphor_set_size(Phosphor *phosphor, int width, int height) {
+    if (!phosphor || width < 1 || height < 1 ||
+        width > PHOSPHOR_MAX_WIDTH || height > PHOSPHOR_MAX_HEIGHT) {
+        return FALSE;
+    }
+
+    if (phosphor->intensity && width == phosphor->width && height == phosphor->height) {
+        return TRUE;
+    }
+
+    int row_stride = (width + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+    size_t bytes = (size_t)row_stride * height * sizeof(float);
+    if (bytes > phosphor->intensity_bytes) {
+        void *memory = NULL;
+        if (posix_memalign(&memory, 64, bytes) != 0) {
+            LOG_ERROR("Phosphor: Failed to allocate a %dx%d grid", width, height);
+            return FALSE;
+        }
+        free(phosphor->intensity);
+        phosphor->intensity = memory;
+        phosphor->intensity_bytes = bytes;
+    }
+
+    memset(phosphor->intensity, 0, bytes);
+    phosphor->gain = 1.0f;
+    phosphor->width = width;
+    phosphor->height = height;
+    phosphor->row_stride = row_stride;
+    phosphor->serial++;
+    return TRUE;
+}
+
+void phosphor_set_persistence(Phosphor *phosphor, float seconds) {
+    if (!phosphor || seconds <= 0.0f) return;
+    phosphor->persistence = seconds;
+}
+
+void phosphor_clear(Phosphor *phosphor) {
+    if (!phosphor) return;
+    if (phosphor->intensity) {
+        memset(phosphor->intensity, 0, (size_t)phosphor->row_stride * phosphor->height * sizeof(float));
+    }
+    phosphor->gain = 1.0f;
+    phosphor->serial++;
+    phosphor->pending_frames = 0;
+    phosphor->history_frames = 0;
+    circular_buffer_clear(&phosphor->feed);
+}
+
+// Folds the gain into the grid, a few times per persistence period at
+// most. Faded cells are flushed to zero before they turn denormal. Cells
+// are never negative, so their bits order like integers and the test is a
+// subtract and shift; a float compare on 8 lanes is split per lane without
+// AVX.
+static void rescale(Phosphor *phosphor) {
+    const v8sf scale = v8sf_set1(phosphor->gain);
+    const v8si floor_bits = v8si_set1(PHOSPHOR_FLOOR_BITS);
+    size_t count = (size_t)phosphor->row_stride * phosphor->height;
+    float *cell = phosphor->intensity;
+
+    for (size_t i = 0; i < count; i += SIMD_LANES) {
+        v8si bits = (v8si)(v8sf_load(cell + i) * scale);
+        v8si below = (bits - floor_bits) >> 31;
+        v8sf_store(cell + i, (v8sf)(bits & ~below));
+    }
+    phosphor->gain = 1.0f;
+}
+
+// Latest rising edge that leaves a third of the window before it, the same
+// place the trace marks its trigger; free-runs on the newest frames if none
+static size_t find_trigger(const float *pairs, size_t frames, size_t window, float level) {
+    size_t pre = window / 3;
+    for (size_t i = frames - (window - pre); i > pre; i--) {
+        if (pairs[(i - 1) * 2] < level && pairs[i * 2] >= level) {
+            return i - pre;
+        }
+    }
+    return frames - window;
+}
+
+// Sample rows are worked out eight at a time; the hits are then scattered
+// one by one, filling the rows a step jumps over so fast edges leave a
+// continuous line. Clipped samples pile up on the pane edge, and NaNs on
+// the top one.
+static void plot(Phosphor *phosphor, const float *pairs, size_t frames) {
+    const float x_step = (float)phosphor->width / frames;
+    const v8sf center = v8sf_set1(phosphor->height * 0.5f + 0.5f);
+    const v8sf gain = v8sf_set1(phosphor->height * 0.25f);
+    const float last_x = phosphor->width - 1;
+    const float bottom = phosphor->height - 1;
+    const float hit = 1.0f / phosphor->gain;
+    float *grid = phosphor->intensity;
+    int stride = phosphor->row_stride;
+    int last_column = -1;
+    int last_row = 0;
+
+    for (size_t i = 0; i < frames; i += SIMD_LANES) {
+        size_t count = MIN(frames - i, (size_t)SIMD_LANES);
+        float tail[SIMD_LANES * 2] = {0};
+        const float *source = pairs + i * 2;
+        if (count < SIMD_LANES) {
+            memcpy(tail, source, count * 2 * sizeof(float));
+            source = tail;
+        }
+
+        v8sf left, right;
+        v8sf_deinterleave(v8sf_load(source), v8sf_load(source + SIMD_LANES), &left, &right);
+        v8sf y = center - left * gain;
+
+        for (size_t lane = 0; lane < count; lane++) {
+            // Clamped while still float: out of range casts are undefined
+            int column = (int)fminf((i + lane) * x_step, last_x);
+            int row = y[lane] > 0.0f ? (int)fminf(y[lane], bottom) : 0;
+            float *cell = grid + column;
+
+            if (last_column >= 0 && column - last_column <= 1 && abs(row - last_row) > 1) {
+                int step = row > last_row ? 1 : -1;
+                for (int r = last_row + step; r != row; r += step) {
+                    cell[r * stride] += hit;
+                }
+            }
+            cell[row * stride] += hit;
+            last_column = column;
+            last_row = row;
+        }
+    }
+}
+
+// Generator thread, with the frames of each block it rendered. A copy into
+// the feed; frames the UI has no room for are dropped.
+void phosphor_feed(Phosphor *phosphor, float *pairs, size_t frames) {
+    if (!phosphor || !pairs || frames == 0) return;
+    circular_buffer_write(&phosphor->feed, pairs, frames);
+}
+
+// An acquisition is half the history, rearmed once a quarter of that has
+// arrived. The grid fades by the time that passed since the last one, so
+// persistence does not depend on the block size.
+static void acquire_window(Phosphor *phosphor, float sample_rate) {
+    size_t frames = phosphor->history_frames;
+    size_t window = frames / 2;
+    if (window < SIMD_LANES || phosphor->pending_frames < window / PHOSPHOR_HOLDOFF_DIVISOR) {
+        return;
+    }
+
+    if (phosphor->intensity) {
+        float elapsed = phosphor->pending_frames / sample_rate;
+        phosphor->gain *= expf(-elapsed / phosphor->persistence);
+        if (phosphor->gain < PHOSPHOR_RENORMALIZE_GAIN) {
+            rescale(phosphor);
+        }
+
+        size_t start = find_trigger(phosphor->history, frames, window, phosphor->trigger_level);
+        plot(phosphor, phosphor->history + start * 2, window);
+        phosphor->acquisitions++;
+        phosphor->serial++;
+    }
+    phosphor->pending_frames = 0;
+}
+
+// Before each render: works through what the generator fed since the last
+// one, a holdoff's worth of frames at a time so no acquisition is skipped
+void phosphor_acquire(Phosphor *phosphor, float sample_rate) {
+    if (!phosphor || sample_rate <= 0.0f) return;
+
+    const size_t capacity = PHOSPHOR_HISTORY_FRAMES;
+    const size_t chunk = capacity / 2 / PHOSPHOR_HOLDOFF_DIVISOR;
+    float *history = phosphor->history;
+    for (;;) {
+        if (phosphor->history_frames + chunk > capacity) {
+            size_t keep = capacity - chunk;
+            memmove(history, history + (phosphor->history_frames - keep) * 2,
+                    keep * 2 * sizeof(float));
+            phosphor->history_frames = keep;
+        }
+        size_t got = circular_buffer_drain(&phosphor->feed,
+                                           history + phosphor->history_frames * 2, chunk);
+        if (got == 0) break;
+        phosphor->history_frames += got;
+        phosphor->pending_frames += got;
+        acquire_window(phosphor, sample_rate);
+    }
+}
+
+// Maps the grid through the palette into a cairo ARGB32 image of the same
+// size. Returns FALSE if the grid does not match, e.g. mid-resize.
+gboolean phosphor_render(Phosphor *phosphor, guint8 *pixels, int stride, int width, int height) {
+    if (!phosphor || !pixels) return FALSE;
+
+    if (!phosphor->intensity || width != phosphor->width || height != phosphor->height) {
+        return FALSE;
+    }
+
+    const v8sf scale = v8sf_set1(phosphor->gain * 255.0f / PHOSPHOR_SATURATION);
+    const v8sf top = v8sf_set1(255.0f);
+    for (int y = 0; y < height; y++) {
+        const float *row = phosphor->intensity + (size_t)y * phosphor->row_stride;
+        guint32 *out = (guint32 *)(pixels + (size_t)y * stride);
+
+        // Rows are padded to whole vectors; only the visible lanes are written
+        for (int x = 0; x < width; x += SIMD_LANES) {
+            // Clamped before the conversion, which is undefined out of range
+            v8si index = __builtin_convertvector(v8sf_min(v8sf_load(row + x) * scale, top), v8si);
+            int count = MIN(width - x, SIMD_LANES);
+            for (int lane = 0; lane < count; lane++) {
+                out[x + lane] = phosphor->palette[index[lane]];
+            }
+        }
+    }
+
+    return TRUE;
+}
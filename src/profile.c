@@ -0,0 +1,160 @@
+#include "profile.h"
+#include "logger.h"
+#include <string.h>
+
+static const char *stage_names[PROFILE_STAGE_COUNT] = {
+    "block", "oscillator", "modulation", "oscillator+filter", "ring write", "scope copy",
+    "fft", "trace", "spectrum", "rasterize cairo", "rasterize gl", "frame"
+};
+
+static ProfileThread *threads[PROFILE_MAX_THREADS];
+
+// Ticks and time at the first sample, to convert ticks on report
+static gint64 reference_us;
+static guint64 reference_ticks;
+static gint have_reference;
+
+static void release_thread(gpointer data);
+static GPrivate thread_histograms = G_PRIVATE_INIT(release_thread);
+
+// Values below PROFILE_SUB_BINS get a bin each; above, every power of two
+// is split into PROFILE_SUB_BINS equal steps
+static int bin_index(guint64 ticks) {
+    if (ticks < PROFILE_SUB_BINS) return (int)ticks;
+    int msb = 63 - __builtin_clzll(ticks);
+    int octave = msb - 2;
+    int sub = (int)(ticks >> (msb - 3)) - PROFILE_SUB_BINS;
+    return MIN(octave * PROFILE_SUB_BINS + sub, PROFILE_BINS - 1);
+}
+
+// Middle of the bin's range
+static double bin_value(int index) {
+    int octave = index / PROFILE_SUB_BINS;
+    int sub = index % PROFILE_SUB_BINS;
+    if (octave == 0) return sub;
+    double width = (double)(1ull << (octave - 1));
+    return (PROFILE_SUB_BINS + sub) * width + width / 2.0;
+}
+
+static ProfileThread* claim_thread(void) {
+    for (int i = 0; i < PROFILE_MAX_THREADS; i++) {
+        ProfileThread *thread = g_atomic_pointer_get(&threads[i]);
+        if (thread) {
+            if (g_atomic_int_compare_and_exchange(&thread->owned, 0, 1)) return thread;
+            continue;
+        }
+
+        thread = g_try_new0(ProfileThread, 1);
+        if (!thread) return NULL;
+        thread->owned = 1;
+        if (g_atomic_pointer_compare_and_exchange(&threads[i], NULL, thread)) return thread;
+        g_free(thread);
+    }
+    return NULL;
+}
+
+// The samples stay and are taken over by the next thread claiming them
+static void release_thread(gpointer data) {
+    ProfileThread *thread = (ProfileThread *)data;
+    g_atomic_int_set(&thread->owned, 0);
+}
+
+// Claims this thread's histograms up front, so a realtime thread does not
+// allocate on its first sample
+void profile_thread_init(void) {
+    if (!g_private_get(&thread_histograms)) {
+        ProfileThread *thread = claim_thread();
+        if (thread) g_private_set(&thread_histograms, thread);
+    }
+}
+
+// Any thread, no locks. A thread that skipped profile_thread_init
+// allocates its histograms on the first sample.
+void profile_record(ProfileStage stage, guint64 ticks) {
+    if ((unsigned)stage >= PROFILE_STAGE_COUNT) return;
+
+    ProfileThread *thread = g_private_get(&thread_histograms);
+    if (!thread) {
+        profile_thread_init();
+        thread = g_private_get(&thread_histograms);
+        if (!thread) return;
+    }
+    if (!g_atomic_int_get(&have_reference) &&
+        g_atomic_int_compare_and_exchange(&have_reference, 0, 1)) {
+        reference_ticks = profile_ticks();
+        reference_us = g_get_monotonic_time();
+        g_atomic_int_set(&have_reference, 2);
+    }
+
+    ProfileHistogram *histogram = &thread->stages[stage];
+    histogram->bins[bin_index(ticks)]++;
+    histogram->count++;
+    histogram->total += ticks;
+    if (ticks > histogram->max) histogram->max = ticks;
+}
+
+static double percentile(const guint32 *bins, guint64 count, double fraction) {
+    guint64 rank = (guint64)(fraction * (count - 1)) + 1;
+    guint64 seen = 0;
+    for (int i = 0; i < PROFILE_BINS; i++) {
+        seen += bins[i];
+        if (seen >= rank) return bin_value(i);
+    }
+    return bin_value(PROFILE_BINS - 1);
+}
+
+// Merges every thread's histograms. FALSE until there is a sample and
+// enough time has passed to calibrate the tick rate.
+gboolean profile_report(ProfileReport *report) {
+    memset(report, 0, sizeof(*report));
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        report->stages[s].name = stage_names[s];
+    }
+    if (g_atomic_int_get(&have_reference) != 2) return FALSE;
+
+    gint64 elapsed_us = g_get_monotonic_time() - reference_us;
+    guint64 elapsed_ticks = profile_ticks() - reference_ticks;
+    if (elapsed_us < 1000 || elapsed_ticks == 0) return FALSE;
+    double us_per_tick = (double)elapsed_us / elapsed_ticks;
+
+    guint32 bins[PROFILE_BINS];
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        ProfileStageReport *stage = &report->stages[s];
+        guint64 total = 0, max = 0;
+        memset(bins, 0, sizeof(bins));
+
+        for (int i = 0; i < PROFILE_MAX_THREADS; i++) {
+            const ProfileThread *thread = g_atomic_pointer_get(&threads[i]);
+            if (!thread) break;
+            const ProfileHistogram *histogram = &thread->stages[s];
+            for (int b = 0; b < PROFILE_BINS; b++) {
+                bins[b] += histogram->bins[b];
+                stage->count += histogram->bins[b];
+            }
+            total += histogram->total;
+            max = MAX(max, histogram->max);
+        }
+        if (stage->count == 0) continue;
+
+        stage->mean_us = total * us_per_tick / stage->count;
+        stage->p50_us = percentile(bins, stage->count, 0.50) * us_per_tick;
+        stage->p99_us = percentile(bins, stage->count, 0.99) * us_per_tick;
+        stage->max_us = max * us_per_tick;
+    }
+    return TRUE;
+}
+
+// Logs a line per stage that has samples; nothing in builds without
+// WAVEFORM_PROFILE
+void profile_dump(void) {
+    ProfileReport report;
+    if (!profile_report(&report)) return;
+
+    LOG_INFO("Profile (us):       count      mean       p50       p99       max");
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        const ProfileStageReport *stage = &report.stages[s];
+        if (stage->count == 0) continue;
+        LOG_INFO("  %-12s %12" G_GUINT64_FORMAT " %9.2f %9.2f %9.2f %9.2f", stage->name,
+                 stage->count, stage->mean_us, stage->p50_us, stage->p99_us, stage->max_us);
+    }
+}
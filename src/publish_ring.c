@@ -0,0 +1,55 @@
+#include "publish_ring.h"
+#include <string.h>
+
+static inline const char* slot(const void *records, size_t record_size, int size, gint n) {
+    return (const char *)records + (size_t)(n & (size - 1)) * record_size;
+}
+
+// Writer only
+void publish_ring_push(void *records, size_t record_size, int size, gint *written,
+                       const void *record) {
+    gint n = *written;
+    memcpy((char *)slot(records, record_size, size, n), record, record_size);
+    g_atomic_int_set(written, n + 1);
+}
+
+// Copies up to `max` records after *cursor and advances it past them
+int publish_ring_read(const void *records, size_t record_size, int size, const gint *written,
+                      gint *cursor, void *out, int max) {
+    gint last = g_atomic_int_get((gint *)written);
+    if (last - *cursor > size - 1) {
+        *cursor = last - (size - 1);
+    }
+
+    gint first = *cursor;
+    int count = 0;
+    while (*cursor != last && count < max) {
+        memcpy((char *)out + (size_t)count * record_size,
+               slot(records, record_size, size, *cursor), record_size);
+        count++;
+        (*cursor)++;
+    }
+
+    // The copies must not be reordered past the second look at the count
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    gint oldest = g_atomic_int_get((gint *)written) - (size - 1);
+    int torn = MIN(count, MAX(oldest - first, 0));
+    if (torn > 0) {
+        memmove(out, (char *)out + (size_t)torn * record_size, (size_t)(count - torn) * record_size);
+        count -= torn;
+    }
+    return count;
+}
+
+// The newest record; FALSE until there is one
+gboolean publish_ring_latest(const void *records, size_t record_size, int size,
+                             const gint *written, void *out) {
+    gint last;
+    do {
+        last = g_atomic_int_get((gint *)written);
+        if (last == 0) return FALSE;
+        memcpy(out, slot(records, record_size, size, last - 1), record_size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (g_atomic_int_get((gint *)written) - last >= size - 1);
+    return TRUE;
+}
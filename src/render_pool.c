@@ -0,0 +1,206 @@
+#include "render_pool.h"
+#include "logger.h"
+#include "trace.h"
+#include "rt_thread.h"
+#include "rt_pool.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static void render_instance(RenderPool *pool, RenderInstance *inst) {
+    OscillatorParams params = *pool->base;
+    if (inst->config.frequency > 0.0f) {
+        params.frequency = params.frequency_end = inst->config.frequency;
+    } else {
+        params.frequency *= inst->config.freq_ratio;
+        params.frequency_end *= inst->config.freq_ratio;
+    }
+    params.amplitude *= inst->config.gain;
+    params.amplitude_end *= inst->config.gain;
+    params.phase_offset = inst->config.phase_offset * (float)(M_PI / 180.0);
+    oscillator_render(&inst->osc, &params, inst->block, pool->frames,
+                      pool->sample_rate, pool->phase_scale);
+}
+
+static void render_range(RenderPool *pool, RenderRange *range) {
+    gint index;
+    while ((index = g_atomic_int_add(&range->next, 1)) < range->end) {
+        render_instance(pool, &pool->instances[index]);
+    }
+}
+
+// Own range first, then steal from the others in a fixed rotation
+static void render_participant(RenderPool *pool, int self) {
+    TRACE_BEGIN("render share");
+    for (int i = 0; i < pool->num_threads; i++) {
+        render_range(pool, &pool->ranges[(self + i) % pool->num_threads]);
+    }
+    TRACE_END("render share");
+
+    if (g_atomic_int_dec_and_test(&pool->pending)) {
+        g_mutex_lock(&pool->mutex);
+        g_cond_signal(&pool->done);
+        g_mutex_unlock(&pool->mutex);
+    }
+}
+
+static gpointer render_worker_func(gpointer data) {
+    RenderPool *pool = (RenderPool *)data;
+    trace_thread_name("render worker");
+    PROFILE_THREAD_INIT();
+    // The generator waits on these, so they run at its priority
+    rt_thread_setup(RT_THREAD_GENERATOR, "render worker");
+
+    // Worker index is its slot in the workers array; 0 is the caller
+    g_mutex_lock(&pool->mutex);
+    int self = 1;
+    while (self < pool->num_threads && pool->workers[self] != g_thread_self()) {
+        self++;
+    }
+    g_mutex_unlock(&pool->mutex);
+
+    // Start from the creation generation, not the current one: a job may
+    // already have been posted before this thread first ran
+    guint seen = 0;
+
+    while (TRUE) {
+        g_mutex_lock(&pool->mutex);
+        while (pool->generation == seen && !pool->quit) {
+            g_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->quit) {
+            g_mutex_unlock(&pool->mutex);
+            break;
+        }
+        seen = pool->generation;
+        g_mutex_unlock(&pool->mutex);
+
+        render_participant(pool, self);
+    }
+    return NULL;
+}
+
+RenderPool* render_pool_create(size_t capacity, int num_threads) {
+    if (capacity == 0) {
+        LOG_ERROR("Render pool: Invalid capacity");
+        return NULL;
+    }
+    if (num_threads <= 0) {
+        num_threads = g_get_num_processors();
+    }
+    num_threads = CLAMP(num_threads, 1, RENDER_POOL_MAX_THREADS);
+
+    RenderPool *pool = g_new0(RenderPool, 1);
+    pool->instances = rt_pool_new(RenderInstance, capacity);
+    if (!pool->instances) {
+        LOG_ERROR("Render pool: Failed to allocate %zu instances", capacity);
+        g_free(pool);
+        return NULL;
+    }
+    pool->capacity = capacity;
+    for (size_t i = 0; i < capacity; i++) {
+        pool->instances[i].config.freq_ratio = 1.0f;
+        pool->instances[i].config.gain = 1.0f;
+        pool->instances[i].route = -1;
+    }
+    render_pool_reset(pool);
+
+    g_mutex_init(&pool->mutex);
+    g_cond_init(&pool->start);
+    g_cond_init(&pool->done);
+    pool->num_threads = num_threads;
+
+    // Hold the lock so workers see their slots filled in
+    g_mutex_lock(&pool->mutex);
+    for (int i = 1; i < num_threads; i++) {
+        pool->workers[i] = g_thread_new("render_worker", render_worker_func, pool);
+    }
+    g_mutex_unlock(&pool->mutex);
+
+    LOG_INFO("Render pool: %zu instances, %d threads", capacity, num_threads);
+    return pool;
+}
+
+void render_pool_destroy(RenderPool *pool) {
+    if (!pool) return;
+
+    g_mutex_lock(&pool->mutex);
+    pool->quit = TRUE;
+    g_cond_broadcast(&pool->start);
+    g_mutex_unlock(&pool->mutex);
+
+    for (int i = 1; i < pool->num_threads; i++) {
+        g_thread_join(pool->workers[i]);
+    }
+
+    g_mutex_clear(&pool->mutex);
+    g_cond_clear(&pool->start);
+    g_cond_clear(&pool->done);
+    rt_pool_free(pool->instances);
+    g_free(pool);
+}
+
+// Restart every instance from phase zero with its own noise seed, so the
+// output depends only on the parameters, never on thread scheduling
+void render_pool_reset(RenderPool *pool) {
+    for (size_t i = 0; i < pool->capacity; i++) {
+        oscillator_seed(&pool->instances[i].osc, (guint32)i + 1);
+        oscillator_reset(&pool->instances[i].osc);
+    }
+}
+
+// Renders instances [0, count) and mixes them into `channels` interleaved
+// outputs. Mixing runs on the caller in instance order, so the result is
+// bit-identical whatever the thread count.
+void render_pool_render(RenderPool *pool, size_t count, const OscillatorParams *base,
+                        float *out, int channels, size_t frames,
+                        float sample_rate, float phase_scale) {
+    count = MIN(count, pool->capacity);
+    frames = MIN(frames, (size_t)MAX_BLOCK_SIZE);
+
+    pool->base = base;
+    pool->frames = frames;
+    pool->sample_rate = sample_rate;
+    pool->phase_scale = phase_scale;
+
+    int participants = (count >= RENDER_POOL_MIN_PARALLEL) ? pool->num_threads : 1;
+    for (int i = 0; i < pool->num_threads; i++) {
+        // Split evenly; ranges beyond the participants stay empty
+        size_t start = (i < participants) ? count * i / participants : count;
+        size_t end = (i < participants) ? count * (i + 1) / participants : count;
+        pool->ranges[i].next = (gint)start;
+        pool->ranges[i].end = (gint)end;
+    }
+
+    if (participants > 1) {
+        g_atomic_int_set(&pool->pending, pool->num_threads);
+        g_mutex_lock(&pool->mutex);
+        pool->generation++;
+        g_cond_broadcast(&pool->start);
+        g_mutex_unlock(&pool->mutex);
+
+        render_participant(pool, 0);
+
+        g_mutex_lock(&pool->mutex);
+        while (g_atomic_int_get(&pool->pending) > 0) {
+            g_cond_wait(&pool->done, &pool->mutex);
+        }
+        g_mutex_unlock(&pool->mutex);
+    } else {
+        g_atomic_int_set(&pool->pending, 1);
+        render_participant(pool, 0);
+    }
+
+    // Mix and route
+    memset(out, 0, frames * channels * sizeof(float));
+    for (size_t k = 0; k < count; k++) {
+        const RenderInstance *inst = &pool->instances[k];
+        if (inst->route < 0 || inst->route >= channels) continue;
+
+        float *dst = out + inst->route;
+        for (size_t i = 0; i < frames; i++) {
+            dst[i * channels] += inst->block[i];
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#define _GNU_SOURCE
+#include "rt_pool.h"
+#include "rt_thread.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static RtPool pool;
+
+// Main thread, after rt_configure and before any owner is created.
+// Without a pool, or once it is full, allocations come from the heap.
+bool rt_pool_init(size_t bytes, bool huge_pages) {
+    if (pool.mapped) return true;
+    if (bytes == 0 || bytes > G_MAXINT) return false;
+
+    void *memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+        size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        memory = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            bytes = rounded;
+            pool.huge_pages = true;
+        }
+    }
+#endif
+    if (memory == MAP_FAILED) {
+        memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            LOG_ERROR("Memory pool: Failed to map %zu KB", bytes / 1024);
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        // No huge pages reserved: transparent ones, if the kernel has them
+        if (huge_pages) {
+            madvise(memory, bytes, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    pool.base = memory;
+    pool.size = bytes;
+    pool.used = 0;
+    pool.mapped = true;
+    rt_prefault(memory, bytes);
+    return true;
+}
+
+// After every owner has freed its buffers
+void rt_pool_shutdown(void) {
+    if (!pool.mapped) return;
+    munmap(pool.base, pool.size);
+    memset(&pool, 0, sizeof(pool));
+}
+
+// Any thread. Zeroed and RT_POOL_ALIGNMENT aligned; from the heap when
+// the pool is missing or full, and then neither prefaulted nor locked.
+void* rt_pool_alloc(size_t bytes) {
+    size_t rounded = (MAX(bytes, 1) + RT_POOL_ALIGNMENT - 1) & ~(size_t)(RT_POOL_ALIGNMENT - 1);
+
+    if (pool.mapped) {
+        gint used = g_atomic_int_get(&pool.used);
+        while ((size_t)used + rounded <= pool.size) {
+            if (g_atomic_int_compare_and_exchange(&pool.used, used, used + (gint)rounded)) {
+                return pool.base + used;
+            }
+            used = g_atomic_int_get(&pool.used);
+        }
+        LOG_WARN("Memory pool: Full, %zu bytes come from the heap", bytes);
+    }
+
+    void *memory = NULL;
+    if (posix_memalign(&memory, RT_POOL_ALIGNMENT, rounded) != 0) return NULL;
+    return memset(memory, 0, rounded);
+}
+
+// Pool memory stays reserved until shutdown, since owners live as long as
+// the program; heap fallbacks are freed
+void rt_pool_free(void *memory) {
+    char *bytes = (char *)memory;
+    if (!bytes) return;
+    if (pool.mapped && bytes >= pool.base && bytes < pool.base + pool.size) return;
+    free(memory);
+}
+
+void rt_pool_report(void) {
+    if (!pool.mapped) return;
+    LOG_INFO("Memory pool: %d of %zu KB used%s", g_atomic_int_get(&pool.used) / 1024,
+             pool.size / 1024, pool.huge_pages ? ", on huge pages" : "");
+}
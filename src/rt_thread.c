@@ -0,0 +1,412 @@
+#define _GNU_SOURCE
+#include "rt_thread.h"
+#include "logger.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <gio/gio.h>
+#include <sys/syscall.h>
+#endif
+#ifdef __APPLE__
+#include <pthread/qos.h>
+#endif
+#ifdef __SSE2__
+#include <pmmintrin.h>
+#endif
+
+#define RTKIT_SERVICE "org.freedesktop.RealtimeKit1"
+#define RTKIT_PATH "/org/freedesktop/RealtimeKit1"
+#define REASON_LENGTH 128
+#define ADOPT_SLOTS 8
+#define ADOPT_POLL_US G_USEC_PER_SEC    // Backstop for a wakeup the callback could not send
+
+// A host thread waiting for the helper to promote it. Only its kernel
+// thread id is kept: the host may end the thread before the helper gets
+// to it, and a pthread_t of an exited thread must not be used.
+typedef struct {
+    gint state;                 // ADOPT_FREE, ADOPT_FILLING or ADOPT_READY
+    RtThreadRole role;
+    const char *name;
+    guint64 tid;
+} AdoptRequest;
+
+enum { ADOPT_FREE, ADOPT_FILLING, ADOPT_READY };
+
+// Zero priority until rt_configure: threads then only flush denormals
+static RtConfig rt_config;
+
+// Per thread: 1 once set up, 2 if it also runs realtime
+static GPrivate thread_state;
+
+static AdoptRequest adopt_requests[ADOPT_SLOTS];
+static GThread *adopt_thread;
+static GMutex adopt_mutex;
+static GCond adopt_cond;
+static gboolean adopt_running;
+
+static gpointer adopt_thread_func(gpointer data);
+
+void rt_config_init(RtConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->priority = RT_DEFAULT_PRIORITY;
+    config->lock_memory = true;
+}
+
+// CPU numbers and ranges, e.g. "2,3" or "4-7"
+bool rt_parse_cpus(const char *list, RtConfig *config) {
+    gchar **parts = g_strsplit(list, ",", -1);
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    bool ok = true;
+
+    config->num_cpus = 0;
+    for (guint i = 0; ok && parts[i]; i++) {
+        char *part = g_strstrip(parts[i]);
+        char *end;
+        long first = strtol(part, &end, 10);
+        long last = first;
+        if (end != part && *end == '-') {
+            char *range = end + 1;
+            last = strtol(range, &end, 10);
+            if (end == range) end = part;
+        }
+        if (end == part || *end != '\0' || first < 0 || last < first || last >= num_cpus ||
+            config->num_cpus + (last - first) >= RT_MAX_CPUS) {
+            ok = false;
+            break;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            config->cpus[config->num_cpus++] = (int)cpu;
+        }
+    }
+    g_strfreev(parts);
+
+    if (!ok) config->num_cpus = 0;
+    return ok && config->num_cpus > 0;
+}
+
+// Main thread, before any thread calls rt_thread_setup or rt_thread_adopt
+void rt_configure(const RtConfig *config) {
+    rt_config = *config;
+    if (config->priority > 0 && !adopt_thread) {
+        adopt_running = TRUE;
+        adopt_thread = g_thread_new("rt_adopt", adopt_thread_func, NULL);
+    }
+    if (config->priority <= 0 || !config->lock_memory) return;
+
+    // Locking future mappings too makes any allocation past RLIMIT_MEMLOCK
+    // fail, so that is left to processes without a limit
+    int flags = MCL_CURRENT;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY) {
+        flags |= MCL_FUTURE;
+    }
+    if (mlockall(flags) == 0) {
+        LOG_INFO("Realtime: Memory locked%s", (flags & MCL_FUTURE) ? ", including later allocations" : "");
+    } else {
+        LOG_WARN("Realtime: Could not lock memory (%s), locking realtime buffers only",
+                 g_strerror(errno));
+    }
+}
+
+// Flush-to-zero and denormals-are-zero for the calling thread. The ladder
+// filter's states decay through the denormal range after a note, where
+// every sample can cost a hundred cycles or more.
+void rt_flush_denormals(void) {
+#if defined(__SSE2__)
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+#elif defined(__aarch64__)
+    guint64 fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    fpcr |= 1ull << 24;         // FZ
+    __asm__ volatile("msr fpcr, %0" : : "r"(fpcr));
+#endif
+}
+
+// Touches every page so the first real access does not fault, and locks
+// the range when realtime is configured. The contents are unchanged.
+void rt_prefault(void *memory, size_t bytes) {
+    if (!memory || bytes == 0) return;
+
+    volatile char *touch = (volatile char *)memory;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < bytes; i += page) {
+        touch[i] = touch[i];
+    }
+    touch[bytes - 1] = touch[bytes - 1];
+
+    if (rt_config.priority > 0 && rt_config.lock_memory) {
+        mlock(memory, bytes);   // Best effort; RLIMIT_MEMLOCK may not allow it
+    }
+}
+
+static __attribute__((noinline)) void prefault_stack(void) {
+    volatile char stack[RT_STACK_PREFAULT];
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sizeof(stack); i += page) {
+        stack[i] = 0;
+    }
+}
+
+// The calling thread through pthreads, another thread by kernel id. The
+// latter fails with ESRCH once that thread has exited.
+static int set_scheduler(guint64 tid, bool self, const struct sched_param *param) {
+#ifdef __linux__
+    if (!self) {
+        return sched_setscheduler((pid_t)tid, SCHED_FIFO, param) == 0 ? 0 : errno;
+    }
+#else
+    (void)tid;
+    (void)self;
+#endif
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, param);
+}
+
+// SCHED_FIFO directly: works as root, with CAP_SYS_NICE, or up to
+// RLIMIT_RTPRIO. Returns 0 or the error.
+static int set_fifo(guint64 tid, bool self, int priority, int *granted) {
+    struct sched_param param = { .sched_priority = priority };
+    int error = set_scheduler(tid, self, &param);
+
+    struct rlimit limit;
+    if (error == EPERM && getrlimit(RLIMIT_RTPRIO, &limit) == 0 &&
+        limit.rlim_cur > 0 && limit.rlim_cur < (rlim_t)priority) {
+        param.sched_priority = (int)limit.rlim_cur;
+        error = set_scheduler(tid, self, &param);
+    }
+    if (error == 0) *granted = param.sched_priority;
+    return error;
+}
+
+#ifdef __linux__
+static bool rtkit_get_int(GDBusConnection *bus, const char *property, gint64 *value) {
+    GVariant *reply = g_dbus_connection_call_sync(bus, RTKIT_SERVICE, RTKIT_PATH,
+                                                  "org.freedesktop.DBus.Properties", "Get",
+                                                  g_variant_new("(ss)", RTKIT_SERVICE, property),
+                                                  G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE,
+                                                  RTKIT_TIMEOUT_MS, NULL, NULL);
+    if (!reply) return false;
+
+    GVariant *inner;
+    g_variant_get(reply, "(v)", &inner);
+    bool ok = true;
+    if (g_variant_is_of_type(inner, G_VARIANT_TYPE_INT32)) {
+        *value = g_variant_get_int32(inner);
+    } else if (g_variant_is_of_type(inner, G_VARIANT_TYPE_INT64)) {
+        *value = g_variant_get_int64(inner);
+    } else {
+        ok = false;
+    }
+    g_variant_unref(inner);
+    g_variant_unref(reply);
+    return ok;
+}
+
+// RTKit only serves processes whose RLIMIT_RTTIME hard limit is within
+// its own, so that is lowered once, for the rest of the process: a
+// realtime thread that runs that long (200 ms by default) without
+// blocking is then killed. The audio and generator threads block on every
+// block.
+static void limit_rttime(gint64 max_rttime) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_RTTIME, &limit) == 0 && limit.rlim_max != RLIM_INFINITY &&
+        limit.rlim_max <= (rlim_t)max_rttime) {
+        return;
+    }
+    limit.rlim_cur = limit.rlim_max = (rlim_t)max_rttime;
+    if (setrlimit(RLIMIT_RTTIME, &limit) == 0) {
+        LOG_INFO("Realtime: RLIMIT_RTTIME lowered to %" G_GINT64_FORMAT " us for RTKit, "
+                 "for the rest of the process", max_rttime);
+    }
+}
+
+// RTKit hands out realtime priority on desktops without rights to it.
+// Blocks for up to a few RTKIT_TIMEOUT_MS, so never on an audio callback.
+static bool rtkit_make_realtime(guint64 tid, int priority, int *granted, char *reason) {
+    GError *error = NULL;
+    GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (!bus) {
+        g_snprintf(reason, REASON_LENGTH, "RTKit: %s", error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    gint64 max_priority = 0, max_rttime = 0;
+    if (!rtkit_get_int(bus, "MaxRealtimePriority", &max_priority) ||
+        !rtkit_get_int(bus, "RTTimeUSecMax", &max_rttime) || max_priority <= 0) {
+        g_snprintf(reason, REASON_LENGTH, "RTKit: Not available");
+        g_object_unref(bus);
+        return false;
+    }
+    priority = MIN(priority, (int)max_priority);
+    limit_rttime(max_rttime);
+
+    GVariant *reply = g_dbus_connection_call_sync(bus, RTKIT_SERVICE, RTKIT_PATH,
+                                                  RTKIT_SERVICE, "MakeThreadRealtime",
+                                                  g_variant_new("(tu)", tid, (guint32)priority),
+                                                  NULL, G_DBUS_CALL_FLAGS_NONE,
+                                                  RTKIT_TIMEOUT_MS, NULL, &error);
+    g_object_unref(bus);
+    if (!reply) {
+        g_snprintf(reason, REASON_LENGTH, "RTKit: %s", error->message);
+        g_error_free(error);
+        return false;
+    }
+    g_variant_unref(reply);
+    *granted = priority;
+    return true;
+}
+#endif
+
+static bool pin_thread(guint64 tid, bool self) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < rt_config.num_cpus; i++) {
+        CPU_SET(rt_config.cpus[i], &set);
+    }
+    if (!self) return sched_setaffinity((pid_t)tid, sizeof(set), &set) == 0;
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)tid;
+    (void)self;
+    return false;
+#endif
+}
+
+static guint64 current_tid(void) {
+#ifdef __linux__
+    return (guint64)syscall(SYS_gettid);
+#else
+    return 0;
+#endif
+}
+
+// Realtime priority and pinning for a thread of this process, from that
+// thread (self) or from the helper by kernel id. Logs what was granted.
+static bool promote(guint64 tid, bool self, RtThreadRole role, const char *name) {
+    int wanted = role == RT_THREAD_GENERATOR ? MAX(rt_config.priority - 1, 1) : rt_config.priority;
+    wanted = CLAMP(wanted, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+    int granted = 0;
+    char reason[REASON_LENGTH];
+    const char *method = "SCHED_FIFO";
+    int error = set_fifo(tid, self, wanted, &granted);
+    if (error == ESRCH) {
+        LOG_INFO("Realtime: %s thread exited before it could be promoted", name);
+        return false;
+    }
+    bool realtime = error == 0;
+    if (!realtime) g_snprintf(reason, REASON_LENGTH, "SCHED_FIFO: %s", g_strerror(error));
+#ifdef __linux__
+    if (!realtime) {
+        char rtkit_reason[REASON_LENGTH];
+        realtime = rtkit_make_realtime(tid, wanted, &granted, rtkit_reason);
+        method = "RTKit";
+        if (!realtime) {
+            g_strlcat(reason, ", ", sizeof(reason));
+            g_strlcat(reason, rtkit_reason, sizeof(reason));
+        }
+    }
+#endif
+
+    if (realtime) {
+        LOG_INFO("Realtime: %s thread at priority %d through %s", name, granted, method);
+    } else {
+#ifdef __APPLE__
+        // Only settable from the thread itself
+        if (self) pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+        LOG_WARN("Realtime: %s thread at normal priority (%s)", name, reason);
+    }
+
+    if (rt_config.num_cpus > 0 && !pin_thread(tid, self)) {
+        LOG_WARN("Realtime: Could not pin %s thread to the chosen CPUs", name);
+    }
+    return realtime;
+}
+
+// Once per thread; later calls return what the first one got. Always
+// flushes denormals. Realtime priority, pinning and the stack prefault
+// follow only once rt_configure has asked for them. Logs what was granted.
+// May block on RTKit, so not for threads the audio host owns.
+bool rt_thread_setup(RtThreadRole role, const char *name) {
+    gint state = GPOINTER_TO_INT(g_private_get(&thread_state));
+    if (state) return state == 2;
+
+    rt_flush_denormals();
+    if (rt_config.priority <= 0) {
+        g_private_set(&thread_state, GINT_TO_POINTER(1));
+        return false;
+    }
+    prefault_stack();
+
+    bool realtime = promote(current_tid(), true, role, name);
+    g_private_set(&thread_state, GINT_TO_POINTER(realtime ? 2 : 1));
+    return realtime;
+}
+
+// For threads the audio host owns, from inside their callback: flushes
+// denormals and, once per thread, hands the thread to a helper that
+// promotes it, so the callback never waits on system calls or D-Bus.
+// No locks are waited on; if the helper is busy it finds the request
+// within ADOPT_POLL_US.
+void rt_thread_adopt(RtThreadRole role, const char *name) {
+    if (g_private_get(&thread_state)) return;
+    rt_flush_denormals();
+    g_private_set(&thread_state, GINT_TO_POINTER(1));
+    // Adopted threads are promoted by kernel id, which only Linux has
+    guint64 tid = current_tid();
+    if (rt_config.priority <= 0 || !adopt_thread || tid == 0) return;
+
+    for (int i = 0; i < ADOPT_SLOTS; i++) {
+        AdoptRequest *request = &adopt_requests[i];
+        if (!g_atomic_int_compare_and_exchange(&request->state, ADOPT_FREE, ADOPT_FILLING)) continue;
+        request->role = role;
+        request->name = name;
+        request->tid = tid;
+        g_atomic_int_set(&request->state, ADOPT_READY);
+        if (g_mutex_trylock(&adopt_mutex)) {
+            g_cond_signal(&adopt_cond);
+            g_mutex_unlock(&adopt_mutex);
+        }
+        return;
+    }
+}
+
+static gpointer adopt_thread_func(gpointer data) {
+    (void)data;
+    g_mutex_lock(&adopt_mutex);
+    while (adopt_running) {
+        for (int i = 0; i < ADOPT_SLOTS; i++) {
+            AdoptRequest *request = &adopt_requests[i];
+            if (g_atomic_int_get(&request->state) != ADOPT_READY) continue;
+            AdoptRequest copy = *request;
+            g_mutex_unlock(&adopt_mutex);
+            promote(copy.tid, false, copy.role, copy.name);
+            g_atomic_int_set(&request->state, ADOPT_FREE);
+            g_mutex_lock(&adopt_mutex);
+        }
+        if (adopt_running) {
+            g_cond_wait_until(&adopt_cond, &adopt_mutex, g_get_monotonic_time() + ADOPT_POLL_US);
+        }
+    }
+    g_mutex_unlock(&adopt_mutex);
+    return NULL;
+}
+
+// Main thread, after the audio host has stopped
+void rt_shutdown(void) {
+    if (!adopt_thread) return;
+    g_mutex_lock(&adopt_mutex);
+    adopt_running = FALSE;
+    g_cond_signal(&adopt_cond);
+    g_mutex_unlock(&adopt_mutex);
+    g_thread_join(adopt_thread);
+    adopt_thread = NULL;
+}
@@ -0,0 +1,287 @@
+#include "scope_frame.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "fft_analyzer.h"
+#include "transfer_analyzer.h"
+#include "logger.h"
+
+static const ScopeColor GRID_COLOR = { 0.2f, 0.2f, 0.2f, 1.0f };
+static const ScopeColor AXIS_TEXT_COLOR = { 0.8f, 0.8f, 0.8f, 1.0f };
+
+// Clears the lists for a new frame; curve storage follows the width
+gboolean scope_frame_begin(ScopeFrame *frame, int width, int height, int wave_height) {
+    if (!frame || width <= 0 || height <= 0) return FALSE;
+
+    if (width > frame->curve_capacity) {
+        g_free(frame->curve_storage);
+        frame->curve_storage = g_try_new(float, (gsize)width * SCOPE_FRAME_MAX_CURVES);
+        frame->curve_capacity = frame->curve_storage ? width : 0;
+        if (!frame->curve_storage) {
+            LOG_ERROR("Scope frame: Failed to allocate curves for width %d", width);
+            return FALSE;
+        }
+    }
+
+    memset(&frame->graticule, 0, sizeof(frame->graticule));
+    frame->graticule.width = width;
+    frame->graticule.height = height;
+    frame->graticule.wave_height = wave_height;
+    frame->num_images = 0;
+    frame->background.num_lines = 0;
+    frame->background.num_labels = 0;
+    frame->num_curves = 0;
+    frame->num_marks = 0;
+    frame->overlay.num_lines = 0;
+    frame->overlay.num_labels = 0;
+    return TRUE;
+}
+
+void scope_frame_free(ScopeFrame *frame) {
+    if (!frame) return;
+    g_free(frame->curve_storage);
+    frame->curve_storage = NULL;
+    frame->curve_capacity = 0;
+}
+
+static void layer_add_line(ScopeLayer *layer, float x0, float y0, float x1, float y1,
+                           float width, ScopeColor color) {
+    if (layer->num_lines == SCOPE_LAYER_MAX_LINES) return;
+    layer->lines[layer->num_lines++] = (ScopeLine){ x0, y0, x1, y1, width, color };
+}
+
+static void layer_add_label(ScopeLayer *layer, float x, float y, int size, gboolean centered,
+                            ScopeColor color, const char *text) {
+    if (layer->num_labels == SCOPE_LAYER_MAX_LABELS || !text) return;
+    ScopeLabel *label = &layer->labels[layer->num_labels++];
+    label->x = x;
+    label->y = y;
+    label->size = size;
+    label->centered = centered;
+    label->color = color;
+    g_strlcpy(label->text, text, sizeof(label->text));
+}
+
+// Returns the row to fill with count y values, NULL when the list is full
+float* scope_frame_add_curve(ScopeFrame *frame, int count, float width, ScopeColor color) {
+    if (frame->num_curves == SCOPE_FRAME_MAX_CURVES || count < 1 ||
+        count > frame->curve_capacity) {
+        return NULL;
+    }
+    float *y = frame->curve_storage + (size_t)frame->num_curves * frame->curve_capacity;
+    frame->curves[frame->num_curves++] = (ScopeCurve){ y, count, width, color };
+    return y;
+}
+
+void scope_frame_add_line(ScopeFrame *frame, float x0, float y0, float x1, float y1,
+                          float width, ScopeColor color) {
+    layer_add_line(&frame->overlay, x0, y0, x1, y1, width, color);
+}
+
+void scope_frame_add_mark(ScopeFrame *frame, float x, float y) {
+    if (frame->num_marks == SCOPE_FRAME_MAX_MARKS) return;
+    frame->marks[frame->num_marks++] = (ScopeMark){ x, y };
+}
+
+void scope_frame_add_label(ScopeFrame *frame, float x, float y, int size, gboolean centered,
+                           ScopeColor color, const char *text) {
+    layer_add_label(&frame->overlay, x, y, size, centered, color, text);
+}
+
+void scope_frame_add_image(ScopeFrame *frame, cairo_surface_t *surface, int x, int y,
+                           guint serial) {
+    if (frame->num_images == SCOPE_FRAME_MAX_IMAGES || !surface) return;
+    frame->images[frame->num_images++] = (ScopeImage){ surface, x, y, serial };
+}
+
+static float spectrum_db_y(int db, int top, int pane_height) {
+    return top + pane_height * (1.0f - (db - MIN_DB) / (MAX_DB - MIN_DB));
+}
+
+static float transfer_db_y(int db, int top, int pane_height) {
+    return top + pane_height * (1.0f - (db - TRANSFER_MIN_DB) / (TRANSFER_MAX_DB - TRANSFER_MIN_DB));
+}
+
+// Frequency lines and labels from 20 Hz to the Nyquist frequency, on the
+// same log axis the spectrum is drawn on
+static void add_spectrum_axes(ScopeLayer *layer, const ScopeGraticule *g) {
+    int width = g->width;
+    int top = g->wave_height;
+    int pane_height = g->height - g->wave_height;
+    double nyquist = g->sample_rate / 2.0;
+    double log_span = log(nyquist / 20.0);
+
+    double freq_markers[] = {20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000,
+                             40000, 80000};
+    int num_markers = sizeof(freq_markers) / sizeof(freq_markers[0]);
+    while (num_markers > 1 && freq_markers[num_markers - 1] > nyquist) {
+        num_markers--;
+    }
+
+    for (int i = 0; i < num_markers; i++) {
+        float x = width * log(freq_markers[i] / 20.0) / log_span;
+        layer_add_line(layer, x, top, x, g->height, 1.0f, GRID_COLOR);
+    }
+    for (int db = -80; db <= 0; db += 20) {
+        float y = spectrum_db_y(db, top, pane_height);
+        layer_add_line(layer, 0, y, width, y, 1.0f, GRID_COLOR);
+    }
+
+    for (int i = 0; i < num_markers; i++) {
+        double freq = freq_markers[i];
+        if (freq != 20 && freq != 100 && freq != 1000 && freq != 10000 &&
+            freq != 20000 && freq != 80000) {
+            continue;
+        }
+
+        char freq_label[32];
+        if (freq >= 1000) {
+            snprintf(freq_label, sizeof(freq_label), "%.1fk", freq / 1000.0);
+        } else {
+            snprintf(freq_label, sizeof(freq_label), "%.0f", freq);
+        }
+        layer_add_label(layer, width * log(freq / 20.0) / log_span - 10, g->height - 5, 10,
+                        FALSE, AXIS_TEXT_COLOR, freq_label);
+    }
+
+    for (int db = -80; db <= 0; db += 20) {
+        char db_label[32];
+        snprintf(db_label, sizeof(db_label), "%ddB", db);
+        layer_add_label(layer, 5, spectrum_db_y(db, top, pane_height) - 2, 10, FALSE,
+                        AXIS_TEXT_COLOR, db_label);
+    }
+}
+
+static void add_transfer_axes(ScopeLayer *layer, const ScopeGraticule *g) {
+    int top = g->wave_height;
+    int pane_height = g->height - g->wave_height;
+
+    for (int db = (int)TRANSFER_MIN_DB; db <= (int)TRANSFER_MAX_DB; db += 20) {
+        float y = transfer_db_y(db, top, pane_height);
+        layer_add_line(layer, 0, y, g->width, y, 1.0f, GRID_COLOR);
+    }
+    for (int db = (int)TRANSFER_MIN_DB; db <= (int)TRANSFER_MAX_DB; db += 20) {
+        char db_label[32];
+        snprintf(db_label, sizeof(db_label), "%ddB", db);
+        layer_add_label(layer, 5, transfer_db_y(db, top, pane_height) - 2, 10, FALSE,
+                        AXIS_TEXT_COLOR, db_label);
+    }
+}
+
+// Turns the finished graticule description into grid lines and axis
+// labels; renderers that cache the background compare the description
+void scope_frame_end(ScopeFrame *frame) {
+    const ScopeGraticule *g = &frame->graticule;
+    ScopeLayer *layer = &frame->background;
+    int width = g->width;
+    int wave_height = g->wave_height;
+
+    if (g->time_grid) {
+        for (int i = 0; i <= 12; i++) {
+            float x = i * width / 12.0f;
+            layer_add_line(layer, x, 0, x, wave_height, 1.0f, GRID_COLOR);
+        }
+        for (int i = 0; i <= 8; i++) {
+            float y = i * wave_height / 8.0f;
+            layer_add_line(layer, 0, y, width, y, 1.0f, GRID_COLOR);
+        }
+    }
+    if (g->xy_size > 0) {
+        float left = (width - g->xy_size) / 2;
+        for (int i = 0; i <= 8; i++) {
+            float offset = i * g->xy_size / 8.0f;
+            layer_add_line(layer, left + offset, 0, left + offset, g->xy_size, 1.0f, GRID_COLOR);
+            layer_add_line(layer, left, offset, left + g->xy_size, offset, 1.0f, GRID_COLOR);
+        }
+    }
+
+    // Dividing line between waveform and spectrum
+    layer_add_line(layer, 0, wave_height, width, wave_height, 1.0f,
+                   (ScopeColor){ 0.3f, 0.3f, 0.3f, 1.0f });
+
+    if (g->axes == SCOPE_AXES_SPECTRUM && g->sample_rate > 0) {
+        add_spectrum_axes(layer, g);
+    } else if (g->axes == SCOPE_AXES_TRANSFER) {
+        add_transfer_axes(layer, g);
+    }
+}
+
+static void set_color(cairo_t *cr, ScopeColor color) {
+    cairo_set_source_rgba(cr, color.red, color.green, color.blue, color.alpha);
+}
+
+static gboolean same_style(const ScopeLine *a, const ScopeLine *b) {
+    return a->width == b->width && memcmp(&a->color, &b->color, sizeof(ScopeColor)) == 0;
+}
+
+// Runs of lines in the same style go out as one path
+static void draw_lines(cairo_t *cr, const ScopeLayer *layer) {
+    for (int i = 0; i < layer->num_lines; i++) {
+        const ScopeLine *line = &layer->lines[i];
+        if (i == 0 || !same_style(line, &layer->lines[i - 1])) {
+            set_color(cr, line->color);
+            cairo_set_line_width(cr, line->width);
+        }
+        cairo_move_to(cr, line->x0, line->y0);
+        cairo_line_to(cr, line->x1, line->y1);
+        if (i + 1 == layer->num_lines || !same_style(line, &layer->lines[i + 1])) {
+            cairo_stroke(cr);
+        }
+    }
+}
+
+static void draw_labels(cairo_t *cr, const ScopeLayer *layer, int width) {
+    for (int i = 0; i < layer->num_labels; i++) {
+        const ScopeLabel *label = &layer->labels[i];
+        double x = label->x;
+        set_color(cr, label->color);
+        cairo_set_font_size(cr, label->size);
+        if (label->centered) {
+            cairo_text_extents_t extents;
+            cairo_text_extents(cr, label->text, &extents);
+            x = fmax(5, fmin(x - extents.width / 2, width - extents.width - 5));
+        }
+        cairo_move_to(cr, x, label->y);
+        cairo_show_text(cr, label->text);
+    }
+}
+
+// The whole frame, black background first
+void scope_frame_draw(cairo_t *cr, const ScopeFrame *frame) {
+    int width = frame->graticule.width;
+
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_paint(cr);
+    for (int i = 0; i < frame->num_images; i++) {
+        const ScopeImage *image = &frame->images[i];
+        cairo_set_source_surface(cr, image->surface, image->x, image->y);
+        cairo_paint(cr);
+    }
+    draw_lines(cr, &frame->background);
+    draw_labels(cr, &frame->background, width);
+
+    for (int i = 0; i < frame->num_curves; i++) {
+        const ScopeCurve *curve = &frame->curves[i];
+        set_color(cr, curve->color);
+        cairo_set_line_width(cr, curve->width);
+        cairo_move_to(cr, 0, curve->y[0]);
+        for (int x = 1; x < curve->count; x++) {
+            cairo_line_to(cr, x, curve->y[x]);
+        }
+        cairo_stroke(cr);
+    }
+
+    draw_lines(cr, &frame->overlay);
+
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    for (int i = 0; i < frame->num_marks; i++) {
+        const ScopeMark *mark = &frame->marks[i];
+        cairo_move_to(cr, mark->x, mark->y - 2);
+        cairo_line_to(cr, mark->x - 4, mark->y - 9);
+        cairo_line_to(cr, mark->x + 4, mark->y - 9);
+        cairo_close_path(cr);
+    }
+    cairo_fill(cr);
+
+    draw_labels(cr, &frame->overlay, width);
+}
@@ -0,0 +1,688 @@
+#include "scope_gl.h"
+#include "logger.h"
+#include "profile.h"
+#include "rt_pool.h"
+#include <string.h>
+#include <math.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#define ATTRIBUTE_POSITION 0
+#define ATTRIBUTE_EXTRA 1             // Edge offsets for strokes, texture coordinates
+#define VERTEX_FLOATS 4
+// Every label at full length plus the peak marks; curves longer than this
+// are uploaded in runs
+#define STAGING_VERTICES (SCOPE_FRAME_MAX_MARKS * 3 + \
+                          SCOPE_LAYER_MAX_LABELS * (SCOPE_LABEL_LENGTH - 1) * 6)
+
+// Lines are widened into quads on the CPU; each vertex carries its
+// distance from the centre line and the line's half width
+static const char *stroke_vertex_source =
+    "#version 150\n"
+    "uniform vec2 viewport;\n"
+    "in vec2 position;\n"
+    "in vec2 edge;\n"
+    "out vec2 offset;\n"
+    "void main() {\n"
+    "    offset = edge;\n"
+    "    gl_Position = vec4(position.x * 2.0 / viewport.x - 1.0,\n"
+    "                       1.0 - position.y * 2.0 / viewport.y, 0.0, 1.0);\n"
+    "}\n";
+
+// Coverage falls off over the outermost pixel; colours are premultiplied
+static const char *stroke_fragment_source =
+    "#version 150\n"
+    "uniform vec4 color;\n"
+    "in vec2 offset;\n"
+    "out vec4 fragment;\n"
+    "void main() {\n"
+    "    fragment = color * clamp(offset.y + 0.5 - abs(offset.x), 0.0, 1.0);\n"
+    "}\n";
+
+static const char *texture_vertex_source =
+    "#version 150\n"
+    "uniform vec2 viewport;\n"
+    "in vec2 position;\n"
+    "in vec2 texcoord;\n"
+    "out vec2 uv;\n"
+    "void main() {\n"
+    "    uv = texcoord;\n"
+    "    gl_Position = vec4(position.x * 2.0 / viewport.x - 1.0,\n"
+    "                       1.0 - position.y * 2.0 / viewport.y, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *texture_fragment_source =
+    "#version 150\n"
+    "uniform sampler2D image;\n"
+    "uniform vec4 tint;\n"
+    "in vec2 uv;\n"
+    "out vec4 fragment;\n"
+    "void main() {\n"
+    "    fragment = texture(image, uv) * tint;\n"
+    "}\n";
+
+ScopeGL* scope_gl_create(void) {
+    ScopeGL *gl = g_new0(ScopeGL, 1);
+    gl->vertices = rt_pool_new(float, STAGING_VERTICES * VERTEX_FLOATS);
+    if (!gl->vertices) {
+        g_free(gl);
+        return NULL;
+    }
+    return gl;
+}
+
+// The GL objects go with the context; unrealize first if it is still alive
+void scope_gl_destroy(ScopeGL *gl) {
+    if (!gl) return;
+    rt_pool_free(gl->vertices);
+    g_free(gl);
+}
+
+static GLuint compile_shader(GLenum type, const char *source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        LOG_ERROR("Scope GL: Shader did not compile: %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Both programs take four-float vertices: a position and a second pair
+static GLuint link_program(const char *vertex_source, const char *fragment_source) {
+    GLuint vertex = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+    GLuint program = 0;
+
+    if (vertex && fragment) {
+        program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glBindAttribLocation(program, ATTRIBUTE_POSITION, "position");
+        glBindAttribLocation(program, ATTRIBUTE_EXTRA, "edge");
+        glBindAttribLocation(program, ATTRIBUTE_EXTRA, "texcoord");
+        glBindFragDataLocation(program, 0, "fragment");
+        glLinkProgram(program);
+
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE) {
+            char log[512];
+            glGetProgramInfoLog(program, sizeof(log), NULL, log);
+            LOG_ERROR("Scope GL: Program did not link: %s", log);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // Attached shaders live on with the program
+    if (vertex) glDeleteShader(vertex);
+    if (fragment) glDeleteShader(fragment);
+    return program;
+}
+
+static GLuint create_texture(void) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+// Cairo's ARGB32 is BGRA in memory on little-endian machines and packed
+// ARGB words either way; rows may be padded. Reallocates only when the
+// size changed.
+static void upload_surface(GLuint texture, cairo_surface_t *surface, int *width, int *height) {
+    cairo_surface_flush(surface);
+    const guint8 *pixels = cairo_image_surface_get_data(surface);
+    int w = cairo_image_surface_get_width(surface);
+    int h = cairo_image_surface_get_height(surface);
+    if (!pixels) return;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, cairo_image_surface_get_stride(surface) / 4);
+    if (w != *width || h != *height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_BGRA,
+                     GL_UNSIGNED_INT_8_8_8_8_REV, pixels);
+        *width = w;
+        *height = h;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_BGRA,
+                        GL_UNSIGNED_INT_8_8_8_8_REV, pixels);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+// White glyphs for every printable character at each label size, packed
+// in rows, plus a small solid block that filled shapes sample
+static gboolean build_atlas(ScopeGL *gl) {
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                          SCOPE_GL_ATLAS_WIDTH,
+                                                          SCOPE_GL_ATLAS_HEIGHT);
+    cairo_t *cr = cairo_create(surface);
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_rectangle(cr, 0, 0, 4, 4);
+    cairo_fill(cr);
+    gl->solid_u = 2.0f / SCOPE_GL_ATLAS_WIDTH;
+    gl->solid_v = 2.0f / SCOPE_GL_ATLAS_HEIGHT;
+
+    int pen_x = 5, pen_y = 0, row_height = 4;
+    gboolean fits = TRUE;
+    for (int s = 0; s < SCOPE_GL_FONT_SIZES && fits; s++) {
+        cairo_set_font_size(cr, SCOPE_GL_MIN_FONT_SIZE + s);
+        for (int c = 0; c < SCOPE_GL_NUM_GLYPHS; c++) {
+            char text[2] = { (char)(SCOPE_GL_FIRST_GLYPH + c), '\0' };
+            cairo_text_extents_t extents;
+            cairo_text_extents(cr, text, &extents);
+
+            // A pixel of margin around the ink keeps the edges of the
+            // antialiasing and neighbours out of each cell
+            ScopeGlyph *glyph = &gl->glyphs[s][c];
+            glyph->left = (int)floor(extents.x_bearing) - 1;
+            glyph->top = (int)floor(extents.y_bearing) - 1;
+            glyph->width = (int)ceil(extents.x_bearing + extents.width) + 1 - glyph->left;
+            glyph->height = (int)ceil(extents.y_bearing + extents.height) + 1 - glyph->top;
+            glyph->advance = extents.x_advance;
+
+            if (pen_x + glyph->width > SCOPE_GL_ATLAS_WIDTH) {
+                pen_x = 0;
+                pen_y += row_height + 1;
+                row_height = 0;
+            }
+            if (pen_y + glyph->height > SCOPE_GL_ATLAS_HEIGHT) {
+                fits = FALSE;
+                break;
+            }
+
+            cairo_move_to(cr, pen_x - glyph->left, pen_y - glyph->top);
+            cairo_show_text(cr, text);
+            glyph->u0 = (float)pen_x / SCOPE_GL_ATLAS_WIDTH;
+            glyph->v0 = (float)pen_y / SCOPE_GL_ATLAS_HEIGHT;
+            glyph->u1 = (float)(pen_x + glyph->width) / SCOPE_GL_ATLAS_WIDTH;
+            glyph->v1 = (float)(pen_y + glyph->height) / SCOPE_GL_ATLAS_HEIGHT;
+            pen_x += glyph->width + 1;
+            row_height = MAX(row_height, glyph->height);
+        }
+    }
+    cairo_destroy(cr);
+
+    if (fits) {
+        int width = 0, height = 0;
+        gl->atlas_texture = create_texture();
+        upload_surface(gl->atlas_texture, surface, &width, &height);
+    } else {
+        LOG_ERROR("Scope GL: Glyphs do not fit a %dx%d atlas",
+                  SCOPE_GL_ATLAS_WIDTH, SCOPE_GL_ATLAS_HEIGHT);
+    }
+    cairo_surface_destroy(surface);
+    return fits;
+}
+
+// Compiles the shaders and builds the atlas. FALSE means the context
+// cannot draw the scope and the caller should fall back to cairo.
+gboolean scope_gl_realize(ScopeGL *gl) {
+    if (!gl) return FALSE;
+    if (gl->realized) return TRUE;
+
+    gl->stroke_program = link_program(stroke_vertex_source, stroke_fragment_source);
+    gl->texture_program = link_program(texture_vertex_source, texture_fragment_source);
+    if (!gl->stroke_program || !gl->texture_program) {
+        scope_gl_unrealize(gl);
+        return FALSE;
+    }
+    gl->stroke_viewport = glGetUniformLocation(gl->stroke_program, "viewport");
+    gl->stroke_color = glGetUniformLocation(gl->stroke_program, "color");
+    gl->texture_viewport = glGetUniformLocation(gl->texture_program, "viewport");
+    gl->texture_tint = glGetUniformLocation(gl->texture_program, "tint");
+
+    glGenVertexArrays(1, &gl->vertex_array);
+    glGenBuffers(1, &gl->stream_buffer);
+    glGenBuffers(1, &gl->background_lines);
+    glGenBuffers(1, &gl->background_glyphs);
+    glGenFramebuffers(SCOPE_FRAME_MAX_IMAGES, gl->image_framebuffers);
+    for (int i = 0; i < SCOPE_FRAME_MAX_IMAGES; i++) {
+        gl->image_textures[i] = create_texture();
+        gl->image_width[i] = 0;
+        gl->image_height[i] = 0;
+    }
+    gl->have_graticule = FALSE;
+
+    gl->realized = TRUE;
+    if (!build_atlas(gl)) {
+        scope_gl_unrealize(gl);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Deleting name 0 is a no-op, so this also cleans up a failed realize
+void scope_gl_unrealize(ScopeGL *gl) {
+    if (!gl) return;
+    glDeleteProgram(gl->stroke_program);
+    glDeleteProgram(gl->texture_program);
+    glDeleteBuffers(1, &gl->stream_buffer);
+    glDeleteBuffers(1, &gl->background_lines);
+    glDeleteBuffers(1, &gl->background_glyphs);
+    glDeleteVertexArrays(1, &gl->vertex_array);
+    glDeleteFramebuffers(SCOPE_FRAME_MAX_IMAGES, gl->image_framebuffers);
+    glDeleteTextures(SCOPE_FRAME_MAX_IMAGES, gl->image_textures);
+    glDeleteTextures(1, &gl->atlas_texture);
+
+    gl->stroke_program = 0;
+    gl->texture_program = 0;
+    gl->stream_buffer = 0;
+    gl->background_lines = 0;
+    gl->background_glyphs = 0;
+    gl->vertex_array = 0;
+    memset(gl->image_framebuffers, 0, sizeof(gl->image_framebuffers));
+    memset(gl->image_textures, 0, sizeof(gl->image_textures));
+    memset(gl->image_width, 0, sizeof(gl->image_width));
+    memset(gl->image_height, 0, sizeof(gl->image_height));
+    memset(gl->image_serial, 0, sizeof(gl->image_serial));
+    gl->atlas_texture = 0;
+    gl->have_graticule = FALSE;
+    gl->realized = FALSE;
+}
+
+// Every vertex is a position and a second pair: texture coordinates for
+// the texture program, edge offsets for strokes
+static void bind_vertices(GLuint buffer) {
+    GLsizei stride = VERTEX_FLOATS * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glVertexAttribPointer(ATTRIBUTE_EXTRA, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(2 * sizeof(float)));
+    glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+    glEnableVertexAttribArray(ATTRIBUTE_EXTRA);
+}
+
+// Replaces the buffer's storage with the staged vertices. For the stream
+// buffer this means the driver never waits on a draw still reading the
+// previous contents.
+static void upload_vertices(ScopeGL *gl, GLuint buffer, size_t vertices, GLenum usage) {
+    bind_vertices(buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices * VERTEX_FLOATS * sizeof(float),
+                 gl->vertices, usage);
+}
+
+static void set_tint(GLint location, ScopeColor color) {
+    glUniform4f(location, color.red * color.alpha, color.green * color.alpha,
+                color.blue * color.alpha, color.alpha);
+}
+
+// Two triangles covering the segment and a pixel either side of it,
+// extended by half the width at the ends so joins have no gaps
+static float* put_segment(float *v, float ax, float ay, float bx, float by, float width) {
+    float half = width * 0.5f;
+    float dx = bx - ax;
+    float dy = by - ay;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length > 0.0f) {
+        dx /= length;
+        dy /= length;
+    } else {
+        dx = 1.0f;
+        dy = 0.0f;
+    }
+
+    float reach = half + 1.0f;
+    float sx = -dy * reach, sy = dx * reach;
+    float cx = dx * half, cy = dy * half;
+    const float corners[6][4] = {
+        { ax - cx + sx, ay - cy + sy, reach, half }, { ax - cx - sx, ay - cy - sy, -reach, half },
+        { bx + cx + sx, by + cy + sy, reach, half }, { ax - cx - sx, ay - cy - sy, -reach, half },
+        { bx + cx - sx, by + cy - sy, -reach, half }, { bx + cx + sx, by + cy + sy, reach, half },
+    };
+    memcpy(v, corners, sizeof(corners));
+    return v + 6 * VERTEX_FLOATS;
+}
+
+// Returns the number of vertices staged
+static size_t stage_lines(ScopeGL *gl, const ScopeLine *lines, int count) {
+    float *v = gl->vertices;
+    for (int i = 0; i < count; i++) {
+        const ScopeLine *line = &lines[i];
+        v = put_segment(v, line->x0, line->y0, line->x1, line->y1, line->width);
+    }
+    return (size_t)count * 6;
+}
+
+static gboolean same_color(const ScopeColor *a, const ScopeColor *b) {
+    return memcmp(a, b, sizeof(ScopeColor)) == 0;
+}
+
+// One draw per run of lines in the same colour, from the bound buffer
+static void draw_lines(ScopeGL *gl, const ScopeLine *lines, int count) {
+    int first = 0;
+    for (int i = 0; i < count; i++) {
+        if (i + 1 < count && same_color(&lines[i].color, &lines[i + 1].color)) {
+            continue;
+        }
+        set_tint(gl->stroke_color, lines[i].color);
+        glDrawArrays(GL_TRIANGLES, first * 6, (i + 1 - first) * 6);
+        first = i + 1;
+    }
+}
+
+static void draw_curves(ScopeGL *gl, const ScopeFrame *frame) {
+    const size_t max_run = STAGING_VERTICES / 6;
+    for (int i = 0; i < frame->num_curves; i++) {
+        const ScopeCurve *curve = &frame->curves[i];
+        size_t segments = curve->count - 1;
+        if (segments == 0) continue;
+
+        set_tint(gl->stroke_color, curve->color);
+        for (size_t first = 0; first < segments; first += max_run) {
+            size_t run = MIN(segments - first, max_run);
+            float *v = gl->vertices;
+            for (size_t x = first; x < first + run; x++) {
+                v = put_segment(v, x, curve->y[x], x + 1, curve->y[x + 1], curve->width);
+            }
+            upload_vertices(gl, gl->stream_buffer, run * 6, GL_STREAM_DRAW);
+            glDrawArrays(GL_TRIANGLES, 0, run * 6);
+        }
+    }
+}
+
+// Two triangles for a rectangle in pixels; returns the next free vertex
+static float* put_quad(float *v, float x0, float y0, float x1, float y1,
+                       float u0, float v0, float u1, float v1) {
+    const float corners[6][4] = {
+        { x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x0, y1, u0, v1 },
+        { x1, y0, u1, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 },
+    };
+    memcpy(v, corners, sizeof(corners));
+    return v + 6 * VERTEX_FLOATS;
+}
+
+static const ScopeGlyph* find_glyph(const ScopeGL *gl, int size, char c) {
+    int s = CLAMP(size - SCOPE_GL_MIN_FONT_SIZE, 0, SCOPE_GL_FONT_SIZES - 1);
+    int index = (unsigned char)c - SCOPE_GL_FIRST_GLYPH;
+    if (index < 0 || index >= SCOPE_GL_NUM_GLYPHS) {
+        index = '?' - SCOPE_GL_FIRST_GLYPH;
+    }
+    return &gl->glyphs[s][index];
+}
+
+static size_t count_glyphs(const ScopeLayer *layer) {
+    size_t count = 0;
+    for (int i = 0; i < layer->num_labels; i++) {
+        count += strlen(layer->labels[i].text);
+    }
+    return count;
+}
+
+// A quad per character, in label order. Glyph cells are pixel aligned, so
+// pens are rounded per glyph.
+static float* put_labels(ScopeGL *gl, const ScopeLayer *layer, int width, float *v) {
+    for (int i = 0; i < layer->num_labels; i++) {
+        const ScopeLabel *label = &layer->labels[i];
+        float x = label->x;
+        if (label->centered) {
+            float extent = 0.0f;
+            for (const char *c = label->text; *c; c++) {
+                extent += find_glyph(gl, label->size, *c)->advance;
+            }
+            x = fmaxf(5, fminf(x - extent / 2, width - extent - 5));
+        }
+
+        float baseline = roundf(label->y);
+        for (const char *c = label->text; *c; c++) {
+            const ScopeGlyph *glyph = find_glyph(gl, label->size, *c);
+            float left = roundf(x) + glyph->left;
+            float top = baseline + glyph->top;
+            v = put_quad(v, left, top, left + glyph->width, top + glyph->height,
+                         glyph->u0, glyph->v0, glyph->u1, glyph->v1);
+            x += glyph->advance;
+        }
+    }
+    return v;
+}
+
+// One draw per run of labels in the same colour, from the bound buffer
+static void draw_labels(ScopeGL *gl, const ScopeLayer *layer, GLint first_vertex) {
+    GLint first = first_vertex;
+    GLint end = first_vertex;
+    for (int i = 0; i < layer->num_labels; i++) {
+        const ScopeColor *color = &layer->labels[i].color;
+        end += (GLint)strlen(layer->labels[i].text) * 6;
+        if (i + 1 < layer->num_labels &&
+            memcmp(color, &layer->labels[i + 1].color, sizeof(ScopeColor)) == 0) {
+            continue;
+        }
+        if (end > first) {
+            set_tint(gl->texture_tint, *color);
+            glDrawArrays(GL_TRIANGLES, first, end - first);
+        }
+        first = end;
+    }
+}
+
+// An opaque horizontal or vertical line covers whole pixels once snapped
+// to them, so a clear can draw it without rasterizing the edge quads
+static gboolean is_grid_rect(const ScopeLine *line) {
+    return (line->x0 == line->x1 || line->y0 == line->y1) && line->color.alpha >= 1.0f;
+}
+
+// The graticule's vertices are only staged again when the layout changed
+static void update_background(ScopeGL *gl, const ScopeFrame *frame) {
+    if (gl->have_graticule &&
+        memcmp(&gl->graticule, &frame->graticule, sizeof(ScopeGraticule)) == 0) {
+        return;
+    }
+
+    const ScopeLayer *layer = &frame->background;
+    gl->num_grid_rects = 0;
+    gl->num_grid_quads = 0;
+    for (int i = 0; i < layer->num_lines; i++) {
+        if (is_grid_rect(&layer->lines[i])) {
+            gl->grid_rects[gl->num_grid_rects++] = layer->lines[i];
+        } else {
+            gl->grid_quads[gl->num_grid_quads++] = layer->lines[i];
+        }
+    }
+    upload_vertices(gl, gl->background_lines, stage_lines(gl, gl->grid_quads, gl->num_grid_quads),
+                    GL_STATIC_DRAW);
+
+    float *start = gl->vertices;
+    float *end = put_labels(gl, layer, frame->graticule.width, start);
+    upload_vertices(gl, gl->background_glyphs, (end - start) / VERTEX_FLOATS, GL_STATIC_DRAW);
+
+    gl->graticule = frame->graticule;
+    gl->have_graticule = TRUE;
+}
+
+// Rounds a span to whole framebuffer pixels, at least one wide. Lines on
+// the far edge of the frame are moved onto its last pixel rather than
+// dropped.
+static void pixel_span(float from, float to, float scale, GLint limit, GLint *start, GLint *end) {
+    GLint a = (GLint)floorf(from * scale + 0.5f);
+    GLint b = MAX((GLint)floorf(to * scale + 0.5f), a + 1);
+    if (a >= limit) {
+        a = limit - 1;
+        b = limit;
+    }
+    *start = a;
+    *end = b;
+}
+
+// Scissored clears for the graticule's grid, scaled to the framebuffer's
+// pixels on HiDPI displays. Leaves the clear colour set to the last line's.
+static void draw_grid_rects(ScopeGL *gl, const ScopeFrame *frame) {
+    if (gl->num_grid_rects == 0) return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float scale_x = viewport[2] / (float)frame->graticule.width;
+    float scale_y = viewport[3] / (float)frame->graticule.height;
+
+    glEnable(GL_SCISSOR_TEST);
+    for (int i = 0; i < gl->num_grid_rects; i++) {
+        const ScopeLine *line = &gl->grid_rects[i];
+        float half = line->width * 0.5f;
+        GLint left, right, top, bottom;
+        pixel_span(MIN(line->x0, line->x1) - half, MAX(line->x0, line->x1) + half, scale_x,
+                   viewport[2], &left, &right);
+        pixel_span(MIN(line->y0, line->y1) - half, MAX(line->y0, line->y1) + half, scale_y,
+                   viewport[3], &top, &bottom);
+
+        glScissor(viewport[0] + left, viewport[1] + viewport[3] - bottom, right - left,
+                  bottom - top);
+        glClearColor(line->color.red, line->color.green, line->color.blue, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
+
+// Rows go in bottom first, the way the framebuffer is laid out, so the
+// copy to the window is a straight blit. Textured quads and flipped blits
+// both cost a software rasterizer several times more on a full pane. The
+// texture keeps the pixels while the image's serial stays the same.
+static void upload_image(ScopeGL *gl, int i, const ScopeImage *image) {
+    cairo_surface_t *surface = image->surface;
+    if (image->serial != 0 && image->serial == gl->image_serial[i] &&
+        cairo_image_surface_get_width(surface) == gl->image_width[i] &&
+        cairo_image_surface_get_height(surface) == gl->image_height[i]) {
+        return;
+    }
+
+    cairo_surface_flush(surface);
+    const guint8 *pixels = cairo_image_surface_get_data(surface);
+    int w = cairo_image_surface_get_width(surface);
+    int h = cairo_image_surface_get_height(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    if (!pixels) return;
+
+    glBindTexture(GL_TEXTURE_2D, gl->image_textures[i]);
+    if (w != gl->image_width[i] || h != gl->image_height[i]) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_BGRA,
+                     GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gl->image_framebuffers[i]);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               gl->image_textures[i], 0);
+        gl->image_width[i] = w;
+        gl->image_height[i] = h;
+    }
+    for (int row = 0; row < h; row++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, h - 1 - row, w, 1, GL_BGRA,
+                        GL_UNSIGNED_INT_8_8_8_8_REV, pixels + (size_t)row * stride);
+    }
+    gl->image_serial[i] = image->serial;
+}
+
+// Straight copies onto the black background, scaled to the framebuffer's
+// pixels on HiDPI displays
+static void draw_images(ScopeGL *gl, const ScopeFrame *frame, GLint target) {
+    if (frame->num_images == 0) return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float scale_x = viewport[2] / (float)frame->graticule.width;
+    float scale_y = viewport[3] / (float)frame->graticule.height;
+
+    for (int i = 0; i < frame->num_images; i++) {
+        const ScopeImage *image = &frame->images[i];
+        upload_image(gl, i, image);
+        int w = gl->image_width[i];
+        int h = gl->image_height[i];
+        if (w == 0 || h == 0) continue;
+
+        GLint x0 = viewport[0] + lroundf(image->x * scale_x);
+        GLint x1 = viewport[0] + lroundf((image->x + w) * scale_x);
+        GLint y0 = viewport[1] + viewport[3] - lroundf((image->y + h) * scale_y);
+        GLint y1 = viewport[1] + viewport[3] - lroundf(image->y * scale_y);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gl->image_framebuffers[i]);
+        glBlitFramebuffer(0, 0, w, h, x0, y0, x1, y1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+}
+
+// Peak triangles and labels share one upload; the triangles sample the
+// atlas's solid block
+static void draw_overlay_text(ScopeGL *gl, const ScopeFrame *frame) {
+    size_t glyphs = count_glyphs(&frame->overlay);
+    if (frame->num_marks == 0 && glyphs == 0) return;
+
+    float *start = gl->vertices;
+    float *v = start;
+    for (int i = 0; i < frame->num_marks; i++) {
+        const ScopeMark *mark = &frame->marks[i];
+        const float triangle[3][4] = {
+            { mark->x, mark->y - 2, gl->solid_u, gl->solid_v },
+            { mark->x - 4, mark->y - 9, gl->solid_u, gl->solid_v },
+            { mark->x + 4, mark->y - 9, gl->solid_u, gl->solid_v },
+        };
+        memcpy(v, triangle, sizeof(triangle));
+        v += 3 * VERTEX_FLOATS;
+    }
+    v = put_labels(gl, &frame->overlay, frame->graticule.width, v);
+    upload_vertices(gl, gl->stream_buffer, (v - start) / VERTEX_FLOATS, GL_STREAM_DRAW);
+
+    if (frame->num_marks > 0) {
+        glUniform4f(gl->texture_tint, 1, 1, 1, 1);
+        glDrawArrays(GL_TRIANGLES, 0, frame->num_marks * 3);
+    }
+    draw_labels(gl, &frame->overlay, frame->num_marks * 3);
+}
+
+// Draws into the framebuffer bound by the area, whose viewport GTK has
+// already set
+gboolean scope_gl_render(ScopeGL *gl, const ScopeFrame *frame) {
+    if (!gl || !gl->realized || !frame) return FALSE;
+    float width = frame->graticule.width;
+    float height = frame->graticule.height;
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    draw_images(gl, frame, target);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(gl->vertex_array);
+    glActiveTexture(GL_TEXTURE0);
+    update_background(gl, frame);
+    draw_grid_rects(gl, frame);
+
+    glUseProgram(gl->stroke_program);
+    glUniform2f(gl->stroke_viewport, width, height);
+    bind_vertices(gl->background_lines);
+    draw_lines(gl, gl->grid_quads, gl->num_grid_quads);
+
+    glUseProgram(gl->texture_program);
+    glUniform2f(gl->texture_viewport, width, height);
+    glBindTexture(GL_TEXTURE_2D, gl->atlas_texture);
+    bind_vertices(gl->background_glyphs);
+    draw_labels(gl, &frame->background, 0);
+
+    glUseProgram(gl->stroke_program);
+    draw_curves(gl, frame);
+    upload_vertices(gl, gl->stream_buffer,
+                    stage_lines(gl, frame->overlay.lines, frame->overlay.num_lines),
+                    GL_STREAM_DRAW);
+    draw_lines(gl, frame->overlay.lines, frame->overlay.num_lines);
+
+    glUseProgram(gl->texture_program);
+    draw_overlay_text(gl, frame);
+
+    glUseProgram(0);
+    glBindVertexArray(0);
+
+#ifdef WAVEFORM_PROFILE
+    // Lets the caller's timer cover the drawing, so it compares with cairo
+    glFinish();
+#endif
+    return TRUE;
+}
@@ -1,9 +1,17 @@
 #include "scope_window.h"  // Must be first
 #include <math.h>
 #include "common_defs.h"
+#include "audio_manager.h"
+#include "scope_gl.h"
+#include "logger.h"
+#include "profile.h"
+#include "trace.h"
+#include "rt_pool.h"
 
+// rms is the signal level if already measured, negative to compute it here
 static gboolean find_trigger_point(const float *buffer, size_t buffer_size, 
-                                 size_t display_width, struct TriggerInfo *trigger) {
+                                 size_t display_width, struct TriggerInfo *trigger,
+                                 float rms) {
     if (!buffer || buffer_size < 4 || !trigger) {
         return FALSE;
     }
@@ -22,12 +30,14 @@ static gboolean find_trigger_point(const float *buffer, size_t buffer_size,
     }
 
     // Add RMS calculation to check signal level
-    float rms = 0.0f;
-    for (size_t i = 0; i < safe_size; i++) {
-        float sample = buffer[i * 2];
-        rms += sample * sample;
+    if (rms < 0.0f) {
+        rms = 0.0f;
+        for (size_t i = 0; i < safe_size; i++) {
+            float sample = buffer[i * 2];
+            rms += sample * sample;
+        }
+        rms = sqrtf(rms / safe_size);
     }
-    rms = sqrtf(rms / safe_size);
 
     // If signal is too low, use center of buffer
     if (rms < 0.01f) {  // Threshold for "too low"
@@ -78,8 +88,8 @@ static void on_size_allocate(GtkWidget *widget, GtkAllocation *allocation, gpoin
                 scope->window_width = allocation->width;
                 scope->window_height = allocation->height;
                 scope->size_changed = TRUE;
-                g_print("Scope window resized to: %dx%d\n", 
-                        scope->window_width, scope->window_height);
+                LOG_DEBUG("Scope window resized to: %dx%d", 
+                          scope->window_width, scope->window_height);
             }
             g_mutex_unlock(&scope->data_mutex);
         }
@@ -87,289 +97,581 @@ static void on_size_allocate(GtkWidget *widget, GtkAllocation *allocation, gpoin
     }
 }
 
-static gboolean on_draw(GtkWidget *widget, cairo_t *cr) {
-    g_print("Starting scope draw...\n");
-    
-    struct ScopeWindow *scope = (struct ScopeWindow *)g_object_get_data(G_OBJECT(widget), "scope");
-    if (!scope) {
-        g_print("Error: No scope data found for widget\n");
-        return FALSE;
+static const ScopeColor TEXT_COLOR = { 0.8f, 0.8f, 0.8f, 1.0f };
+static const ScopeColor WHITE = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+// Small triangles over the spectrum, positioned from the interpolated
+// frequency and level rather than the nearest pixel
+static void add_peak_markers(ScopeFrame *frame, const FFTPeak *peaks, int count, int width,
+                             int top, int pane_height, double log_span) {
+    for (int i = 0; i < count; i++) {
+        if (peaks[i].frequency < 20.0f) continue;
+
+        double x = width * log(peaks[i].frequency / 20.0) / log_span;
+        float level = fminf(fmaxf(peaks[i].magnitude_db, MIN_DB), MAX_DB);
+        double y = top + pane_height * (1.0 - (level - MIN_DB) / (MAX_DB - MIN_DB));
+        scope_frame_add_mark(frame, x, y);
+
+        // The rest carry only their frequency, to keep the pane readable
+        char label[48];
+        if (i == 0) {
+            snprintf(label, sizeof(label), "%.2f Hz  %.1f dBFS", peaks[i].frequency,
+                     peaks[i].level_dbfs);
+        } else {
+            snprintf(label, sizeof(label), "%.2f", peaks[i].frequency);
+        }
+        scope_frame_add_label(frame, x, fmax(y - 12, top + 12), 12, TRUE, WHITE, label);
     }
+}
 
-    scope->drawing_in_progress = TRUE;  // Add this line early
-    
-    // Get widget dimensions first
-    GtkAllocation allocation;
-    gtk_widget_get_allocation(widget, &allocation);
-    g_print("Widget dimensions: %d x %d\n", allocation.width, allocation.height);
-    int width = allocation.width;
-    int height = allocation.height;
+// Tracked tones in the waveform pane's top-left corner
+static void add_tone_readings(ScopeFrame *frame, struct ToneTracker *tracker) {
+    ToneReading readings[TONE_TRACKER_MAX];
+    int count = tone_tracker_read(tracker, readings, TONE_TRACKER_MAX);
+
+    for (int i = 0; i < count; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "%9.1f Hz  %7.2f dBFS  %7.1f deg", readings[i].frequency,
+                 readings[i].level_db, readings[i].phase * 180.0 / M_PI);
+        scope_frame_add_label(frame, 5, 15 + i * 13, 11, FALSE, TEXT_COLOR, line);
+    }
+}
+
+// Seconds with an engineering prefix, for periods and edge times
+static void format_time(char *out, size_t size, float seconds) {
+    if (seconds <= 0.0f) {
+        snprintf(out, size, "---");
+    } else if (seconds < 1e-3f) {
+        snprintf(out, size, "%.2f us", seconds * 1e6f);
+    } else if (seconds < 1.0f) {
+        snprintf(out, size, "%.3f ms", seconds * 1e3f);
+    } else {
+        snprintf(out, size, "%.3f s", seconds);
+    }
+}
+
+// Latest window's figures in the waveform pane's bottom-right corner
+static void add_measurements(ScopeFrame *frame, const WaveformMeasurement *m, int width, int height) {
+    char rise[16], fall[16], period[16];
+    format_time(rise, sizeof(rise), m->rise_time);
+    format_time(fall, sizeof(fall), m->fall_time);
+    format_time(period, sizeof(period), m->period);
+
+    char lines[6][64];
+    snprintf(lines[0], sizeof(lines[0]), "Vpp    %.4f V", m->vpp);
+    snprintf(lines[1], sizeof(lines[1]), "RMS    %.4f V  AC %.4f V", m->rms, m->ac_rms);
+    snprintf(lines[2], sizeof(lines[2]), "Mean   %.4f V  Crest %.2f", m->mean, m->crest_factor);
+    if (m->frequency > 0.0f) {
+        snprintf(lines[3], sizeof(lines[3]), "Freq   %.2f Hz  (%s)", m->frequency, period);
+        snprintf(lines[4], sizeof(lines[4]), "Duty   %.1f%%", m->duty_percent);
+    } else {
+        snprintf(lines[3], sizeof(lines[3]), "Freq   ---");
+        snprintf(lines[4], sizeof(lines[4]), "Duty   ---");
+    }
+    snprintf(lines[5], sizeof(lines[5]), "Rise   %s  Fall %s", rise, fall);
+
+    for (int i = 0; i < 6; i++) {
+        scope_frame_add_label(frame, width - 230, height - 10 - (5 - i) * 13, 11, FALSE,
+                              TEXT_COLOR, lines[i]);
+    }
+}
+
+#ifdef WAVEFORM_PROFILE
+#define PROFILE_OVERLAY_INTERVAL_US 500000
+
+// Stage timings in the waveform pane's top-right corner, merged from the
+// histograms twice a second
+static void add_profile(ScopeFrame *frame, int width) {
+    static ProfileReport report;
+    static gint64 updated;
+    gint64 now = g_get_monotonic_time();
+    if (now - updated >= PROFILE_OVERLAY_INTERVAL_US) {
+        profile_report(&report);
+        updated = now;
+    }
+
+    int line = 0;
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        const ProfileStageReport *stage = &report.stages[s];
+        if (stage->count == 0) continue;
+        char text[64];
+        snprintf(text, sizeof(text), "%-10s p50 %8.1f  p99 %8.1f us", stage->name,
+                 stage->p50_us, stage->p99_us);
+        scope_frame_add_label(frame, width - 280, 15 + line++ * 13, 11, FALSE, TEXT_COLOR, text);
+    }
+}
+#endif
+
+// THD, THD+N, SINAD, SNR and ENOB in the spectrum pane's top-right corner
+static void add_distortion(ScopeFrame *frame, const DistortionResult *result, int width, int top) {
+    char lines[6][64];
+    snprintf(lines[0], sizeof(lines[0]), "%.1f Hz  %.1f dBFS", result->fundamental_freq,
+             result->fundamental_dbfs);
+    snprintf(lines[1], sizeof(lines[1]), "THD    %.4f%%  %.1f dB", result->thd_percent, result->thd_db);
+    snprintf(lines[2], sizeof(lines[2]), "THD+N  %.4f%%  %.1f dB", result->thdn_percent, result->thdn_db);
+    snprintf(lines[3], sizeof(lines[3]), "SINAD  %.1f dB", result->sinad_db);
+    snprintf(lines[4], sizeof(lines[4]), "SNR    %.1f dB", result->snr_db);
+    snprintf(lines[5], sizeof(lines[5]), "ENOB   %.2f bits", result->enob);
+
+    for (int i = 0; i < 6; i++) {
+        scope_frame_add_label(frame, width - 200, top + 15 + i * 13, 11, FALSE,
+                              TEXT_COLOR, lines[i]);
+    }
+}
+
+static double transfer_db_y(float db, int top, int pane_height) {
+    float clamped = fminf(fmaxf(db, TRANSFER_MIN_DB), TRANSFER_MAX_DB);
+    return top + pane_height * (1.0 - (clamped - TRANSFER_MIN_DB) / (TRANSFER_MAX_DB - TRANSFER_MIN_DB));
+}
+
+// Magnitude response on the spectrum's log axis: H1 yellow, H2 orange and
+// coherence (0 at the bottom, 1 at the top) grey. Sweeps have only H1.
+static void add_transfer(ScopeFrame *frame, const TransferResult *result,
+                         int width, int top, int pane_height) {
+    double nyquist = result->sample_rate / 2.0;
+    double log_span = log(nyquist / 20.0);
+    double bin_hz = result->sample_rate / TRANSFER_FFT_SIZE;
+    gboolean welch = result->method == TRANSFER_WELCH;
+    frame->graticule.axes = SCOPE_AXES_TRANSFER;
+
+    const float *curves[] = {result->coherence, result->h2_db, result->h1_db};
+    const ScopeColor colors[] = {{0.5f, 0.5f, 0.5f, 0.8f}, {1, 0.5f, 0, 0.8f}, {1, 1, 0, 0.8f}};
+    for (int c = welch ? 0 : 2; c < 3; c++) {
+        float *y = scope_frame_add_curve(frame, width, c == 2 ? 1.5f : 1.0f, colors[c]);
+        for (int x = 0; y && x < width; x++) {
+            double freq = fmin(20.0 * exp((double)x / width * log_span), nyquist);
+            size_t bin = MIN((size_t)lround(freq / bin_hz), TRANSFER_BINS - 1);
+            y[x] = (c == 0) ? top + pane_height * (1.0 - curves[c][bin])
+                            : transfer_db_y(curves[c][bin], top, pane_height);
+        }
+    }
+
+    char label[64];
+    if (welch) {
+        snprintf(label, sizeof(label), "H1 / H2 / coherence, %d averages", result->averages);
+    } else {
+        snprintf(label, sizeof(label), "Sweep response, %d sweeps", result->averages);
+    }
+    scope_frame_add_label(frame, width - 240, top + 15, 12, FALSE, TEXT_COLOR, label);
+}
+
+// The grid follows the waveform pane; the image surface is kept between
+// draws and only recreated when the pane size changes. It is only redrawn
+// when the grid changed, so a paused or idle display uploads nothing.
+static gboolean add_phosphor(struct ScopeWindow *scope, ScopeFrame *frame, int width, int height,
+                             int sample_rate) {
+    if (!phosphor_set_size(scope->phosphor, width, height)) return FALSE;
+    phosphor_acquire(scope->phosphor, (float)sample_rate);
+
+    cairo_surface_t *surface = scope->phosphor_surface;
+    if (surface && (cairo_image_surface_get_width(surface) != width ||
+                    cairo_image_surface_get_height(surface) != height)) {
+        cairo_surface_destroy(surface);
+        surface = NULL;
+    }
+    if (!surface) {
+        surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+        scope->phosphor_surface = surface;
+        scope->phosphor_drawn = 0;
+    }
+
+    if (scope->phosphor_drawn != scope->phosphor->serial) {
+        cairo_surface_flush(surface);
+        guint8 *pixels = cairo_image_surface_get_data(surface);
+        if (!pixels || !phosphor_render(scope->phosphor, pixels,
+                                        cairo_image_surface_get_stride(surface), width, height)) {
+            scope->phosphor_drawn = 0;
+            return FALSE;
+        }
+        cairo_surface_mark_dirty(surface);
+        scope->phosphor_drawn = scope->phosphor->serial;
+        scope->phosphor_image = ++scope->image_serial;
+    }
+
+    scope_frame_add_image(frame, surface, 0, 0, scope->phosphor_image);
+    return TRUE;
+}
+
+// Keeps the newest SCOPE_BUFFER_SIZE pairs or more, dropping the older
+// half of the history whenever it fills
+static void drain_capture(struct ScopeWindow *scope) {
+    const size_t capacity = SCOPE_BUFFER_SIZE;
+    for (;;) {
+        if (scope->xy_frames == capacity) {
+            memmove(scope->xy_history, scope->xy_history + capacity, capacity * sizeof(float));
+            scope->xy_frames = capacity / 2;
+        }
+        size_t got = audio_manager_read_capture(scope->xy_audio,
+                                                scope->xy_history + scope->xy_frames * 2,
+                                                capacity - scope->xy_frames);
+        if (got == 0) break;
+        scope->xy_frames += got;
+        scope->xy_capture_serial++;
+    }
+}
+
+// Square plot centred in the waveform pane, ±XY_PLOT_FULL_SCALE on both
+// axes with the same eight divisions as the time display. The plot is
+// only redrawn when its pairs changed; data_serial is 0 when the channels
+// could not be copied this time.
+static void add_xy(struct ScopeWindow *scope, ScopeFrame *frame, int width, int height,
+                   const float *channels, size_t channel_frames, guint data_serial) {
+    int size = MIN(width, height);
+    if (size < 2 || !scope->xy) return;
+    int left = (width - size) / 2;
+    frame->graticule.xy_size = size;
+
+    const float *pairs = channels;
+    size_t frames = channel_frames;
+    guint serial = data_serial;
+    const char *label = "XY: Channel 1 vs 2";
+    float red = 0.2f, green = 1.0f, blue = 0.2f;
+    if (scope->xy_source == SCOPE_XY_CAPTURE) {
+        label = "XY: Output vs Input";
+        blue = 0.2f;
+        red = 1.0f;
+        if (scope->transfer) {
+            label = "XY: Input in use by the transfer measurement";
+        } else if (scope->xy_audio && scope->xy_audio->capture_enabled) {
+            drain_capture(scope);
+        } else {
+            label = "XY: Enable capture to plot the input";
+        }
+        pairs = scope->xy_history;
+        frames = scope->xy_frames;
+        serial = scope->xy_capture_serial;
+    }
+
+    cairo_surface_t *surface = scope->xy_surface;
+    if (surface && cairo_image_surface_get_width(surface) != size) {
+        cairo_surface_destroy(surface);
+        surface = NULL;
+    }
+    if (!surface) {
+        surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+        scope->xy_surface = surface;
+        scope->xy_drawn_serial = 0;
+    }
+
+    guint8 *pixels = cairo_image_surface_get_data(surface);
+    if (pixels) {
+        if (serial == 0 || serial != scope->xy_drawn_serial ||
+            scope->xy_source != scope->xy_drawn_source) {
+            cairo_surface_flush(surface);
+            xy_plot_render(scope->xy, pairs, frames, pixels,
+                           cairo_image_surface_get_stride(surface), size, red, green, blue);
+            cairo_surface_mark_dirty(surface);
+            scope->xy_drawn_source = scope->xy_source;
+            scope->xy_drawn_serial = serial;
+            scope->xy_image = ++scope->image_serial;
+        }
+        scope_frame_add_image(frame, surface, left, 0, scope->xy_image);
+    }
+
+    scope_frame_add_label(frame, left + 10, size - 10, 12, FALSE, TEXT_COLOR, label);
+}
+
+// Copies the latest data and runs the display-side analysis, leaving
+// everything to draw in scope->frame for either renderer
+static gboolean build_frame(struct ScopeWindow *scope, int width, int height) {
     if (width <= 0 || height <= 0) {
         return FALSE;
     }
-    
-    g_print("Calculating heights...\n");
+
     // Calculate split heights
     int wave_height = (height * 2) / 3;
     int fft_height = height - wave_height;
     scope->fft_height = fft_height;
 
-    g_print("Drawing background...\n");
-    // Draw black background - this is safe without data
-    cairo_set_source_rgb(cr, 0, 0, 0);
-    cairo_paint(cr);
+    ScopeFrame *frame = &scope->frame;
+    if (!scope_frame_begin(frame, width, height, wave_height)) {
+        return FALSE;
+    }
 
-    // Allocate local data buffer only if we'll use it
-    float *local_data = NULL;
+    // Copied out so the generator is not held up while the frame is built
+    float *local_data = scope->draw_data;
     size_t local_write_pos = 0;
+    guint local_data_serial = 0;
+    int local_sample_rate = DEFAULT_SAMPLE_RATE;
     gboolean have_data = FALSE;
+    SweepMarker local_markers[SCOPE_MAX_MARKERS];
+    int local_num_markers = 0;
+    guint64 local_end_time = 0;
+    float local_sweep_frequency = 0.0f;
 
-    g_print("Checking scope data size: %zu\n", scope->data_size);
     if (scope->data_size > 0) {
-        g_print("Allocating local buffer of size %zu\n", scope->data_size * 2 * sizeof(float));
-        local_data = g_malloc(scope->data_size * 2 * sizeof(float));
         if (local_data) {
-            g_print("Local buffer allocated at %p\n", (void*)local_data);
             if (g_mutex_trylock(&scope->data_mutex)) {
-                g_print("Data mutex locked, write_pos: %zu\n", scope->write_pos);
                 local_write_pos = scope->write_pos;
+                if (scope->sample_rate > 0) {
+                    local_sample_rate = scope->sample_rate;
+                }
                 if (local_write_pos > 0 && scope->waveform_data) {
-                    g_print("Copying %zu bytes from waveform_data\n", local_write_pos * 2 * sizeof(float));
                     memcpy(local_data, scope->waveform_data, local_write_pos * 2 * sizeof(float));
+                    local_data_serial = scope->data_serial;
                     have_data = TRUE;
                 }
+                local_end_time = scope->end_time;
+                local_num_markers = scope->num_markers;
+                memcpy(local_markers, scope->markers, local_num_markers * sizeof(SweepMarker));
+                local_sweep_frequency = scope->sweep_frequency;
                 g_mutex_unlock(&scope->data_mutex);
-                g_print("Data mutex unlocked\n");
+            } else {
+                TRACE_INSTANT("scope data locked");
             }
         } else {
-            g_print("Failed to allocate local buffer\n");
+            LOG_ERROR("No buffer to draw from");
         }
     }
 
-    g_print("Drawing waveform grid...\n");
-    // Draw waveform grid
-    cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
-    cairo_set_line_width(cr, 1.0);
-    
-    // Vertical divisions for waveform
-    float div_width = width / 12.0f;
-    for (int i = 0; i <= 12; i++) {
-        double x = i * div_width;
-        cairo_move_to(cr, x, 0);
-        cairo_line_to(cr, x, wave_height);
+    gboolean xy_mode = scope->xy_source != SCOPE_XY_OFF;
+    frame->graticule.time_grid = !xy_mode;
+
+    gboolean phosphor_drawn = FALSE;
+    if (xy_mode) {
+        add_xy(scope, frame, width, wave_height, local_data, have_data ? local_write_pos : 0,
+               local_data_serial);
+    } else if (scope->show_phosphor && scope->phosphor) {
+        phosphor_drawn = add_phosphor(scope, frame, width, wave_height, local_sample_rate);
     }
-    
-    // Horizontal divisions for waveform
-    float div_height = wave_height / 8.0f;
-    for (int i = 0; i <= 8; i++) {
-        double y = i * div_height;
-        cairo_move_to(cr, 0, y);
-        cairo_line_to(cr, width, y);
-    }
-    cairo_stroke(cr);
-
-    // Draw dividing line between waveform and FFT
-    cairo_set_source_rgb(cr, 0.3, 0.3, 0.3);
-    cairo_set_line_width(cr, 1.0);
-    cairo_move_to(cr, 0, wave_height);
-    cairo_line_to(cr, width, wave_height);
-    cairo_stroke(cr);
-    
-    g_print("Processing waveform data...\n");
-    // Draw waveform if we have data
-    if (have_data && local_write_pos > 0) {
-        float *display_data = g_malloc(width * sizeof(float));
-        if (display_data) {
-            g_print("Display buffer allocated at %p\n", (void*)display_data);
-            scope->trigger.valid = FALSE;  // Force new trigger search
-            find_trigger_point(local_data, local_write_pos, width, &scope->trigger);
-            
-            if (scope->trigger.valid) {
-                scope_window_downsample_buffer(local_data, local_write_pos,
-                                            display_data, width,
-                                            scope->trigger.position);
-                
-                // Draw waveform
-                cairo_set_source_rgb(cr, 0, 1, 0);
-                cairo_set_line_width(cr, 2.0);
-                
+
+    // The generator measures every block; its RMS also arms the trigger
+    WaveformMeasurement measurement;
+    gboolean have_measurement = waveform_measure_latest(scope->measure, &measurement);
+
+    if (have_data && local_write_pos > 0 && !xy_mode) {
+        PROFILE_START(trace_start);
+        scope->trigger.valid = FALSE;  // Force new trigger search
+        find_trigger_point(local_data, local_write_pos, width, &scope->trigger,
+                           have_measurement ? measurement.rms : -1.0f);
+
+        if (scope->trigger.valid) {
+            // Waveform, unless the phosphor image already shows it
+            float *trace = phosphor_drawn ? NULL :
+                scope_frame_add_curve(frame, width, 2.0f, (ScopeColor){0, 1, 0, 1});
+            if (trace) {
+                scope_window_downsample_buffer(local_data, local_write_pos, trace, width,
+                                               scope->trigger.position);
+
                 float half_height = wave_height / 2.0f;
                 float scale = wave_height / 4.0f;
-                
-                cairo_move_to(cr, 0, half_height - display_data[0] * scale);
-                for (int x = 1; x < width; x++) {
-                    cairo_line_to(cr, x, half_height - display_data[x] * scale);
+                for (int x = 0; x < width; x++) {
+                    trace[x] = half_height - trace[x] * scale;
                 }
-                cairo_stroke(cr);
-                
-                // Draw trigger marker
-                cairo_set_source_rgb(cr, 1, 0, 0);
-                cairo_set_line_width(cr, 1.0);
-                int trigger_x = width/3;
-                cairo_move_to(cr, trigger_x, 0);
-                cairo_line_to(cr, trigger_x, wave_height);
-                cairo_stroke(cr);
             }
-            
-            g_print("Freeing display buffer %p\n", (void*)display_data);
-            g_free(display_data);
+
+            // Trigger marker
+            int trigger_x = width/3;
+            scope_frame_add_line(frame, trigger_x, 0, trigger_x, wave_height, 1.0f,
+                                 (ScopeColor){1, 0, 0, 1});
+
+            // Sweep markers at their frame in the window: start and end
+            // in magenta, steps dim, settled steps bright cyan
+            for (int m = 0; m < local_num_markers; m++) {
+                guint64 age = local_end_time - local_markers[m].sample_time;
+                if (age > local_write_pos) continue;
+
+                float x = (double)(local_write_pos - age) * width / local_write_pos;
+                ScopeColor color;
+                switch (local_markers[m].kind) {
+                    case SWEEP_MARK_START:
+                    case SWEEP_MARK_END:
+                        color = (ScopeColor){1, 0, 1, 1};
+                        break;
+                    case SWEEP_MARK_STEP:
+                        color = (ScopeColor){0, 0.4f, 0.4f, 1};
+                        break;
+                    default:
+                        color = (ScopeColor){0, 1, 1, 1};
+                        break;
+                }
+                scope_frame_add_line(frame, x, 0, x, wave_height, 1.0f, color);
+            }
+        }
+        PROFILE_STOP(PROFILE_TRACE, trace_start);
+    }
+    if (scope->tracker) {
+        add_tone_readings(frame, scope->tracker);
+    }
+    if (have_measurement && scope->show_measurements && !xy_mode) {
+        add_measurements(frame, &measurement, width, wave_height);
+    }
+
+    // A running transfer measurement takes over the spectrum pane
+    gboolean show_transfer = FALSE;
+    if (scope->transfer && scope->show_fft) {
+        transfer_analyzer_read(scope->transfer, scope->transfer_result, &scope->transfer_serial);
+        show_transfer = scope->transfer_result->averages > 0;
+        if (show_transfer) {
+            add_transfer(frame, scope->transfer_result, width, wave_height, fft_height);
         }
     }
- g_print("Processing FFT data...\n");
-    // Draw FFT if enabled
-    if (have_data && scope->show_fft && scope->fft && local_write_pos > 0) {
+
+    if (have_data && scope->show_fft && scope->fft && local_write_pos > 0 && !show_transfer) {
         // Process current buffer through FFT
+        TRACE_BEGIN("fft");
+        PROFILE_START(fft_start);
         fft_analyzer_process(scope->fft, local_data, local_write_pos);
-        
-        // Draw FFT grid
-        cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
-        cairo_set_line_width(cr, 1.0);
-        
-        // Draw frequency grid lines
-        double freq_markers[] = {20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000};
-        int num_markers = sizeof(freq_markers) / sizeof(freq_markers[0]);
-        
-        for (int i = 0; i < num_markers; i++) {
-            double freq = freq_markers[i];
-            double log_pos = log(freq/20.0) / log(SAMPLE_RATE/2 / 20.0);
-            double x = width * log_pos;
-            
-            cairo_move_to(cr, x, wave_height);
-            cairo_line_to(cr, x, height);
-        }
-        cairo_stroke(cr);
-        
-        // Draw amplitude grid lines
-        for (int db = -80; db <= 0; db += 20) {
-            float y = wave_height + fft_height * (1.0 - (float)(db - MIN_DB) / (MAX_DB - MIN_DB));
-            cairo_move_to(cr, 0, y);
-            cairo_line_to(cr, width, y);
-        }
-        cairo_stroke(cr);
+        PROFILE_STOP(PROFILE_FFT, fft_start);
+        TRACE_END("fft");
+        PROFILE_START(spectrum_start);
+        gboolean have_distortion = scope->distortion &&
+            distortion_analyzer_process(scope->distortion, scope->fft, local_sample_rate);
+        frame->graticule.axes = SCOPE_AXES_SPECTRUM;
+        frame->graticule.sample_rate = local_sample_rate;
 
-        // Draw FFT spectrum
-        cairo_set_source_rgba(cr, 1, 1, 0, 0.8);
-        cairo_set_line_width(cr, 1.5);
-        
-        gboolean first_point = TRUE;
-        float max_magnitude = 0.0f;
-        float peak_x = 0;
-        float peak_y = 0;
-        float peak_freq = 0;
-        
-        for (int x = 0; x < width; x++) {
-            // Map screen position to frequency linearly in log space
-            double log_pos = (double)x / width;
-            double freq = 20.0 * exp(log_pos * log(SAMPLE_RATE/2 / 20.0));
-            freq = fmin(freq, SAMPLE_RATE/2);
-            
-            // Direct bin calculation
-            size_t bin = (size_t)((freq * FFT_SIZE) / SAMPLE_RATE);
-            bin = MIN(bin, FFT_SIZE/2);
-            
-            if (bin < FFT_SIZE/2) {
-                float magnitude = scope->fft->magnitudes[bin];
-                float y = wave_height + fft_height * (1.0f - magnitude);
-                y = fminf(fmaxf(y, wave_height), height);
-                
-                // Track maximum magnitude
-                if (magnitude > max_magnitude) {
-                    max_magnitude = magnitude;
-                    peak_x = x;
-                    peak_y = y;
-                    peak_freq = freq;
-                }
-                
-                if (first_point) {
-                    cairo_move_to(cr, x, y);
-                    first_point = FALSE;
-                } else {
-                    cairo_line_to(cr, x, y);
-                }
-            }
+        // Axis spans 20 Hz to the Nyquist frequency of the current stream
+        double nyquist = local_sample_rate / 2.0;
+        double log_span = log(nyquist / 20.0);
+
+        // Screen position maps to frequency linearly in log space
+        float *spectrum = scope_frame_add_curve(frame, width, 1.5f, (ScopeColor){1, 1, 0, 0.8f});
+        for (int x = 0; spectrum && x < width; x++) {
+            double freq = fmin(20.0 * exp((double)x / width * log_span), nyquist);
+            size_t bin = MIN((size_t)((freq * FFT_SIZE) / local_sample_rate), FFT_SIZE/2 - 1);
+            float y = wave_height + fft_height * (1.0f - scope->fft->magnitudes[bin]);
+            spectrum[x] = fminf(fmaxf(y, wave_height), height);
         }
-        cairo_stroke(cr);
 
-        // Draw labels
-        cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
-        cairo_set_font_size(cr, 10);
-        
-        // Frequency labels
-        for (int i = 0; i < num_markers; i++) {
-            double freq = freq_markers[i];
-            double log_pos = log(freq/20.0) / log(SAMPLE_RATE/2 / 20.0);
-            double x = width * log_pos;
-            
-            char freq_label[32];
-            if (freq >= 1000) {
-                snprintf(freq_label, sizeof(freq_label), "%.1fk", freq/1000.0);
-            } else {
-                snprintf(freq_label, sizeof(freq_label), "%.0f", freq);
-            }
-            
-            if (freq == 20 || freq == 100 || freq == 1000 || freq == 10000 || freq == 20000) {
-                cairo_move_to(cr, x - 10, height - 5);
-                cairo_show_text(cr, freq_label);
-            }
+        // Current sweep frequency
+        if (local_sweep_frequency >= 20.0f && local_sweep_frequency <= nyquist) {
+            float x = width * log(local_sweep_frequency / 20.0) / log_span;
+            scope_frame_add_line(frame, x, wave_height, x, height, 1.0f, (ScopeColor){0, 1, 1, 1});
         }
-        
-        // dB labels
-        for (int db = -80; db <= 0; db += 20) {
-            float y = wave_height + fft_height * (1.0 - (float)(db - MIN_DB) / (MAX_DB - MIN_DB));
-            char db_label[32];
-            snprintf(db_label, sizeof(db_label), "%ddB", db);
-            cairo_move_to(cr, 5, y - 2);
-            cairo_show_text(cr, db_label);
+
+        // Peaks found between bins: a marker on each, the strongest labelled
+        int num_peaks = fft_analyzer_find_peaks(scope->fft, local_sample_rate);
+        if (num_peaks > 0) {
+            add_peak_markers(frame, scope->fft->peaks, num_peaks, width, wave_height, fft_height,
+                             log_span);
         }
 
-        // Draw peak frequency label if we found a peak
-        if (max_magnitude > 0.01f) {  // Lower threshold to catch smaller peaks
-            cairo_set_source_rgb(cr, 1, 1, 1);  // White text
-            cairo_set_font_size(cr, 12);
-            
-            char freq_label[32];
-            if (peak_freq >= 1000) {
-                snprintf(freq_label, sizeof(freq_label), "%.1f kHz", peak_freq/1000.0);
-            } else {
-                snprintf(freq_label, sizeof(freq_label), "%.1f Hz", peak_freq);
-            }
-            
-            // Get text extents for centering
-            cairo_text_extents_t extents;
-            cairo_text_extents(cr, freq_label, &extents);
-            
-            // Position label 5 pixels above peak
-            double label_x = peak_x - (extents.width / 2);
-            double label_y = peak_y - 15;  // Move label further up for better visibility
-            
-            // Adjusted bounds checking - ensure we don't clip at wave_height
-            label_x = fmax(5, fmin(label_x, width - extents.width - 5));
-            label_y = fmin(label_y, height - 5);  // Only clamp at bottom of window
-            
-            cairo_move_to(cr, label_x, label_y);
-            cairo_show_text(cr, freq_label);
+        if (have_distortion) {
+            add_distortion(frame, &scope->distortion->result, width, wave_height);
         }
+        PROFILE_STOP(PROFILE_SPECTRUM, spectrum_start);
     }
-    
-    if (local_data) {
-        g_print("Freeing local buffer %p\n", (void*)local_data);
-        g_free(local_data);
+
+#ifdef WAVEFORM_PROFILE
+    add_profile(frame, width);
+#endif
+    scope_frame_end(frame);
+    return TRUE;
+}
+
+static gboolean on_draw(GtkWidget *widget, cairo_t *cr) {
+    struct ScopeWindow *scope = (struct ScopeWindow *)g_object_get_data(G_OBJECT(widget), "scope");
+    if (!scope) {
+        LOG_ERROR("No scope data found for widget");
+        return FALSE;
     }
 
-    scope->drawing_in_progress = FALSE;  // Add this line before return
-    
+    TRACE_BEGIN("scope draw");
+    PROFILE_START(frame_start);
+    scope->drawing_in_progress = TRUE;
+    GtkAllocation allocation;
+    gtk_widget_get_allocation(widget, &allocation);
+    if (build_frame(scope, allocation.width, allocation.height)) {
+        TRACE_BEGIN("rasterize");
+        PROFILE_START(draw_start);
+        scope_frame_draw(cr, &scope->frame);
+        PROFILE_STOP(PROFILE_RASTERIZE_CAIRO, draw_start);
+        TRACE_END("rasterize");
+    }
+    scope->drawing_in_progress = FALSE;
+    PROFILE_STOP(PROFILE_FRAME, frame_start);
+    TRACE_END("scope draw");
+    return TRUE;
+}
+
+static gboolean fall_back_to_cairo(gpointer data) {
+    scope_window_set_renderer((struct ScopeWindow *)data, SCOPE_RENDER_CAIRO);
+    return G_SOURCE_REMOVE;
+}
+
+// GTK has created the context by now; without a usable one the widget is
+// swapped for a cairo drawing area once this signal has returned
+static void on_gl_realize(GtkWidget *widget, gpointer data) {
+    struct ScopeWindow *scope = (struct ScopeWindow *)data;
+    GtkGLArea *area = GTK_GL_AREA(widget);
+
+    gtk_gl_area_make_current(area);
+    GError *error = gtk_gl_area_get_error(area);
+    if (error || !scope_gl_realize(scope->gl)) {
+        LOG_WARN("Scope: OpenGL renderer unavailable (%s), using cairo",
+                 error ? error->message : "see above");
+        g_idle_add(fall_back_to_cairo, scope);
+    }
+}
+
+static void on_gl_unrealize(GtkWidget *widget, gpointer data) {
+    struct ScopeWindow *scope = (struct ScopeWindow *)data;
+    GtkGLArea *area = GTK_GL_AREA(widget);
+
+    gtk_gl_area_make_current(area);
+    if (!gtk_gl_area_get_error(area) && scope->gl->realized) {
+        scope_gl_unrealize(scope->gl);
+    }
+}
+
+static gboolean on_gl_render(GtkGLArea *area, GdkGLContext *context, gpointer data) {
+    (void)context;
+    struct ScopeWindow *scope = (struct ScopeWindow *)data;
+
+    TRACE_BEGIN("scope draw");
+    PROFILE_START(frame_start);
+    scope->drawing_in_progress = TRUE;
+    GtkAllocation allocation;
+    gtk_widget_get_allocation(GTK_WIDGET(area), &allocation);
+    if (build_frame(scope, allocation.width, allocation.height)) {
+        // Command submission only; the driver may still be drawing after,
+        // except in profiling builds
+        TRACE_BEGIN("rasterize");
+        PROFILE_START(draw_start);
+        scope_gl_render(scope->gl, &scope->frame);
+        PROFILE_STOP(PROFILE_RASTERIZE_GL, draw_start);
+        TRACE_END("rasterize");
+    }
+    scope->drawing_in_progress = FALSE;
+    PROFILE_STOP(PROFILE_FRAME, frame_start);
+    TRACE_END("scope draw");
     return TRUE;
 }
+
+static GtkWidget* create_display(struct ScopeWindow *scope, ScopeRenderer renderer) {
+    GtkWidget *area;
+    if (renderer == SCOPE_RENDER_GL) {
+        area = gtk_gl_area_new();
+        gtk_gl_area_set_required_version(GTK_GL_AREA(area), 3, 2);
+        gtk_gl_area_set_has_alpha(GTK_GL_AREA(area), FALSE);
+        g_signal_connect(area, "realize", G_CALLBACK(on_gl_realize), scope);
+        g_signal_connect(area, "unrealize", G_CALLBACK(on_gl_unrealize), scope);
+        g_signal_connect(area, "render", G_CALLBACK(on_gl_render), scope);
+    } else {
+        area = gtk_drawing_area_new();
+        g_signal_connect(area, "draw", G_CALLBACK(on_draw), NULL);
+    }
+
+    gtk_widget_set_size_request(area, scope->window_width, scope->window_height);
+    g_object_set_data(G_OBJECT(area), "scope", scope);
+    gtk_widget_set_hexpand(area, TRUE);
+    gtk_widget_set_vexpand(area, TRUE);
+    g_signal_connect(area, "size-allocate", G_CALLBACK(on_size_allocate), scope);
+    return area;
+}
+
 struct ScopeWindow* scope_window_create(GtkWidget *parent, struct ParameterStore *params) {
-    g_print("Creating scope window\n");
+    LOG_INFO("Creating scope window");
     
     struct ScopeWindow *scope = g_new0(struct ScopeWindow, 1);
     scope->params = params;
     
     // Initialize data buffer
     scope->data_size = SCOPE_BUFFER_SIZE;
-    scope->waveform_data = g_malloc(sizeof(float) * scope->data_size * 2);
+    scope->waveform_data = rt_pool_new(float, scope->data_size * 2);
+    scope->draw_data = rt_pool_new(float, scope->data_size * 2);
     scope->write_pos = 0;
+    scope->sample_rate = DEFAULT_SAMPLE_RATE;
     
     // Initialize display parameters
     scope->time_scale = 1.0f;
@@ -391,41 +693,45 @@ struct ScopeWindow* scope_window_create(GtkWidget *parent, struct ParameterStore
     // Initialize FFT analyzer
     scope->fft = fft_analyzer_create();
     if (!scope->fft) {
-        g_print("Failed to create FFT analyzer\n");
-        g_free(scope->waveform_data);
+        LOG_ERROR("Failed to create FFT analyzer");
+        rt_pool_free(scope->waveform_data);
+        rt_pool_free(scope->draw_data);
         g_free(scope);
         return NULL;
     }
     
+    // Blackman-Harris sidelobes sit below the noise of a 24-bit path,
+    // so leakage does not count as noise in the distortion figures
+    fft_analyzer_set_window(scope->fft, FFT_WINDOW_BLACKMAN_HARRIS);
+    scope->distortion = distortion_analyzer_create();
+    scope->phosphor = phosphor_create();
+    scope->show_phosphor = FALSE;
+    scope->xy_source = SCOPE_XY_OFF;
+    scope->show_measurements = TRUE;
+    scope->xy = xy_plot_create(SCOPE_BUFFER_SIZE);
+    scope->xy_history = rt_pool_new(float, SCOPE_BUFFER_SIZE * 2);
+
     scope->show_fft = TRUE;
-    scope->fft_data = g_malloc(sizeof(float) * (FFT_SIZE/2 + 1));
+    scope->fft_data = rt_pool_new(float, FFT_SIZE/2 + 1);
     if (!scope->fft_data) {
-        g_print("Failed to allocate FFT display buffer\n");
+        LOG_ERROR("Failed to allocate FFT display buffer");
+        xy_plot_destroy(scope->xy);
+        rt_pool_free(scope->xy_history);
+        phosphor_destroy(scope->phosphor);
+        distortion_analyzer_destroy(scope->distortion);
         fft_analyzer_destroy(scope->fft);
-        g_free(scope->waveform_data);
+        rt_pool_free(scope->waveform_data);
+        rt_pool_free(scope->draw_data);
         g_free(scope);
         return NULL;
     }
     
-    memset(scope->fft_data, 0, sizeof(float) * (FFT_SIZE/2 + 1));
-    
     g_mutex_init(&scope->data_mutex);
     g_mutex_init(&scope->update_mutex);
     
-    // Create drawing area
-    scope->drawing_area = gtk_drawing_area_new();
-    gtk_widget_set_size_request(scope->drawing_area, 
-                             scope->window_width, 
-                             scope->window_height);
-    g_object_set_data(G_OBJECT(scope->drawing_area), "scope", scope);
-    gtk_widget_set_hexpand(scope->drawing_area, TRUE);
-    gtk_widget_set_vexpand(scope->drawing_area, TRUE);
-    
-    // Connect signals
-    g_signal_connect(scope->drawing_area, "draw", 
-                    G_CALLBACK(on_draw), NULL);
-    g_signal_connect(scope->drawing_area, "size-allocate", 
-                    G_CALLBACK(on_size_allocate), scope);
+    // Cairo until another renderer is picked
+    scope->renderer = SCOPE_RENDER_CAIRO;
+    scope->drawing_area = create_display(scope, scope->renderer);
     
     // Add to parent
     gtk_container_add(GTK_CONTAINER(parent), scope->drawing_area);
@@ -438,11 +744,11 @@ void scope_window_destroy(struct ScopeWindow *scope) {
     
     g_mutex_lock(&scope->data_mutex);
     if (scope->waveform_data) {
-        g_free(scope->waveform_data);
+        rt_pool_free(scope->waveform_data);
         scope->waveform_data = NULL;
     }
     if (scope->fft_data) {
-        g_free(scope->fft_data);
+        rt_pool_free(scope->fft_data);
         scope->fft_data = NULL;
     }
     g_mutex_unlock(&scope->data_mutex);
@@ -451,6 +757,20 @@ void scope_window_destroy(struct ScopeWindow *scope) {
         fft_analyzer_destroy(scope->fft);
         scope->fft = NULL;
     }
+    distortion_analyzer_destroy(scope->distortion);
+    g_free(scope->transfer_result);
+    phosphor_destroy(scope->phosphor);
+    if (scope->phosphor_surface) {
+        cairo_surface_destroy(scope->phosphor_surface);
+    }
+    xy_plot_destroy(scope->xy);
+    rt_pool_free(scope->xy_history);
+    rt_pool_free(scope->draw_data);
+    if (scope->xy_surface) {
+        cairo_surface_destroy(scope->xy_surface);
+    }
+    scope_gl_destroy(scope->gl);
+    scope_frame_free(&scope->frame);
     
     g_mutex_clear(&scope->data_mutex);
     g_mutex_clear(&scope->update_mutex);
@@ -465,6 +785,7 @@ void scope_window_update_data(struct ScopeWindow *scope, const float *data, size
     size_t samples_to_copy = MIN(count, scope->data_size);
     memcpy(scope->waveform_data, data, samples_to_copy * sizeof(float) * 2);
     scope->write_pos = samples_to_copy;
+    scope->data_serial++;
     g_mutex_unlock(&scope->data_mutex);
     
     // Modify this if check
@@ -480,7 +801,7 @@ void scope_window_downsample_buffer(const float *source_buffer, size_t source_sa
     // Safety checks
     if (!source_buffer || !display_buffer || source_samples == 0 || 
         display_width == 0 || trigger_position >= source_samples) {
-        g_print("Scope: Invalid parameters for downsampling\n");
+        LOG_ERROR("Scope: Invalid parameters for downsampling");
         memset(display_buffer, 0, display_width * sizeof(float));
         return;
     }
@@ -523,3 +844,88 @@ void scope_window_toggle_fft(struct ScopeWindow *scope, gboolean show) {
        gtk_widget_queue_draw(scope->drawing_area);
    }
 }
+
+void scope_window_set_tracker(struct ScopeWindow *scope, struct ToneTracker *tracker) {
+   if (!scope) return;
+   scope->tracker = tracker;
+}
+
+// The analyzer stays owned by the caller; NULL returns to the spectrum
+void scope_window_set_transfer(struct ScopeWindow *scope, struct TransferAnalyzer *analyzer) {
+   if (!scope) return;
+   if (analyzer && !scope->transfer_result) {
+       scope->transfer_result = g_new0(TransferResult, 1);
+   }
+   scope->transfer = analyzer;
+   scope->transfer_serial = 0;
+   if (scope->transfer_result) {
+       memset(scope->transfer_result, 0, sizeof(TransferResult));
+   }
+   if (scope->drawing_area) {
+       gtk_widget_queue_draw(scope->drawing_area);
+   }
+}
+
+// Each switch-on starts from a dark screen
+void scope_window_set_phosphor(struct ScopeWindow *scope, gboolean show) {
+   if (!scope || !scope->phosphor) return;
+   if (show && !scope->show_phosphor) {
+       phosphor_clear(scope->phosphor);
+   }
+   scope->show_phosphor = show;
+   if (scope->drawing_area) {
+       gtk_widget_queue_draw(scope->drawing_area);
+   }
+}
+
+// The audio manager is only needed for SCOPE_XY_CAPTURE and is not owned
+void scope_window_set_xy(struct ScopeWindow *scope, ScopeXYSource source, struct AudioManager *audio) {
+   if (!scope) return;
+   scope->xy_source = source;
+   scope->xy_audio = audio;
+   scope->xy_frames = 0;
+   scope->xy_capture_serial++;
+   if (scope->drawing_area) {
+       gtk_widget_queue_draw(scope->drawing_area);
+   }
+}
+
+void scope_window_set_measure(struct ScopeWindow *scope, struct WaveformMeasure *measure) {
+   if (!scope) return;
+   scope->measure = measure;
+}
+
+void scope_window_show_measurements(struct ScopeWindow *scope, gboolean show) {
+   if (!scope) return;
+   scope->show_measurements = show;
+   if (scope->drawing_area) {
+       gtk_widget_queue_draw(scope->drawing_area);
+   }
+}
+
+// Replaces the display widget. The generator queues redraws on it under
+// both locks, so it is swapped while holding them.
+void scope_window_set_renderer(struct ScopeWindow *scope, ScopeRenderer renderer) {
+   if (!scope || !scope->drawing_area || renderer == scope->renderer) return;
+   if (renderer == SCOPE_RENDER_GL && !scope->gl) {
+       scope->gl = scope_gl_create();
+       if (!scope->gl) return;
+   }
+
+   GtkWidget *old_area = scope->drawing_area;
+   GtkWidget *parent = gtk_widget_get_parent(old_area);
+   GtkWidget *area = create_display(scope, renderer);
+
+   g_mutex_lock(&scope->update_mutex);
+   g_mutex_lock(&scope->data_mutex);
+   scope->drawing_area = area;
+   scope->renderer = renderer;
+   g_mutex_unlock(&scope->data_mutex);
+   g_mutex_unlock(&scope->update_mutex);
+
+   gtk_widget_destroy(old_area);
+   if (parent) {
+       gtk_container_add(GTK_CONTAINER(parent), area);
+       gtk_widget_show(area);
+   }
+}
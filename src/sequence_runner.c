@@ -0,0 +1,554 @@
+#include "sequence_runner.h"
+#include "waveform_generator.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sndfile.h>
+
+#define LIVE_LOOKAHEAD_S 0.25     // Events are queued this far ahead of their time
+#define LIVE_POLL_US 2000
+#define APPLIED_READ_CHUNK 64
+#define APPLIED_UNKNOWN G_MAXUINT64
+
+// When each step took effect, relative to the sequence start. Parameter
+// events are tagged with their step index + 1 and reported by the render
+// thread once applied.
+typedef struct {
+    ParamEventQueue *queue;
+    int num_steps;
+    guint64 *frames;
+    guint64 origin;
+    gint cursor;
+    int late_before;
+} AppliedLog;
+
+typedef struct {
+    const char *name;
+    void (*setter)(struct ParameterStore *store, float freq, float depth);
+} LfoCommand;
+
+static const LfoCommand lfo_commands[] = {
+    { "fm", parameter_store_set_fm },
+    { "am", parameter_store_set_am },
+    { "dcm", parameter_store_set_dcm },
+    { "cutoff-lfo", parameter_store_set_filter_cutoff_lfo },
+    { "res-lfo", parameter_store_set_filter_res_lfo },
+    { NULL, NULL }
+};
+
+static const struct {
+    const char *name;
+    WaveformType type;
+} waveform_names[] = {
+    { "sine", WAVE_SINE },
+    { "square", WAVE_SQUARE },
+    { "saw", WAVE_SAW },
+    { "sawtooth", WAVE_SAW },
+    { "triangle", WAVE_TRIANGLE },
+    { "noise", WAVE_PINK_NOISE },
+    { "pinknoise", WAVE_PINK_NOISE },
+    { "sweep", WAVE_SWEEP },
+    { NULL, 0 }
+};
+
+// Case-insensitive match ignoring anything but letters and digits, so
+// "filter-cutoff", "filter_cutoff" and "Filter Cutoff" are the same name
+static bool name_matches(const char *token, const char *name) {
+    while (*token || *name) {
+        if (*token && !g_ascii_isalnum(*token)) { token++; continue; }
+        if (*name && !g_ascii_isalnum(*name)) { name++; continue; }
+        if (g_ascii_tolower(*token) != g_ascii_tolower(*name)) return false;
+        token++;
+        name++;
+    }
+    return true;
+}
+
+static bool parse_number(const char *token, double *value) {
+    char *end = NULL;
+    *value = g_ascii_strtod(token, &end);
+    return end != token && *end == '\0' && isfinite(*value);
+}
+
+static bool parse_param(const char *token, ParamId *param) {
+    for (int p = 0; p < PARAM_COUNT; p++) {
+        if (name_matches(token, param_id_name(p))) {
+            *param = p;
+            return true;
+        }
+    }
+    // Short forms used in hand-written sequences
+    if (name_matches(token, "duty")) { *param = PARAM_DUTY_CYCLE; return true; }
+    if (name_matches(token, "cutoff")) { *param = PARAM_FILTER_CUTOFF; return true; }
+    if (name_matches(token, "resonance")) { *param = PARAM_FILTER_RESONANCE; return true; }
+    return false;
+}
+
+// Returns 1 for a step, 0 for a cursor move and -1 for a bad line
+static int parse_line(SequenceStep *step, gchar **tok, int count, double *cursor, double *duration) {
+    double a, b, c;
+    const char *cmd = tok[0];
+
+    step->time = *cursor;
+
+    if (!strcmp(cmd, "hold") && count == 2 && parse_number(tok[1], &a) && a >= 0.0) {
+        *cursor += a;
+        *duration = fmax(*duration, *cursor);
+        return 0;
+    }
+    if (!strcmp(cmd, "at") && count == 2 && parse_number(tok[1], &a) && a >= *cursor) {
+        *cursor = a;
+        *duration = fmax(*duration, *cursor);
+        return 0;
+    }
+
+    if (!strcmp(cmd, "set") && count == 3 &&
+        parse_param(tok[1], &step->event.param) && parse_number(tok[2], &a)) {
+        step->type = SEQUENCE_EVENT;
+        step->event.value = (float)a;
+        step->event.shape = PARAM_RAMP_STEP;
+        return 1;
+    }
+    if (!strcmp(cmd, "ramp") && (count == 4 || count == 5) &&
+        parse_param(tok[1], &step->event.param) && parse_number(tok[2], &a) &&
+        parse_number(tok[3], &b) && b >= 0.0) {
+        step->type = SEQUENCE_EVENT;
+        step->event.value = (float)a;
+        step->ramp_seconds = b;
+        step->event.shape = PARAM_RAMP_LINEAR;
+        if (count == 5) {
+            if (!strcmp(tok[4], "exp")) step->event.shape = PARAM_RAMP_EXPONENTIAL;
+            else if (strcmp(tok[4], "linear")) return -1;
+        }
+        *duration = fmax(*duration, *cursor + b);
+        return 1;
+    }
+    if (!strcmp(cmd, "waveform") && count == 2) {
+        for (int i = 0; waveform_names[i].name; i++) {
+            if (name_matches(tok[1], waveform_names[i].name)) {
+                step->type = SEQUENCE_WAVEFORM;
+                step->index = waveform_names[i].type;
+                return 1;
+            }
+        }
+        return -1;
+    }
+    for (int i = 0; lfo_commands[i].name; i++) {
+        if (!strcmp(cmd, lfo_commands[i].name) && count == 3 &&
+            parse_number(tok[1], &a) && parse_number(tok[2], &b) && a >= 0.0) {
+            step->type = SEQUENCE_LFO;
+            step->lfo_setter = lfo_commands[i].setter;
+            step->freq = (float)a;
+            step->depth = (float)b;
+            return 1;
+        }
+    }
+    if (!strcmp(cmd, "mod-source") && count == 4 && parse_number(tok[1], &a) &&
+        a >= 1 && a <= MOD_MAX_SOURCES && parse_number(tok[3], &b) && b >= 0.0) {
+        for (int shape = 0; shape < MOD_SHAPE_COUNT; shape++) {
+            if (name_matches(tok[2], mod_shape_name(shape))) {
+                step->type = SEQUENCE_MOD_SOURCE;
+                step->index = (int)a - 1;
+                step->shape = shape;
+                step->freq = (float)b;
+                return 1;
+            }
+        }
+        return -1;
+    }
+    if (!strcmp(cmd, "mod-route") && count == 5 && parse_number(tok[1], &a) &&
+        a >= 1 && a <= MOD_MAX_ROUTES && parse_number(tok[2], &b) &&
+        b >= 0 && b <= MOD_MAX_SOURCES && parse_number(tok[4], &c)) {
+        for (int dest = 0; dest < MOD_DEST_COUNT; dest++) {
+            if (name_matches(tok[3], mod_destination_name(dest))) {
+                step->type = SEQUENCE_MOD_ROUTE;
+                step->index = (int)a - 1;
+                step->source = (int)b - 1;
+                step->shape = dest;
+                step->depth = (float)c;
+                return 1;
+            }
+        }
+        return -1;
+    }
+    if (!strcmp(cmd, "sweep") && (count == 5 || count == 7) &&
+        parse_number(tok[2], &a) && parse_number(tok[3], &b) && parse_number(tok[4], &c)) {
+        static const char *types[SWEEP_TYPE_COUNT] = { "linear", "exp", "stepped" };
+        SweepConfig *sweep = &step->sweep;
+        sweep_config_default(sweep);
+        sweep->type = SWEEP_TYPE_COUNT;
+        for (int type = 0; type < SWEEP_TYPE_COUNT; type++) {
+            if (!strcmp(tok[1], types[type])) sweep->type = type;
+        }
+        sweep->start_freq = (float)a;
+        sweep->end_freq = (float)b;
+        if (sweep->type == SWEEP_STEPPED) {
+            double settle, dwell;
+            if (count != 7 || !parse_number(tok[5], &settle) || !parse_number(tok[6], &dwell)) {
+                return -1;
+            }
+            sweep->steps = (int)c;
+            sweep->settle = (float)settle;
+            sweep->dwell = (float)dwell;
+        } else if (count == 5) {
+            sweep->duration = (float)c;
+        } else {
+            return -1;
+        }
+        // Nyquist is checked when the sweep starts, at the rate it runs at
+        if (!sweep_config_valid(sweep, G_MAXFLOAT)) return -1;
+
+        step->type = SEQUENCE_SWEEP;
+        *duration = fmax(*duration, *cursor + sweep_duration(sweep));
+        return 1;
+    }
+
+    return -1;
+}
+
+Sequence* sequence_load(const char *path) {
+    gchar *contents = NULL;
+    GError *error = NULL;
+
+    if (!g_file_get_contents(path, &contents, NULL, &error)) {
+        LOG_ERROR("Sequence: %s", error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    Sequence *sequence = g_new0(Sequence, 1);
+    sequence->path = g_strdup(path);
+
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    int capacity = 0;
+    double cursor = 0.0;
+    bool ok = true;
+
+    for (int n = 0; lines[n]; n++) {
+        gchar *comment = strchr(lines[n], '#');
+        if (comment) *comment = '\0';
+        g_strstrip(lines[n]);
+        if (!lines[n][0]) continue;
+
+        // Collapse runs of blanks so the token count is meaningful
+        gchar **raw = g_strsplit_set(lines[n], " \t", -1);
+        gchar *tok[9];
+        int count = 0;
+        for (int i = 0; raw[i] && count < 8; i++) {
+            if (raw[i][0]) tok[count++] = raw[i];
+        }
+        tok[count] = NULL;
+
+        SequenceStep step = { .line = n + 1 };
+        int parsed = parse_line(&step, tok, count, &cursor, &sequence->duration);
+        if (parsed < 0) {
+            LOG_ERROR("Sequence %s:%d: Cannot parse '%s'", path, n + 1, lines[n]);
+            ok = false;
+        } else if (parsed > 0) {
+            if (sequence->num_steps == capacity) {
+                capacity = MAX(capacity * 2, 64);
+                sequence->steps = g_renew(SequenceStep, sequence->steps, capacity);
+            }
+            step.text = g_strdup(lines[n]);
+            sequence->steps[sequence->num_steps++] = step;
+        }
+        g_strfreev(raw);
+    }
+
+    g_strfreev(lines);
+    g_free(contents);
+
+    // Events due on one frame are all queued before any is applied, so more
+    // than the queue holds cannot be delivered. Steps are in time order.
+    int same_time = 0;
+    double last_time = -1.0;
+    for (int i = 0; ok && i < sequence->num_steps; i++) {
+        const SequenceStep *step = &sequence->steps[i];
+        if (step->type != SEQUENCE_EVENT) continue;
+        same_time = step->time == last_time ? same_time + 1 : 1;
+        last_time = step->time;
+        if (same_time > PARAM_EVENT_QUEUE_SIZE - 1) {
+            LOG_ERROR("Sequence %s:%d: More than %d parameter events at %.6f s",
+                      path, step->line, PARAM_EVENT_QUEUE_SIZE - 1, step->time);
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        sequence_destroy(sequence);
+        return NULL;
+    }
+    return sequence;
+}
+
+void sequence_destroy(Sequence *sequence) {
+    if (!sequence) return;
+
+    for (int i = 0; i < sequence->num_steps; i++) {
+        g_free(sequence->steps[i].text);
+    }
+    g_free(sequence->steps);
+    g_free(sequence->path);
+    g_free(sequence);
+}
+
+static guint64 seconds_to_frames(double seconds, int sample_rate) {
+    return (guint64)llround(seconds * sample_rate);
+}
+
+// Everything except parameter events goes through the store
+static void apply_store_step(const SequenceStep *step, struct ParameterStore *params) {
+    switch (step->type) {
+        case SEQUENCE_WAVEFORM:
+            parameter_store_set_waveform(params, step->index);
+            break;
+        case SEQUENCE_LFO:
+            step->lfo_setter(params, step->freq, step->depth);
+            break;
+        case SEQUENCE_MOD_SOURCE:
+            parameter_store_set_mod_source(params, step->index, step->shape, step->freq);
+            break;
+        case SEQUENCE_MOD_ROUTE:
+            parameter_store_set_mod_route(params, step->index, step->source, step->shape, step->depth);
+            break;
+        case SEQUENCE_SWEEP:
+            parameter_store_set_sweep(params, &step->sweep);
+            parameter_store_set_waveform(params, WAVE_SWEEP);
+            break;
+        case SEQUENCE_EVENT:
+            break;
+    }
+}
+
+static bool push_event(const Sequence *sequence, int index, WaveformGenerator *gen,
+                       guint64 sample_time, int sample_rate) {
+    const SequenceStep *step = &sequence->steps[index];
+    ParamEvent event = step->event;
+    event.sample_time = sample_time;
+    event.ramp_frames = (guint32)seconds_to_frames(step->ramp_seconds, sample_rate);
+    event.tag = (guint32)index + 1;
+    return param_event_queue_push(gen->events, &event);
+}
+
+static void applied_log_init(AppliedLog *applied, const Sequence *sequence,
+                             WaveformGenerator *gen, guint64 origin) {
+    applied->queue = gen->events;
+    applied->num_steps = sequence->num_steps;
+    applied->frames = g_new(guint64, MAX(sequence->num_steps, 1));
+    for (int i = 0; i < sequence->num_steps; i++) {
+        applied->frames[i] = APPLIED_UNKNOWN;
+    }
+    applied->origin = origin;
+    applied->cursor = g_atomic_int_get(&gen->events->applied_written);
+    applied->late_before = param_event_queue_late_events(gen->events);
+}
+
+// Picks up the events the render thread has applied since the last call
+static void applied_log_collect(AppliedLog *applied) {
+    ParamEventApplied records[APPLIED_READ_CHUNK];
+    int count;
+
+    while ((count = param_event_queue_read_applied(applied->queue, &applied->cursor,
+                                                   records, APPLIED_READ_CHUNK)) > 0) {
+        for (int i = 0; i < count; i++) {
+            guint32 tag = records[i].tag;
+            if (tag == 0 || tag > (guint32)applied->num_steps) continue;
+            applied->frames[tag - 1] = records[i].applied_time - applied->origin;
+        }
+    }
+}
+
+// Written once the run is over, so every step has its applied frame. An
+// event that never took effect shows '-'.
+static void write_log(const Sequence *sequence, const char *log_path, int sample_rate,
+                      const AppliedLog *applied, const char *result) {
+    if (!log_path) return;
+
+    FILE *log = fopen(log_path, "w");
+    if (!log) {
+        LOG_ERROR("Sequence: Cannot write '%s'", log_path);
+        return;
+    }
+    fprintf(log, "# sequence %s, %d Hz, %.6f s\n", sequence->path, sample_rate, sequence->duration);
+    fprintf(log, "# line scheduled_s scheduled_frame applied_frame late_frames command\n");
+
+    for (int i = 0; i < sequence->num_steps; i++) {
+        const SequenceStep *step = &sequence->steps[i];
+        guint64 scheduled = seconds_to_frames(step->time, sample_rate);
+        guint64 frame = applied->frames[i];
+
+        if (frame == APPLIED_UNKNOWN) {
+            fprintf(log, "%d %.6f %" G_GUINT64_FORMAT " - - %s\n",
+                    step->line, step->time, scheduled, step->text);
+        } else {
+            fprintf(log, "%d %.6f %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %s\n",
+                    step->line, step->time, scheduled, frame,
+                    frame > scheduled ? frame - scheduled : 0, step->text);
+        }
+    }
+
+    fprintf(log, "# late events: %d\n",
+            param_event_queue_late_events(applied->queue) - applied->late_before);
+    fprintf(log, "# %s\n", result);
+    fclose(log);
+}
+
+static bool write_frames(SNDFILE *file, WaveformGenerator *gen, float *block,
+                         guint64 frames) {
+    while (frames > 0) {
+        size_t n = (size_t)MIN(frames, (guint64)MAX_BLOCK_SIZE);
+        waveform_generator_render(gen, block, n);
+        if (file && sf_writef_float(file, block, n) != (sf_count_t)n) {
+            LOG_ERROR("Sequence: Write failed: %s", sf_strerror(file));
+            return false;
+        }
+        frames -= n;
+    }
+    return true;
+}
+
+bool sequence_render(const Sequence *sequence, int sample_rate, int channels,
+                     const char *wav_path, const char *log_path) {
+    if (!sequence || sample_rate <= 0 || channels <= 0 || channels > MAX_OUTPUT_CHANNELS) {
+        return false;
+    }
+
+    struct ParameterStore *params = parameter_store_create();
+    WaveformGenerator *gen = waveform_generator_create(params, NULL, NULL);
+    if (!gen) {
+        parameter_store_destroy(params);
+        return false;
+    }
+    waveform_generator_set_sample_rate(gen, sample_rate);
+    waveform_generator_set_channels(gen, channels);
+
+    SNDFILE *file = NULL;
+    if (wav_path) {
+        SF_INFO info = {
+            .samplerate = sample_rate,
+            .channels = channels,
+            .format = SF_FORMAT_WAV | SF_FORMAT_FLOAT
+        };
+        file = sf_open(wav_path, SFM_WRITE, &info);
+        if (!file) {
+            LOG_ERROR("Sequence: Failed to open '%s': %s", wav_path, sf_strerror(NULL));
+        }
+    }
+
+    AppliedLog applied;
+    applied_log_init(&applied, sequence, gen, 0);
+    float *block = g_malloc(MAX_BLOCK_SIZE * channels * sizeof(float));
+    gint64 started = g_get_monotonic_time();
+    bool ok = !wav_path || file;
+    guint64 cursor = 0;
+
+    // Render up to each step, then apply it: store changes land on the
+    // same sample as parameter events
+    for (int i = 0; ok && i < sequence->num_steps; i++) {
+        const SequenceStep *step = &sequence->steps[i];
+        guint64 at = seconds_to_frames(step->time, sample_rate);
+
+        ok = write_frames(file, gen, block, at - cursor);
+        applied_log_collect(&applied);
+        cursor = at;
+
+        if (step->type == SEQUENCE_EVENT) {
+            if (ok && !push_event(sequence, i, gen, at, sample_rate)) {
+                LOG_ERROR("Sequence %s:%d: Parameter event queue full", sequence->path, step->line);
+                ok = false;
+            }
+        } else {
+            apply_store_step(step, params);
+            applied.frames[i] = at;
+        }
+    }
+
+    guint64 total = seconds_to_frames(sequence->duration, sample_rate);
+    if (ok && total > cursor) {
+        ok = write_frames(file, gen, block, total - cursor);
+    }
+    applied_log_collect(&applied);
+
+    gchar *result = g_strdup_printf("%s: %" G_GUINT64_FORMAT " frames in %.1f ms",
+                                    ok ? "done" : "failed", total,
+                                    (g_get_monotonic_time() - started) / 1000.0);
+    write_log(sequence, log_path, sample_rate, &applied, result);
+    g_free(result);
+    g_free(applied.frames);
+
+    if (file) sf_close(file);
+    g_free(block);
+    waveform_generator_destroy(gen);
+    parameter_store_destroy(params);
+    return ok;
+}
+
+// Sleeps until the generator clock reaches `frame`, collecting applied
+// events meanwhile; false if cancelled
+static bool wait_for_frame(WaveformGenerator *gen, guint64 frame, gint *cancel, guint64 *now,
+                           AppliedLog *applied) {
+    while ((*now = waveform_generator_get_sample_time(gen)) < frame) {
+        if (cancel && g_atomic_int_get(cancel)) return false;
+        applied_log_collect(applied);
+        g_usleep(LIVE_POLL_US);
+    }
+    applied_log_collect(applied);
+    return true;
+}
+
+// The queue frees up as the generator reaches earlier events, so a full
+// queue only delays the push; false if cancelled
+static bool push_event_live(const Sequence *sequence, int index, WaveformGenerator *gen,
+                            guint64 sample_time, int sample_rate, gint *cancel,
+                            AppliedLog *applied) {
+    while (!push_event(sequence, index, gen, sample_time, sample_rate)) {
+        if (cancel && g_atomic_int_get(cancel)) return false;
+        applied_log_collect(applied);
+        g_usleep(LIVE_POLL_US);
+    }
+    return true;
+}
+
+bool sequence_run_live(const Sequence *sequence, WaveformGenerator *gen,
+                       const char *log_path, gint *cancel) {
+    if (!sequence || !gen) return false;
+
+    int sample_rate = (int)waveform_generator_get_sample_rate(gen);
+    guint64 lookahead = seconds_to_frames(LIVE_LOOKAHEAD_S, sample_rate);
+    bool ok = true;
+
+    // Start one lookahead out so the first events are not already late
+    guint64 start = waveform_generator_get_sample_time(gen) + lookahead;
+    AppliedLog applied;
+    applied_log_init(&applied, sequence, gen, start);
+
+    for (int i = 0; ok && i < sequence->num_steps; i++) {
+        const SequenceStep *step = &sequence->steps[i];
+        guint64 at = start + seconds_to_frames(step->time, sample_rate);
+        guint64 due = (step->type == SEQUENCE_EVENT && at > lookahead) ? at - lookahead : at;
+        guint64 now;
+
+        if (!wait_for_frame(gen, due, cancel, &now, &applied)) {
+            ok = false;
+            break;
+        }
+
+        if (step->type == SEQUENCE_EVENT) {
+            // Queued ahead, so it lands on its sample unless we woke too late
+            ok = push_event_live(sequence, i, gen, at, sample_rate, cancel, &applied);
+        } else {
+            apply_store_step(step, gen->params);
+            applied.frames[i] = now - start;
+        }
+    }
+
+    guint64 end = start + seconds_to_frames(sequence->duration, sample_rate);
+    guint64 now;
+    ok = ok && wait_for_frame(gen, end, cancel, &now, &applied);
+
+    write_log(sequence, log_path, sample_rate, &applied, ok ? "done" : "failed");
+    g_free(applied.frames);
+    return ok;
+}
@@ -0,0 +1,262 @@
+#include "sweep.h"
+#include "logger.h"
+#include "publish_ring.h"
+#include <string.h>
+#include <math.h>
+
+#define TWO_PI (2.0 * M_PI)
+
+void sweep_config_default(SweepConfig *config) {
+    config->type = SWEEP_EXPONENTIAL;
+    config->start_freq = 20.0f;
+    config->end_freq = 20000.0f;
+    config->duration = 10.0f;
+    config->steps = 31;
+    config->settle = 0.05f;
+    config->dwell = 0.1f;
+    config->loop = FALSE;
+}
+
+gboolean sweep_config_valid(const SweepConfig *config, float sample_rate) {
+    float nyquist = sample_rate * 0.5f;
+
+    if (config->type < 0 || config->type >= SWEEP_TYPE_COUNT) return FALSE;
+    if (config->start_freq <= 0.0f || config->start_freq >= nyquist) return FALSE;
+    if (config->end_freq <= 0.0f || config->end_freq >= nyquist) return FALSE;
+
+    if (config->type == SWEEP_STEPPED) {
+        return config->steps >= 2 && config->steps <= SWEEP_MAX_STEPS &&
+               config->settle >= 0.0f && config->dwell > 0.0f;
+    }
+    return config->duration > 0.0f;
+}
+
+double sweep_duration(const SweepConfig *config) {
+    if (config->type == SWEEP_STEPPED) {
+        return config->steps * ((double)config->settle + config->dwell);
+    }
+    return config->duration;
+}
+
+// Instantaneous frequency `seconds` into a sweep, for mapping marker
+// times or analysis windows back to frequency
+double sweep_frequency_at(const SweepConfig *config, double seconds) {
+    double f1 = config->start_freq;
+    double f2 = config->end_freq;
+    double t = fmax(0.0, fmin(seconds, sweep_duration(config)));
+
+    switch (config->type) {
+        case SWEEP_LINEAR:
+            return f1 + (f2 - f1) * t / config->duration;
+
+        case SWEEP_EXPONENTIAL:
+            return f1 * pow(f2 / f1, t / config->duration);
+
+        case SWEEP_STEPPED: {
+            int step = (int)(t / ((double)config->settle + config->dwell));
+            step = MIN(step, config->steps - 1);
+            return f1 * pow(f2 / f1, (double)step / (config->steps - 1));
+        }
+
+        default:
+            return 0.0;
+    }
+}
+
+// Phase and increment at the current position from the closed form:
+//   linear       phi(t) = 2*pi * (f1*t + k*t^2/2),        k = (f2 - f1) / T
+//   exponential  phi(t) = 2*pi * f1 * L * (e^(t/L) - 1),  L = T / ln(f2 / f1)
+// Stepped sweeps hold a constant increment per step and keep their phase.
+static void sync_phase(Sweep *sweep) {
+    double fs = sweep->sample_rate;
+    double n = (double)sweep->position;
+    double f1 = sweep->config.start_freq;
+
+    switch (sweep->config.type) {
+        case SWEEP_LINEAR:
+            sweep->phase = fmod(TWO_PI / fs * (f1 * n + sweep->rate * n * n / (2.0 * fs)), TWO_PI);
+            sweep->inc = TWO_PI / fs * (f1 + sweep->rate * (2.0 * n + 1.0) / (2.0 * fs));
+            break;
+
+        case SWEEP_EXPONENTIAL: {
+            double L = sweep->rate;
+            double growth = exp(n / (L * fs));
+            sweep->phase = fmod(TWO_PI * f1 * L * (growth - 1.0), TWO_PI);
+            sweep->inc = TWO_PI * f1 * L * growth * expm1(1.0 / (L * fs));
+            break;
+        }
+
+        case SWEEP_STEPPED: {
+            guint64 step = sweep->position / sweep->step_frames;
+            sweep->inc = TWO_PI / fs * f1 * pow(sweep->step_ratio, (double)step);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void sweep_start(Sweep *sweep, const SweepConfig *config, float sample_rate, guint64 now) {
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->config = *config;
+    sweep->sample_rate = sample_rate;
+    sweep->origin = now;
+
+    if (!sweep_config_valid(config, sample_rate)) {
+        LOG_ERROR("Sweep: Invalid %s sweep, %.1f-%.1f Hz", sweep_type_name(config->type),
+                  config->start_freq, config->end_freq);
+        return;
+    }
+
+    double fs = sample_rate;
+    double f1 = config->start_freq;
+    double f2 = config->end_freq;
+
+    // Equal end frequencies make the exponential rate infinite; the linear
+    // form gives the same constant tone
+    if (sweep->config.type == SWEEP_EXPONENTIAL && f1 == f2) {
+        sweep->config.type = SWEEP_LINEAR;
+    }
+
+    switch (sweep->config.type) {
+        case SWEEP_LINEAR:
+            sweep->rate = (f2 - f1) / config->duration;
+            sweep->inc_step = TWO_PI * sweep->rate / (fs * fs);
+            sweep->length = (guint64)llround(config->duration * fs);
+            break;
+
+        case SWEEP_EXPONENTIAL:
+            sweep->rate = config->duration / log(f2 / f1);
+            sweep->inc_step = exp(1.0 / (sweep->rate * fs));
+            sweep->length = (guint64)llround(config->duration * fs);
+            break;
+
+        case SWEEP_STEPPED:
+            sweep->settle_frames = (guint64)llround(config->settle * fs);
+            sweep->step_frames = MAX(sweep->settle_frames + (guint64)llround(config->dwell * fs), 1);
+            sweep->step_ratio = pow(f2 / f1, 1.0 / (config->steps - 1));
+            sweep->length = sweep->step_frames * config->steps;
+            break;
+
+        default:
+            break;
+    }
+
+    sweep->active = sweep->length > 0;
+    sync_phase(sweep);
+}
+
+static void push_marker(Sweep *sweep, SweepMarkerRing *markers, SweepMarkKind kind,
+                        float frequency, int step) {
+    if (!markers) return;
+
+    SweepMarker marker = {
+        .sample_time = sweep->origin + sweep->position,
+        .kind = kind,
+        .frequency = frequency,
+        .step = step
+    };
+    sweep_marker_ring_push(markers, &marker);
+}
+
+// Mono sweep at unit amplitude; silence once a one-shot sweep has ended
+void sweep_render(Sweep *sweep, float *out, size_t frames, SweepMarkerRing *markers) {
+    if (sweep->active && sweep->config.type != SWEEP_STEPPED) {
+        sync_phase(sweep);
+    }
+
+    while (frames > 0) {
+        if (!sweep->active) {
+            memset(out, 0, frames * sizeof(float));
+            return;
+        }
+
+        if (sweep->position == 0) {
+            push_marker(sweep, markers, SWEEP_MARK_START, sweep->config.start_freq, 0);
+        }
+
+        // Render up to the next marker or the end of the pass
+        guint64 next = sweep->length;
+        if (sweep->config.type == SWEEP_STEPPED) {
+            guint64 step = sweep->position / sweep->step_frames;
+            guint64 into_step = sweep->position - step * sweep->step_frames;
+            float frequency = (float)(sweep->inc * sweep->sample_rate / TWO_PI);
+
+            if (into_step == 0) {
+                sync_phase(sweep);
+                frequency = (float)(sweep->inc * sweep->sample_rate / TWO_PI);
+                push_marker(sweep, markers, SWEEP_MARK_STEP, frequency, (int)step);
+            }
+            if (into_step == sweep->settle_frames) {
+                push_marker(sweep, markers, SWEEP_MARK_SETTLED, frequency, (int)step);
+            }
+            next = step * sweep->step_frames +
+                   (into_step < sweep->settle_frames ? sweep->settle_frames : sweep->step_frames);
+        }
+
+        size_t count = (size_t)MIN((guint64)frames, next - sweep->position);
+        double phase = sweep->phase;
+        double inc = sweep->inc;
+
+        if (sweep->config.type == SWEEP_EXPONENTIAL) {
+            double ratio = sweep->inc_step;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = sinf((float)phase);
+                phase += inc;
+                if (phase >= TWO_PI) phase -= TWO_PI;
+                inc *= ratio;
+            }
+        } else {
+            double step = sweep->inc_step;   // Zero for stepped sweeps
+            for (size_t i = 0; i < count; i++) {
+                out[i] = sinf((float)phase);
+                phase += inc;
+                if (phase >= TWO_PI) phase -= TWO_PI;
+                inc += step;
+            }
+        }
+
+        sweep->phase = phase;
+        sweep->inc = inc;
+        sweep->position += count;
+        out += count;
+        frames -= count;
+
+        if (sweep->position == sweep->length) {
+            push_marker(sweep, markers, SWEEP_MARK_END, sweep->config.end_freq,
+                        sweep->config.type == SWEEP_STEPPED ? sweep->config.steps - 1 : 0);
+            if (sweep->config.loop) {
+                sweep->origin += sweep->length;
+                sweep->position = 0;
+                sweep->phase = 0.0;
+                sync_phase(sweep);
+            } else {
+                sweep->active = FALSE;
+            }
+        }
+    }
+}
+
+const char* sweep_type_name(SweepType type) {
+    switch (type) {
+        case SWEEP_LINEAR:      return "Linear Chirp";
+        case SWEEP_EXPONENTIAL: return "Exponential";
+        case SWEEP_STEPPED:     return "Stepped Sine";
+        default:                return "Unknown";
+    }
+}
+
+// Render thread only
+void sweep_marker_ring_push(SweepMarkerRing *ring, const SweepMarker *marker) {
+    publish_ring_push(ring->markers, sizeof(SweepMarker), SWEEP_MARKER_RING_SIZE,
+                      &ring->written, marker);
+}
+
+// Copies up to `max` markers after *cursor and advances it, by the rules
+// in publish_ring.h
+int sweep_marker_ring_read(const SweepMarkerRing *ring, gint *cursor,
+                           SweepMarker *out, int max) {
+    return publish_ring_read(ring->markers, sizeof(SweepMarker), SWEEP_MARKER_RING_SIZE,
+                             &ring->written, cursor, out, max);
+}
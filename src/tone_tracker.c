@@ -0,0 +1,263 @@
+#include "tone_tracker.h"
+#include "logger.h"
+#include "rt_pool.h"
+#include <string.h>
+#include <math.h>
+
+// Block length, window and rotations for one stream rate, into the setup
+// the processing thread is not using. Never on the processing thread.
+static void prepare(ToneTracker *tracker, float sample_rate) {
+    g_mutex_lock(&tracker->prepare_mutex);
+    gint serial = g_atomic_int_get(&tracker->published);
+    // Already set up for this rate, or the last setup has not been taken
+    // yet and the next read tries again
+    if ((serial > 0 && tracker->rates[serial & 1].sample_rate == sample_rate) ||
+        g_atomic_int_get(&tracker->adopted) != serial) {
+        g_mutex_unlock(&tracker->prepare_mutex);
+        return;
+    }
+    ToneTrackerRate *rate = &tracker->rates[(serial + 1) & 1];
+
+    size_t frames = MAX((size_t)lround(tracker->block_seconds * sample_rate), 2);
+    if (frames > tracker->window_capacity) {
+        LOG_WARN("Tone tracker: Blocks at %.0f Hz are cut to %zu frames", sample_rate,
+                 tracker->window_capacity);
+        frames = tracker->window_capacity;
+    }
+    rate->window_sum = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        rate->window[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (frames - 1)));
+        rate->window_sum += rate->window[i];
+    }
+
+    // The stream may come up at a lower rate than the tracker was made for
+    float nyquist = 0.5f * sample_rate;
+    for (int k = 0; k < tracker->count; k++) {
+        rate->frequency[k] = tracker->frequency[k];
+        if (rate->frequency[k] >= nyquist) {
+            LOG_WARN("Tone tracker: %.1f Hz is above Nyquist at %.0f Hz, tracking %.1f Hz",
+                     tracker->frequency[k], sample_rate, nextafterf(nyquist, 0.0f));
+            rate->frequency[k] = nextafterf(nyquist, 0.0f);
+        }
+        double w = 2.0 * M_PI * rate->frequency[k] / sample_rate;
+        rate->rotate_re[k] = (float)cos(w);
+        rate->rotate_im[k] = (float)-sin(w);
+    }
+
+    rate->sample_rate = sample_rate;
+    rate->block_frames = frames;
+    g_atomic_int_set(&tracker->published, serial + 1);
+    g_mutex_unlock(&tracker->prepare_mutex);
+}
+
+// Frequencies must lie below the Nyquist limit of sample_rate, the rate
+// the stream is expected to run at
+ToneTracker* tone_tracker_create(const float *frequencies, int count, float block_seconds,
+                                 float sample_rate) {
+    if (!frequencies || count < 1 || count > TONE_TRACKER_MAX || block_seconds <= 0.0f ||
+        sample_rate <= 0.0f) {
+        LOG_ERROR("Tone tracker: Need 1 to %d frequencies and a positive block length",
+                  TONE_TRACKER_MAX);
+        return NULL;
+    }
+    for (int k = 0; k < count; k++) {
+        if (frequencies[k] <= 0.0f || frequencies[k] >= 0.5f * sample_rate) {
+            LOG_ERROR("Tone tracker: %.1f Hz is not below Nyquist (%.1f Hz)",
+                      frequencies[k], 0.5f * sample_rate);
+            return NULL;
+        }
+    }
+
+    ToneTracker *tracker = rt_pool_new(ToneTracker, 1);
+    if (!tracker) return NULL;
+
+    memcpy(tracker->frequency, frequencies, count * sizeof(float));
+    tracker->count = count;
+    tracker->groups = (count + SIMD_LANES - 1) / SIMD_LANES;
+    tracker->block_seconds = block_seconds;
+    g_mutex_init(&tracker->prepare_mutex);
+
+    tracker->window_capacity = MAX((size_t)lround(block_seconds * TONE_TRACKER_MAX_RATE), 2);
+    for (int i = 0; i < 2; i++) {
+        tracker->rates[i].window = rt_pool_new(float, tracker->window_capacity);
+        if (!tracker->rates[i].window) {
+            tone_tracker_destroy(tracker);
+            return NULL;
+        }
+    }
+    prepare(tracker, sample_rate);
+    return tracker;
+}
+
+void tone_tracker_destroy(ToneTracker *tracker) {
+    if (!tracker) return;
+    rt_pool_free(tracker->rates[0].window);
+    rt_pool_free(tracker->rates[1].window);
+    g_mutex_clear(&tracker->prepare_mutex);
+    rt_pool_free(tracker);
+}
+
+// Sets each phasor exactly from the absolute sample time, so rounding in
+// the per-sample rotation never builds up beyond TONE_TRACKER_RESYNC steps
+static void resync(ToneTracker *tracker, guint64 sample_time) {
+    const ToneTrackerRate *rate = tracker->rate;
+    for (int k = 0; k < tracker->count; k++) {
+        double cycles = fmod((double)rate->frequency[k] * sample_time / rate->sample_rate, 1.0);
+        tracker->phasor_re[k] = (float)cos(2.0 * M_PI * cycles);
+        tracker->phasor_im[k] = (float)-sin(2.0 * M_PI * cycles);
+    }
+}
+
+// Each group of trackers stays in registers across the whole span
+static void accumulate(ToneTracker *tracker, const float *weighted, size_t frames) {
+    for (int g = 0; g < tracker->groups; g++) {
+        int lane = g * SIMD_LANES;
+        v8sf p_re = v8sf_load(&tracker->phasor_re[lane]);
+        v8sf p_im = v8sf_load(&tracker->phasor_im[lane]);
+        v8sf r_re = v8sf_load(&tracker->rate->rotate_re[lane]);
+        v8sf r_im = v8sf_load(&tracker->rate->rotate_im[lane]);
+        v8sf a_re = v8sf_load(&tracker->acc_re[lane]);
+        v8sf a_im = v8sf_load(&tracker->acc_im[lane]);
+
+        for (size_t i = 0; i < frames; i++) {
+            v8sf x = v8sf_set1(weighted[i]);
+            a_re += x * p_re;
+            a_im += x * p_im;
+            v8sf next_re = p_re * r_re - p_im * r_im;
+            p_im = p_re * r_im + p_im * r_re;
+            p_re = next_re;
+        }
+
+        v8sf_store(&tracker->phasor_re[lane], p_re);
+        v8sf_store(&tracker->phasor_im[lane], p_im);
+        v8sf_store(&tracker->acc_re[lane], a_re);
+        v8sf_store(&tracker->acc_im[lane], a_im);
+    }
+}
+
+// x = A cos(w n + phi) sums to (A / 2) * sum(window) * e^(j phi)
+static void publish(ToneTracker *tracker) {
+    const ToneTrackerRate *rate = tracker->rate;
+    g_atomic_int_inc(&tracker->sequence);
+    for (int k = 0; k < tracker->count; k++) {
+        double re = tracker->acc_re[k];
+        double im = tracker->acc_im[k];
+        ToneReading *reading = &tracker->readings[k];
+
+        reading->frequency = rate->frequency[k];
+        reading->amplitude = (float)(2.0 * hypot(re, im) / rate->window_sum);
+        reading->level_db = 20.0f * log10f(fmaxf(reading->amplitude, 1e-10f));
+        reading->phase = (float)atan2(im, re);
+        reading->sample_time = tracker->block_start;
+    }
+    tracker->blocks++;
+    g_atomic_int_inc(&tracker->sequence);
+}
+
+// Feeds channel 0 of an interleaved block. Blocks run back to back on the
+// sample clock; a gap in sample_time restarts the current one. At a rate
+// with no setup yet, blocks are skipped until tone_tracker_read prepares one.
+void tone_tracker_process(ToneTracker *tracker, const float *samples, size_t frames, int stride,
+                          guint64 sample_time, float sample_rate) {
+    if (!tracker || !samples || sample_rate <= 0.0f) return;
+
+    gint serial = g_atomic_int_get(&tracker->published);
+    if (serial != tracker->rate_serial) {
+        tracker->rate = &tracker->rates[serial & 1];
+        tracker->rate_serial = serial;
+        tracker->position = 0;
+        g_atomic_int_set(&tracker->adopted, serial);
+    }
+    if (tracker->rate->sample_rate != sample_rate) {
+        g_atomic_int_set(&tracker->wanted_rate, (gint)lroundf(sample_rate));
+        tracker->position = 0;
+        return;
+    }
+    const ToneTrackerRate *rate = tracker->rate;
+
+    if (tracker->position > 0 && sample_time != tracker->block_start + tracker->position) {
+        tracker->position = 0;
+    }
+
+    float weighted[TONE_TRACKER_RESYNC];
+    size_t done = 0;
+    while (done < frames) {
+        if (tracker->position == 0) {
+            tracker->block_start = sample_time + done;
+            memset(tracker->acc_re, 0, sizeof(tracker->acc_re));
+            memset(tracker->acc_im, 0, sizeof(tracker->acc_im));
+        }
+
+        size_t into_span = tracker->position % TONE_TRACKER_RESYNC;
+        if (into_span == 0) {
+            resync(tracker, tracker->block_start + tracker->position);
+        }
+
+        size_t count = MIN(frames - done, TONE_TRACKER_RESYNC - into_span);
+        count = MIN(count, rate->block_frames - tracker->position);
+
+        const float *window = rate->window + tracker->position;
+        for (size_t i = 0; i < count; i++) {
+            weighted[i] = samples[(done + i) * stride] * window[i];
+        }
+        accumulate(tracker, weighted, count);
+
+        tracker->position += count;
+        done += count;
+        if (tracker->position == rate->block_frames) {
+            publish(tracker);
+            tracker->position = 0;
+        }
+    }
+}
+
+// Copies the latest readings; returns 0 until the first block completes.
+// Also prepares the setup for a stream rate the processing thread has
+// asked for, so readers must not be realtime threads.
+int tone_tracker_read(ToneTracker *tracker, ToneReading *out, int max) {
+    if (!tracker || !out) return 0;
+
+    gint wanted = g_atomic_int_get(&tracker->wanted_rate);
+    if (wanted > 0) {
+        prepare(tracker, (float)wanted);
+    }
+
+    int count = MIN(max, tracker->count);
+    guint64 blocks = 0;
+    gint before;
+    do {
+        while ((before = g_atomic_int_get(&tracker->sequence)) & 1) {
+            g_thread_yield();
+        }
+        memcpy(out, tracker->readings, count * sizeof(ToneReading));
+        blocks = tracker->blocks;
+        // Keeps the copy's loads before the re-read of the sequence
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (g_atomic_int_get(&tracker->sequence) != before);
+
+    return blocks > 0 ? count : 0;
+}
+
+// Comma-separated frequencies in Hz, as given to --track
+ToneTracker* tone_tracker_parse(const char *list, float sample_rate) {
+    if (!list) return NULL;
+
+    gchar **items = g_strsplit(list, ",", -1);
+    float frequencies[TONE_TRACKER_MAX];
+    int count = 0;
+    gboolean ok = TRUE;
+
+    for (int i = 0; items[i]; i++) {
+        char *end;
+        double freq = g_ascii_strtod(items[i], &end);
+        if (end == items[i] || *end != '\0' || freq <= 0.0 || count == TONE_TRACKER_MAX) {
+            LOG_ERROR("Tone tracker: Bad frequency '%s'", items[i]);
+            ok = FALSE;
+            break;
+        }
+        frequencies[count++] = (float)freq;
+    }
+    g_strfreev(items);
+
+    return ok ? tone_tracker_create(frequencies, count, TONE_TRACKER_DEFAULT_BLOCK_S, sample_rate) : NULL;
+}
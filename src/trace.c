@@ -0,0 +1,223 @@
+#include "trace.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+gint trace_enabled;
+
+static TraceBuffer *buffers[TRACE_MAX_THREADS];
+static gint next_id = 1;
+static gint64 start_ns;
+
+static const char *phase_codes[] = { "B", "E", "C", "i" };
+
+static void release_buffer(gpointer data);
+static GPrivate thread_buffer = G_PRIVATE_INIT(release_buffer);
+
+static gint64 now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (gint64)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// A released buffer is emptied for its next owner, so a thread's events
+// are only in the trace while it runs or until another thread replaces it
+static TraceBuffer* claim_buffer(void) {
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        TraceBuffer *buffer = g_atomic_pointer_get(&buffers[i]);
+        if (buffer) {
+            if (!g_atomic_int_compare_and_exchange(&buffer->owned, 0, 1)) continue;
+            // Id 0 while emptying tells a reader copying it to drop the copy
+            g_atomic_int_set(&buffer->id, 0);
+            g_atomic_int_set(&buffer->written, 0);
+            g_atomic_int_set(&buffer->full, 0);
+            buffer->name[0] = '\0';
+            g_atomic_int_set(&buffer->id, g_atomic_int_add(&next_id, 1));
+            return buffer;
+        }
+
+        buffer = g_try_new0(TraceBuffer, 1);
+        if (!buffer) return NULL;
+        buffer->owned = 1;
+        buffer->id = g_atomic_int_add(&next_id, 1);
+        if (g_atomic_pointer_compare_and_exchange(&buffers[i], NULL, buffer)) return buffer;
+        g_free(buffer);
+    }
+    return NULL;
+}
+
+static void release_buffer(gpointer data) {
+    TraceBuffer *buffer = (TraceBuffer *)data;
+    g_atomic_int_set(&buffer->owned, 0);
+}
+
+static TraceBuffer* get_buffer(void) {
+    TraceBuffer *buffer = g_private_get(&thread_buffer);
+    if (!buffer) {
+        buffer = claim_buffer();
+        if (buffer) g_private_set(&thread_buffer, buffer);
+    }
+    return buffer;
+}
+
+// Main thread, before the threads that record are started
+void trace_start(void) {
+    if (g_atomic_int_get(&trace_enabled)) return;
+    start_ns = now_ns();
+    g_atomic_int_set(&trace_enabled, 1);
+}
+
+// Claims the calling thread's buffer up front and labels it; the first
+// name a thread is given sticks
+void trace_thread_name(const char *name) {
+    if (!g_atomic_int_get(&trace_enabled)) return;
+    TraceBuffer *buffer = get_buffer();
+    if (buffer && !buffer->name[0]) {
+        g_strlcpy(buffer->name, name, sizeof(buffer->name));
+    }
+}
+
+// Makes sure a free buffer is waiting for a thread that must not allocate
+// on its first event, such as the audio host's callback thread. Call just
+// before that thread starts; threads we create claim theirs on startup.
+void trace_reserve(void) {
+    if (!g_atomic_int_get(&trace_enabled)) return;
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        TraceBuffer *buffer = g_atomic_pointer_get(&buffers[i]);
+        if (buffer) {
+            if (!g_atomic_int_get(&buffer->owned)) return;
+            continue;
+        }
+
+        // Id 0 until claimed, so trace_write skips it
+        buffer = g_try_new0(TraceBuffer, 1);
+        if (!buffer) return;
+        if (g_atomic_pointer_compare_and_exchange(&buffers[i], NULL, buffer)) return;
+        g_free(buffer);
+    }
+}
+
+// Any thread, no locks. Use the TRACE_ macros, which skip the call while
+// tracing is off.
+void trace_event(TracePhase phase, const char *name, double value) {
+    TraceBuffer *buffer = get_buffer();
+    if (!buffer) return;
+
+    guint index = (guint)buffer->written;
+    TraceEvent *event = &buffer->events[index & (TRACE_BUFFER_EVENTS - 1)];
+    event->time_ns = now_ns();
+    event->name = name;
+    event->value = value;
+    event->phase = phase;
+    g_atomic_int_set(&buffer->written, (gint)(index + 1));
+    if (index + 1 == TRACE_BUFFER_EVENTS) {
+        g_atomic_int_set(&buffer->full, 1);
+    }
+}
+
+// Copies a buffer's events, oldest first, while its owner keeps writing.
+// Returns how many are intact, or -1 if the buffer changed hands.
+static int snapshot(TraceBuffer *buffer, TraceEvent *events, gint *id, char *name) {
+    *id = g_atomic_int_get(&buffer->id);
+    if (*id == 0) return -1;
+    guint written = (guint)g_atomic_int_get(&buffer->written);
+    guint count = g_atomic_int_get(&buffer->full) ? TRACE_BUFFER_EVENTS : written;
+    memcpy(name, buffer->name, TRACE_NAME_LENGTH);
+    name[TRACE_NAME_LENGTH - 1] = '\0';
+
+    guint first = written - count;
+    for (guint i = 0; i < count; i++) {
+        events[i] = buffer->events[(first + i) & (TRACE_BUFFER_EVENTS - 1)];
+    }
+
+    // Events written since, plus the one being written, reused the oldest slots
+    guint advanced = (guint)g_atomic_int_get(&buffer->written) - written;
+    if (g_atomic_int_get(&buffer->id) != *id) return -1;
+    guint lost = count + advanced + 1 > TRACE_BUFFER_EVENTS ?
+                 MIN(count + advanced + 1 - TRACE_BUFFER_EVENTS, count) : 0;
+    if (lost > 0) {
+        memmove(events, events + lost, (count - lost) * sizeof(TraceEvent));
+    }
+    return (int)(count - lost);
+}
+
+// Chrome trace-event JSON, which chrome://tracing and Perfetto open. Any
+// thread, at any time; the other threads keep recording meanwhile.
+gboolean trace_write(const char *path) {
+    if (!g_atomic_int_get(&trace_enabled)) return FALSE;
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        LOG_ERROR("Cannot write trace to '%s'", path);
+        return FALSE;
+    }
+    TraceEvent *events = g_try_new(TraceEvent, TRACE_BUFFER_EVENTS);
+    if (!events) {
+        LOG_ERROR("Trace: Out of memory");
+        fclose(file);
+        return FALSE;
+    }
+
+    int pid = (int)getpid();
+    int total = 0, threads = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"name\":\"process_name\","
+            "\"args\":{\"name\":\"waveform_generator\"}}", pid);
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        TraceBuffer *buffer = g_atomic_pointer_get(&buffers[i]);
+        if (!buffer) break;
+
+        gint id;
+        char name[TRACE_NAME_LENGTH];
+        int count = snapshot(buffer, events, &id, name);
+        if (count <= 0) continue;
+
+        threads++;
+        fprintf(file, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\","
+                "\"args\":{\"name\":\"", pid, id);
+        if (name[0]) {
+            fputs(name, file);
+        } else {
+            fprintf(file, "thread %d", id);
+        }
+        fputs("\"}}", file);
+
+        // The oldest events may end spans whose beginning was overwritten
+        int depth = 0;
+        for (int e = 0; e < count; e++) {
+            const TraceEvent *event = &events[e];
+            if (event->phase == TRACE_PHASE_BEGIN) {
+                depth++;
+            } else if (event->phase == TRACE_PHASE_END) {
+                if (depth == 0) continue;
+                depth--;
+            }
+
+            fprintf(file, ",\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"name\":\"%s\"",
+                    phase_codes[event->phase], pid, id,
+                    (event->time_ns - start_ns) / 1000.0, event->name);
+            if (event->phase == TRACE_PHASE_COUNTER) {
+                fprintf(file, ",\"args\":{\"value\":%.10g}", event->value);
+            } else if (event->phase == TRACE_PHASE_INSTANT) {
+                fputs(",\"s\":\"t\"", file);
+            }
+            fputc('}', file);
+            total++;
+        }
+    }
+    fputs("\n]}\n", file);
+    g_free(events);
+
+    gboolean ok = !ferror(file);
+    if (fclose(file) != 0) ok = FALSE;
+    if (ok) {
+        LOG_INFO("Trace: Wrote %d events from %d threads to %s", total, threads, path);
+    } else {
+        LOG_ERROR("Cannot write trace to '%s'", path);
+    }
+    return ok;
+}
@@ -0,0 +1,405 @@
+#include "transfer_analyzer.h"
+#include "fft_analyzer.h"
+#include "audio_manager.h"
+#include "waveform_generator.h"
+#include "parameter_store.h"
+#include "logger.h"
+#include "rt_pool.h"
+#include <string.h>
+#include <math.h>
+
+#define TRANSFER_POLL_US 5000
+#define TRANSFER_REGULARIZATION 1e-6f   // Relative to the peak excitation power
+
+static float to_db(double magnitude) {
+    return 20.0f * log10f((float)fmax(magnitude, 1e-10));
+}
+
+TransferAnalyzer* transfer_analyzer_create(void) {
+    TransferAnalyzer *analyzer = g_new0(TransferAnalyzer, 1);
+    g_mutex_init(&analyzer->mutex);
+
+    analyzer->window = fftwf_alloc_real(TRANSFER_FFT_SIZE);
+    analyzer->frame = fftwf_alloc_real(TRANSFER_FFT_SIZE);
+    analyzer->spectrum_x = fftwf_alloc_complex(TRANSFER_BINS);
+    analyzer->spectrum_y = fftwf_alloc_complex(TRANSFER_BINS);
+    analyzer->sxx = rt_pool_new(double, TRANSFER_BINS);
+    analyzer->syy = rt_pool_new(double, TRANSFER_BINS);
+    analyzer->sxy_re = rt_pool_new(double, TRANSFER_BINS);
+    analyzer->sxy_im = rt_pool_new(double, TRANSFER_BINS);
+    analyzer->pending = rt_pool_new(float, TRANSFER_FFT_SIZE * 2);
+    analyzer->capture = rt_pool_new(float, TRANSFER_HOP * 2);
+    analyzer->result = g_new0(TransferResult, 1);
+
+    if (!analyzer->window || !analyzer->frame || !analyzer->spectrum_x || !analyzer->spectrum_y) {
+        transfer_analyzer_destroy(analyzer);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < TRANSFER_FFT_SIZE; i++) {
+        analyzer->window[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (TRANSFER_FFT_SIZE - 1)));
+    }
+
+    fft_planner_lock();
+    analyzer->plan = fftwf_plan_dft_r2c_1d(TRANSFER_FFT_SIZE, analyzer->frame,
+                                           analyzer->spectrum_x, FFTW_MEASURE);
+    fft_planner_unlock();
+    if (!analyzer->plan) {
+        transfer_analyzer_destroy(analyzer);
+        return NULL;
+    }
+
+    transfer_analyzer_reset(analyzer, DEFAULT_SAMPLE_RATE);
+    return analyzer;
+}
+
+void transfer_analyzer_destroy(TransferAnalyzer *analyzer) {
+    if (!analyzer) return;
+
+    transfer_analyzer_stop(analyzer);
+
+    if (analyzer->plan) {
+        fft_planner_lock();
+        fftwf_destroy_plan(analyzer->plan);
+        fft_planner_unlock();
+    }
+    if (analyzer->window) fftwf_free(analyzer->window);
+    if (analyzer->frame) fftwf_free(analyzer->frame);
+    if (analyzer->spectrum_x) fftwf_free(analyzer->spectrum_x);
+    if (analyzer->spectrum_y) fftwf_free(analyzer->spectrum_y);
+    rt_pool_free(analyzer->sxx);
+    rt_pool_free(analyzer->syy);
+    rt_pool_free(analyzer->sxy_re);
+    rt_pool_free(analyzer->sxy_im);
+    rt_pool_free(analyzer->pending);
+    rt_pool_free(analyzer->capture);
+    g_free(analyzer->sweep_x);
+    g_free(analyzer->sweep_y);
+    g_free(analyzer->result);
+    g_mutex_clear(&analyzer->mutex);
+    g_free(analyzer);
+}
+
+// Drops all averages and any sweep in progress
+void transfer_analyzer_reset(TransferAnalyzer *analyzer, float sample_rate) {
+    memset(analyzer->sxx, 0, TRANSFER_BINS * sizeof(double));
+    memset(analyzer->syy, 0, TRANSFER_BINS * sizeof(double));
+    memset(analyzer->sxy_re, 0, TRANSFER_BINS * sizeof(double));
+    memset(analyzer->sxy_im, 0, TRANSFER_BINS * sizeof(double));
+    analyzer->averages = 0;
+    analyzer->num_pending = 0;
+    analyzer->recording = FALSE;
+    analyzer->sweep_frames = 0;
+    analyzer->sweep_tail = 0;
+    analyzer->sweeps = 0;
+    analyzer->sample_rate = sample_rate;
+
+    g_mutex_lock(&analyzer->mutex);
+    memset(analyzer->result, 0, sizeof(TransferResult));
+    analyzer->result->sample_rate = sample_rate;
+    analyzer->serial++;
+    g_mutex_unlock(&analyzer->mutex);
+}
+
+static void publish_welch(TransferAnalyzer *analyzer) {
+    TransferResult *result = analyzer->result;
+
+    g_mutex_lock(&analyzer->mutex);
+    result->method = TRANSFER_WELCH;
+    result->averages = analyzer->averages;
+    result->sample_rate = analyzer->sample_rate;
+    for (size_t k = 0; k < TRANSFER_BINS; k++) {
+        double sxx = analyzer->sxx[k] + 1e-30;
+        double syy = analyzer->syy[k] + 1e-30;
+        double cross = hypot(analyzer->sxy_re[k], analyzer->sxy_im[k]) + 1e-30;
+
+        result->h1_db[k] = to_db(cross / sxx);
+        result->h2_db[k] = to_db(syy / cross);
+        result->phase[k] = (float)atan2(analyzer->sxy_im[k], analyzer->sxy_re[k]);
+        result->coherence[k] = (float)fmin(cross * cross / (sxx * syy), 1.0);
+    }
+    analyzer->serial++;
+    g_mutex_unlock(&analyzer->mutex);
+}
+
+// One Welch frame from the oldest TRANSFER_FFT_SIZE pending pairs. The
+// running mean is linear for the first TRANSFER_MAX_AVERAGES frames and
+// exponential after that, so the display keeps following the device.
+static void welch_frame(TransferAnalyzer *analyzer) {
+    const float *pairs = analyzer->pending;
+
+    for (size_t i = 0; i < TRANSFER_FFT_SIZE; i++) {
+        analyzer->frame[i] = pairs[i * 2] * analyzer->window[i];
+    }
+    fftwf_execute_dft_r2c(analyzer->plan, analyzer->frame, analyzer->spectrum_x);
+    for (size_t i = 0; i < TRANSFER_FFT_SIZE; i++) {
+        analyzer->frame[i] = pairs[i * 2 + 1] * analyzer->window[i];
+    }
+    fftwf_execute_dft_r2c(analyzer->plan, analyzer->frame, analyzer->spectrum_y);
+
+    double weight = 1.0 / MIN(analyzer->averages + 1, TRANSFER_MAX_AVERAGES);
+    for (size_t k = 0; k < TRANSFER_BINS; k++) {
+        double xr = analyzer->spectrum_x[k][0], xi = analyzer->spectrum_x[k][1];
+        double yr = analyzer->spectrum_y[k][0], yi = analyzer->spectrum_y[k][1];
+
+        // Sxy = conj(X) * Y
+        analyzer->sxx[k] += weight * (xr * xr + xi * xi - analyzer->sxx[k]);
+        analyzer->syy[k] += weight * (yr * yr + yi * yi - analyzer->syy[k]);
+        analyzer->sxy_re[k] += weight * (xr * yr + xi * yi - analyzer->sxy_re[k]);
+        analyzer->sxy_im[k] += weight * (xr * yi - xi * yr - analyzer->sxy_im[k]);
+    }
+    analyzer->averages++;
+}
+
+// Regularized deconvolution of the recorded sweep: H = Y X* / (|X|^2 + e).
+// The linear response is causal, so the impulse response is cut to the
+// analysis length from time zero; the harmonic responses of an
+// exponential sweep land at negative times and fall away with the rest.
+static void deconvolve_sweep(TransferAnalyzer *analyzer) {
+    size_t length = analyzer->sweep_frames;
+    if (length < TRANSFER_FFT_SIZE) {
+        LOG_ERROR("Transfer: Sweep too short to deconvolve (%zu frames)", length);
+        return;
+    }
+
+    size_t n = 1;
+    while (n < 2 * length) n <<= 1;
+    size_t bins = n / 2 + 1;
+
+    float *signal = fftwf_alloc_real(n);
+    fftwf_complex *x = fftwf_alloc_complex(bins);
+    fftwf_complex *y = fftwf_alloc_complex(bins);
+    if (!signal || !x || !y) {
+        LOG_ERROR("Transfer: Out of memory deconvolving %zu frames", length);
+        fftwf_free(signal);
+        fftwf_free(x);
+        fftwf_free(y);
+        return;
+    }
+
+    fft_planner_lock();
+    fftwf_plan forward = fftwf_plan_dft_r2c_1d((int)n, signal, x, FFTW_ESTIMATE);
+    fftwf_plan inverse = fftwf_plan_dft_c2r_1d((int)n, x, signal, FFTW_ESTIMATE);
+    fft_planner_unlock();
+
+    memcpy(signal, analyzer->sweep_x, length * sizeof(float));
+    memset(signal + length, 0, (n - length) * sizeof(float));
+    fftwf_execute_dft_r2c(forward, signal, x);
+    memcpy(signal, analyzer->sweep_y, length * sizeof(float));
+    memset(signal + length, 0, (n - length) * sizeof(float));
+    fftwf_execute_dft_r2c(forward, signal, y);
+
+    float peak = 0.0f;
+    for (size_t k = 0; k < bins; k++) {
+        peak = fmaxf(peak, x[k][0] * x[k][0] + x[k][1] * x[k][1]);
+    }
+    float epsilon = peak * TRANSFER_REGULARIZATION + 1e-30f;
+
+    for (size_t k = 0; k < bins; k++) {
+        float xr = x[k][0], xi = x[k][1];
+        float yr = y[k][0], yi = y[k][1];
+        float scale = 1.0f / ((xr * xr + xi * xi + epsilon) * n);
+        x[k][0] = (yr * xr + yi * xi) * scale;
+        x[k][1] = (yi * xr - yr * xi) * scale;
+    }
+    fftwf_execute(inverse);
+
+    // Impulse response, faded out over its last quarter
+    size_t fade = TRANSFER_FFT_SIZE / 4;
+    for (size_t i = 0; i < TRANSFER_FFT_SIZE; i++) {
+        float gain = 1.0f;
+        if (i >= TRANSFER_FFT_SIZE - fade) {
+            gain = 0.5f * (1.0f + cosf(M_PI * (i - (TRANSFER_FFT_SIZE - fade)) / fade));
+        }
+        analyzer->frame[i] = signal[i] * gain;
+    }
+    fftwf_execute_dft_r2c(analyzer->plan, analyzer->frame, analyzer->spectrum_x);
+
+    fft_planner_lock();
+    fftwf_destroy_plan(forward);
+    fftwf_destroy_plan(inverse);
+    fft_planner_unlock();
+    fftwf_free(signal);
+    fftwf_free(x);
+    fftwf_free(y);
+
+    analyzer->sweeps++;
+    TransferResult *result = analyzer->result;
+    g_mutex_lock(&analyzer->mutex);
+    result->method = TRANSFER_SWEEP;
+    result->averages = analyzer->sweeps;
+    result->sample_rate = analyzer->sample_rate;
+    for (size_t k = 0; k < TRANSFER_BINS; k++) {
+        double re = analyzer->spectrum_x[k][0];
+        double im = analyzer->spectrum_x[k][1];
+        result->h1_db[k] = to_db(hypot(re, im));
+        result->h2_db[k] = result->h1_db[k];
+        result->phase[k] = (float)atan2(im, re);
+        result->coherence[k] = 1.0f;
+    }
+    analyzer->serial++;
+    g_mutex_unlock(&analyzer->mutex);
+
+    LOG_INFO("Transfer: Sweep %d deconvolved from %.2f s", analyzer->sweeps,
+             length / analyzer->sample_rate);
+}
+
+// Starts recording for deconvolution. A sweep that starts while the
+// previous one is still being recorded is left to that recording.
+void transfer_analyzer_begin_sweep(TransferAnalyzer *analyzer) {
+    if (analyzer->recording) return;
+
+    size_t capacity = (size_t)((TRANSFER_MAX_SWEEP_S + TRANSFER_SWEEP_TAIL_S) * analyzer->sample_rate);
+    if (capacity != analyzer->sweep_capacity) {
+        analyzer->sweep_x = g_renew(float, analyzer->sweep_x, capacity);
+        analyzer->sweep_y = g_renew(float, analyzer->sweep_y, capacity);
+        analyzer->sweep_capacity = capacity;
+    }
+    analyzer->sweep_frames = 0;
+    analyzer->sweep_tail = 0;
+    analyzer->recording = TRUE;
+}
+
+// Keeps recording long enough for the output latency and the decay
+void transfer_analyzer_end_sweep(TransferAnalyzer *analyzer) {
+    if (!analyzer->recording || analyzer->sweep_tail > 0) return;
+    analyzer->sweep_tail = MAX((size_t)(TRANSFER_SWEEP_TAIL_S * analyzer->sample_rate), 1);
+}
+
+static void record_sweep(TransferAnalyzer *analyzer, const float *pairs, size_t frames) {
+    size_t count = MIN(frames, analyzer->sweep_capacity - analyzer->sweep_frames);
+    float *x = analyzer->sweep_x + analyzer->sweep_frames;
+    float *y = analyzer->sweep_y + analyzer->sweep_frames;
+
+    for (size_t i = 0; i < count; i++) {
+        x[i] = pairs[i * 2];
+        y[i] = pairs[i * 2 + 1];
+    }
+    analyzer->sweep_frames += count;
+
+    bool done = analyzer->sweep_frames == analyzer->sweep_capacity;
+    if (analyzer->sweep_tail > 0) {
+        done = done || count >= analyzer->sweep_tail;
+        analyzer->sweep_tail -= MIN(count, analyzer->sweep_tail);
+    }
+    if (done) {
+        analyzer->recording = FALSE;
+        analyzer->sweep_tail = 0;
+        deconvolve_sweep(analyzer);
+    }
+}
+
+// Feeds (played, captured) pairs: into the sweep recording while one is
+// running, otherwise into the Welch averages
+void transfer_analyzer_process(TransferAnalyzer *analyzer, const float *pairs, size_t frames) {
+    if (analyzer->recording) {
+        record_sweep(analyzer, pairs, frames);
+        return;
+    }
+
+    bool updated = false;
+    while (frames > 0) {
+        size_t count = MIN(frames, TRANSFER_FFT_SIZE - analyzer->num_pending);
+        memcpy(analyzer->pending + analyzer->num_pending * 2, pairs, count * 2 * sizeof(float));
+        analyzer->num_pending += count;
+        pairs += count * 2;
+        frames -= count;
+
+        if (analyzer->num_pending == TRANSFER_FFT_SIZE) {
+            welch_frame(analyzer);
+            memmove(analyzer->pending, analyzer->pending + TRANSFER_HOP * 2,
+                    (TRANSFER_FFT_SIZE - TRANSFER_HOP) * 2 * sizeof(float));
+            analyzer->num_pending = TRANSFER_FFT_SIZE - TRANSFER_HOP;
+            updated = true;
+        }
+    }
+
+    if (updated) {
+        publish_welch(analyzer);
+    }
+}
+
+// Copies the latest result if it changed since *serial
+bool transfer_analyzer_read(TransferAnalyzer *analyzer, TransferResult *result, guint *serial) {
+    if (!analyzer || !result || !serial) return false;
+
+    g_mutex_lock(&analyzer->mutex);
+    bool changed = *serial != analyzer->serial;
+    if (changed) {
+        memcpy(result, analyzer->result, sizeof(TransferResult));
+        *serial = analyzer->serial;
+    }
+    g_mutex_unlock(&analyzer->mutex);
+    return changed;
+}
+
+static gpointer measure_thread_func(gpointer data) {
+    TransferAnalyzer *analyzer = (TransferAnalyzer *)data;
+    WaveformGenerator *gen = analyzer->generator;
+    float *pairs = analyzer->capture;
+    gint cursor = g_atomic_int_get(&gen->markers.written);
+
+    while (g_atomic_int_get(&analyzer->running)) {
+        float sample_rate = (float)waveform_generator_get_sample_rate(gen);
+        if (sample_rate != analyzer->sample_rate) {
+            transfer_analyzer_reset(analyzer, sample_rate);
+        }
+
+        SweepMarker markers[16];
+        int count;
+        while ((count = waveform_generator_read_sweep_markers(gen, &cursor, markers, 16)) > 0) {
+            for (int i = 0; i < count; i++) {
+                SweepConfig sweep;
+                if (markers[i].kind == SWEEP_MARK_START &&
+                    parameter_store_get_sweep(gen->params, &sweep) && sweep.type != SWEEP_STEPPED) {
+                    transfer_analyzer_begin_sweep(analyzer);
+                } else if (markers[i].kind == SWEEP_MARK_END) {
+                    transfer_analyzer_end_sweep(analyzer);
+                }
+            }
+        }
+
+        size_t frames = audio_manager_read_capture(analyzer->audio, pairs, TRANSFER_HOP);
+        if (frames == 0) {
+            g_usleep(TRANSFER_POLL_US);
+            continue;
+        }
+
+        // Welch needs a continuous excitation; a sweep's silence would only dilute it
+        g_mutex_lock(&gen->params->mutex);
+        gboolean sweeping = gen->params->waveform == WAVE_SWEEP;
+        g_mutex_unlock(&gen->params->mutex);
+        if (analyzer->recording || !sweeping) {
+            transfer_analyzer_process(analyzer, pairs, frames);
+        }
+    }
+
+    return NULL;
+}
+
+bool transfer_analyzer_start(TransferAnalyzer *analyzer, AudioManager *audio,
+                             WaveformGenerator *generator) {
+    if (!analyzer || !audio || !generator || analyzer->thread) return false;
+
+    if (!audio_manager_toggle_capture(audio, true)) {
+        LOG_ERROR("Transfer: Needs running audio with an input to measure from");
+        return false;
+    }
+
+    analyzer->audio = audio;
+    analyzer->generator = generator;
+    transfer_analyzer_reset(analyzer, (float)waveform_generator_get_sample_rate(generator));
+    g_atomic_int_set(&analyzer->running, 1);
+    analyzer->thread = g_thread_new("transfer_analyzer", measure_thread_func, analyzer);
+    LOG_INFO("Transfer: Measuring");
+    return true;
+}
+
+void transfer_analyzer_stop(TransferAnalyzer *analyzer) {
+    if (!analyzer || !analyzer->thread) return;
+
+    g_atomic_int_set(&analyzer->running, 0);
+    g_thread_join(analyzer->thread);
+    analyzer->thread = NULL;
+    audio_manager_toggle_capture(analyzer->audio, false);
+}
@@ -0,0 +1,406 @@
+#include "voice_engine.h"
+#include "logger.h"
+#include "pink_noise.h"
+#include "rt_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static float envelope_step(float ms, float sample_rate) {
+    return 1.0f / fmaxf(1.0f, ms * sample_rate * 0.001f);
+}
+
+static bool push_event(VoiceEngine *engine, const VoiceEvent *event) {
+    g_mutex_lock(&engine->producer_mutex);
+    guint write = (guint)engine->event_write;
+    guint read = (guint)g_atomic_int_get(&engine->event_read);
+    bool queued = (write - read) < VOICE_EVENT_RING;
+    if (queued) {
+        engine->events[write & (VOICE_EVENT_RING - 1)] = *event;
+        g_atomic_int_set(&engine->event_write, (gint)(write + 1));
+    }
+    g_mutex_unlock(&engine->producer_mutex);
+
+    if (!queued) {
+        LOG_WARN("Voice engine: Event queue full, dropping event");
+    }
+    return queued;
+}
+
+static void copy_voice(VoiceEngine *engine, int dst, int src) {
+    engine->phase[dst] = engine->phase[src];
+    engine->increment[dst] = engine->increment[src];
+    engine->gain[dst] = engine->gain[src];
+    engine->env[dst] = engine->env[src];
+    engine->env_step[dst] = engine->env_step[src];
+    engine->stage0[dst] = engine->stage0[src];
+    engine->stage1[dst] = engine->stage1[src];
+    engine->stage2[dst] = engine->stage2[src];
+    engine->stage3[dst] = engine->stage3[src];
+    engine->pink0[dst] = engine->pink0[src];
+    engine->pink1[dst] = engine->pink1[src];
+    engine->pink2[dst] = engine->pink2[src];
+    engine->noise[dst] = engine->noise[src];
+    engine->frequency[dst] = engine->frequency[src];
+    engine->id[dst] = engine->id[src];
+    engine->age[dst] = engine->age[src];
+}
+
+// Prefer the quietest releasing voice, otherwise the oldest one
+static int pick_victim(VoiceEngine *engine) {
+    int victim = -1;
+    for (int k = 0; k < engine->active; k++) {
+        if (engine->env_step[k] < 0.0f &&
+            (victim < 0 || engine->env[k] < engine->env[victim])) {
+            victim = k;
+        }
+    }
+    if (victim >= 0) return victim;
+
+    victim = 0;
+    for (int k = 1; k < engine->active; k++) {
+        if ((gint32)(engine->age[k] - engine->age[victim]) < 0) {
+            victim = k;
+        }
+    }
+    return victim;
+}
+
+static void start_voice(VoiceEngine *engine, const VoiceEvent *event) {
+    int k = -1;
+
+    // Retrigger a voice already playing this id
+    for (int i = 0; i < engine->active; i++) {
+        if (engine->id[i] == event->id) {
+            k = i;
+            break;
+        }
+    }
+
+    if (k < 0 && engine->active < VOICE_MAX) {
+        k = engine->active++;
+        engine->phase[k] = 0.0f;
+        engine->env[k] = 0.0f;
+        engine->stage0[k] = engine->stage1[k] = engine->stage2[k] = engine->stage3[k] = 0.0f;
+        engine->pink0[k] = engine->pink1[k] = engine->pink2[k] = 0.0f;
+        engine->noise[k] = ++engine->next_seed;
+    } else if (k < 0) {
+        // Stolen voices keep their envelope level and filter state, so the
+        // new note ramps from where the old one was instead of clicking
+        k = pick_victim(engine);
+        engine->steals++;
+    }
+
+    engine->frequency[k] = event->frequency;
+    engine->increment[k] = event->frequency / engine->sample_rate;
+    engine->gain[k] = event->velocity;
+    engine->env_step[k] = envelope_step(engine->attack_ms, engine->sample_rate);
+    engine->id[k] = event->id;
+    engine->age[k] = engine->next_age++;
+}
+
+static void apply_events(VoiceEngine *engine) {
+    guint read = (guint)engine->event_read;
+    guint write = (guint)g_atomic_int_get(&engine->event_write);
+
+    for (; read != write; read++) {
+        const VoiceEvent *event = &engine->events[read & (VOICE_EVENT_RING - 1)];
+        float release = -envelope_step(engine->release_ms, engine->sample_rate);
+
+        switch (event->type) {
+            case VOICE_EVENT_NOTE_ON:
+                start_voice(engine, event);
+                break;
+
+            case VOICE_EVENT_NOTE_OFF:
+                for (int k = 0; k < engine->active; k++) {
+                    if (engine->id[k] == event->id && engine->env_step[k] >= 0.0f) {
+                        engine->env_step[k] = release;
+                    }
+                }
+                break;
+
+            case VOICE_EVENT_ALL_OFF:
+                for (int k = 0; k < engine->active; k++) {
+                    if (engine->env_step[k] >= 0.0f) {
+                        engine->env_step[k] = release;
+                    }
+                }
+                break;
+
+            case VOICE_EVENT_ENVELOPE:
+                engine->attack_ms = event->frequency;
+                engine->release_ms = event->velocity;
+                break;
+        }
+    }
+
+    g_atomic_int_set(&engine->event_read, (gint)read);
+}
+
+// Drop voices whose release has finished, keeping the active set packed
+static void retire_voices(VoiceEngine *engine) {
+    for (int k = engine->active - 1; k >= 0; k--) {
+        if (engine->env_step[k] < 0.0f && engine->env[k] <= 0.0f) {
+            engine->active--;
+            if (k != engine->active) {
+                copy_voice(engine, k, engine->active);
+            }
+        }
+    }
+}
+
+VoiceEngine* voice_engine_create(float sample_rate) {
+    VoiceEngine *engine = rt_pool_new(VoiceEngine, 1);
+    if (!engine) {
+        LOG_ERROR("Voice engine: Allocation failed");
+        return NULL;
+    }
+
+    engine->sample_rate = sample_rate > 0.0f ? sample_rate : DEFAULT_SAMPLE_RATE;
+    engine->attack_ms = VOICE_DEFAULT_ATTACK_MS;
+    engine->release_ms = VOICE_DEFAULT_RELEASE_MS;
+    mod_state_reset(&engine->mod, 1);
+    g_mutex_init(&engine->producer_mutex);
+    return engine;
+}
+
+void voice_engine_destroy(VoiceEngine *engine) {
+    if (!engine) return;
+
+    g_mutex_clear(&engine->producer_mutex);
+    rt_pool_free(engine);
+}
+
+// Any thread. Reusing an id that is still sounding retriggers that voice.
+bool voice_engine_note_on(VoiceEngine *engine, guint32 id, float frequency, float velocity) {
+    if (!engine || frequency <= 0.0f) return false;
+
+    VoiceEvent event = {
+        .type = VOICE_EVENT_NOTE_ON,
+        .id = id,
+        .frequency = frequency,
+        .velocity = CLAMP(velocity, 0.0f, 1.0f)
+    };
+    return push_event(engine, &event);
+}
+
+bool voice_engine_note_off(VoiceEngine *engine, guint32 id) {
+    if (!engine) return false;
+
+    VoiceEvent event = { .type = VOICE_EVENT_NOTE_OFF, .id = id };
+    return push_event(engine, &event);
+}
+
+bool voice_engine_all_off(VoiceEngine *engine) {
+    if (!engine) return false;
+
+    VoiceEvent event = { .type = VOICE_EVENT_ALL_OFF };
+    return push_event(engine, &event);
+}
+
+bool voice_engine_set_envelope(VoiceEngine *engine, float attack_ms, float release_ms) {
+    if (!engine || attack_ms < 0.0f || release_ms < 0.0f) return false;
+
+    VoiceEvent event = {
+        .type = VOICE_EVENT_ENVELOPE,
+        .frequency = attack_ms,
+        .velocity = release_ms
+    };
+    return push_event(engine, &event);
+}
+
+void voice_engine_set_sample_rate(VoiceEngine *engine, float sample_rate) {
+    if (!engine || sample_rate <= 0.0f || sample_rate == engine->sample_rate) return;
+
+    engine->sample_rate = sample_rate;
+    for (int k = 0; k < engine->active; k++) {
+        engine->increment[k] = engine->frequency[k] / sample_rate;
+    }
+}
+
+// Expands the modulation program over the block. Pitch, gain and duty
+// cycle are stored per sample; the filter at each interval boundary, for
+// render_group to interpolate.
+static void expand_modulation(VoiceEngine *engine, const OscillatorParams *params,
+                              size_t frames) {
+    const ModProgram *mod = params->mod;
+    float inv_sample_rate = 1.0f / engine->sample_rate;
+    float cutoff_range = params->filter_cutoff - 20.0f;
+    bool clamp_duty = (mod->dest_mask & (1u << MOD_DEST_DUTY)) != 0;
+    float amplitude_step = (params->amplitude_end - params->amplitude) / (float)frames;
+    float mod_start[MOD_DEST_COUNT];
+    float mod_end[MOD_DEST_COUNT];
+
+    mod_program_evaluate(mod, &engine->mod, mod_start);
+    ladder_filter_coeffs(&engine->filter_mod[0],
+                         params->filter_cutoff + mod_start[MOD_DEST_CUTOFF] * cutoff_range,
+                         params->filter_resonance + mod_start[MOD_DEST_RESONANCE],
+                         engine->sample_rate);
+
+    for (size_t start = 0, n = 0; start < frames; start += MOD_CONTROL_INTERVAL, n++) {
+        size_t end = MIN(start + MOD_CONTROL_INTERVAL, frames);
+        float inv_count = 1.0f / (float)(end - start);
+
+        mod_program_advance(mod, &engine->mod, end - start, inv_sample_rate);
+        mod_program_evaluate(mod, &engine->mod, mod_end);
+
+        float duty = params->duty_cycle + mod_start[MOD_DEST_DUTY];
+        float duty_end = params->duty_cycle + mod_end[MOD_DEST_DUTY];
+        if (clamp_duty) {
+            duty = fmaxf(0.1f, fminf(0.9f, duty));
+            duty_end = fmaxf(0.1f, fminf(0.9f, duty_end));
+        }
+        float duty_step = (duty_end - duty) * inv_count;
+        ladder_filter_coeffs(&engine->filter_mod[n + 1],
+                             params->filter_cutoff + mod_end[MOD_DEST_CUTOFF] * cutoff_range,
+                             params->filter_resonance + mod_end[MOD_DEST_RESONANCE],
+                             engine->sample_rate);
+
+        float pitch = 1.0f + mod_start[MOD_DEST_PITCH];
+        float pitch_step = (mod_end[MOD_DEST_PITCH] - mod_start[MOD_DEST_PITCH]) * inv_count;
+        float gain = 1.0f + mod_start[MOD_DEST_AMPLITUDE];
+        float gain_step = (mod_end[MOD_DEST_AMPLITUDE] - mod_start[MOD_DEST_AMPLITUDE]) * inv_count;
+        for (size_t i = start; i < end; i++) {
+            engine->pitch_mod[i] = pitch;
+            engine->gain_mod[i] = gain * (params->amplitude + amplitude_step * i);
+            engine->duty_mod[i] = duty;
+            pitch += pitch_step;
+            gain += gain_step;
+            duty += duty_step;
+        }
+
+        memcpy(mod_start, mod_end, sizeof(mod_start));
+    }
+}
+
+// One group of SIMD_LANES voices over the whole block
+static void render_group(VoiceEngine *engine, int base, const OscillatorParams *params,
+                         size_t frames) {
+    const v8sf zero = v8sf_set1(0.0f);
+    const v8sf one = v8sf_set1(1.0f);
+    const v8sf two = v8sf_set1(2.0f);
+    const v8sf four = v8sf_set1(4.0f);
+    const v8sf half = v8sf_set1(0.5f);
+
+    v8sf phase = v8sf_load(&engine->phase[base]);
+    v8sf inc = v8sf_load(&engine->increment[base]);
+    v8sf env = v8sf_load(&engine->env[base]);
+    v8sf env_step = v8sf_load(&engine->env_step[base]);
+    v8sf s0 = v8sf_load(&engine->stage0[base]);
+    v8sf s1 = v8sf_load(&engine->stage1[base]);
+    v8sf s2 = v8sf_load(&engine->stage2[base]);
+    v8sf s3 = v8sf_load(&engine->stage3[base]);
+    v8sf pink[PINK_NOISE_POLES] = {
+        v8sf_load(&engine->pink0[base]),
+        v8sf_load(&engine->pink1[base]),
+        v8sf_load(&engine->pink2[base]),
+    };
+    v8su noise = v8su_load(&engine->noise[base]);
+
+    // Lanes past the active count are silent; the shared amplitude is
+    // applied after the lanes are summed
+    v8si lane = (v8si){0, 1, 2, 3, 4, 5, 6, 7} + v8si_set1(base);
+    v8sf gain = v8sf_load(&engine->gain[base]);
+    gain = v8sf_select(lane < v8si_set1(engine->active), gain, zero);
+
+    for (size_t start = 0, n = 0; start < frames; start += MOD_CONTROL_INTERVAL, n++) {
+        size_t end = MIN(start + MOD_CONTROL_INTERVAL, frames);
+        float inv_count = 1.0f / (float)(end - start);
+        const LadderCoeffs *from = &engine->filter_mod[n];
+        const LadderCoeffs *to = &engine->filter_mod[n + 1];
+        v8sf p = v8sf_set1(from->p);
+        v8sf feedback = v8sf_set1(from->feedback);
+        v8sf comp = v8sf_set1(from->comp);
+        v8sf drive = v8sf_set1(from->drive);
+        const v8sf p_step = v8sf_set1((to->p - from->p) * inv_count);
+        const v8sf feedback_step = v8sf_set1((to->feedback - from->feedback) * inv_count);
+        const v8sf comp_step = v8sf_set1((to->comp - from->comp) * inv_count);
+        const v8sf drive_step = v8sf_set1((to->drive - from->drive) * inv_count);
+
+        for (size_t i = start; i < end; i++) {
+            v8sf wave;
+            switch (params->waveform) {
+                case WAVE_SINE:
+                    wave = v8sf_sin_cycles(phase);
+                    break;
+                case WAVE_SQUARE:
+                    wave = v8sf_select(v8sf_less(v8sf_set1(engine->duty_mod[i]), phase), -one, one);
+                    break;
+                case WAVE_SAW:
+                    wave = phase * two - one;
+                    break;
+                case WAVE_TRIANGLE:
+                    wave = one - four * v8sf_abs(phase - half);
+                    break;
+                case WAVE_PINK_NOISE:
+                    wave = v8sf_pink_noise_step(pink, v8su_white_noise(&noise));
+                    break;
+                default:
+                    wave = zero;
+                    break;
+            }
+
+            // Same ladder as the single-voice path
+            v8sf in = (wave - feedback * s3) * comp;
+            s0 = s0 + p * (v8sf_tanh(in * drive) - s0);
+            s1 = s1 + p * (v8sf_tanh(s0 * drive) - s1);
+            s2 = s2 + p * (v8sf_tanh(s1 * drive) - s2);
+            s3 = s3 + p * (v8sf_tanh(s2 * drive) - s3);
+            p += p_step;
+            feedback += feedback_step;
+            comp += comp_step;
+            drive += drive_step;
+
+            env = v8sf_min(v8sf_max(env + env_step, zero), one);
+            engine->mix[i] += s3 * env * gain;
+
+            // Deep pitch modulation can run the phase backwards, or more
+            // than a cycle per sample at a low stream rate
+            phase += inc * v8sf_set1(engine->pitch_mod[i]);
+            phase -= v8sf_floor(phase);
+        }
+    }
+
+    v8sf_store(&engine->phase[base], phase);
+    v8sf_store(&engine->env[base], env);
+    v8sf_store(&engine->stage0[base], s0);
+    v8sf_store(&engine->stage1[base], s1);
+    v8sf_store(&engine->stage2[base], s2);
+    v8sf_store(&engine->stage3[base], s3);
+    v8sf_store(&engine->pink0[base], pink[0]);
+    v8sf_store(&engine->pink1[base], pink[1]);
+    v8sf_store(&engine->pink2[base], pink[2]);
+    v8su_store(&engine->noise[base], noise);
+}
+
+// Applies queued events, renders every active voice into `out` (mono,
+// overwritten) and returns the number of voices still sounding.
+// Voices share the waveform, amplitude, duty cycle, filter and one set of
+// modulation sources. Voices keep their own pitch, so frequency_end is
+// ignored; amplitude_end ramps all of them.
+int voice_engine_render(VoiceEngine *engine, const OscillatorParams *params,
+                        float *out, size_t frames) {
+    frames = MIN(frames, (size_t)MAX_BLOCK_SIZE);
+    apply_events(engine);
+
+    // Sources keep running while silent so notes join them in phase
+    expand_modulation(engine, params, frames);
+
+    if (engine->active == 0) {
+        memset(out, 0, frames * sizeof(float));
+        return 0;
+    }
+
+    memset(engine->mix, 0, frames * sizeof(v8sf));
+    for (int base = 0; base < engine->active; base += SIMD_LANES) {
+        render_group(engine, base, params, frames);
+    }
+
+    for (size_t i = 0; i < frames; i++) {
+        out[i] = v8sf_hsum(engine->mix[i]) * engine->gain_mod[i];
+    }
+
+    retire_voices(engine);
+    return engine->active;
+}
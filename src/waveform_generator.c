@@ -2,288 +2,282 @@
 #include "parameter_store.h"
 #include "scope_window.h"
 #include "audio_manager.h"
+#include "logger.h"
+#include "profile.h"
+#include "trace.h"
+#include "rt_thread.h"
+#include "rt_pool.h"
 #include <math.h>
 
 static size_t audio_callback(float *buffer, size_t frames, void *userdata);
-static float generate_waveform(float phase, WaveformType type, float duty_cycle);
 static gpointer generator_thread_func(gpointer data);
 size_t circular_buffer_write(CircularBuffer *buffer, float *data, size_t frames);
 
-#define PINK_NOISE_OCTAVES 7
-static float pink_noise_values[PINK_NOISE_OCTAVES] = {0};
-static float pink_noise_total = 0;
-
-static float generate_pink_noise(void) {
-    float white = ((float)rand() / RAND_MAX) * 2.0f - 1.0f;
-    
-    // Update pink noise values
-    pink_noise_total -= pink_noise_values[0];
-    for (int i = 0; i < PINK_NOISE_OCTAVES - 1; i++) {
-        pink_noise_values[i] = pink_noise_values[i + 1];
+// Instances follow the per-channel settings, one per output channel
+static void route_channels(WaveformGenerator *gen, const ChannelConfig *config) {
+    for (int ch = 0; ch < gen->channels; ch++) {
+        gen->pool->instances[ch].config = config[ch];
+        gen->pool->instances[ch].route = ch;
     }
-    pink_noise_values[PINK_NOISE_OCTAVES - 1] = white;
-    pink_noise_total += white;
-    
-    // Mix white noise with filtered pink noise
-    float pink = pink_noise_total / PINK_NOISE_OCTAVES;
-    return (pink + white) * 0.5f;
 }
 
-
-// Utility function for tanh approximation (faster than std tanh)
-static float fast_tanh(float x) {
-    float x2 = x * x;
-    return x * (27.0f + x2) / (27.0f + 9.0f * x2);
+// Tones are log-spaced over the audio band and dealt round-robin across
+// the outputs, scaled so no channel sums above the main amplitude
+static void route_tones(WaveformGenerator *gen, float nyquist) {
+    int per_channel = (gen->tones + gen->channels - 1) / gen->channels;
+    float top = fminf(TONE_MAX_FREQ, nyquist * 0.9f);
+    float span = (gen->tones > 1) ? logf(top / TONE_MIN_FREQ) / (gen->tones - 1) : 0.0f;
+
+    for (int k = 0; k < gen->tones; k++) {
+        RenderInstance *inst = &gen->pool->instances[k];
+        inst->config.frequency = TONE_MIN_FREQ * expf(span * k);
+        inst->config.freq_ratio = 1.0f;
+        inst->config.phase_offset = 0.0f;
+        inst->config.gain = 1.0f / per_channel;
+        inst->route = k % gen->channels;
+    }
 }
 
-static void ladder_filter_reset(LadderFilter *filter) {
-    memset(filter->stage, 0, sizeof(float) * FILTER_STAGES);
-    memset(filter->delay, 0, sizeof(float) * FILTER_STAGES);
-    filter->cutoff_mod = 0.0f;  // Reset modulation
-    filter->res_mod = 0.0f;     // Reset resonance mod
+// Measurement sweeps skip the filter and modulation so the stimulus is
+// exactly the closed-form sweep, scaled by amplitude and channel gain
+static void render_sweep(WaveformGenerator *gen, const OscillatorParams *base,
+                         const ChannelConfig *config, float *buffer, size_t frames) {
+    sweep_render(&gen->sweep, gen->voice_out, frames, &gen->markers);
+
+    float amplitude_step = (base->amplitude_end - base->amplitude) / frames;
+    for (int ch = 0; ch < gen->channels; ch++) {
+        float amplitude = base->amplitude * config[ch].gain;
+        float step = amplitude_step * config[ch].gain;
+        for (size_t i = 0; i < frames; i++) {
+            buffer[i * gen->channels + ch] = gen->voice_out[i] * amplitude;
+            amplitude += step;
+        }
+    }
 }
 
-static float ladder_filter_process(LadderFilter *filter, float input, float sample_rate) {
-    // Calculate and bound cutoff frequency with extra safety margin
-    float fc = filter->cutoff + filter->cutoff_mod;
-    fc = fmaxf(20.0f, fminf(fc, 20000.0f));
-    
-    // Add extra safety bound for very low frequencies
-    fc = fmaxf(fc, sample_rate * 0.0005f);  // Minimum 0.05% of sample rate
-    
-    // Smoothed frequency normalization
-    float f = fminf(0.499f, fc / sample_rate);  // Prevent getting too close to Nyquist
-
-    // Enhanced resonance response
-    float res = filter->resonance + filter->res_mod;
-    res = fmaxf(0.0f, fminf(res, 1.0f));
-    
-    // Scale resonance for feedback (reduced from 4.0 to 3.8 to prevent self-oscillation getting too extreme)
-    float scaled_res = 3.8f * powf(res, 0.5f);
-    
-    // Compute filter coefficients
-    float k = 4.0f * (f * M_PI);
-    float p = k / (1.0f + k);
-    
-    // Adjusted compensation - only compensate for resonance-induced gain changes
-    float comp = 1.0f / (1.0f + scaled_res * 0.1f);
-    
-    // Input with resonance feedback
-    float input_with_res = input - scaled_res * filter->delay[3];
-    input_with_res *= comp;
-    
-    // Cascade of 4 one-pole filters
-    float stages[4];
-    stages[0] = input_with_res;
-    
-    for (int i = 0; i < 4; i++) {
-        if (i > 0) stages[i] = filter->delay[i-1];
-        
-        // Nonlinear processing - scale back the resonance influence
-        stages[i] = fast_tanh(stages[i] * (1.0f + 0.3f * res));
-        
-        // One-pole lowpass filter
-        filter->delay[i] = filter->delay[i] + p * (stages[i] - filter->delay[i]);
+// Renders one span of the block with fixed parameter endpoints
+static void render_span(WaveformGenerator *gen, const OscillatorParams *base,
+                        const ChannelConfig *config, float *buffer, size_t frames,
+                        float sample_rate, float phase_scale) {
+    if (base->waveform == WAVE_SWEEP) {
+        render_sweep(gen, base, config, buffer, frames);
+        return;
     }
-    
-    return filter->delay[3];
-}
 
-static float generate_waveform(float phase, WaveformType type, float duty_cycle) {
-    switch(type) {
-        case WAVE_SINE:
-            return sinf(phase);
-            
-        case WAVE_SQUARE: {
-            float threshold = duty_cycle * 2.0f * M_PI;
-            return (phase <= threshold) ? 1.0f : -1.0f;
-        }
-            
-        case WAVE_SAW:
-            return (phase / (2.0f * M_PI) * 2.0f) - 1.0f;
-            
-        case WAVE_TRIANGLE: {
-            float normalized = phase / (2.0f * M_PI);
-            if (normalized < 0.5f) {
-                return normalized * 4.0f - 1.0f;
-            } else {
-                return 3.0f - normalized * 4.0f;
+    if (g_atomic_int_get(&gen->poly)) {
+        voice_engine_set_sample_rate(gen->voices, sample_rate);
+        voice_engine_render(gen->voices, base, gen->voice_out, frames);
+        for (int ch = 0; ch < gen->channels; ch++) {
+            float gain = config[ch].gain;
+            for (size_t i = 0; i < frames; i++) {
+                buffer[i * gen->channels + ch] = gen->voice_out[i] * gain;
             }
         }
+        return;
+    }
 
-        case WAVE_PINK_NOISE:
-            return generate_pink_noise();
-            
-        default:
-            return 0.0f;
+    size_t count = gen->tones;
+    if (!gen->tones) {
+        route_channels(gen, config);
+        count = gen->channels;
     }
+    render_pool_render(gen->pool, count, base, buffer, gen->channels,
+                       frames, sample_rate, phase_scale);
 }
 
+static void set_span_params(OscillatorParams *base, const float *start, const float *end) {
+    base->frequency = start[PARAM_FREQUENCY];
+    base->frequency_end = end[PARAM_FREQUENCY];
+    base->amplitude = start[PARAM_AMPLITUDE];
+    base->amplitude_end = end[PARAM_AMPLITUDE];
+    base->duty_cycle = start[PARAM_DUTY_CYCLE];
+    base->filter_cutoff = start[PARAM_FILTER_CUTOFF];
+    base->filter_resonance = start[PARAM_FILTER_RESONANCE];
+}
 
-
+// Renders gen->channels interleaved channels into buffer. The block is
+// split wherever a parameter event falls, so events land on their exact
+// sample; ramps are followed per sample or per PARAM_RAMP_INTERVAL.
 static size_t audio_callback(float *buffer, size_t frames, void *userdata) {
     WaveformGenerator *gen = (WaveformGenerator *)userdata;
+    OscillatorParams base;
+    ChannelConfig config[MAX_OUTPUT_CHANNELS];
+    ModMatrix matrix;
+    SweepConfig sweep;
+    float store_values[PARAM_COUNT];
+
+    frames = MIN(frames, (size_t)MAX_BLOCK_SIZE);
 
     // Get current parameters with minimal lock time
     g_mutex_lock(&gen->params->mutex);
-    WaveformType current_type = gen->params->waveform;
-    float current_frequency = gen->params->frequency;
-    float current_amplitude = gen->params->amplitude;
-    float current_duty_cycle = gen->params->duty_cycle;
-    float current_fm_freq = gen->params->fm_frequency;
-    float current_fm_depth = gen->params->fm_depth;
-    float current_am_freq = gen->params->am_frequency;
-    float current_am_depth = gen->params->am_depth;
-    float current_dcm_freq = gen->params->dcm_frequency;
-    float current_dcm_depth = gen->params->dcm_depth;
-    float current_cutoff = gen->params->filter_cutoff;
-    float current_resonance = gen->params->filter_resonance;
-    float current_cutoff_lfo_freq = gen->params->filter_cutoff_lfo_freq;
-    float current_cutoff_lfo_amount = gen->params->filter_cutoff_lfo_amount;
-    float current_res_lfo_freq = gen->params->filter_res_lfo_freq;
-    float current_res_lfo_amount = gen->params->filter_res_lfo_amount;
+    base.waveform = gen->params->waveform;
+    base.phase_offset = 0.0f;
+    store_values[PARAM_FREQUENCY] = gen->params->frequency;
+    store_values[PARAM_AMPLITUDE] = gen->params->amplitude;
+    store_values[PARAM_DUTY_CYCLE] = gen->params->duty_cycle;
+    store_values[PARAM_FILTER_CUTOFF] = gen->params->filter_cutoff;
+    store_values[PARAM_FILTER_RESONANCE] = gen->params->filter_resonance;
+    matrix = gen->params->mod;
+    sweep = gen->params->sweep;
+    guint sweep_serial = gen->params->sweep_serial;
+    memcpy(config, gen->params->channels, gen->channels * sizeof(ChannelConfig));
     g_mutex_unlock(&gen->params->mutex);
 
-    // Get phase variables with minimal lock time
+    // Flatten the active routes once; every instance runs the same program
+    mod_program_compile(&gen->mod, &matrix);
+    base.mod = &gen->mod;
+
     g_mutex_lock(&gen->mutex);
-    float current_phase = gen->phase;
-    float current_fm_phase = gen->fm_phase;
-    float current_am_phase = gen->am_phase;
-    float current_dcm_phase = gen->dcm_phase;
-    float cutoff_lfo_phase = gen->filter.cutoff_lfo_phase;
-    float res_lfo_phase = gen->filter.res_lfo_phase;
+    float sample_rate = (float)gen->sample_rate;
+    float phase_scale = gen->phase_scale;
+    guint64 now = gen->sample_time;
+    gen->sample_time += frames;
     g_mutex_unlock(&gen->mutex);
 
-    // Generate samples
-    for (size_t i = 0; i < frames; i++) {
-        // Calculate FM modulation
-        float frequency_mod = 0.0f;
-        if (current_fm_freq > 0.0f) {
-            frequency_mod = current_fm_depth * sinf(current_fm_phase);
-            current_fm_phase = fmodf(current_fm_phase +
-                (2.0f * M_PI * current_fm_freq / SAMPLE_RATE), 2.0f * M_PI);
-        }
+    // A sweep starts over whenever it is selected, reconfigured or the
+    // stream rate changes
+    gboolean sweeping = base.waveform == WAVE_SWEEP;
+    if (sweeping && (!gen->sweeping || sweep_serial != gen->sweep_serial ||
+                     gen->sweep.sample_rate != sample_rate)) {
+        sweep_start(&gen->sweep, &sweep, sample_rate, now);
+        gen->sweep_serial = sweep_serial;
+    }
+    gen->sweeping = sweeping;
 
-        // Calculate duty cycle modulation
-        float duty_mod = current_duty_cycle;
-        if (current_dcm_freq > 0.0f) {
-            duty_mod += current_dcm_depth * sinf(current_dcm_phase);
-            duty_mod = fmaxf(0.1f, fminf(0.9f, duty_mod));
-            current_dcm_phase = fmodf(current_dcm_phase +
-                (2.0f * M_PI * current_dcm_freq / SAMPLE_RATE), 2.0f * M_PI);
-        }
+    param_event_queue_begin(gen->events, store_values);
 
-        // Generate base waveform
-        float wave_value = generate_waveform(current_phase, current_type, duty_mod);
-
-        // Calculate filter modulation - use Hz range for cutoff modulation
-        float cutoff_mod = 0.0f;
-        if (current_cutoff_lfo_freq > 0.0f) {
-            // Modulate between 20Hz and current cutoff frequency
-            float mod_range = current_cutoff - 20.0f;
-            cutoff_mod = current_cutoff_lfo_amount * sinf(cutoff_lfo_phase) * mod_range;
-            cutoff_lfo_phase += 2.0f * M_PI * current_cutoff_lfo_freq / SAMPLE_RATE;
-            if (cutoff_lfo_phase >= 2.0f * M_PI)
-                cutoff_lfo_phase -= 2.0f * M_PI;
-        }
+    size_t pos = 0;
+    while (pos < frames) {
+        float start[PARAM_COUNT];
+        float end[PARAM_COUNT];
 
-        float res_mod = 0.0f;
-        if (current_res_lfo_freq > 0.0f) {
-            res_mod = current_res_lfo_amount * sinf(res_lfo_phase);
-            res_lfo_phase += 2.0f * M_PI * current_res_lfo_freq / SAMPLE_RATE;
-            if (res_lfo_phase >= 2.0f * M_PI)
-                res_lfo_phase -= 2.0f * M_PI;
-        }
+        param_event_queue_apply(gen->events, now + pos);
+        size_t span = param_event_queue_span(gen->events, now + pos, frames - pos);
 
-        // Apply filter
-        gen->filter.cutoff = current_cutoff;
-        gen->filter.resonance = current_resonance;
-        gen->filter.cutoff_mod = cutoff_mod;
-        gen->filter.res_mod = res_mod;
+        memcpy(start, store_values, sizeof(start));
+        param_event_queue_values(gen->events, start);
+        param_event_queue_advance(gen->events, span);
+        memcpy(end, store_values, sizeof(end));
+        param_event_queue_values(gen->events, end);
 
-        wave_value = ladder_filter_process(&gen->filter, wave_value, SAMPLE_RATE);
+        set_span_params(&base, start, end);
+        render_span(gen, &base, config, buffer + pos * gen->channels, span,
+                    sample_rate, phase_scale);
+        pos += span;
+    }
 
-        // Apply AM modulation
-        float amplitude_mod = 1.0f;
-        if (current_am_freq > 0.0f) {
-            amplitude_mod = 1.0f + (current_am_depth * sinf(current_am_phase));
-            current_am_phase = fmodf(current_am_phase +
-                (2.0f * M_PI * current_am_freq / SAMPLE_RATE), 2.0f * M_PI);
-        }
+    if (gen->tracker) {
+        tone_tracker_process(gen->tracker, buffer, frames, gen->channels, now, sample_rate);
+    }
+    if (gen->measure) {
+        waveform_measure_process(gen->measure, buffer, frames, gen->channels, now, sample_rate);
+    }
 
-        // Calculate final value
-        float value = wave_value * current_amplitude * amplitude_mod;
+    return frames;
+}
 
-        // Write to stereo buffer
-        buffer[i * 2] = value;
-        buffer[i * 2 + 1] = value;
+// Restart all instances phase-locked after the layout changes
+static void reset_instances(WaveformGenerator *gen) {
+    render_pool_reset(gen->pool);
+    if (gen->tones) {
+        route_tones(gen, gen->sample_rate * 0.5f);
+    }
+}
 
-        // Update phase
-        current_phase = fmodf(current_phase +
-            (2.0f * M_PI * current_frequency / SAMPLE_RATE) *
-            (1.0f + frequency_mod), 2.0f * M_PI);
+// The scope shows channels 1 and 2; a mono stream shows channel 1 twice
+static void copy_scope_pairs(float *dst, const float *src, size_t frames, int channels) {
+    if (channels == 2) {
+        memcpy(dst, src, frames * 2 * sizeof(float));
+        return;
+    }
+    size_t right = channels > 1 ? 1 : 0;
+    for (size_t i = 0; i < frames; i++) {
+        dst[i * 2] = src[i * channels];
+        dst[i * 2 + 1] = src[i * channels + right];
     }
+}
 
-    // Save phase states with minimal lock time
-    g_mutex_lock(&gen->mutex);
-    gen->phase = current_phase;
-    gen->fm_phase = current_fm_phase;
-    gen->am_phase = current_am_phase;
-    gen->dcm_phase = current_dcm_phase;
-    gen->filter.cutoff_lfo_phase = cutoff_lfo_phase;
-    gen->filter.res_lfo_phase = res_lfo_phase;
-    g_mutex_unlock(&gen->mutex);
+// Keeps the sweep markers that still fall inside the scope window, oldest
+// first, dropping the oldest when more arrive than the scope can show
+static void collect_scope_markers(WaveformGenerator *gen, gint *cursor, SweepMarker *recent,
+                                  int *num_recent, guint64 window_start) {
+    SweepMarker fresh[SCOPE_MAX_MARKERS];
+    int count;
+
+    while ((count = sweep_marker_ring_read(&gen->markers, cursor, fresh, SCOPE_MAX_MARKERS)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (*num_recent == SCOPE_MAX_MARKERS) {
+                memmove(recent, recent + 1, (SCOPE_MAX_MARKERS - 1) * sizeof(SweepMarker));
+                (*num_recent)--;
+            }
+            recent[(*num_recent)++] = fresh[i];
+        }
+    }
 
-    return frames;
+    int expired = 0;
+    while (expired < *num_recent && recent[expired].sample_time < window_start) {
+        expired++;
+    }
+    if (expired > 0) {
+        *num_recent -= expired;
+        memmove(recent, recent + expired, *num_recent * sizeof(SweepMarker));
+    }
 }
 
 //#define TARGET_BUFFER_FILL (CIRCULAR_BUFFER_FRAMES / 2)  // Try to maintain 50% fill
 static gpointer generator_thread_func(gpointer data) {
-    g_print("Generator thread: Starting initialization\n");
+    logger_thread_init();
+    trace_thread_name("generator");
+    PROFILE_THREAD_INIT();
+    rt_thread_setup(RT_THREAD_GENERATOR, "generator");
+    LOG_DEBUG("Generator thread: Starting initialization");
     
     if (!data) {
-        g_print("ERROR: Generator thread started with NULL data\n");
+        LOG_ERROR("Generator thread started with NULL data");
         return NULL;
     }
 
     struct WaveformGenerator *gen = (struct WaveformGenerator *)data;
-    g_print("Generator thread: Got generator pointer\n");
+    LOG_DEBUG("Generator thread: Got generator pointer");
     
     if (!gen->scope) {
-        g_print("ERROR: Generator has NULL scope\n");
+        LOG_ERROR("Generator has NULL scope");
         return NULL;
     }
-    g_print("Generator thread: Got valid scope pointer\n");
+    LOG_DEBUG("Generator thread: Got valid scope pointer");
     
     if (!gen->scope->waveform_data) {
-        g_print("ERROR: Scope has NULL waveform data\n");
+        LOG_ERROR("Scope has NULL waveform data");
         return NULL;
     }
-    g_print("Generator thread: Got valid waveform data\n");
+    LOG_DEBUG("Generator thread: Got valid waveform data");
     
     // Initialize FFT if needed
     if (gen->scope->fft) {
-        g_print("Generator thread: Found FFT analyzer\n");
+        LOG_DEBUG("Generator thread: Found FFT analyzer");
     }
 
-    float *audio_buffer = g_malloc(AUDIO_BUFFER_SIZE * 2 * sizeof(float));
-    float *scope_buffer = g_malloc(SCOPE_BUFFER_SIZE * 2 * sizeof(float));
+    float *audio_buffer = gen->block_out;
+    float *scope_buffer = gen->scope_history;
     size_t scope_samples = 0;
+    SweepMarker scope_markers[SCOPE_MAX_MARKERS];
+    int num_scope_markers = 0;
+    gint marker_cursor = 0;
     
     if (!audio_buffer || !scope_buffer) {
-        g_print("ERROR: Failed to allocate generator buffers\n");
-        g_free(audio_buffer);
-        g_free(scope_buffer);
+        LOG_ERROR("Failed to allocate generator buffers");
         return NULL;
     }
    
-    g_print("Generator thread: Local buffers initialized\n");
+    LOG_DEBUG("Generator thread: Local buffers initialized");
     size_t failed_lock_count = 0;
     bool was_locked_out = false;
+    bool was_playing = false;
+    size_t configured_min_fill = 0;
     
     while (TRUE) {
         if (!gen->scope) {  // Check again in loop
-            g_print("ERROR: Scope became NULL during operation\n");
+            LOG_ERROR("Scope became NULL during operation");
             break;
         }
 
@@ -292,32 +286,71 @@ static gpointer generator_thread_func(gpointer data) {
         g_mutex_unlock(&gen->mutex);
         
         if (!is_running) {
-            g_print("Generator thread stopping normally\n");
+            LOG_INFO("Generator thread stopping normally");
             break;
         }
 
         // Wait for audio callback timing
-        if (gen->audio) {
+        bool playing = gen->audio && audio_manager_is_playback_active(gen->audio);
+        if (playing) {
+            gint64 now = g_get_monotonic_time();
+            guint64 xruns = audio_telemetry_xrun_count(&gen->audio->telemetry);
+            if (!was_playing) {
+                // Stream format is settled once playback is active
+                waveform_generator_set_sample_rate(gen, audio_manager_get_sample_rate(gen->audio));
+                reset_instances(gen);
+                configured_min_fill = 0;
+                latency_controller_reset(&gen->latency, xruns, now);
+            }
+
             g_mutex_lock(&gen->audio->buffer.mutex);
-            gboolean need_data = (gen->audio->buffer.frames_stored < AUDIO_BUFFER_SIZE * 2);
+            size_t fill = gen->audio->buffer.frames_stored;
+            // Render exactly the channel layout the ring was opened with
+            if (gen->audio->buffer.channels != gen->channels) {
+                gen->channels = gen->audio->buffer.channels;
+                reset_instances(gen);
+                LOG_INFO("Generator rendering %d channels", gen->channels);
+            }
+            // The first callbacks reveal the real device block size
+            if (gen->audio->buffer.min_fill != configured_min_fill) {
+                configured_min_fill = gen->audio->buffer.min_fill;
+                latency_controller_configure(&gen->latency, gen->sample_rate, configured_min_fill);
+            }
+            latency_controller_update(&gen->latency, fill, xruns, now);
+            gboolean need_data = (fill < gen->latency.target_fill);
+            TRACE_COUNTER("ring fill (generator)", fill);
+            TRACE_COUNTER("target fill", gen->latency.target_fill);
             if (!need_data) {
+                TRACE_BEGIN("wait for callback");
                 g_cond_wait(&gen->audio->buffer.data_ready, &gen->audio->buffer.mutex);
+                TRACE_END("wait for callback");
             }
             g_mutex_unlock(&gen->audio->buffer.mutex);
         }
+        was_playing = playing;
         
         // Generate audio
-        size_t frames_written = audio_callback(audio_buffer, AUDIO_BUFFER_SIZE, gen);
+        TRACE_BEGIN("render block");
+        PROFILE_START(block_start);
+        size_t frames_written = audio_callback(audio_buffer, gen->latency.block_size, gen);
+        PROFILE_STOP(PROFILE_BLOCK, block_start);
+        TRACE_END("render block");
         
         // Handle audio output
-        if (gen->audio && audio_manager_is_playback_active(gen->audio)) {
+        if (playing) {
+            TRACE_BEGIN("ring write");
+            PROFILE_START(ring_start);
             circular_buffer_write(&gen->audio->buffer, audio_buffer, frames_written);
+            PROFILE_STOP(PROFILE_RING_WRITE, ring_start);
+            TRACE_END("ring write");
         }
         
         // Always accumulate in local buffer
+        PROFILE_TOTAL(copy_ticks);
+        PROFILE_START(history_start);
         if (scope_samples + frames_written <= SCOPE_BUFFER_SIZE) {
-            memcpy(&scope_buffer[scope_samples * 2], audio_buffer, 
-                   frames_written * sizeof(float) * 2);
+            copy_scope_pairs(&scope_buffer[scope_samples * 2], audio_buffer,
+                             frames_written, gen->channels);
             scope_samples += frames_written;
         } else {
             // Buffer is full, shift data left and add new samples at end
@@ -326,18 +359,37 @@ static gpointer generator_thread_func(gpointer data) {
                 memmove(scope_buffer, &scope_buffer[frames_written * 2], 
                        remaining * sizeof(float) * 2);
             }
-            memcpy(&scope_buffer[remaining * 2], audio_buffer,
-                   frames_written * sizeof(float) * 2);
+            copy_scope_pairs(&scope_buffer[remaining * 2], audio_buffer,
+                             frames_written, gen->channels);
             scope_samples = SCOPE_BUFFER_SIZE;
         }
+        PROFILE_ADD(copy_ticks, history_start);
+
+        // The display acquires from the feed; it takes no scope lock, so no
+        // frames are lost while the display holds that
+        if (gen->scope->show_phosphor && frames_written > 0) {
+            phosphor_feed(gen->scope->phosphor, &scope_buffer[(scope_samples - frames_written) * 2],
+                          frames_written);
+        }
+
+        // This thread is the only one advancing the clock while it runs
+        guint64 end_time = waveform_generator_get_sample_time(gen);
+        collect_scope_markers(gen, &marker_cursor, scope_markers, &num_scope_markers,
+                              end_time - scope_samples);
+        float sweep_frequency = 0.0f;
+        if (gen->sweeping && gen->sweep.active) {
+            sweep_frequency = (float)(gen->sweep.inc * gen->sample_rate / (2.0 * M_PI));
+        }
 
         // Try to update display buffer - but keep accumulating even if we can't
         if (g_mutex_trylock(&gen->scope->update_mutex)) {
             if (g_mutex_trylock(&gen->scope->data_mutex)) {
+                TRACE_BEGIN("scope publish");
                 if (was_locked_out) {
-                    g_print("Display update resumed after %zu failed attempts\n", failed_lock_count);
+                    LOG_INFO("Display update resumed after %zu failed attempts", failed_lock_count);
                     was_locked_out = false;
                     failed_lock_count = 0;
+                    TRACE_COUNTER("scope lockouts", 0);
                 }
                 
                 if (gen->scope->waveform_data && scope_samples > 0) {
@@ -345,8 +397,16 @@ static gpointer generator_thread_func(gpointer data) {
                     size_t max_bytes = gen->scope->data_size * sizeof(float) * 2;
                     
                     if (bytes_to_copy <= max_bytes) {
+                        PROFILE_START(publish_start);
                         memcpy(gen->scope->waveform_data, scope_buffer, bytes_to_copy);
                         gen->scope->write_pos = scope_samples;
+                        gen->scope->sample_rate = gen->sample_rate;
+                        gen->scope->end_time = end_time;
+                        memcpy(gen->scope->markers, scope_markers,
+                               num_scope_markers * sizeof(SweepMarker));
+                        gen->scope->num_markers = num_scope_markers;
+                        gen->scope->sweep_frequency = sweep_frequency;
+                        PROFILE_ADD(copy_ticks, publish_start);
                         
                         if (gen->scope->drawing_area && GTK_IS_WIDGET(gen->scope->drawing_area)) {
                             gtk_widget_queue_draw(gen->scope->drawing_area);
@@ -354,46 +414,64 @@ static gpointer generator_thread_func(gpointer data) {
                     }
                 }
                 g_mutex_unlock(&gen->scope->data_mutex);
+                TRACE_END("scope publish");
+            } else {
+                TRACE_INSTANT("scope data locked");
             }
             g_mutex_unlock(&gen->scope->update_mutex);
+            PROFILE_RECORD(PROFILE_SCOPE_COPY, copy_ticks);
         } else {
+            TRACE_INSTANT("scope update locked");
             if (!was_locked_out) {
-                g_print("Display update locked out\n");
+                LOG_WARN("Display update locked out");
                 was_locked_out = true;
             }
             failed_lock_count++;
+            TRACE_COUNTER("scope lockouts", failed_lock_count);
             if (failed_lock_count % 1000 == 0) {  // Log every 1000 failures
-                g_print("Still locked out after %zu attempts\n", failed_lock_count);
+                LOG_WARN("Still locked out after %zu attempts", failed_lock_count);
             }
         }
     }
     
-    g_free(audio_buffer);
-    g_free(scope_buffer);
-    g_print("Generator thread exiting\n");
+    LOG_INFO("Generator thread exiting");
     return NULL;
 }
 
 struct WaveformGenerator* waveform_generator_create(ParameterStore *params, struct ScopeWindow *scope, AudioManager *audio) {
-    g_print("Creating waveform generator\n");
+    LOG_INFO("Creating waveform generator");
     
     WaveformGenerator *gen = g_new0(WaveformGenerator, 1);
     gen->params = params;
     gen->scope = scope;
     gen->audio = audio;
     gen->running = FALSE;  // Start as not running
-    gen->phase = 0.0f;
-    gen->fm_phase = 0.0f;
-    gen->am_phase = 0.0f;
-    gen->dcm_phase = 0.0f;
-    gen->sample_rate = SAMPLE_RATE;
-    gen->buffer_size = BUFFER_SIZE;
+    gen->buffer_size = MAX_BLOCK_SIZE;
+    gen->channels = DEFAULT_OUTPUT_CHANNELS;
+    gen->tones = 0;
     
-    // Initialize filter
-    ladder_filter_reset(&gen->filter);
+    // Channel mode renders inline; a tone bank brings its own workers
+    gen->pool = render_pool_create(MAX_OUTPUT_CHANNELS, 1);
+    gen->voices = voice_engine_create(DEFAULT_SAMPLE_RATE);
+    gen->voice_out = rt_pool_new(float, MAX_BLOCK_SIZE);
+    gen->block_out = rt_pool_new(float, MAX_BLOCK_SIZE * MAX_OUTPUT_CHANNELS);
+    gen->scope_history = rt_pool_new(float, SCOPE_BUFFER_SIZE * 2);
+    gen->events = param_event_queue_create();
+    if (!gen->pool || !gen->voices) {
+        render_pool_destroy(gen->pool);
+        voice_engine_destroy(gen->voices);
+        param_event_queue_destroy(gen->events);
+        rt_pool_free(gen->voice_out);
+        rt_pool_free(gen->block_out);
+        rt_pool_free(gen->scope_history);
+        g_free(gen);
+        return NULL;
+    }
+    latency_controller_init(&gen->latency, MAX_BLOCK_SIZE);
     
     g_mutex_init(&gen->mutex);
     g_cond_init(&gen->cond);
+    waveform_generator_set_sample_rate(gen, DEFAULT_SAMPLE_RATE);
     
     // Don't start thread yet
     gen->generator_thread = NULL;
@@ -405,7 +483,7 @@ struct WaveformGenerator* waveform_generator_create(ParameterStore *params, stru
 void waveform_generator_destroy(WaveformGenerator *gen) {
     if (!gen) return;
     
-    g_print("Destroying waveform generator\n");
+    LOG_INFO("Destroying waveform generator");
     
     // Stop the generator thread safely
     g_mutex_lock(&gen->mutex);
@@ -426,6 +504,12 @@ void waveform_generator_destroy(WaveformGenerator *gen) {
     g_mutex_clear(&gen->mutex);
     g_cond_clear(&gen->cond);
     
+    render_pool_destroy(gen->pool);
+    voice_engine_destroy(gen->voices);
+    param_event_queue_destroy(gen->events);
+    rt_pool_free(gen->voice_out);
+    rt_pool_free(gen->block_out);
+    rt_pool_free(gen->scope_history);
     g_free(gen);
 }
 
@@ -449,3 +533,101 @@ void waveform_generator_start(WaveformGenerator *gen) {
                                        generator_thread_func, gen);
     g_mutex_unlock(&gen->mutex);
 }
+
+// Precomputes the per-rate constants used by the render loop
+void waveform_generator_set_sample_rate(WaveformGenerator *gen, uint32_t sample_rate) {
+    if (!gen || sample_rate == 0) return;
+
+    g_mutex_lock(&gen->mutex);
+    if (gen->sample_rate != sample_rate) {
+        LOG_INFO("Generator sample rate: %u Hz", sample_rate);
+    }
+    gen->sample_rate = sample_rate;
+    gen->inv_sample_rate = 1.0f / sample_rate;
+    gen->phase_scale = 2.0f * M_PI / sample_rate;
+    g_mutex_unlock(&gen->mutex);
+}
+
+// Replaces the per-channel generators with a bank of `tones` tones
+// rendered across `render_threads` threads (0 = one per core). Must be
+// called before the generator thread starts.
+bool waveform_generator_set_tones(WaveformGenerator *gen, int tones, int render_threads) {
+    if (!gen || gen->generator_thread || tones < 0 || tones > MAX_TONES) {
+        LOG_ERROR("Cannot configure %d tones", tones);
+        return false;
+    }
+
+    RenderPool *pool = render_pool_create(MAX(tones, MAX_OUTPUT_CHANNELS), render_threads);
+    if (!pool) return false;
+
+    render_pool_destroy(gen->pool);
+    gen->pool = pool;
+    gen->tones = tones;
+    reset_instances(gen);
+    LOG_INFO("Generator: %d tones", tones);
+    return true;
+}
+
+// Switches the output between the per-channel generators and the voice
+// engine. Notes go straight to gen->voices through voice_engine_note_on().
+void waveform_generator_set_poly(WaveformGenerator *gen, bool enable) {
+    if (!gen) return;
+
+    g_atomic_int_set(&gen->poly, enable);
+    if (!enable) {
+        voice_engine_all_off(gen->voices);
+    }
+    LOG_INFO("Generator: %s", enable ? "polyphonic voices" : "channel generators");
+}
+
+// Current position of the event clock. Events timestamped at or after
+// this reach the output on their exact sample; earlier ones apply at the
+// start of the next block.
+guint64 waveform_generator_get_sample_time(WaveformGenerator *gen) {
+    if (!gen) return 0;
+
+    g_mutex_lock(&gen->mutex);
+    guint64 now = gen->sample_time;
+    g_mutex_unlock(&gen->mutex);
+    return now;
+}
+
+uint32_t waveform_generator_get_sample_rate(WaveformGenerator *gen) {
+    if (!gen) return 0;
+
+    g_mutex_lock(&gen->mutex);
+    uint32_t sample_rate = gen->sample_rate;
+    g_mutex_unlock(&gen->mutex);
+    return sample_rate;
+}
+
+// Fixes the channel layout for waveform_generator_render(). With an audio
+// stream the layout follows the output ring instead.
+bool waveform_generator_set_channels(WaveformGenerator *gen, int channels) {
+    if (!gen || gen->generator_thread || channels <= 0 || channels > MAX_OUTPUT_CHANNELS) {
+        LOG_ERROR("Cannot configure %d generator channels", channels);
+        return false;
+    }
+
+    gen->channels = channels;
+    reset_instances(gen);
+    return true;
+}
+
+// Renders interleaved frames straight into `out`, bypassing the output
+// ring, for headless use. Must not run alongside the generator thread.
+void waveform_generator_render(WaveformGenerator *gen, float *out, size_t frames) {
+    while (frames > 0) {
+        size_t n = audio_callback(out, MIN(frames, (size_t)MAX_BLOCK_SIZE), gen);
+        out += n * gen->channels;
+        frames -= n;
+    }
+}
+
+// Copies sweep markers published since *cursor (start it at 0); see
+// sweep_marker_ring_read()
+int waveform_generator_read_sweep_markers(WaveformGenerator *gen, gint *cursor,
+                                          SweepMarker *out, int max) {
+    if (!gen || !cursor || !out) return 0;
+    return sweep_marker_ring_read(&gen->markers, cursor, out, max);
+}
@@ -0,0 +1,315 @@
+#include "waveform_measure.h"
+#include "logger.h"
+#include "publish_ring.h"
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+WaveformMeasure* waveform_measure_create(float window_seconds) {
+    if (window_seconds <= 0.0f) {
+        LOG_ERROR("Measure: Window must be positive");
+        return NULL;
+    }
+
+    WaveformMeasure *measure = g_new0(WaveformMeasure, 1);
+    measure->window_seconds = window_seconds;
+    return measure;
+}
+
+void waveform_measure_destroy(WaveformMeasure *measure) {
+    g_free(measure);
+}
+
+static void begin_window(WaveformMeasure *measure, guint64 sample_time) {
+    measure->window_start = sample_time;
+    measure->min = FLT_MAX;
+    measure->max = -FLT_MAX;
+    measure->sum = 0.0;
+    measure->sum_squares = 0.0;
+    measure->rises = 0;
+    measure->high_time = 0.0;
+    measure->high_at_last_rise = 0.0;
+    measure->rise_sum = 0.0;
+    measure->rise_count = 0;
+    measure->fall_sum = 0.0;
+    measure->fall_count = 0;
+}
+
+// Edges are timed only once a window has supplied the levels
+static void forget_edges(WaveformMeasure *measure) {
+    measure->have_levels = FALSE;
+    measure->from_low = FALSE;
+    measure->from_high = FALSE;
+    measure->armed_rise = FALSE;
+    measure->armed_fall = FALSE;
+}
+
+static void configure(WaveformMeasure *measure, float sample_rate) {
+    measure->sample_rate = sample_rate;
+    measure->window_frames = MAX((size_t)lround(measure->window_seconds * sample_rate), 2);
+    measure->position = 0;
+    forget_edges(measure);
+}
+
+// Linear interpolation between the sample before t and the one at t
+static inline double crossing(float previous, float current, float level, double t) {
+    return t - 1.0 + (level - previous) / (current - previous);
+}
+
+// One step of the edge logic; t is the current sample's position in the
+// window. Levels are visited in the direction of travel, so a step that
+// jumps across all three still sees them in order.
+static void edge_step(WaveformMeasure *measure, float previous, float current, double t) {
+    float low = measure->level_low;
+    float mid = measure->level_mid;
+    float high = measure->level_high;
+
+    if (current > previous) {
+        if (previous < low && current >= low) {
+            measure->low_exit = crossing(previous, current, low, t);
+            measure->from_low = TRUE;
+        }
+        if (previous < mid && current >= mid && measure->armed_rise) {
+            double at = crossing(previous, current, mid, t);
+            if (measure->rises == 0) {
+                measure->first_rise = at;
+            }
+            measure->high_at_last_rise = measure->high_time;
+            measure->last_rise = at;
+            measure->pulse_start = at;
+            measure->rises++;
+            measure->armed_rise = FALSE;
+        }
+        if (previous < high && current >= high) {
+            if (measure->from_low) {
+                measure->rise_sum += crossing(previous, current, high, t) - measure->low_exit;
+                measure->rise_count++;
+                measure->from_low = FALSE;
+            }
+            measure->armed_fall = TRUE;
+        }
+    } else if (current < previous) {
+        if (previous >= high && current < high) {
+            measure->high_exit = crossing(previous, current, high, t);
+            measure->from_high = TRUE;
+        }
+        if (previous >= mid && current < mid && measure->armed_fall) {
+            // Only pulses that started in this window count towards duty
+            if (measure->rises > 0) {
+                measure->high_time += crossing(previous, current, mid, t) - measure->pulse_start;
+            }
+            measure->armed_fall = FALSE;
+        }
+        if (previous >= low && current < low) {
+            if (measure->from_high) {
+                measure->fall_sum += crossing(previous, current, low, t) - measure->high_exit;
+                measure->fall_count++;
+                measure->from_high = FALSE;
+            }
+            measure->from_low = FALSE;
+            measure->armed_rise = TRUE;
+        }
+    }
+}
+
+// All-ones lanes where v is below level: the sign of the difference
+static inline v8si below(v8sf v, v8sf level) {
+    return (v8si)(v - level) >> 31;
+}
+
+static inline gboolean any_lane(v8si mask) {
+    uint64_t words[4];
+    memcpy(words, &mask, sizeof(words));
+    return (words[0] | words[1] | words[2] | words[3]) != 0;
+}
+
+// x[0] is the sample before the chunk, x[1..count] the chunk itself
+static void scan(WaveformMeasure *measure, const float *x, size_t count) {
+    const v8sf low = v8sf_set1(measure->level_low);
+    const v8sf mid = v8sf_set1(measure->level_mid);
+    const v8sf high = v8sf_set1(measure->level_high);
+    v8sf lo = v8sf_set1(measure->min);
+    v8sf hi = v8sf_set1(measure->max);
+    v8sf sum = v8sf_set1(0.0f);
+    v8sf squares = v8sf_set1(0.0f);
+    size_t flagged[MEASURE_CHUNK / SIMD_LANES];
+    size_t num_flagged = 0;
+
+    size_t groups = count / SIMD_LANES;
+    for (size_t g = 0; g < groups; g++) {
+        v8sf previous = v8sf_load(x + g * SIMD_LANES);
+        v8sf current = v8sf_load(x + g * SIMD_LANES + 1);
+
+        lo = v8sf_min(lo, current);
+        hi = v8sf_max(hi, current);
+        sum += current;
+        squares += current * current;
+
+        v8si crossed = (below(previous, low) ^ below(current, low)) |
+                       (below(previous, mid) ^ below(current, mid)) |
+                       (below(previous, high) ^ below(current, high));
+        if (any_lane(crossed)) {
+            flagged[num_flagged++] = g;
+        }
+    }
+
+    float chunk_min = measure->min;
+    float chunk_max = measure->max;
+    for (int lane = 0; lane < SIMD_LANES; lane++) {
+        chunk_min = fminf(chunk_min, lo[lane]);
+        chunk_max = fmaxf(chunk_max, hi[lane]);
+    }
+    double chunk_sum = v8sf_hsum(sum);
+    double chunk_squares = v8sf_hsum(squares);
+    for (size_t i = groups * SIMD_LANES; i < count; i++) {
+        float v = x[i + 1];
+        chunk_min = fminf(chunk_min, v);
+        chunk_max = fmaxf(chunk_max, v);
+        chunk_sum += v;
+        chunk_squares += (double)v * v;
+    }
+    measure->min = chunk_min;
+    measure->max = chunk_max;
+    measure->sum += chunk_sum;
+    measure->sum_squares += chunk_squares;
+
+    if (!measure->have_levels) return;
+
+    // Chunk sample i sits at window position + i
+    double base = (double)measure->position;
+    for (size_t f = 0; f < num_flagged; f++) {
+        size_t start = flagged[f] * SIMD_LANES;
+        for (size_t i = start; i < start + SIMD_LANES; i++) {
+            edge_step(measure, x[i], x[i + 1], base + i);
+        }
+    }
+    for (size_t i = groups * SIMD_LANES; i < count; i++) {
+        edge_step(measure, x[i], x[i + 1], base + i);
+    }
+}
+
+static void publish(WaveformMeasure *measure) {
+    double frames = (double)measure->window_frames;
+    double rate = measure->sample_rate;
+    WaveformMeasurement result = {0};
+
+    result.sample_time = measure->window_start;
+    result.duration = (float)(frames / rate);
+    result.min = measure->min;
+    result.max = measure->max;
+    result.vpp = measure->max - measure->min;
+    double mean = measure->sum / frames;
+    double mean_square = measure->sum_squares / frames;
+    result.mean = (float)mean;
+    result.rms = (float)sqrt(mean_square);
+    result.ac_rms = (float)sqrt(fmax(mean_square - mean * mean, 0.0));
+    if (result.rms > 0.0f) {
+        result.crest_factor = fmaxf(fabsf(result.max), fabsf(result.min)) / result.rms;
+    }
+
+    result.edges = measure->rises;
+    if (measure->rises >= 2) {
+        double span = measure->last_rise - measure->first_rise;
+        result.period = (float)(span / (measure->rises - 1) / rate);
+        result.frequency = 1.0f / result.period;
+        result.duty_percent = (float)(100.0 * measure->high_at_last_rise / span);
+    }
+    if (measure->rise_count > 0) {
+        result.rise_time = (float)(measure->rise_sum / measure->rise_count / rate);
+    }
+    if (measure->fall_count > 0) {
+        result.fall_time = (float)(measure->fall_sum / measure->fall_count / rate);
+    }
+
+    publish_ring_push(measure->ring, sizeof(WaveformMeasurement), MEASURE_RING_SIZE,
+                      &measure->written, &result);
+
+    // Carried edge times move to the next window's origin
+    measure->low_exit -= frames;
+    measure->high_exit -= frames;
+    measure->pulse_start -= frames;
+
+    // This window's extremes set the levels for the next one
+    if (result.vpp < MEASURE_MIN_SWING) {
+        forget_edges(measure);
+        return;
+    }
+    measure->level_low = result.min + 0.1f * result.vpp;
+    measure->level_mid = result.min + 0.5f * result.vpp;
+    measure->level_high = result.min + 0.9f * result.vpp;
+    if (!measure->have_levels) {
+        measure->armed_rise = measure->last_sample < measure->level_low;
+        measure->armed_fall = measure->last_sample >= measure->level_high;
+        measure->have_levels = TRUE;
+    }
+}
+
+// Feeds channel 0 of an interleaved block. Windows run back to back on the
+// sample clock; a gap in sample_time restarts the current one.
+void waveform_measure_process(WaveformMeasure *measure, const float *samples, size_t frames,
+                              int stride, guint64 sample_time, float sample_rate) {
+    if (!measure || !samples || frames == 0 || sample_rate <= 0.0f) return;
+
+    if (sample_rate != measure->sample_rate) {
+        configure(measure, sample_rate);
+        measure->last_sample = samples[0];
+    }
+    if (measure->position > 0 && sample_time != measure->window_start + measure->position) {
+        measure->position = 0;
+        measure->last_sample = samples[0];
+        forget_edges(measure);
+    }
+
+    float chunk[MEASURE_CHUNK + 1];
+    size_t done = 0;
+    while (done < frames) {
+        if (measure->position == 0) {
+            begin_window(measure, sample_time + done);
+        }
+
+        size_t count = MIN(frames - done, (size_t)MEASURE_CHUNK);
+        count = MIN(count, measure->window_frames - measure->position);
+
+        chunk[0] = measure->last_sample;
+        for (size_t i = 0; i < count; i++) {
+            chunk[i + 1] = samples[(done + i) * stride];
+        }
+        scan(measure, chunk, count);
+        measure->last_sample = chunk[count];
+
+        measure->position += count;
+        done += count;
+        if (measure->position == measure->window_frames) {
+            publish(measure);
+            measure->position = 0;
+        }
+    }
+}
+
+// The newest window; FALSE until the first one completes
+gboolean waveform_measure_latest(const WaveformMeasure *measure, WaveformMeasurement *out) {
+    if (!measure || !out) return FALSE;
+    return publish_ring_latest(measure->ring, sizeof(WaveformMeasurement), MEASURE_RING_SIZE,
+                               &measure->written, out);
+}
+
+// Copies up to `max` windows after *cursor and advances it, by the rules
+// in publish_ring.h
+int waveform_measure_read(const WaveformMeasure *measure, gint *cursor,
+                          WaveformMeasurement *out, int max) {
+    if (!measure || !cursor || !out) return 0;
+    return publish_ring_read(measure->ring, sizeof(WaveformMeasurement), MEASURE_RING_SIZE,
+                             &measure->written, cursor, out, max);
+}
+
+void waveform_measure_write_header(FILE *file) {
+    fprintf(file, "# sample_time duration_s min max vpp mean rms ac_rms crest edges "
+                  "frequency_hz period_s duty_percent rise_s fall_s\n");
+}
+
+void waveform_measure_write(FILE *file, const WaveformMeasurement *m) {
+    fprintf(file, "%" G_GUINT64_FORMAT " %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.4f %d %.4f %.9f %.3f %.9f %.9f\n",
+            m->sample_time, m->duration, m->min, m->max, m->vpp, m->mean, m->rms, m->ac_rms,
+            m->crest_factor, m->edges, m->frequency, m->period, m->duty_percent,
+            m->rise_time, m->fall_time);
+}
@@ -1,4 +1,6 @@
 #include "window_manager.h"
+#include "scope_window.h"
+#include "logger.h"
 #include <gtk/gtk.h>
 
 
@@ -111,11 +113,85 @@ static void on_device_selected(GtkMenuItem *item, gpointer user_data) {
     static void on_audio_capture_toggled(GtkCheckMenuItem *item, gpointer user_data) {
         WindowManager *manager = (WindowManager *)user_data;
         bool enable = gtk_check_menu_item_get_active(item);
+        if (manager->audio_manager && !audio_manager_toggle_capture(manager->audio_manager, enable) &&
+            enable) {
+            LOG_WARN("Capture needs running audio on a device with an input");
+            g_signal_handlers_block_by_func(item, on_audio_capture_toggled, user_data);
+            gtk_check_menu_item_set_active(item, FALSE);
+            g_signal_handlers_unblock_by_func(item, on_audio_capture_toggled, user_data);
+        }
+    }
+
+    static void on_measure_transfer_toggled(GtkCheckMenuItem *item, gpointer user_data) {
+        WindowManager *manager = (WindowManager *)user_data;
+        bool enable = gtk_check_menu_item_get_active(item);
+        if (!manager->generator || !manager->audio_manager) return;
+
+        if (!enable) {
+            scope_window_set_transfer(manager->generator->scope, NULL);
+            transfer_analyzer_stop(manager->transfer);
+            return;
+        }
+
+        if (!manager->transfer) {
+            manager->transfer = transfer_analyzer_create();
+        }
+        if (!manager->transfer ||
+            !transfer_analyzer_start(manager->transfer, manager->audio_manager, manager->generator)) {
+            LOG_ERROR("Failed to start transfer function measurement");
+            g_signal_handlers_block_by_func(item, on_measure_transfer_toggled, user_data);
+            gtk_check_menu_item_set_active(item, FALSE);
+            g_signal_handlers_unblock_by_func(item, on_measure_transfer_toggled, user_data);
+            return;
+        }
+        scope_window_set_transfer(manager->generator->scope, manager->transfer);
+    }
+
+    static void on_audio_stats_activated(GtkMenuItem *item, gpointer user_data) {
+        (void)item;
+        WindowManager *manager = (WindowManager *)user_data;
+        if (manager->audio_manager) {
+            AudioTelemetrySnapshot snapshot;
+            audio_manager_get_telemetry(manager->audio_manager, &snapshot);
+            audio_telemetry_print(&snapshot);
+            if (manager->generator) {
+                latency_controller_print(&manager->generator->latency, snapshot.sample_rate);
+            }
+        }
+    }
+
+    static void on_audio_stats_reset(GtkMenuItem *item, gpointer user_data) {
+        (void)item;
+        WindowManager *manager = (WindowManager *)user_data;
         if (manager->audio_manager) {
-            audio_manager_toggle_capture(manager->audio_manager, enable);
+            audio_manager_reset_telemetry(manager->audio_manager);
         }
     }
 
+    static void on_phosphor_toggled(GtkCheckMenuItem *item, gpointer user_data) {
+        WindowManager *manager = (WindowManager *)user_data;
+        if (manager->generator) {
+            scope_window_set_phosphor(manager->generator->scope,
+                                      gtk_check_menu_item_get_active(item));
+        }
+    }
+
+    static void on_measurements_toggled(GtkCheckMenuItem *item, gpointer user_data) {
+        WindowManager *manager = (WindowManager *)user_data;
+        if (manager->generator) {
+            scope_window_show_measurements(manager->generator->scope,
+                                           gtk_check_menu_item_get_active(item));
+        }
+    }
+
+    static void on_xy_source_toggled(GtkCheckMenuItem *item, gpointer user_data) {
+        WindowManager *manager = (WindowManager *)user_data;
+        if (!gtk_check_menu_item_get_active(item) || !manager->generator) return;
+
+        ScopeXYSource source = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(item), "xy-source"));
+        scope_window_set_xy(manager->generator->scope, source, manager->audio_manager);
+    }
+
     static GtkWidget* create_menubar(WindowManager *manager) {
         GtkWidget *menubar = gtk_menu_bar_new();
         
@@ -142,23 +218,76 @@ static void on_device_selected(GtkMenuItem *item, gpointer user_data) {
         // Audio menu items
         GtkWidget *playback_item = gtk_check_menu_item_new_with_label("Enable Playback");
         GtkWidget *capture_item = gtk_check_menu_item_new_with_label("Enable Capture");
+        GtkWidget *transfer_item = gtk_check_menu_item_new_with_label("Measure Transfer Function");
+        GtkWidget *stats_item = gtk_menu_item_new_with_label("Show Statistics");
+        GtkWidget *stats_reset_item = gtk_menu_item_new_with_label("Reset Statistics");
         
         // If no audio manager, disable the menu items
         if (!manager->audio_manager) {
             gtk_widget_set_sensitive(playback_item, FALSE);
             gtk_widget_set_sensitive(capture_item, FALSE);
+            gtk_widget_set_sensitive(transfer_item, FALSE);
             gtk_widget_set_sensitive(device_item, FALSE);
+            gtk_widget_set_sensitive(stats_item, FALSE);
+            gtk_widget_set_sensitive(stats_reset_item, FALSE);
         }
         
         gtk_menu_shell_append(GTK_MENU_SHELL(audio_menu), playback_item);
         gtk_menu_shell_append(GTK_MENU_SHELL(audio_menu), capture_item);
+        gtk_menu_shell_append(GTK_MENU_SHELL(audio_menu), transfer_item);
+        gtk_menu_shell_append(GTK_MENU_SHELL(audio_menu), gtk_separator_menu_item_new());
+        gtk_menu_shell_append(GTK_MENU_SHELL(audio_menu), stats_item);
+        gtk_menu_shell_append(GTK_MENU_SHELL(audio_menu), stats_reset_item);
         gtk_menu_shell_append(GTK_MENU_SHELL(menubar), audio_item);
+
+        // View menu
+        GtkWidget *view_menu = gtk_menu_new();
+        GtkWidget *view_item = gtk_menu_item_new_with_label("View");
+        gtk_menu_item_set_submenu(GTK_MENU_ITEM(view_item), view_menu);
+        GtkWidget *phosphor_item = gtk_check_menu_item_new_with_label("Phosphor Persistence");
+        GtkWidget *measurements_item = gtk_check_menu_item_new_with_label("Measurements");
+        gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(measurements_item), TRUE);
+        gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), measurements_item);
+        gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), phosphor_item);
+        gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), gtk_separator_menu_item_new());
+
+        // Plot modes, one radio group
+        static const struct {
+            const char *label;
+            ScopeXYSource source;
+        } plot_modes[] = {
+            { "Time Domain", SCOPE_XY_OFF },
+            { "XY: Channel 1 vs 2", SCOPE_XY_CHANNELS },
+            { "XY: Output vs Input", SCOPE_XY_CAPTURE },
+        };
+        GSList *plot_group = NULL;
+        for (size_t i = 0; i < G_N_ELEMENTS(plot_modes); i++) {
+            GtkWidget *mode_item = gtk_radio_menu_item_new_with_label(plot_group, plot_modes[i].label);
+            plot_group = gtk_radio_menu_item_get_group(GTK_RADIO_MENU_ITEM(mode_item));
+            g_object_set_data(G_OBJECT(mode_item), "xy-source", GINT_TO_POINTER(plot_modes[i].source));
+            if (plot_modes[i].source == SCOPE_XY_CAPTURE && !manager->audio_manager) {
+                gtk_widget_set_sensitive(mode_item, FALSE);
+            }
+            gtk_menu_shell_append(GTK_MENU_SHELL(view_menu), mode_item);
+            g_signal_connect(mode_item, "toggled", G_CALLBACK(on_xy_source_toggled), manager);
+        }
+        gtk_menu_shell_append(GTK_MENU_SHELL(menubar), view_item);
         
         // Connect signals
         g_signal_connect(playback_item, "toggled",
                         G_CALLBACK(on_audio_playback_toggled), manager);
         g_signal_connect(capture_item, "toggled",
                         G_CALLBACK(on_audio_capture_toggled), manager);
+        g_signal_connect(transfer_item, "toggled",
+                        G_CALLBACK(on_measure_transfer_toggled), manager);
+        g_signal_connect(measurements_item, "toggled",
+                        G_CALLBACK(on_measurements_toggled), manager);
+        g_signal_connect(phosphor_item, "toggled",
+                        G_CALLBACK(on_phosphor_toggled), manager);
+        g_signal_connect(stats_item, "activate",
+                        G_CALLBACK(on_audio_stats_activated), manager);
+        g_signal_connect(stats_reset_item, "activate",
+                        G_CALLBACK(on_audio_stats_reset), manager);
         
         return menubar;
     }
@@ -167,7 +296,7 @@ static void on_device_selected(GtkMenuItem *item, gpointer user_data) {
         (void)widget;
         (void)event;
         (void)data;
-        g_print("Window close requested\n");
+        LOG_INFO("Window close requested");
         gtk_main_quit();
         return FALSE;
     }
@@ -177,11 +306,11 @@ static void on_device_selected(GtkMenuItem *item, gpointer user_data) {
         WindowManager *manager = (WindowManager *)data;
         manager->window_width = allocation->width;
         manager->window_height = allocation->height;
-        g_print("Window resized to: %d x %d\n", allocation->width, allocation->height);
+        LOG_DEBUG("Window resized to: %d x %d", allocation->width, allocation->height);
     }
 
     WindowManager* window_manager_create(AudioManager *audio_manager, WaveformGenerator *generator) {
-        g_print("Creating window manager\n");
+        LOG_INFO("Creating window manager");
         
         WindowManager *manager = g_new0(WindowManager, 1);
         
@@ -241,14 +370,15 @@ static void on_device_selected(GtkMenuItem *item, gpointer user_data) {
     }
 
     void window_manager_run(WindowManager *manager) {
-        g_print("Showing all windows\n");
+        LOG_INFO("Showing all windows");
         gtk_widget_show_all(manager->main_window);
     }
 
     void window_manager_destroy(WindowManager *manager) {
-        g_print("Destroying window manager\n");
+        LOG_INFO("Destroying window manager");
         if (!manager) return;
         
         // Don't destroy audio_manager here since we don't own it
+        transfer_analyzer_destroy(manager->transfer);
         g_free(manager);
 }
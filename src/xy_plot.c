@@ -0,0 +1,156 @@
+#include "xy_plot.h"
+#include "logger.h"
+#include "rt_pool.h"
+#include <string.h>
+#include <math.h>
+
+#define XY_PLOT_HIT 72              // Alpha added per visit, four visits saturate
+
+XYPlot* xy_plot_create(size_t max_frames) {
+    if (max_frames < 2) return NULL;
+
+    XYPlot *plot = g_new0(XYPlot, 1);
+    plot->capacity = max_frames;
+
+    // Padded to whole vectors for the mapping pass
+    size_t padded = (max_frames + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+    plot->x = rt_pool_new(float, padded);
+    plot->y = rt_pool_new(float, padded);
+    plot->points = rt_pool_new(float, max_frames * 2);
+    if (!plot->x || !plot->y || !plot->points) {
+        LOG_ERROR("XY plot: Failed to allocate buffers for %zu frames", max_frames);
+        xy_plot_destroy(plot);
+        return NULL;
+    }
+    return plot;
+}
+
+void xy_plot_destroy(XYPlot *plot) {
+    if (!plot) return;
+    rt_pool_free(plot->x);
+    rt_pool_free(plot->y);
+    rt_pool_free(plot->points);
+    g_free(plot);
+}
+
+// Pixel positions of every pair, and the length of the path through them
+// in pixels (Manhattan, which is all the bin width needs)
+static float map_pairs(XYPlot *plot, const float *pairs, size_t frames, int size) {
+    const v8sf center = v8sf_set1(size * 0.5f);
+    const v8sf scale = v8sf_set1(size * 0.5f / XY_PLOT_FULL_SCALE);
+
+    for (size_t i = 0; i < frames; i += SIMD_LANES) {
+        float tail[SIMD_LANES * 2] = {0};
+        const float *source = pairs + i * 2;
+        if (frames - i < SIMD_LANES) {
+            memcpy(tail, source, (frames - i) * 2 * sizeof(float));
+            source = tail;
+        }
+
+        v8sf left, right;
+        v8sf_deinterleave(v8sf_load(source), v8sf_load(source + SIMD_LANES), &left, &right);
+        v8sf_store(plot->x + i, center + left * scale);
+        v8sf_store(plot->y + i, center - right * scale);
+    }
+
+    v8sf travel = v8sf_set1(0.0f);
+    size_t i = 1;
+    for (; i + SIMD_LANES <= frames; i += SIMD_LANES) {
+        travel += v8sf_abs(v8sf_load(plot->x + i) - v8sf_load(plot->x + i - 1));
+        travel += v8sf_abs(v8sf_load(plot->y + i) - v8sf_load(plot->y + i - 1));
+    }
+    float length = v8sf_hsum(travel);
+    for (; i < frames; i++) {
+        length += fabsf(plot->x[i] - plot->x[i - 1]) + fabsf(plot->y[i] - plot->y[i - 1]);
+    }
+    return length;
+}
+
+// Far off-screen points are pulled in so segments towards them stay short
+static void emit(XYPlot *plot, size_t index, float limit) {
+    float *point = plot->points + plot->num_points * 2;
+    point[0] = fminf(fmaxf(plot->x[index], -limit), 2.0f * limit);
+    point[1] = fminf(fmaxf(plot->y[index], -limit), 2.0f * limit);
+    plot->num_points++;
+}
+
+// Bins are as many pairs as travel one pixel on average. Each keeps the
+// two pairs at the ends of its range on whichever axis it moves further.
+static void decimate(XYPlot *plot, size_t frames, float length, int size) {
+    plot->bin_frames = MAX((size_t)(frames / fmaxf(length, 1.0f)), 1);
+    plot->num_points = 0;
+
+    for (size_t start = 0; start < frames; start += plot->bin_frames) {
+        size_t end = MIN(start + plot->bin_frames, frames);
+        if (end - start == 1) {
+            emit(plot, start, size);
+            continue;
+        }
+
+        size_t x_lo = start, x_hi = start, y_lo = start, y_hi = start;
+        for (size_t i = start + 1; i < end; i++) {
+            if (plot->x[i] < plot->x[x_lo]) x_lo = i;
+            if (plot->x[i] > plot->x[x_hi]) x_hi = i;
+            if (plot->y[i] < plot->y[y_lo]) y_lo = i;
+            if (plot->y[i] > plot->y[y_hi]) y_hi = i;
+        }
+
+        gboolean use_x = plot->x[x_hi] - plot->x[x_lo] >= plot->y[y_hi] - plot->y[y_lo];
+        size_t lo = use_x ? x_lo : y_lo;
+        size_t hi = use_x ? x_hi : y_hi;
+        emit(plot, MIN(lo, hi), size);
+        if (lo != hi) {
+            emit(plot, MAX(lo, hi), size);
+        }
+    }
+}
+
+static inline void hit(guint8 *pixels, int stride, int size, const guint32 *levels, float x, float y) {
+    int px = (int)floorf(x);
+    int py = (int)floorf(y);
+    if (px < 0 || py < 0 || px >= size || py >= size) return;
+
+    guint32 *pixel = (guint32 *)(pixels + (size_t)py * stride) + px;
+    *pixel = levels[MIN((*pixel >> 24) + XY_PLOT_HIT, 255u)];
+}
+
+// Clears the image, then draws the pairs as a connected path. Returns the
+// number of points left after decimation.
+size_t xy_plot_render(XYPlot *plot, const float *pairs, size_t frames,
+                      guint8 *pixels, int stride, int size,
+                      float red, float green, float blue) {
+    if (!plot || !pixels || size < 1) return 0;
+
+    for (int row = 0; row < size; row++) {
+        memset(pixels + (size_t)row * stride, 0, (size_t)size * sizeof(guint32));
+    }
+    plot->num_points = 0;
+    if (!pairs || frames == 0) return 0;
+    frames = MIN(frames, plot->capacity);
+
+    // Premultiplied colour at every alpha, indexed by the alpha reached
+    guint32 levels[256];
+    for (guint32 a = 0; a < 256; a++) {
+        levels[a] = (a << 24) | ((guint32)lroundf(red * a) << 16) |
+                    ((guint32)lroundf(green * a) << 8) | (guint32)lroundf(blue * a);
+    }
+
+    float length = map_pairs(plot, pairs, frames, size);
+    decimate(plot, frames, length, size);
+
+    const float *point = plot->points;
+    hit(pixels, stride, size, levels, point[0], point[1]);
+    for (size_t i = 1; i < plot->num_points; i++) {
+        float x = point[(i - 1) * 2];
+        float y = point[(i - 1) * 2 + 1];
+        float dx = point[i * 2] - x;
+        float dy = point[i * 2 + 1] - y;
+        int steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy)));
+
+        // The first point of each segment is the last of the one before
+        for (int s = 1; s <= steps; s++) {
+            hit(pixels, stride, size, levels, x + dx * s / steps, y + dy * s / steps);
+        }
+    }
+    return plot->num_points;
+}